@@ -22,11 +22,23 @@
 #include "cache_service.hh"
 #include "api/api-doc/cache_service.json.hh"
 #include "column_family.hh"
+#include "sstables/index_cache.hh"
 
 namespace api {
 using namespace json;
 namespace cs = httpd::cache_service_json;
 
+// Scylla has no key cache, but the index cache plays the same role: it saves
+// the index lookup of partitions, so we report it as the key cache.
+template<typename Func, typename T>
+static future<json::json_return_type> map_reduce_index_cache(http_context& ctx, T init, Func&& func) {
+    return ctx.db.map_reduce0([func = std::forward<Func>(func)](database&) {
+        return func(sstables::global_index_cache());
+    }, init, std::plus<T>()).then([](T res) {
+        return make_ready_future<json::json_return_type>(res);
+    });
+}
+
 void set_cache_service(http_context& ctx, routes& r) {
     cs::get_row_cache_save_period_in_seconds.set(r, [](std::unique_ptr<request> req) {
         // We never save the cache
@@ -106,10 +118,12 @@ void set_cache_service(http_context& ctx, routes& r) {
         return make_ready_future<json::json_return_type>(json_void());
     });
 
-    cs::invalidate_key_cache.set(r, [](std::unique_ptr<request> req) {
-        // TBD
-        unimplemented();
-        return make_ready_future<json::json_return_type>(json_void());
+    cs::invalidate_key_cache.set(r, [&ctx](std::unique_ptr<request> req) {
+        return ctx.db.invoke_on_all([] (database&) {
+            sstables::global_index_cache().clear();
+        }).then([] {
+            return make_ready_future<json::json_return_type>(json_void());
+        });
     });
 
     cs::invalidate_counter_cache.set(r, [](std::unique_ptr<request> req) {
@@ -145,52 +159,40 @@ void set_cache_service(http_context& ctx, routes& r) {
         return make_ready_future<json::json_return_type>(json_void());
     });
 
-    cs::get_key_capacity.set(r, [] (std::unique_ptr<request> req) {
-        // TBD
-        // FIXME
-        // we don't support keys cache,
-        // so currently returning a 0 for capacity is ok
-        return make_ready_future<json::json_return_type>(0);
+    cs::get_key_capacity.set(r, [&ctx] (std::unique_ptr<request> req) {
+        return map_reduce_index_cache(ctx, uint64_t(0), [] (const sstables::index_cache& c) {
+            return c.max_size();
+        });
     });
 
-    cs::get_key_hits.set(r, [] (std::unique_ptr<request> req) {
-        // TBD
-        // FIXME
-        // we don't support keys cache,
-        // so currently returning a 0 for hits is ok
-        return make_ready_future<json::json_return_type>(0);
+    cs::get_key_hits.set(r, [&ctx] (std::unique_ptr<request> req) {
+        return map_reduce_index_cache(ctx, uint64_t(0), [] (const sstables::index_cache& c) {
+            return c.get_stats().hits;
+        });
     });
 
-    cs::get_key_requests.set(r, [] (std::unique_ptr<request> req) {
-        // TBD
-        // FIXME
-        // we don't support keys cache,
-        // so currently returning a 0 for request is ok
-        return make_ready_future<json::json_return_type>(0);
+    cs::get_key_requests.set(r, [&ctx] (std::unique_ptr<request> req) {
+        return map_reduce_index_cache(ctx, uint64_t(0), [] (const sstables::index_cache& c) {
+            return c.get_stats().hits + c.get_stats().misses;
+        });
     });
 
-    cs::get_key_hit_rate.set(r, [] (std::unique_ptr<request> req) {
-        // TBD
-        // FIXME
-        // we don't support keys cache,
-        // so currently returning a 0 for rate is ok
-        return make_ready_future<json::json_return_type>(0);
+    cs::get_key_hit_rate.set(r, [&ctx] (std::unique_ptr<request> req) {
+        return map_reduce_index_cache(ctx, ratio_holder(), [] (const sstables::index_cache& c) {
+            return ratio_holder(c.get_stats().hits + c.get_stats().misses, c.get_stats().hits);
+        });
     });
 
-    cs::get_key_size.set(r, [] (std::unique_ptr<request> req) {
-        // TBD
-        // FIXME
-        // we don't support keys cache,
-        // so currently returning a 0 for size is ok
-        return make_ready_future<json::json_return_type>(0);
+    cs::get_key_size.set(r, [&ctx] (std::unique_ptr<request> req) {
+        return map_reduce_index_cache(ctx, uint64_t(0), [] (const sstables::index_cache& c) {
+            return c.region().occupancy().used_space();
+        });
     });
 
-    cs::get_key_entries.set(r, [] (std::unique_ptr<request> req) {
-        // TBD
-        // FIXME
-        // we don't support keys cache,
-        // so currently returning a 0 for key entries is ok
-        return make_ready_future<json::json_return_type>(0);
+    cs::get_key_entries.set(r, [&ctx] (std::unique_ptr<request> req) {
+        return map_reduce_index_cache(ctx, uint64_t(0), [] (const sstables::index_cache& c) {
+            return c.pages();
+        });
     });
 
     cs::get_row_capacity.set(r, [&ctx] (std::unique_ptr<request> req) {
@@ -21,6 +21,7 @@
 
 #include "hinted_handoff.hh"
 #include "api/api-doc/hinted_handoff.json.hh"
+#include "db/hints/manager.hh"
 
 namespace api {
 
@@ -30,47 +31,67 @@ namespace hh = httpd::hinted_handoff_json;
 
 void set_hinted_handoff(http_context& ctx, routes& r) {
     hh::list_endpoints_pending_hints.set(r, [] (std::unique_ptr<request> req) {
-        //TBD
-        unimplemented();
-        std::vector<sstring> res;
-        return make_ready_future<json::json_return_type>(res);
+        auto res = make_shared<std::set<sstring>>();
+        return db::hints::get_manager().map_reduce([res] (std::vector<gms::inet_address> eps) {
+            for (auto& ep : eps) {
+                res->insert(ep.to_sstring());
+            }
+        }, [] (db::hints::manager& m) {
+            return make_ready_future<std::vector<gms::inet_address>>(m.endpoints_pending_hints());
+        }).then([res] {
+            return make_ready_future<json::json_return_type>(std::vector<sstring>(res->begin(), res->end()));
+        });
     });
 
     hh::truncate_all_hints.set(r, [] (std::unique_ptr<request> req) {
-        //TBD
-        unimplemented();
         sstring host = req->get_query_param("host");
-        return make_ready_future<json::json_return_type>(json_void());
+        std::experimental::optional<gms::inet_address> ep;
+        if (!host.empty()) {
+            ep = gms::inet_address(host);
+        }
+        return db::hints::get_manager().invoke_on_all([ep] (db::hints::manager& m) {
+            return m.truncate_hints(ep);
+        }).then([] {
+            return make_ready_future<json::json_return_type>(json_void());
+        });
     });
 
     hh::schedule_hint_delivery.set(r, [] (std::unique_ptr<request> req) {
-        //TBD
-        unimplemented();
-        sstring host = req->get_query_param("host");
-        return make_ready_future<json::json_return_type>(json_void());
+        gms::inet_address ep(req->get_query_param("host"));
+        return db::hints::get_manager().invoke_on_all([ep] (db::hints::manager& m) {
+            m.schedule_delivery(ep);
+        }).then([] {
+            return make_ready_future<json::json_return_type>(json_void());
+        });
     });
 
     hh::pause_hints_delivery.set(r, [] (std::unique_ptr<request> req) {
-        //TBD
-        unimplemented();
-        sstring pause = req->get_query_param("pause");
-        return make_ready_future<json::json_return_type>(json_void());
+        auto val_str = req->get_query_param("pause");
+        bool pause = (val_str == "True") || (val_str == "true") || (val_str == "1");
+        return db::hints::get_manager().invoke_on_all([pause] (db::hints::manager& m) {
+            m.pause_delivery(pause);
+        }).then([] {
+            return make_ready_future<json::json_return_type>(json_void());
+        });
     });
 
     hh::get_create_hint_count.set(r, [] (std::unique_ptr<request> req) {
-        //TBD
-        unimplemented();
-        sstring host = req->get_query_param("host");
-        return make_ready_future<json::json_return_type>(0);
+        gms::inet_address ep(req->param["addr"]);
+        return db::hints::get_manager().map_reduce0([ep] (db::hints::manager& m) {
+            return m.get_create_hint_count(ep);
+        }, uint64_t(0), std::plus<uint64_t>()).then([] (uint64_t count) {
+            return make_ready_future<json::json_return_type>(count);
+        });
     });
 
     hh::get_not_stored_hints_count.set(r, [] (std::unique_ptr<request> req) {
-        //TBD
-        unimplemented();
-        sstring host = req->get_query_param("host");
-        return make_ready_future<json::json_return_type>(0);
+        gms::inet_address ep(req->param["addr"]);
+        return db::hints::get_manager().map_reduce0([ep] (db::hints::manager& m) {
+            return m.get_not_stored_hints_count(ep);
+        }, uint64_t(0), std::plus<uint64_t>()).then([] (uint64_t count) {
+            return make_ready_future<json::json_return_type>(count);
+        });
     });
 }
 
 }
-
@@ -232,6 +232,14 @@ void set_storage_proxy(http_context& ctx, routes& r) {
         return sum_stats(ctx.sp, &proxy::stats::read_repair_repaired_background);
     });
 
+    sp::get_speculative_retries.set(r, [&ctx](std::unique_ptr<request> req)  {
+        return sum_stats(ctx.sp, &proxy::stats::speculative_retries);
+    });
+
+    sp::get_speculative_retries_won.set(r, [&ctx](std::unique_ptr<request> req)  {
+        return sum_stats(ctx.sp, &proxy::stats::speculative_retries_won);
+    });
+
     sp::get_schema_versions.set(r, [](std::unique_ptr<request> req)  {
         return service::get_local_storage_service().describe_schema_versions().then([] (auto result) {
             std::vector<sp::mapper_list> res;
@@ -96,6 +96,17 @@ create_partition_slice_filter(schema_ptr s, const partition_slice& slice) {
     return ::make_shared<partition_slice_clustering_key_filter_factory>(std::move(s), slice);
 }
 
+clustering_key_filtering_context
+clustering_key_filtering_context::create_for_ranges(schema_ptr schema, std::vector<range<clustering_key_prefix>> ranges) {
+    auto filter = [schema, ranges] (const clustering_key& key) {
+        clustering_key_prefix::prefix_equal_tri_compare cmp(*schema);
+        return std::any_of(std::begin(ranges), std::end(ranges),
+            [&cmp, &key] (const range<clustering_key_prefix>& r) { return r.contains(key, cmp); });
+    };
+    return clustering_key_filtering_context(
+        ::make_shared<stateless_clustering_key_filter_factory>(std::move(ranges), std::move(filter)));
+}
+
 const clustering_key_filtering_context
 clustering_key_filtering_context::create(schema_ptr schema, const partition_slice& slice) {
     static thread_local clustering_key_filtering_context accept_all = clustering_key_filtering_context(
@@ -67,6 +67,9 @@ class clustering_key_filtering_context {
 
     static const clustering_key_filtering_context create(schema_ptr, const partition_slice&);
 
+    // Creates a filtering context selecting the given ranges in every partition.
+    static clustering_key_filtering_context create_for_ranges(schema_ptr, std::vector<range<clustering_key_prefix>>);
+
     static clustering_key_filtering_context create_no_filtering();
 };
 
@@ -30,7 +30,7 @@ enum class compaction_strategy_type {
     major,
     size_tiered,
     leveled,
-    // FIXME: Add support to DateTiered.
+    time_window,
 };
 
 class compaction_strategy_impl;
@@ -64,6 +64,8 @@ class compaction_strategy {
             return "SizeTieredCompactionStrategy";
         case compaction_strategy_type::leveled:
             return "LeveledCompactionStrategy";
+        case compaction_strategy_type::time_window:
+            return "TimeWindowCompactionStrategy";
         default:
             throw std::runtime_error("Invalid Compaction Strategy");
         }
@@ -80,6 +82,8 @@ class compaction_strategy {
             return compaction_strategy_type::size_tiered;
         } else if (short_name == "LeveledCompactionStrategy") {
             return compaction_strategy_type::leveled;
+        } else if (short_name == "TimeWindowCompactionStrategy") {
+            return compaction_strategy_type::time_window;
         } else {
             throw exceptions::configuration_exception(sprint("Unable to find compaction strategy class '%s'", name));
         }
@@ -36,6 +36,8 @@ template<allow_prefixes AllowPrefixes = allow_prefixes::no>
 class compound_type final {
 private:
     const std::vector<data_type> _types;
+    // Comparators of the components, built along with the schema.
+    const std::vector<value_comparator> _comparators;
     const bool _byte_order_equal;
     const bool _byte_order_comparable;
     const bool _is_reversed;
@@ -47,6 +49,7 @@ class compound_type final {
 
     compound_type(std::vector<data_type> types)
         : _types(std::move(types))
+        , _comparators(_types.begin(), _types.end())
         , _byte_order_equal(std::all_of(_types.begin(), _types.end(), [] (auto t) {
                 return t->is_byte_order_equal();
             }))
@@ -60,6 +63,12 @@ class compound_type final {
         return _types;
     }
 
+    // Comparators of the components, for use in place of types() with
+    // value_comparator_tri_compare.
+    auto const& comparators() const {
+        return _comparators;
+    }
+
     bool is_singular() const {
         return _types.size() == 1;
     }
@@ -210,10 +219,8 @@ class compound_type final {
                 return compare_unsigned(b1, b2);
             }
         }
-        return lexicographical_tri_compare(_types.begin(), _types.end(),
-            begin(b1), end(b1), begin(b2), end(b2), [] (auto&& type, auto&& v1, auto&& v2) {
-                return type->compare(v1, v2);
-            });
+        return lexicographical_tri_compare(_comparators.begin(), _comparators.end(),
+            begin(b1), end(b1), begin(b2), end(b2), value_comparator_tri_compare());
     }
     // Retruns true iff given prefix has no missing components
     bool is_full(bytes_view v) const {
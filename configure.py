@@ -170,6 +170,7 @@ scylla_tests = [
     'tests/partitioner_test',
     'tests/frozen_mutation_test',
     'tests/perf/perf_mutation',
+    'tests/perf/perf_key_compare',
     'tests/lsa_async_eviction_test',
     'tests/lsa_sync_eviction_test',
     'tests/row_cache_alloc_stress',
@@ -180,17 +181,23 @@ scylla_tests = [
     'tests/memory_footprint',
     'tests/perf/perf_sstable',
     'tests/cql_query_test',
+    'tests/cql_compression_test',
+    'tests/admission_controller_test',
     'tests/storage_proxy_test',
+    'tests/sstable_streaming_test',
     'tests/schema_change_test',
     'tests/mutation_reader_test',
+    'tests/streamed_mutation_test',
     'tests/key_reader_test',
     'tests/mutation_query_test',
+    'tests/querier_cache_test',
     'tests/row_cache_test',
     'tests/test-serialization',
     'tests/sstable_test',
     'tests/sstable_mutation_test',
     'tests/memtable_test',
     'tests/commitlog_test',
+    'tests/hints_manager_test',
     'tests/cartesian_product_test',
     'tests/hash_test',
     'tests/map_difference_test',
@@ -198,6 +205,7 @@ scylla_tests = [
     'tests/gossip',
     'tests/gossip_test',
     'tests/compound_test',
+    'tests/checksum_tree_test',
     'tests/config_test',
     'tests/gossiping_property_file_snitch_test',
     'tests/ec2_snitch_test',
@@ -291,7 +299,9 @@ scylla_core = (['database.cc',
                  'mutation_partition_view.cc',
                  'mutation_partition_serializer.cc',
                  'mutation_reader.cc',
+                 'streamed_mutation.cc',
                  'mutation_query.cc',
+                 'querier.cc',
                  'key_reader.cc',
                  'keys.cc',
                  'clustering_key_filter.cc',
@@ -304,6 +314,8 @@ scylla_core = (['database.cc',
                  'sstables/compaction.cc',
                  'sstables/compaction_strategy.cc',
                  'sstables/compaction_manager.cc',
+                 'sstables/sstable_set.cc',
+                 'sstables/index_cache.cc',
                  'transport/event.cc',
                  'transport/event_notifier.cc',
                  'transport/server.cc',
@@ -398,6 +410,7 @@ scylla_core = (['database.cc',
                  'db/index/secondary_index.cc',
                  'db/marshal/type_parser.cc',
                  'db/batchlog_manager.cc',
+                 'db/hints/manager.cc',
                  'io/io.cc',
                  'utils/utils.cc',
                  'utils/UUID_gen.cc',
@@ -452,6 +465,7 @@ scylla_core = (['database.cc',
                  'streaming/stream_request.cc',
                  'streaming/stream_summary.cc',
                  'streaming/stream_transfer_task.cc',
+                 'streaming/stream_sstable_files.cc',
                  'streaming/stream_receive_task.cc',
                  'streaming/stream_plan.cc',
                  'streaming/progress_info.cc',
@@ -560,8 +574,10 @@ deps = {
 tests_not_using_seastar_test_framework = set([
     'tests/keys_test',
     'tests/partitioner_test',
+    'tests/checksum_tree_test',
     'tests/map_difference_test',
     'tests/perf/perf_mutation',
+    'tests/perf/perf_key_compare',
     'tests/lsa_async_eviction_test',
     'tests/lsa_sync_eviction_test',
     'tests/row_cache_alloc_stress',
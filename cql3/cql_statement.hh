@@ -107,6 +107,17 @@ class cql_statement {
     virtual bool depends_on_column_family(const sstring& cf_name) const = 0;
 
     virtual shared_ptr<const metadata> get_result_metadata() const = 0;
+
+    /**
+     * Returns the token of the partition the statement is restricted to with
+     * the given values, or nothing if it may touch more than one partition.
+     * Used to route a request to the shard which owns its data.
+     *
+     * @param options options for this query, with the bound values prepared
+     */
+    virtual std::experimental::optional<dht::token> routing_token(const query_options& options) {
+        return {};
+    }
 };
 
 class cql_statement_no_metadata : public cql_statement {
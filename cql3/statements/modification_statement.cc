@@ -645,6 +645,18 @@ bool modification_statement::depends_on_column_family(const sstring& cf_name) co
     return column_family() == cf_name;
 }
 
+std::experimental::optional<dht::token>
+modification_statement::routing_token(const query_options& options) {
+    if (_processed_keys.size() < s->partition_key_size()) {
+        return {};
+    }
+    auto keys = build_partition_keys(options);
+    if (keys.size() != 1) {
+        return {};
+    }
+    return dht::global_partitioner().get_token(*s, keys.front());
+}
+
 void modification_statement::add_operation(::shared_ptr<operation> op) {
     if (op->column.is_static()) {
         _sets_static_columns = true;
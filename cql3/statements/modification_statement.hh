@@ -198,6 +198,8 @@ class modification_statement : public cql_statement_no_metadata {
     virtual future<::shared_ptr<transport::messages::result_message>>
     execute_internal(distributed<service::storage_proxy>& proxy, service::query_state& qs, const query_options& options) override;
 
+    virtual std::experimental::optional<dht::token> routing_token(const query_options& options) override;
+
 private:
     future<>
     execute_without_condition(distributed<service::storage_proxy>& proxy, service::query_state& qs, const query_options& options);
@@ -143,6 +143,18 @@ bool select_statement::depends_on_column_family(const sstring& cf_name) const {
     return column_family() == cf_name;
 }
 
+std::experimental::optional<dht::token>
+select_statement::routing_token(const query_options& options) {
+    if (_restrictions->is_key_range() || _restrictions->key_is_in_relation()) {
+        return {};
+    }
+    auto ranges = _restrictions->get_partition_key_ranges(options);
+    if (ranges.size() != 1 || !ranges.front().is_singular()) {
+        return {};
+    }
+    return ranges.front().start()->value().token();
+}
+
 const sstring& select_statement::keyspace() const {
     return _schema->ks_name();
 }
@@ -226,7 +238,7 @@ select_statement::execute(distributed<service::storage_proxy>& proxy,
     auto now = db_clock::now();
 
     auto command = ::make_lw_shared<query::read_command>(_schema->id(), _schema->version(),
-        make_partition_slice(options), limit, to_gc_clock(now), std::experimental::nullopt, options.get_timestamp(state));
+        make_partition_slice(options), limit, to_gc_clock(now), std::experimental::nullopt, std::experimental::nullopt, options.get_timestamp(state));
 
     if (state.is_tracing()) {
         command->trace_info.emplace(std::move(state.tracing_session_id()), state.trace_type(), state.flush_trace_on_close());
@@ -328,7 +340,7 @@ select_statement::execute_internal(distributed<service::storage_proxy>& proxy,
     int32_t limit = get_limit(options);
     auto now = db_clock::now();
     auto command = ::make_lw_shared<query::read_command>(_schema->id(), _schema->version(),
-        make_partition_slice(options), limit, to_gc_clock(now), std::experimental::nullopt, options.get_timestamp(state));
+        make_partition_slice(options), limit, to_gc_clock(now), std::experimental::nullopt, std::experimental::nullopt, options.get_timestamp(state));
     auto partition_ranges = _restrictions->get_partition_key_ranges(options);
 
     if (needs_post_query_ordering() && _limit) {
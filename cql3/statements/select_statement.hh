@@ -120,6 +120,8 @@ class select_statement : public cql_statement {
     virtual future<::shared_ptr<transport::messages::result_message>> execute_internal(distributed<service::storage_proxy>& proxy,
             service::query_state& state, const query_options& options) override;
 
+    virtual std::experimental::optional<dht::token> routing_token(const query_options& options) override;
+
     future<::shared_ptr<transport::messages::result_message>> execute(distributed<service::storage_proxy>& proxy,
         lw_shared_ptr<query::read_command> cmd, std::vector<query::partition_range>&& partition_ranges, service::query_state& state,
          const query_options& options, db_clock::time_point now);
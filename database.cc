@@ -114,6 +114,7 @@ column_family::column_family(schema_ptr schema, config config, db::commitlog* cl
     , _memtables(_config.enable_disk_writes ? make_memtable_list() : make_memory_only_memtable_list())
     , _streaming_memtables(_config.enable_disk_writes ? make_streaming_memtable_list() : make_memory_only_memtable_list())
     , _sstables(make_lw_shared<sstable_list>())
+    , _sstable_set(make_lw_shared<sstables::sstable_set>(_schema))
     , _cache(_schema, sstables_as_mutation_source(), sstables_as_key_source(), global_cache_tracker())
     , _commitlog(cl)
     , _compaction_manager(compaction_manager)
@@ -162,46 +163,55 @@ logalloc::occupancy_stats column_family::occupancy() const {
     return res;
 }
 
+api::timestamp_type column_family::min_memtable_timestamp() const {
+    auto min_timestamp = api::max_timestamp;
+    for (auto m : *_memtables) {
+        min_timestamp = std::min(min_timestamp, m->min_timestamp());
+    }
+    for (auto m : *_streaming_memtables) {
+        min_timestamp = std::min(min_timestamp, m->min_timestamp());
+    }
+    return min_timestamp;
+}
+
 static
-bool belongs_to_current_shard(const mutation& m) {
+bool belongs_to_current_shard(const streamed_mutation& m) {
     return dht::shard_of(m.token()) == engine().cpu_id();
 }
 
-class range_sstable_reader final : public mutation_reader::impl {
-    const query::partition_range& _pr;
-    lw_shared_ptr<sstable_list> _sstables;
-    mutation_reader _reader;
-    // Use a pointer instead of copying, so we don't need to regenerate the reader if
-    // the priority changes.
-    const io_priority_class& _pc;
-    query::clustering_key_filtering_context _ck_filtering;
-public:
-    range_sstable_reader(schema_ptr s,
-                         lw_shared_ptr<sstable_list> sstables,
-                         const query::partition_range& pr,
-                         query::clustering_key_filtering_context ck_filtering,
-                         const io_priority_class& pc)
-        : _pr(pr)
-        , _sstables(std::move(sstables))
-        , _pc(pc)
-        , _ck_filtering(ck_filtering)
-    {
-        std::vector<mutation_reader> readers;
-        for (const lw_shared_ptr<sstables::sstable>& sst : *_sstables | boost::adaptors::map_values) {
-            // FIXME: make sstable::read_range_rows() return ::mutation_reader so that we can drop this wrapper.
-            mutation_reader reader =
-                make_mutation_reader<sstable_range_wrapping_reader>(sst, s, pr, _ck_filtering, _pc);
+// Reads the range from the sstables, merging the partitions found in more
+// than one of them fragment by fragment.
+class range_sstable_reader final : public streamed_mutation_reader::impl {
+    std::vector<sstables::shared_sstable> _sstables;
+    streamed_mutation_reader _reader;
+private:
+    static streamed_mutation_reader make_reader(schema_ptr s,
+                                                const std::vector<sstables::shared_sstable>& sstables,
+                                                const query::partition_range& pr,
+                                                query::clustering_key_filtering_context ck_filtering,
+                                                const io_priority_class& pc) {
+        std::vector<streamed_mutation_reader> readers;
+        readers.reserve(sstables.size());
+        for (const lw_shared_ptr<sstables::sstable>& sst : sstables) {
+            auto reader = sst->read_range_rows_streamed(s, pr, ck_filtering, pc);
             if (sst->is_shared()) {
-                reader = make_filtering_reader(std::move(reader), belongs_to_current_shard);
+                reader = make_filtering_streamed_reader(std::move(reader), belongs_to_current_shard);
             }
             readers.emplace_back(std::move(reader));
         }
-        _reader = make_combined_reader(std::move(readers));
+        return make_combined_streamed_reader(std::move(readers));
     }
+public:
+    range_sstable_reader(schema_ptr s,
+                         std::vector<sstables::shared_sstable> sstables,
+                         const query::partition_range& pr,
+                         query::clustering_key_filtering_context ck_filtering,
+                         const io_priority_class& pc)
+        : _sstables(std::move(sstables))
+        , _reader(make_reader(std::move(s), _sstables, pr, ck_filtering, pc))
+    { }
 
-    range_sstable_reader(range_sstable_reader&&) = delete; // reader takes reference to member fields
-
-    virtual future<mutation_opt> operator()() override {
+    virtual future<streamed_mutation_opt> operator()() override {
         return _reader();
     }
 };
@@ -211,14 +221,14 @@ class single_key_sstable_reader final : public mutation_reader::impl {
     sstables::key _key;
     mutation_opt _m;
     bool _done = false;
-    lw_shared_ptr<sstable_list> _sstables;
+    std::vector<sstables::shared_sstable> _sstables;
     // Use a pointer instead of copying, so we don't need to regenerate the reader if
     // the priority changes.
     const io_priority_class& _pc;
     query::clustering_key_filtering_context _ck_filtering;
 public:
     single_key_sstable_reader(schema_ptr schema,
-                              lw_shared_ptr<sstable_list> sstables,
+                              std::vector<sstables::shared_sstable> sstables,
                               const partition_key& key,
                               query::clustering_key_filtering_context ck_filtering,
                               const io_priority_class& pc)
@@ -233,7 +243,7 @@ class single_key_sstable_reader final : public mutation_reader::impl {
         if (_done) {
             return make_ready_future<mutation_opt>();
         }
-        return parallel_for_each(*_sstables | boost::adaptors::map_values,
+        return parallel_for_each(_sstables,
             [this](const lw_shared_ptr<sstables::sstable>& sstable) {
                 return sstable->read_row(_schema, _key, _ck_filtering, _pc)
                     .then([this](mutation_opt mo) {
@@ -256,19 +266,32 @@ column_family::make_sstable_reader(schema_ptr s,
         if (dht::shard_of(pos.token()) != engine().cpu_id()) {
             return make_empty_reader(); // range doesn't belong to this shard
         }
-        return make_mutation_reader<single_key_sstable_reader>(std::move(s), _sstables, *pos.key(), ck_filtering, pc);
+        return make_mutation_reader<single_key_sstable_reader>(std::move(s), _sstable_set->select(pr), *pos.key(), ck_filtering, pc);
     } else {
-        // range_sstable_reader is not movable so we need to wrap it
-        return make_mutation_reader<range_sstable_reader>(std::move(s), _sstables, pr, ck_filtering, pc);
+        return mutation_reader_from_streamed_reader(make_streamed_mutation_reader<range_sstable_reader>(
+                std::move(s), _sstable_set->select(pr), pr, ck_filtering, pc));
+    }
+}
+
+streamed_mutation_reader
+column_family::make_sstable_streamed_reader(schema_ptr s,
+                                            const query::partition_range& pr,
+                                            query::clustering_key_filtering_context ck_filtering,
+                                            const io_priority_class& pc) const {
+    if (pr.is_singular() && pr.start()->value().has_key()) {
+        // Single partition reads use the promoted index, which isn't
+        // available to streamed reads yet.
+        return streamed_reader_from_mutation_reader(make_sstable_reader(std::move(s), pr, ck_filtering, pc));
     }
+    return make_streamed_mutation_reader<range_sstable_reader>(std::move(s), _sstable_set->select(pr), pr, ck_filtering, pc);
 }
 
 key_source column_family::sstables_as_key_source() const {
     return key_source([this] (const query::partition_range& range, const io_priority_class& pc) {
+        auto sstables = _sstable_set->select(range);
         std::vector<key_reader> readers;
-        readers.reserve(_sstables->size());
-        std::transform(_sstables->begin(), _sstables->end(), std::back_inserter(readers), [&] (auto&& entry) {
-            auto& sst = entry.second;
+        readers.reserve(sstables.size());
+        std::transform(sstables.begin(), sstables.end(), std::back_inserter(readers), [&] (auto&& sst) {
             auto rd = sstables::make_key_reader(_schema, sst, range, pc);
             if (sst->is_shared()) {
                 rd = make_filtering_reader(std::move(rd), [] (const dht::decorated_key& dk) {
@@ -323,12 +346,14 @@ column_family::make_reader(schema_ptr s,
                            const query::clustering_key_filtering_context& ck_filtering,
                            const io_priority_class& pc) const {
     if (query::is_wrap_around(range, *s)) {
-        // make_combined_reader() can't handle streams that wrap around yet.
+        // make_combined_streamed_reader() can't handle streams that wrap around yet.
         fail(unimplemented::cause::WRAP_AROUND);
     }
 
-    std::vector<mutation_reader> readers;
-    readers.reserve(_memtables->size() + _sstables->size());
+    // The sources are merged fragment by fragment, so that partitions found
+    // in several of them are only built once, by the returned reader.
+    std::vector<streamed_mutation_reader> readers;
+    readers.reserve(_memtables->size() + 1);
 
     // We're assuming that cache and memtables are both read atomically
     // for single-key queries, so we don't need to special case memtable
@@ -351,16 +376,57 @@ column_family::make_reader(schema_ptr s,
     // https://github.com/scylladb/scylla/issues/185
 
     for (auto&& mt : *_memtables) {
-        readers.emplace_back(mt->make_reader(s, range, ck_filtering, pc));
+        readers.emplace_back(streamed_reader_from_mutation_reader(mt->make_reader(s, range, ck_filtering, pc)));
     }
 
     if (_config.enable_cache) {
-        readers.emplace_back(_cache.make_reader(s, range, ck_filtering, pc));
+        readers.emplace_back(streamed_reader_from_mutation_reader(_cache.make_reader(s, range, ck_filtering, pc)));
     } else {
-        readers.emplace_back(make_sstable_reader(s, range, ck_filtering, pc));
+        readers.emplace_back(make_sstable_streamed_reader(s, range, ck_filtering, pc));
     }
 
-    return make_combined_reader(std::move(readers));
+    return mutation_reader_from_streamed_reader(make_combined_streamed_reader(std::move(readers)));
+}
+
+mutation_reader
+column_family::make_streaming_reader(schema_ptr s,
+                                     const query::partition_range& range,
+                                     const std::vector<sstables::shared_sstable>& excluded,
+                                     const io_priority_class& pc) const {
+    if (query::is_wrap_around(range, *s)) {
+        fail(unimplemented::cause::WRAP_AROUND);
+    }
+
+    std::vector<streamed_mutation_reader> readers;
+    readers.reserve(_memtables->size() + 1);
+    for (auto&& mt : *_memtables) {
+        readers.emplace_back(streamed_reader_from_mutation_reader(mt->make_reader(s, range, query::no_clustering_key_filtering, pc)));
+    }
+
+    auto sstables = _sstable_set->select(range);
+    sstables.erase(boost::remove_if(sstables, [&excluded] (const sstables::shared_sstable& sst) {
+        return boost::find(excluded, sst) != excluded.end();
+    }), sstables.end());
+    readers.emplace_back(make_streamed_mutation_reader<range_sstable_reader>(s, std::move(sstables), range, query::no_clustering_key_filtering, pc));
+
+    return mutation_reader_from_streamed_reader(make_combined_streamed_reader(std::move(readers)));
+}
+
+std::vector<sstables::shared_sstable>
+column_family::select_sstables_contained_in(const range<dht::token>& r) const {
+    std::vector<sstables::shared_sstable> ret;
+    for (auto&& entry : *_sstables) {
+        auto& sst = entry.second;
+        if (sst->is_shared()) {
+            continue;
+        }
+        auto first_token = dht::global_partitioner().get_token(*_schema, sst->get_first_partition_key(*_schema));
+        auto last_token = dht::global_partitioner().get_token(*_schema, sst->get_last_partition_key(*_schema));
+        if (r.contains(range<dht::token>::make(first_token, last_token), dht::token_comparator())) {
+            ret.push_back(sst);
+        }
+    }
+    return ret;
 }
 
 // Not performance critical. Currently used for testing only.
@@ -560,10 +626,17 @@ void column_family::add_sstable(lw_shared_ptr<sstables::sstable> sstable) {
     auto generation = sstable->generation();
     // allow in-progress reads to continue using old list
     _sstables = make_lw_shared<sstable_list>(*_sstables);
+    _sstable_set = make_lw_shared<sstables::sstable_set>(*_sstable_set);
     update_stats_for_new_sstable(sstable->bytes_on_disk());
+    _sstable_set->insert(sstable);
     _sstables->emplace(generation, std::move(sstable));
 }
 
+void column_family::set_sstables(lw_shared_ptr<sstable_list> new_sstables) {
+    _sstable_set = make_lw_shared<sstables::sstable_set>(_schema, *new_sstables);
+    _sstables = std::move(new_sstables);
+}
+
 future<>
 column_family::update_cache(memtable& m, lw_shared_ptr<sstable_list> old_sstables) {
     if (_config.enable_cache) {
@@ -936,7 +1009,7 @@ column_family::rebuild_sstable_list(const std::vector<sstables::shared_sstable>&
             new_compacted_but_not_deleted.push_back(tab);
         }
     }
-    _sstables = std::move(new_sstable_list);
+    set_sstables(std::move(new_sstable_list));
     _sstables_compacted_but_not_deleted = std::move(new_compacted_but_not_deleted);
 
     rebuild_statistics();
@@ -973,7 +1046,33 @@ column_family::compact_sstables(sstables::compaction_descriptor descriptor, bool
     }
 
     return with_lock(_sstables_lock.for_read(), [this, descriptor = std::move(descriptor), cleanup] {
+        if (descriptor.drop_expired) {
+            dblog.info("Dropping {} fully expired sstables of {}.{}", descriptor.sstables.size(), _schema->ks_name(), _schema->cf_name());
+            this->rebuild_sstable_list({}, descriptor.sstables);
+            return make_ready_future<>();
+        }
+
         auto sstables_to_compact = make_lw_shared<std::vector<sstables::shared_sstable>>(std::move(descriptor.sstables));
+        auto max_sstable_bytes = descriptor.max_sstable_bytes;
+        sstables::compaction_release_fn release;
+        if (!cleanup && _config.incremental_compaction_sstable_size
+                && sstables::can_release_incrementally(*_schema, *sstables_to_compact)) {
+            // Inputs are replaced by outputs as they are written, so only
+            // a few outputs need space on top of the inputs. Outputs are not
+            // split when no input could be released before the end anyway.
+            max_sstable_bytes = std::min(max_sstable_bytes, _config.incremental_compaction_sstable_size);
+            release = [this, sstables_to_compact, on_release = std::move(descriptor.on_release)]
+                    (std::vector<sstables::shared_sstable> sealed, std::vector<sstables::shared_sstable> exhausted) {
+                std::unordered_set<sstables::shared_sstable> s(exhausted.begin(), exhausted.end());
+                sstables_to_compact->erase(boost::range::remove_if(*sstables_to_compact, [&s] (auto& sst) {
+                    return s.count(sst);
+                }), sstables_to_compact->end());
+                this->rebuild_sstable_list(sealed, exhausted);
+                if (on_release) {
+                    on_release(exhausted);
+                }
+            };
+        }
 
         auto create_sstable = [this] {
                 auto gen = this->calculate_generation_for_new_table();
@@ -984,8 +1083,8 @@ column_family::compact_sstables(sstables::compaction_descriptor descriptor, bool
                 sst->set_unshared();
                 return sst;
         };
-        return sstables::compact_sstables(*sstables_to_compact, *this, create_sstable, descriptor.max_sstable_bytes, descriptor.level,
-                cleanup).then([this, sstables_to_compact] (auto new_sstables) {
+        return sstables::compact_sstables(*sstables_to_compact, *this, create_sstable, max_sstable_bytes, descriptor.level,
+                cleanup, descriptor.parallelism, std::move(release)).then([this, sstables_to_compact] (auto new_sstables) {
             return this->rebuild_sstable_list(new_sstables, *sstables_to_compact);
         });
     });
@@ -1291,7 +1390,11 @@ database::database(const db::config& cfg)
                            &_memtables_throttler
     )
 {
+    _compaction_manager.set_max_parallel_ranges(_cfg->compaction_parallel_ranges());
     _compaction_manager.start();
+    // The key cache of Origin is our index cache, and its size is split
+    // evenly between the shards.
+    sstables::global_index_cache().set_max_size((uint64_t(_cfg->key_cache_size_in_mb()) << 20) / smp::count);
     setup_collectd();
 
     dblog.info("Row: max_vector_size: {}, internal_count: {}", size_t(row::max_vector_size), size_t(row::internal_count));
@@ -1334,6 +1437,41 @@ database::setup_collectd() {
                 , "total_operations", "total_reads")
                 , scollectd::make_typed(scollectd::data_type::DERIVE, _stats->total_reads)
     ));
+
+    _collectd.push_back(
+        scollectd::add_polled_metric(scollectd::type_instance_id("querier_cache"
+                , scollectd::per_cpu_plugin_instance
+                , "total_operations", "hits")
+                , scollectd::make_typed(scollectd::data_type::DERIVE, [this] { return _querier_cache.get_stats().hits; })
+    ));
+
+    _collectd.push_back(
+        scollectd::add_polled_metric(scollectd::type_instance_id("querier_cache"
+                , scollectd::per_cpu_plugin_instance
+                , "total_operations", "misses")
+                , scollectd::make_typed(scollectd::data_type::DERIVE, [this] { return _querier_cache.get_stats().misses; })
+    ));
+
+    _collectd.push_back(
+        scollectd::add_polled_metric(scollectd::type_instance_id("querier_cache"
+                , scollectd::per_cpu_plugin_instance
+                , "total_operations", "evictions")
+                , scollectd::make_typed(scollectd::data_type::DERIVE, [this] { return _querier_cache.get_stats().evictions; })
+    ));
+
+    _collectd.push_back(
+        scollectd::add_polled_metric(scollectd::type_instance_id("querier_cache"
+                , scollectd::per_cpu_plugin_instance
+                , "objects", "population")
+                , scollectd::make_typed(scollectd::data_type::GAUGE, [this] { return _querier_cache.get_stats().population; })
+    ));
+
+    _collectd.push_back(
+        scollectd::add_polled_metric(scollectd::type_instance_id("querier_cache"
+                , scollectd::per_cpu_plugin_instance
+                , "bytes", "memory_usage")
+                , scollectd::make_typed(scollectd::data_type::GAUGE, [this] { return _querier_cache.get_stats().memory_usage; })
+    ));
 }
 
 database::~database() {
@@ -1705,6 +1843,7 @@ keyspace::make_column_family_config(const schema& s) const {
     cfg.streaming_dirty_memory_region_group = _config.streaming_dirty_memory_region_group;
     cfg.cf_stats = _config.cf_stats;
     cfg.enable_incremental_backups = _config.enable_incremental_backups;
+    cfg.incremental_compaction_sstable_size = _config.incremental_compaction_sstable_size;
 
     return cfg;
 }
@@ -1873,15 +2012,164 @@ struct query_state {
     }
 };
 
+// Reads the range of one page of a paged range scan. If the reader of the
+// previous page was parked where this page starts, it is resumed; the
+// partition the previous page ended in is read afresh first, as the page
+// may have ended in the middle of it. If this page ends before the range
+// does, the reader is parked for the next page.
+class paged_range_query {
+    query_state& _qs;
+    mutation_source _source;
+    querier_cache& _cache;
+    utils::UUID _key;
+    uint32_t _limit;
+    std::unique_ptr<query::partition_range> _range;
+    std::unique_ptr<query::partition_slice> _slice;
+    std::experimental::optional<querier> _parked;
+    std::experimental::optional<dht::decorated_key> _last_key;
+private:
+    std::function<void(uint32_t, mutation&&)> consumer() {
+        return [this] (uint32_t live_rows, mutation&& m) {
+            _limit -= std::min(_limit, live_rows);
+            _last_key = m.decorated_key();
+            auto pb = _qs.builder.add_partition(*_qs.schema, m.key());
+            m.partition().query_compacted(pb, *_qs.schema, live_rows);
+        };
+    }
+    future<> read_last_partition() {
+        auto pr = std::make_unique<query::partition_range>(query::partition_range::make_singular(dht::ring_position(_parked->last_key)));
+        auto rd = std::make_unique<querying_reader>(_qs.schema, _source, *pr, _qs.cmd.slice, _limit, _qs.cmd.timestamp, consumer());
+        auto f = rd->read();
+        return f.finally([pr = std::move(pr), rd = std::move(rd)] {});
+    }
+    future<> read_rest() {
+        auto rd = std::make_unique<querying_reader>(_qs.schema, _source, *_range, *_slice, _limit, _qs.cmd.timestamp, consumer());
+        if (_parked) {
+            rd->resume(std::move(_parked->reader));
+            _parked = {};
+        }
+        _last_key = {};
+        auto& r = *rd;
+        return r.read().then([this, rd = std::move(rd)] {
+            if (!_limit && _last_key) {
+                _cache.insert(_key, querier{_qs.schema, std::move(_range), std::move(_slice), rd->release_reader(), std::move(*_last_key)});
+            }
+        });
+    }
+public:
+    paged_range_query(query_state& qs, mutation_source source, const query::partition_range& range, querier_cache& cache)
+        : _qs(qs)
+        , _source(std::move(source))
+        , _cache(cache)
+        , _key(*qs.cmd.query_id)
+        , _limit(qs.limit)
+        , _parked(cache.lookup(_key, *qs.schema, range))
+    {
+        if (_parked) {
+            _range = std::move(_parked->range);
+            _slice = std::move(_parked->slice);
+        } else {
+            _range = std::make_unique<query::partition_range>(range);
+            _slice = std::make_unique<query::partition_slice>(qs.cmd.slice);
+        }
+    }
+
+    future<> run(bool resume_inside_last_partition) {
+        if (!_parked || !resume_inside_last_partition) {
+            return read_rest();
+        }
+        return read_last_partition().then([this] {
+            if (!_limit) {
+                // The page ended inside the partition again, the parked
+                // reader is still positioned right after it.
+                _parked->range = std::move(_range);
+                _parked->slice = std::move(_slice);
+                _cache.insert(_key, std::move(*_parked));
+                return make_ready_future<>();
+            }
+            return read_rest();
+        });
+    }
+};
+
+// Reads one page of a paged single-partition query. A reader can't be
+// parked in the middle of a partition, so the first page parks the whole
+// partition, as read and before it is compacted, and the next pages are
+// served from it, each restricted by its own slice.
+class paged_partition_query {
+    query_state& _qs;
+    mutation_source _source;
+    querier_cache& _cache;
+    utils::UUID _key;
+    uint32_t _limit;
+    const query::partition_range& _range;
+    std::experimental::optional<querier> _parked;
+private:
+    future<mutation_opt> read_partition() {
+        if (_parked) {
+            return make_ready_future<mutation_opt>(std::move(_parked->partition));
+        }
+        auto rd = make_lw_shared<mutation_reader>(_source(_qs.schema, _range,
+                query::clustering_key_filtering_context::create(_qs.schema, _qs.cmd.slice), service::get_local_sstable_query_read_priority()));
+        return (*rd)().finally([rd] {});
+    }
+public:
+    paged_partition_query(query_state& qs, mutation_source source, const query::partition_range& range, querier_cache& cache)
+        : _qs(qs)
+        , _source(std::move(source))
+        , _cache(cache)
+        , _key(*qs.cmd.query_id)
+        , _limit(qs.limit)
+        , _range(range)
+        , _parked(cache.lookup(_key, *qs.schema, range))
+    { }
+
+    future<> run() {
+        return read_partition().then([this] (mutation_opt m) {
+            if (!m) {
+                return make_ready_future<>();
+            }
+            auto consumer = [this] (uint32_t live_rows, mutation&& m) {
+                _limit -= std::min(_limit, live_rows);
+                auto pb = _qs.builder.add_partition(*_qs.schema, m.key());
+                m.partition().query_compacted(pb, *_qs.schema, live_rows);
+            };
+            auto rd = std::make_unique<querying_reader>(_qs.schema, _source, _range, _qs.cmd.slice, _limit, _qs.cmd.timestamp, consumer);
+            // Compaction trims what it is given, so the page reads a copy.
+            rd->resume(make_reader_returning(*m));
+            auto& r = *rd;
+            return r.read().then([this, m = std::move(*m), rd = std::move(rd)] () mutable {
+                if (!_limit) {
+                    auto dk = m.decorated_key();
+                    _cache.insert(_key, querier{_qs.schema, std::make_unique<query::partition_range>(_range),
+                            std::make_unique<query::partition_slice>(_qs.cmd.slice), make_empty_reader(), std::move(dk), std::move(m)});
+                }
+            });
+        });
+    }
+};
+
 future<lw_shared_ptr<query::result>>
-column_family::query(schema_ptr s, const query::read_command& cmd, query::result_request request, const std::vector<query::partition_range>& partition_ranges) {
+column_family::query(schema_ptr s, const query::read_command& cmd, query::result_request request, const std::vector<query::partition_range>& partition_ranges,
+        querier_cache& querier_cache) {
     utils::latency_counter lc;
     _stats.reads.set_latency(lc);
     auto qs_ptr = std::make_unique<query_state>(std::move(s), cmd, request, partition_ranges);
     auto& qs = *qs_ptr;
     {
-        return do_until(std::bind(&query_state::done, &qs), [this, &qs] {
+        return do_until(std::bind(&query_state::done, &qs), [this, &qs, &querier_cache, single_range = partition_ranges.size() == 1] {
             auto&& range = *qs.current_partition_range++;
+            if (qs.cmd.query_id && single_range) {
+                if (range.is_singular()) {
+                    return do_with(paged_partition_query(qs, as_mutation_source(), range, querier_cache), [] (auto& q) {
+                        return q.run();
+                    });
+                }
+                auto inclusive = range.start() && range.start()->is_inclusive();
+                return do_with(paged_range_query(qs, as_mutation_source(), range, querier_cache), [inclusive] (auto& q) {
+                    return q.run(inclusive);
+                });
+            }
             auto add_partition = [&qs] (uint32_t live_rows, mutation&& m) {
                 auto pb = qs.builder.add_partition(*qs.schema, m.key());
                 m.partition().query_compacted(pb, *qs.schema, live_rows);
@@ -1900,6 +2188,24 @@ column_family::query(schema_ptr s, const query::read_command& cmd, query::result
     }
 }
 
+void column_family::add_coordinator_read_latency(std::chrono::steady_clock::duration latency) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    _stats.estimated_coordinator_read.add(us);
+    _recent_coordinator_read.add(us);
+}
+
+std::chrono::microseconds column_family::get_coordinator_read_latency_percentile(double percentile) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - _coordinator_read_latency_percentile_updated >= std::chrono::seconds(1)) {
+        _coordinator_read_latency_percentile_updated = now;
+        if (_recent_coordinator_read.count()) {
+            _coordinator_read_latency_percentile = std::chrono::microseconds(_recent_coordinator_read.percentile(percentile));
+            _recent_coordinator_read.clear();
+        }
+    }
+    return _coordinator_read_latency_percentile;
+}
+
 mutation_source
 column_family::as_mutation_source() const {
     return mutation_source([this] (schema_ptr s,
@@ -1913,7 +2219,7 @@ column_family::as_mutation_source() const {
 future<lw_shared_ptr<query::result>>
 database::query(schema_ptr s, const query::read_command& cmd, query::result_request request, const std::vector<query::partition_range>& ranges) {
     column_family& cf = find_column_family(cmd.cf_id);
-    return cf.query(std::move(s), cmd, request, ranges).then([this, s = _stats] (auto&& res) {
+    return cf.query(std::move(s), cmd, request, ranges, _querier_cache).then([this, s = _stats] (auto&& res) {
         ++s->total_reads;
         return std::move(res);
     });
@@ -2135,6 +2441,20 @@ future<> database::apply_streaming_mutation(schema_ptr s, const frozen_mutation&
     });
 }
 
+future<> database::apply_streaming_mutations(schema_ptr s, const std::vector<const frozen_mutation*>& ms) {
+    if (!s->is_synced()) {
+        throw std::runtime_error(sprint("attempted to mutate using not synced schema of %s.%s, version=%s",
+                                 s->ks_name(), s->cf_name(), s->version()));
+    }
+
+    return _streaming_throttler.throttle().then([this, &ms, s = std::move(s)] {
+        auto& cf = find_column_family(s->id());
+        for (auto m : ms) {
+            cf.apply_streaming_mutation(s, *m);
+        }
+    });
+}
+
 keyspace::config
 database::make_keyspace_config(const keyspace_metadata& ksm) {
     // FIXME support multiple directories
@@ -2164,6 +2484,7 @@ database::make_keyspace_config(const keyspace_metadata& ksm) {
     cfg.streaming_dirty_memory_region_group = &_streaming_dirty_memory_region_group;
     cfg.cf_stats = &_cf_stats;
     cfg.enable_incremental_backups = _enable_incremental_backups;
+    cfg.incremental_compaction_sstable_size = uint64_t(_cfg->incremental_compaction_sstable_size_in_mb()) << 20;
     return cfg;
 }
 
@@ -2216,6 +2537,7 @@ operator<<(std::ostream& os, const atomic_cell& ac) {
 
 future<>
 database::stop() {
+    _querier_cache.clear();
     return _compaction_manager.stop().then([this] {
         // try to ensure that CL has done disk flushing
         if (_commitlog != nullptr) {
@@ -2243,6 +2565,7 @@ future<> database::truncate(sstring ksname, sstring cfname, timestamp_func tsf)
 
 future<> database::truncate(const keyspace& ks, column_family& cf, timestamp_func tsf)
 {
+    _querier_cache.evict_all_for_table(cf.schema()->id());
     const auto durable = ks.metadata()->durable_writes();
     const auto auto_snapshot = get_config().auto_snapshot();
 
@@ -2667,7 +2990,7 @@ future<db::replay_position> column_family::discard_sstables(db_clock::time_point
             pruned->emplace(p.first, p.second);
         }
 
-        _sstables = std::move(pruned);
+        set_sstables(std::move(pruned));
         dblog.debug("cleaning out row cache");
         _cache.clear();
 
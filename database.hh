@@ -69,7 +69,9 @@
 #include "utils/histogram.hh"
 #include "sstables/estimated_histogram.hh"
 #include "sstables/compaction.hh"
+#include "sstables/sstable_set.hh"
 #include "key_reader.hh"
+#include "querier.hh"
 #include <seastar/core/rwlock.hh>
 #include <seastar/core/shared_future.hh>
 
@@ -261,6 +263,9 @@ class column_family {
         bool enable_incremental_backups = false;
         size_t max_memtable_size = 5'000'000;
         size_t max_streaming_memtable_size = 5'000'000;
+        // Size of the sstables written by incremental compactions; 0 if
+        // compactions aren't incremental.
+        uint64_t incremental_compaction_sstable_size = 0;
         logalloc::region_group* dirty_memory_region_group = nullptr;
         logalloc::region_group* streaming_dirty_memory_region_group = nullptr;
         ::cf_stats* cf_stats = nullptr;
@@ -281,6 +286,8 @@ class column_family {
         sstables::estimated_histogram estimated_read;
         sstables::estimated_histogram estimated_write;
         sstables::estimated_histogram estimated_sstable_per_read;
+        // Latency of reads coordinated by this shard, in microseconds.
+        sstables::estimated_histogram estimated_coordinator_read;
         utils::timed_rate_moving_average_and_histogram tombstone_scanned;
         utils::timed_rate_moving_average_and_histogram live_scanned;
     };
@@ -294,6 +301,13 @@ class column_family {
     config _config;
     stats _stats;
 
+    // Coordinator read latencies since the last time the speculative retry
+    // threshold was computed. Only recent reads are used, so that the
+    // threshold follows changes in latency.
+    sstables::estimated_histogram _recent_coordinator_read;
+    std::chrono::microseconds _coordinator_read_latency_percentile{0};
+    std::chrono::steady_clock::time_point _coordinator_read_latency_percentile_updated;
+
     // We would like to serialize the flushing of memtables. While flushing many memtables
     // simultaneously can sustain high levels of throughput, the memory is not freed until the
     // memtable is totally gone. That means that if we have throttled requests, they will stay
@@ -339,6 +353,10 @@ class column_family {
 
     // generation -> sstable. Ordered by key so we can easily get the most recent.
     lw_shared_ptr<sstable_list> _sstables;
+    // Same sstables as in _sstables, indexed by the key range they cover. Used
+    // by readers to select only sstables relevant to the range being read.
+    // Must be updated together with _sstables.
+    lw_shared_ptr<sstables::sstable_set> _sstable_set;
     // sstables that have been compacted (so don't look up in query) but
     // have not been deleted yet, so must not GC any tombstones in other sstables
     // that may delete data in these sstables:
@@ -395,6 +413,8 @@ class column_family {
     // Rebuild existing _sstables with new_sstables added to it and sstables_to_remove removed from it.
     void rebuild_sstable_list(const std::vector<sstables::shared_sstable>& new_sstables,
                               const std::vector<sstables::shared_sstable>& sstables_to_remove);
+    // Replaces _sstables with new_sstables and rebuilds _sstable_set from it.
+    void set_sstables(lw_shared_ptr<sstable_list> new_sstables);
     void rebuild_statistics();
 private:
     // Creates a mutation reader which covers sstables.
@@ -405,6 +425,11 @@ class column_family {
                                         const query::partition_range& range,
                                         query::clustering_key_filtering_context ck_filtering,
                                         const io_priority_class& pc) const;
+    // Like make_sstable_reader(), but returns the partitions as streams.
+    streamed_mutation_reader make_sstable_streamed_reader(schema_ptr schema,
+                                                          const query::partition_range& range,
+                                                          query::clustering_key_filtering_context ck_filtering,
+                                                          const io_priority_class& pc) const;
 
     mutation_source sstables_as_mutation_source();
     key_source sstables_as_key_source() const;
@@ -445,6 +470,19 @@ class column_family {
             const query::clustering_key_filtering_context& ck_filtering = query::no_clustering_key_filtering,
             const io_priority_class& pc = default_priority_class()) const;
 
+    // Reads the range for streaming from the memtables and from the sstables
+    // other than the excluded ones, which are being streamed as files.
+    // Bypasses the cache, which would otherwise return their data as well.
+    // The 'range' parameter must be live as long as the reader is used.
+    mutation_reader make_streaming_reader(schema_ptr schema,
+            const query::partition_range& range,
+            const std::vector<sstables::shared_sstable>& excluded,
+            const io_priority_class& pc = default_priority_class()) const;
+
+    // Returns the sstables which hold data of this shard alone and whose
+    // partitions all fall within the given range.
+    std::vector<sstables::shared_sstable> select_sstables_contained_in(const range<dht::token>& r) const;
+
     mutation_source as_mutation_source() const;
 
     // Queries can be satisfied from multiple data sources, so they are returned
@@ -463,6 +501,8 @@ class column_family {
     }
 
     logalloc::occupancy_stats occupancy() const;
+    // Lowest timestamp of the data in memtables not yet flushed.
+    api::timestamp_type min_memtable_timestamp() const;
 private:
     column_family(schema_ptr schema, config cfg, db::commitlog* cl, compaction_manager&);
 public:
@@ -487,7 +527,8 @@ class column_family {
     // Returns at most "cmd.limit" rows
     future<lw_shared_ptr<query::result>> query(schema_ptr,
         const query::read_command& cmd, query::result_request request,
-        const std::vector<query::partition_range>& ranges);
+        const std::vector<query::partition_range>& ranges,
+        querier_cache& querier_cache);
 
     future<> populate(sstring datadir);
 
@@ -568,6 +609,11 @@ class column_family {
     future<bool> snapshot_exists(sstring name);
 
     future<> load_new_sstables(std::vector<sstables::entry_descriptor> new_tables);
+    // Returns a generation for an sstable written outside of the column
+    // family, e.g. received from a peer, to be loaded with load_new_sstables().
+    uint64_t new_sstable_generation() {
+        return calculate_generation_for_new_table();
+    }
     future<> snapshot(sstring name);
     future<> clear_snapshot(sstring name);
     future<std::unordered_map<sstring, snapshot_details>> get_snapshot_details();
@@ -603,6 +649,13 @@ class column_family {
         return _stats;
     }
 
+    void add_coordinator_read_latency(std::chrono::steady_clock::duration latency);
+
+    // Returns the given percentile of the latency of recent reads coordinated
+    // by this shard, or zero if no read was coordinated yet. The value is
+    // recomputed at most once a second.
+    std::chrono::microseconds get_coordinator_read_latency_percentile(double percentile);
+
     compaction_manager& get_compaction_manager() const {
         return _compaction_manager;
     }
@@ -784,6 +837,7 @@ class keyspace {
         bool enable_incremental_backups = false;
         size_t max_memtable_size = 5'000'000;
         size_t max_streaming_memtable_size = 5'000'000;
+        uint64_t incremental_compaction_sstable_size = 0;
         logalloc::region_group* dirty_memory_region_group = nullptr;
         logalloc::region_group* streaming_dirty_memory_region_group = nullptr;
         ::cf_stats* cf_stats = nullptr;
@@ -887,6 +941,7 @@ class database {
     compaction_manager _compaction_manager;
     std::vector<scollectd::registration> _collectd;
     bool _enable_incremental_backups = false;
+    querier_cache _querier_cache;
 
     future<> init_commitlog();
     future<> apply_in_memory(const frozen_mutation& m, const schema_ptr& m_schema, const db::replay_position&);
@@ -973,6 +1028,9 @@ class database {
     future<reconcilable_result> query_mutations(schema_ptr, const query::read_command& cmd, const query::partition_range& range);
     future<> apply(schema_ptr, const frozen_mutation&);
     future<> apply_streaming_mutation(schema_ptr, const frozen_mutation&);
+    // Applies streamed mutations of a single table, all owned by this shard,
+    // under a single throttle.
+    future<> apply_streaming_mutations(schema_ptr, const std::vector<const frozen_mutation*>&);
     keyspace::config make_keyspace_config(const keyspace_metadata& ksm);
     const sstring& get_snitch_name() const;
     future<> clear_snapshot(sstring tag, std::vector<sstring> keyspace_names);
@@ -1003,6 +1061,10 @@ class database {
         return *_cfg;
     }
 
+    const querier_cache::stats& get_querier_cache_stats() const {
+        return _querier_cache.get_stats();
+    }
+
     future<> flush_all_memtables();
 
     // See #937. Truncation now requires a callback to get a time stamp
@@ -55,8 +55,11 @@
 #include <core/rwlock.hh>
 #include <core/gate.hh>
 #include <core/fstream.hh>
+#include <core/sleep.hh>
+#include <core/shared_future.hh>
 #include <seastar/core/memory.hh>
 #include <net/byteorder.hh>
+#include <lz4.h>
 
 #include "commitlog.hh"
 #include "db/config.hh"
@@ -101,7 +104,15 @@ db::commitlog::config::config(const db::config& cfg)
     , commitlog_total_space_in_mb(cfg.commitlog_total_space_in_mb() >= 0 ? cfg.commitlog_total_space_in_mb() : memory::stats().total_memory() >> 20)
     , commitlog_segment_size_in_mb(cfg.commitlog_segment_size_in_mb())
     , commitlog_sync_period_in_ms(cfg.commitlog_sync_period_in_ms())
-    , mode(cfg.commitlog_sync() == "batch" ? sync_mode::BATCH : sync_mode::PERIODIC)
+    , commitlog_sync_group_window_in_ms(cfg.commitlog_sync_group_window_in_ms())
+    , mode(cfg.commitlog_sync() == "batch" ? sync_mode::BATCH : cfg.commitlog_sync() == "group" ? sync_mode::GROUP : sync_mode::PERIODIC)
+    , compress([&cfg] {
+        auto& c = cfg.commitlog_compression();
+        if (!c.empty() && c != "LZ4Compressor" && c != "org.apache.cassandra.io.compress.LZ4Compressor") {
+            throw std::invalid_argument("Unsupported commitlog compression: " + c);
+        }
+        return !c.empty();
+    }())
 {}
 
 db::commitlog::descriptor::descriptor(segment_id_type i, uint32_t v)
@@ -189,6 +200,10 @@ class db::commitlog::segment_manager : public ::enable_shared_from_this<segment_
         uint64_t total_size = 0;
         uint64_t buffer_list_bytes = 0;
         uint64_t total_size_on_disk = 0;
+        uint64_t bytes_compressed_in = 0;
+        uint64_t bytes_compressed_out = 0;
+        uint64_t group_syncs = 0;
+        uint64_t group_sync_writes = 0;
     };
 
     stats totals;
@@ -260,7 +275,9 @@ class db::commitlog::segment_manager : public ::enable_shared_from_this<segment_
                 cfg.commit_log_location, max_disk_size / (1024 * 1024),
                 smp::count);
 
-        _regs = create_counters();
+        if (cfg.register_metrics) {
+            _regs = create_counters();
+        }
     }
     ~segment_manager() {
         logger.trace("Commitlog {} disposed", cfg.commit_log_location);
@@ -303,7 +320,7 @@ class db::commitlog::segment_manager : public ::enable_shared_from_this<segment_
     buffer_type acquire_buffer(size_t s);
     void release_buffer(buffer_type&&);
 
-    future<std::vector<descriptor>> list_descriptors(sstring dir);
+    static future<std::vector<descriptor>> list_descriptors(sstring dir);
 
     flush_handler_id add_flush_handler(flush_handler h) {
         auto id = ++_flush_ids;
@@ -386,7 +403,10 @@ class db::commitlog::segment: public enable_lw_shared_from_this<segment> {
     file _file;
     sstring _file_name;
 
+    // Position in the stream of entries up to which the buffers have been
+    // sent to disk. Same as _disk_pos unless the segment is compressed.
     uint64_t _file_pos = 0;
+    uint64_t _disk_pos = 0;
     uint64_t _flush_pos = 0;
     uint64_t _buf_pos = 0;
     bool _closed = false;
@@ -403,6 +423,11 @@ class db::commitlog::segment: public enable_lw_shared_from_this<segment> {
     seastar::gate _gate;
     uint64_t _write_waiters = 0;
     semaphore _queue;
+    // Resolved by the next group commit, while one is scheduled.
+    std::experimental::optional<shared_promise<>> _group_sync;
+    // Batch mode syncs of compressed segments, see coalesced_sync().
+    bool _sync_in_flight = false;
+    std::experimental::optional<shared_promise<>> _next_sync;
 
     std::unordered_set<table_schema_version> _known_schema_versions;
 
@@ -445,6 +470,10 @@ class db::commitlog::segment: public enable_lw_shared_from_this<segment> {
     static constexpr size_t segment_overhead_size = 2 * sizeof(uint32_t);
     static constexpr size_t descriptor_header_size = 5 * sizeof(uint32_t);
     static constexpr uint32_t segment_magic = ('S'<<24) |('C'<< 16) | ('L' << 8) | 'C';
+    static constexpr uint32_t compressed_segment_magic = ('S'<<24) |('C'<< 16) | ('L' << 8) | 'Z';
+    // Follows the chunk header in compressed segments (int: position of the first entry
+    // + int: uncompressed size + int: compressed size + int: checksum)
+    static constexpr size_t compressed_chunk_header_size = 4 * sizeof(uint32_t);
 
     // The commit log (chained) sync marker/header size in bytes (int: length + int: checksum [segmentId, position])
     static constexpr size_t sync_marker_size = 2 * sizeof(uint32_t);
@@ -488,7 +517,7 @@ class db::commitlog::segment: public enable_lw_shared_from_this<segment> {
     }
 
     bool must_sync() {
-        if (_segment_manager->cfg.mode == sync_mode::BATCH) {
+        if (_segment_manager->cfg.mode != sync_mode::PERIODIC) {
             return false;
         }
         auto now = clock_type::now();
@@ -609,11 +638,15 @@ class db::commitlog::segment: public enable_lw_shared_from_this<segment> {
      */
     // See class comment for info
     future<sseg_ptr> cycle() {
+        if (_segment_manager->cfg.compress) {
+            return cycle_compressed();
+        }
         auto size = clear_buffer_slack();
         auto buf = std::move(_buffer);
         auto off = _file_pos;
 
         _file_pos += size;
+        _disk_pos += size;
         _buf_pos = 0;
 
         auto me = shared_from_this();
@@ -628,32 +661,104 @@ class db::commitlog::segment: public enable_lw_shared_from_this<segment> {
 
         data_output out(p, p + buf.size());
 
-        auto header_size = 0;
-
-        if (off == 0) {
-            // first block. write file header.
-            out.write(segment_magic);
-            out.write(_desc.ver);
-            out.write(_desc.id);
-            crc32_nbo crc;
-            crc.process(_desc.ver);
-            crc.process<int32_t>(_desc.id & 0xffffffff);
-            crc.process<int32_t>(_desc.id >> 32);
-            out.write(crc.checksum());
-            header_size = descriptor_header_size;
+        auto header_size = write_headers(out, off);
+        write_chunk_header(out, off + header_size, _file_pos);
+
+        forget_schema_versions();
+
+        return write_buffer(std::move(buf), off, size);
+    }
+
+    /**
+     * Same as cycle, but sends the entries in the buffer to disk as a single
+     * LZ4 compressed block. The positions of the entries, and thus _file_pos,
+     * remain those they have in the uncompressed buffer, and the block header
+     * records where they start so that the reader can recover them.
+     */
+    future<sseg_ptr> cycle_compressed() {
+        auto me = shared_from_this();
+        assert(!me.owned());
+
+        if (_buffer.empty()) {
+            return make_ready_future<sseg_ptr>(std::move(me));
         }
 
-        // write chunk header
+        auto buf = std::move(_buffer);
+        auto overhead = segment_overhead_size + (_file_pos == 0 ? descriptor_header_size : 0);
+        auto first = _file_pos + overhead;
+        auto len = _buf_pos - overhead;
+
+        _file_pos += _buf_pos;
+        _buf_pos = 0;
+
+        auto off = _disk_pos;
+        auto header_size = off == 0 ? descriptor_header_size : 0;
+        auto hdr = header_size + segment_overhead_size + compressed_chunk_header_size;
+        auto size = align_up<size_t>(hdr + LZ4_COMPRESSBOUND(len), alignment);
+        auto cbuf = _segment_manager->acquire_buffer(size);
+
+        auto clen = LZ4_compress(buf.get() + overhead, cbuf.get_write() + hdr, len);
+        _segment_manager->release_buffer(std::move(buf));
+        if (clen <= 0) {
+            _segment_manager->release_buffer(std::move(cbuf));
+            return make_exception_future<sseg_ptr>(std::runtime_error("LZ4 compression failure: LZ4_compress() failed"));
+        }
+        size = align_up<size_t>(hdr + clen, alignment);
+        std::fill(cbuf.get_write() + hdr + clen, cbuf.get_write() + size, 0);
+        _disk_pos += size;
+
+        _segment_manager->totals.bytes_compressed_in += len;
+        _segment_manager->totals.bytes_compressed_out += clen;
+
+        data_output out(cbuf.get_write(), hdr);
+        write_headers(out, off);
+        write_chunk_header(out, off + header_size, _disk_pos);
+
         crc32_nbo crc;
+        crc.process(uint32_t(first));
+        crc.process(uint32_t(len));
+        crc.process(uint32_t(clen));
+        crc.process_bytes(cbuf.get() + hdr, clen);
+
+        out.write(uint32_t(first));
+        out.write(uint32_t(len));
+        out.write(uint32_t(clen));
+        out.write(crc.checksum());
+
+        forget_schema_versions();
+
+        return write_buffer(std::move(cbuf), off, size);
+    }
+
+    // Writes the file header if off is the start of the file, and returns its size.
+    size_t write_headers(data_output& out, uint64_t off) {
+        if (off != 0) {
+            return 0;
+        }
+        auto magic = _segment_manager->cfg.compress ? compressed_segment_magic : segment_magic;
+        out.write(magic);
+        out.write(_desc.ver);
+        out.write(_desc.id);
+        crc32_nbo crc;
+        crc.process(_desc.ver);
         crc.process<int32_t>(_desc.id & 0xffffffff);
         crc.process<int32_t>(_desc.id >> 32);
-        crc.process(uint32_t(off + header_size));
-
-        out.write(uint32_t(_file_pos));
         out.write(crc.checksum());
+        return descriptor_header_size;
+    }
 
-        forget_schema_versions();
+    void write_chunk_header(data_output& out, uint64_t start, uint64_t next) {
+        crc32_nbo crc;
+        crc.process<int32_t>(_desc.id & 0xffffffff);
+        crc.process<int32_t>(_desc.id >> 32);
+        crc.process(uint32_t(start));
+
+        out.write(uint32_t(next));
+        out.write(crc.checksum());
+    }
 
+    future<sseg_ptr> write_buffer(buffer_type buf, uint64_t off, size_t size) {
+        auto me = shared_from_this();
         // acquire read lock
         return begin_write().then([this, size, off, buf = std::move(buf)]() mutable {
             auto written = make_lw_shared<size_t>(0);
@@ -752,7 +857,7 @@ class db::commitlog::segment: public enable_lw_shared_from_this<segment> {
             op = sync();
         } else if (must_wait_for_alloc()) {
             op = wait_for_alloc();
-        } else if (!is_still_allocating() || position() + s > _segment_manager->max_size) { // would we make the file too big?
+        } else if (!is_still_allocating() || !fits(s)) { // would we make the file too big?
             // do this in next segment instead.
             op = finish_and_get_new();
         } else if (_buffer.empty()) {
@@ -796,21 +901,126 @@ class db::commitlog::segment: public enable_lw_shared_from_this<segment> {
 
         _gate.leave();
 
+        if (_segment_manager->cfg.mode == sync_mode::BATCH && _segment_manager->cfg.compress) {
+            return coalesced_sync().then([rp] {
+                return make_ready_future<replay_position>(rp);
+            });
+        }
         if (_segment_manager->cfg.mode == sync_mode::BATCH) {
             return sync().then([rp](sseg_ptr) {
                 return make_ready_future<replay_position>(rp);
             });
         }
+        if (_segment_manager->cfg.mode == sync_mode::GROUP) {
+            return group_sync().then([rp] {
+                return make_ready_future<replay_position>(rp);
+            });
+        }
 
         return make_ready_future<replay_position>(rp);
     }
 
+    /**
+     * Group commit: the first allocation after a sync schedules the next
+     * one a window later, and all allocations made until it starts wait
+     * for it, so they share a single write and flush. The gate keeps the
+     * segment from being shut down with a sync scheduled.
+     */
+    future<> group_sync() {
+        ++_segment_manager->totals.group_sync_writes;
+        if (!_group_sync) {
+            _gate.enter();
+            _group_sync.emplace();
+            auto me = shared_from_this();
+            auto window = std::chrono::milliseconds(_segment_manager->cfg.commitlog_sync_group_window_in_ms);
+            sleep(window).then([me] {
+                auto p = std::move(*me->_group_sync);
+                me->_group_sync = {};
+                ++me->_segment_manager->totals.group_syncs;
+                return me->sync().then_wrapped([p = std::move(p)] (future<sseg_ptr> f) mutable {
+                    try {
+                        f.get();
+                        p.set_value();
+                    } catch (...) {
+                        p.set_exception(std::current_exception());
+                    }
+                });
+            }).finally([me] {
+                me->_gate.leave();
+            });
+        }
+        return _group_sync->get_shared_future();
+    }
+
+    /**
+     * Batch mode sync of compressed segments. Every chunk is padded to the
+     * alignment, which would dwarf small entries compressed one per chunk.
+     * So a sync requested while another one is in flight waits for it, and
+     * is shared with every write arriving meanwhile: their entries are
+     * compressed together as the next chunk.
+     */
+    future<> coalesced_sync() {
+        if (!_sync_in_flight) {
+            return start_coalesced_sync();
+        }
+        if (!_next_sync) {
+            _gate.enter();
+            _next_sync.emplace();
+        }
+        return _next_sync->get_shared_future();
+    }
+
+    future<> start_coalesced_sync() {
+        _sync_in_flight = true;
+        auto me = shared_from_this();
+        return sync().then_wrapped([me] (future<sseg_ptr> f) {
+            me->_sync_in_flight = false;
+            if (me->_next_sync) {
+                auto p = std::move(*me->_next_sync);
+                me->_next_sync = {};
+                me->start_coalesced_sync().then_wrapped([p = std::move(p)] (future<> f) mutable {
+                    try {
+                        f.get();
+                        p.set_value();
+                    } catch (...) {
+                        p.set_exception(std::current_exception());
+                    }
+                }).finally([me] {
+                    me->_gate.leave();
+                });
+            }
+            return f.discard_result();
+        });
+    }
+
     position_type position() const {
         return position_type(_file_pos + _buf_pos);
     }
 
+    // The most a chunk of len bytes of entries can take in a compressed
+    // segment, if they don't compress at all.
+    size_t max_compressed_chunk_size(size_t len) const {
+        auto header_size = _disk_pos == 0 ? descriptor_header_size : 0;
+        return align_up<size_t>(header_size + segment_overhead_size + compressed_chunk_header_size + LZ4_COMPRESSBOUND(len), alignment);
+    }
+
+    // Whether an entry of s bytes still fits in the segment. Positions in a
+    // compressed segment are those of the uncompressed entries, so it is
+    // bounded by what it takes on disk instead: what was written so far,
+    // plus the worst case for the chunk the entry would be written in.
+    bool fits(size_t s) const {
+        if (!_segment_manager->cfg.compress) {
+            return position() + s <= _segment_manager->max_size;
+        }
+        size_t buffered = 0;
+        if (!_buffer.empty()) {
+            buffered = _buf_pos - segment_overhead_size - (_file_pos == 0 ? descriptor_header_size : 0);
+        }
+        return _disk_pos + max_compressed_chunk_size(buffered + s) <= _segment_manager->max_size;
+    }
+
     size_t size_on_disk() const {
-        return _file_pos;
+        return _disk_pos;
     }
 
     // ensures no more of this segment is writeable, by allocating any unused section at the end and marking it discarded
@@ -839,7 +1049,8 @@ class db::commitlog::segment: public enable_lw_shared_from_this<segment> {
         _cf_dirty.clear();
     }
     bool is_still_allocating() const {
-        return !_closed && position() < _segment_manager->max_size;
+        auto pos = _segment_manager->cfg.compress ? _disk_pos : position();
+        return !_closed && pos < _segment_manager->max_size;
     }
     bool is_clean() const {
         return _cf_dirty.empty();
@@ -912,7 +1123,7 @@ db::commitlog::segment_manager::list_descriptors(sstring dirname) {
         }
     };
 
-    return open_checked_directory(commit_error, dirname).then([this, dirname](file dir) {
+    return open_checked_directory(commit_error, dirname).then([dirname](file dir) {
         auto h = make_lw_shared<helper>(std::move(dirname), std::move(dir));
         return h->done().then([h]() {
             return make_ready_future<std::vector<db::commitlog::descriptor>>(std::move(h->_result));
@@ -989,6 +1200,22 @@ scollectd::registrations db::commitlog::segment_manager::create_counters() {
                         , per_cpu_plugin_instance, "total_bytes", "slack")
                 , make_typed(data_type::DERIVE, totals.bytes_slack)
         ),
+        add_polled_metric(type_instance_id("commitlog"
+                        , per_cpu_plugin_instance, "total_bytes", "compressed_in")
+                , make_typed(data_type::DERIVE, totals.bytes_compressed_in)
+        ),
+        add_polled_metric(type_instance_id("commitlog"
+                        , per_cpu_plugin_instance, "total_bytes", "compressed_out")
+                , make_typed(data_type::DERIVE, totals.bytes_compressed_out)
+        ),
+        add_polled_metric(type_instance_id("commitlog"
+                        , per_cpu_plugin_instance, "total_operations", "group_sync")
+                , make_typed(data_type::DERIVE, totals.group_syncs)
+        ),
+        add_polled_metric(type_instance_id("commitlog"
+                        , per_cpu_plugin_instance, "total_operations", "group_sync_writes")
+                , make_typed(data_type::DERIVE, totals.group_sync_writes)
+        ),
 
         add_polled_metric(type_instance_id("commitlog"
                         , per_cpu_plugin_instance, "queue_length", "pending_writes")
@@ -1213,7 +1440,7 @@ void db::commitlog::segment_manager::on_timer() {
     // without waiting for them, so segement_manager could be shut down
     // while they are running.
     seastar::with_gate(_gate, [this] {
-        if (cfg.mode != sync_mode::BATCH) {
+        if (cfg.mode == sync_mode::PERIODIC) {
             sync();
         }
         // IFF a new segment was put in use since last we checked, and we're
@@ -1464,16 +1691,26 @@ const db::commitlog::config& db::commitlog::active_config() const {
 // on error at startup if required
 future<std::unique_ptr<subscription<temporary_buffer<char>, db::replay_position>>>
 db::commitlog::read_log_file(const sstring& filename, commit_load_reader_func next, position_type off) {
-    return open_checked_file_dma(commit_error, filename, open_flags::ro).then([next = std::move(next), off](file f) {
+    return read_log_file(filename, std::move(next), off, default_priority_class());
+}
+
+future<std::unique_ptr<subscription<temporary_buffer<char>, db::replay_position>>>
+db::commitlog::read_log_file(const sstring& filename, commit_load_reader_func next, position_type off, const io_priority_class& pc) {
+    return open_checked_file_dma(commit_error, filename, open_flags::ro).then([next = std::move(next), off, &pc](file f) {
        return std::make_unique<subscription<temporary_buffer<char>, replay_position>>(
-           read_log_file(std::move(f), std::move(next), off));
+           read_log_file(std::move(f), std::move(next), off, pc));
     });
 }
 
+subscription<temporary_buffer<char>, db::replay_position>
+db::commitlog::read_log_file(file f, commit_load_reader_func next, position_type off) {
+    return read_log_file(std::move(f), std::move(next), off, default_priority_class());
+}
+
 // No commit_io_check needed in the log reader since the database will fail
 // on error at startup if required
 subscription<temporary_buffer<char>, db::replay_position>
-db::commitlog::read_log_file(file f, commit_load_reader_func next, position_type off) {
+db::commitlog::read_log_file(file f, commit_load_reader_func next, position_type off, const io_priority_class& pc) {
     struct work {
         file f;
         stream<temporary_buffer<char>, replay_position> s;
@@ -1488,9 +1725,19 @@ db::commitlog::read_log_file(file f, commit_load_reader_func next, position_type
         size_t corrupt_size = 0;
         bool eof = false;
         bool header = true;
-
-        work(file f, position_type o = 0)
-                : f(f), fin(make_file_input_stream(f)), start_off(o) {
+        bool compressed = false;
+
+        static file_input_stream_options make_options(const io_priority_class& pc) {
+            file_input_stream_options options;
+            options.io_priority_class = pc;
+            // Segments are read start to end, so keep reads in flight
+            // ahead of the one being parsed.
+            options.buffer_size = 128 * 1024;
+            options.read_ahead = 4;
+            return options;
+        }
+        work(file f, position_type o, const io_priority_class& pc)
+                : f(f), fin(make_file_input_stream(f, 0, make_options(pc))), start_off(o) {
         }
         work(work&&) = default;
 
@@ -1540,7 +1787,7 @@ db::commitlog::read_log_file(file f, commit_load_reader_func next, position_type
                     return stop();
                 }
 
-                if (magic != segment::segment_magic) {
+                if (magic != segment::segment_magic && magic != segment::compressed_segment_magic) {
                     throw std::invalid_argument("Not a scylla format commitlog file");
                 }
                 crc32_nbo crc;
@@ -1555,6 +1802,7 @@ db::commitlog::read_log_file(file f, commit_load_reader_func next, position_type
 
                 this->id = id;
                 this->next = 0;
+                this->compressed = magic == segment::compressed_segment_magic;
 
                 return make_ready_future<>();
             });
@@ -1592,6 +1840,10 @@ db::commitlog::read_log_file(file f, commit_load_reader_func next, position_type
 
                 this->next = next;
 
+                if (compressed) {
+                    return read_compressed_chunk();
+                }
+
                 if (start_off >= next) {
                     return skip(next - pos);
                 }
@@ -1661,6 +1913,99 @@ db::commitlog::read_log_file(file f, commit_load_reader_func next, position_type
                 });
             });
         }
+        future<> read_compressed_chunk() {
+            return fin.read_exactly(segment::compressed_chunk_header_size).then([this](temporary_buffer<char> buf) {
+                if (!advance(buf)) {
+                    return make_ready_future<>();
+                }
+
+                data_input in(buf);
+                auto first = in.read<uint32_t>();
+                auto len = in.read<uint32_t>();
+                auto clen = in.read<uint32_t>();
+                auto checksum = in.read<uint32_t>();
+
+                if (pos + clen > next) {
+                    logger.debug("Compressed segment chunk at {} is larger than the chunk. Skipping to next chunk", pos);
+                    corrupt_size += next - pos;
+                    return skip(next - pos);
+                }
+                // Positions in a compressed segment are those of the uncompressed entries.
+                if (start_off >= first + len) {
+                    return skip(next - pos);
+                }
+
+                return fin.read_exactly(clen).then([this, first, len, clen, checksum](temporary_buffer<char> buf) {
+                    if (!advance(buf)) {
+                        return make_ready_future<>();
+                    }
+
+                    crc32_nbo crc;
+                    crc.process(first);
+                    crc.process(len);
+                    crc.process(clen);
+                    crc.process_bytes(buf.get(), buf.size());
+
+                    temporary_buffer<char> data(len);
+                    if (buf.size() != clen || crc.checksum() != checksum
+                            || LZ4_decompress_safe(buf.get(), data.get_write(), clen, len) != int(len)) {
+                        logger.debug("Checksum error in compressed segment chunk at {}. Skipping to next chunk", pos);
+                        corrupt_size += len;
+                        return skip(next - pos);
+                    }
+
+                    return read_entries(std::move(data), first).then([this] {
+                        return skip(next - pos);
+                    });
+                });
+            });
+        }
+        // Same as read_entry, but over the entries of a decompressed chunk.
+        future<> read_entries(temporary_buffer<char> data, position_type first) {
+            return do_with(std::move(data), size_t(0), [this, first](temporary_buffer<char>& data, size_t& off) {
+                return repeat([this, first, &data, &off] {
+                    static constexpr size_t entry_header_size = segment::entry_overhead_size - sizeof(uint32_t);
+
+                    if (off + entry_header_size >= data.size()) {
+                        return make_ready_future<stop_iteration>(stop_iteration::yes);
+                    }
+
+                    replay_position rp(id, position_type(first + off));
+                    data_input in(data.share(off, entry_header_size));
+
+                    auto size = in.read<uint32_t>();
+                    auto checksum = in.read<uint32_t>();
+
+                    crc32_nbo crc;
+                    crc.process(size);
+
+                    if (size < 3 * sizeof(uint32_t) || checksum != crc.checksum() || off + size > data.size()) {
+                        // Nothing after a broken header can be trusted within the chunk
+                        logger.debug("Segment entry at {} has broken header. Skipping to next chunk ({} bytes)", rp, data.size() - off);
+                        corrupt_size += data.size() - off;
+                        return make_ready_future<stop_iteration>(stop_iteration::yes);
+                    }
+
+                    auto data_size = size - segment::entry_overhead_size;
+                    auto entry = data.share(off + entry_header_size, data_size);
+                    data_input tail(data.share(off + size - sizeof(uint32_t), sizeof(uint32_t)));
+                    checksum = tail.read<uint32_t>();
+                    off += size;
+
+                    crc.process_bytes(entry.get(), data_size);
+
+                    if (crc.checksum() != checksum) {
+                        logger.debug("Segment entry at {} checksum error. Skipping {} bytes", rp, size);
+                        corrupt_size += size;
+                        return make_ready_future<stop_iteration>(stop_iteration::no);
+                    }
+
+                    return s.produce(std::move(entry), rp).then([] {
+                        return stop_iteration::no;
+                    });
+                });
+            });
+        }
         future<> read_file() {
             return f.size().then([this](uint64_t size) {
                 file_size = size;
@@ -1677,7 +2022,7 @@ db::commitlog::read_log_file(file f, commit_load_reader_func next, position_type
         }
     };
 
-    auto w = make_lw_shared<work>(std::move(f), off);
+    auto w = make_lw_shared<work>(std::move(f), off, pc);
     auto ret = w->s.listen(std::move(next));
 
     w->s.started().then(std::bind(&work::read_file, w.get())).then([w] {
@@ -1750,15 +2095,15 @@ future<std::vector<db::commitlog::descriptor>> db::commitlog::list_existing_desc
     return list_existing_descriptors(active_config().commit_log_location);
 }
 
-future<std::vector<db::commitlog::descriptor>> db::commitlog::list_existing_descriptors(const sstring& dir) const {
-    return _segment_manager->list_descriptors(dir);
+future<std::vector<db::commitlog::descriptor>> db::commitlog::list_existing_descriptors(const sstring& dir) {
+    return segment_manager::list_descriptors(dir);
 }
 
 future<std::vector<sstring>> db::commitlog::list_existing_segments() const {
     return list_existing_segments(active_config().commit_log_location);
 }
 
-future<std::vector<sstring>> db::commitlog::list_existing_segments(const sstring& dir) const {
+future<std::vector<sstring>> db::commitlog::list_existing_segments(const sstring& dir) {
     return list_existing_descriptors(dir).then([dir](auto descs) {
         std::vector<sstring> paths;
         std::transform(descs.begin(), descs.end(), std::back_inserter(paths), [&](auto& d) {
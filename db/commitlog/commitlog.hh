@@ -51,6 +51,7 @@
 #include "commitlog_entry.hh"
 
 class file;
+class io_priority_class;
 
 namespace db {
 
@@ -75,12 +76,20 @@ using cf_id_type = utils::UUID;
  * In BATCH mode, every write to the log will also send the data to disk
  * + issue a flush and wait for both to complete.
  *
+ * In GROUP mode, writes are acknowledged after a flush as in BATCH mode,
+ * but the first write after a flush waits a short window for others to
+ * join it, and all of them share a single write + flush.
+ *
  * In PERIODIC mode, most writes will only add to the internal memory
  * buffers. If the mem buffer is saturated, data is sent to disk, but we
  * don't wait for the write to complete. However, if periodic (timer)
  * flushing has not been done in X ms, we will write + flush to file. In
  * which case we wait for it.
  *
+ * Segments can optionally be compressed, in which case every chunk of
+ * entries is LZ4 compressed before being written. Replay positions then
+ * refer to positions in the uncompressed stream of entries.
+ *
  * The commitlog does not guarantee any ordering between "add" callers
  * (due to the above). The actual order in the commitlog is however
  * identified by the replay_position returned.
@@ -101,7 +110,7 @@ class commitlog {
     ::shared_ptr<segment_manager> _segment_manager;
 public:
     enum class sync_mode {
-        PERIODIC, BATCH
+        PERIODIC, BATCH, GROUP
     };
     struct config {
         config() = default;
@@ -112,6 +121,8 @@ class commitlog {
         uint64_t commitlog_total_space_in_mb = 0;
         uint64_t commitlog_segment_size_in_mb = 32;
         uint64_t commitlog_sync_period_in_ms = 10 * 1000; //TODO: verify default!
+        // How long the first write after a flush waits for others in GROUP mode.
+        uint64_t commitlog_sync_group_window_in_ms = 5;
         // Max number of segments to keep in pre-alloc reserve.
         // Not (yet) configurable from scylla.conf.
         uint64_t max_reserve_segments = 12;
@@ -121,6 +132,14 @@ class commitlog {
         uint64_t max_active_flushes = 0;
 
         sync_mode mode = sync_mode::PERIODIC;
+
+        // LZ4 compress segment chunks before writing them.
+        bool compress = false;
+
+        // Metrics are exported under fixed names, so only one commitlog
+        // per shard may register them. Other users of the segment
+        // machinery (e.g. the hints store) turn this off.
+        bool register_metrics = true;
     };
 
     struct descriptor {
@@ -294,10 +313,10 @@ class commitlog {
     future<> shutdown();
 
     future<std::vector<descriptor>> list_existing_descriptors() const;
-    future<std::vector<descriptor>> list_existing_descriptors(const sstring& dir) const;
+    static future<std::vector<descriptor>> list_existing_descriptors(const sstring& dir);
 
     future<std::vector<sstring>> list_existing_segments() const;
-    future<std::vector<sstring>> list_existing_segments(const sstring& dir) const;
+    static future<std::vector<sstring>> list_existing_segments(const sstring& dir);
 
     typedef std::function<future<>(temporary_buffer<char>, replay_position)> commit_load_reader_func;
 
@@ -314,8 +333,12 @@ class commitlog {
     };
 
     static subscription<temporary_buffer<char>, replay_position> read_log_file(file, commit_load_reader_func, position_type = 0);
+    static subscription<temporary_buffer<char>, replay_position> read_log_file(file, commit_load_reader_func, position_type,
+            const io_priority_class&);
     static future<std::unique_ptr<subscription<temporary_buffer<char>, replay_position>>> read_log_file(
             const sstring&, commit_load_reader_func, position_type = 0);
+    static future<std::unique_ptr<subscription<temporary_buffer<char>, replay_position>>> read_log_file(
+            const sstring&, commit_load_reader_func, position_type, const io_priority_class&);
 private:
     commitlog(config);
 
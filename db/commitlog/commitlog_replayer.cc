@@ -44,9 +44,12 @@
 #include <algorithm>
 #include <unordered_map>
 #include <boost/range/adaptor/map.hpp>
+#include <boost/range/irange.hpp>
 
 #include <core/future.hh>
 #include <core/sharded.hh>
+#include <core/semaphore.hh>
+#include <core/gate.hh>
 
 #include "commitlog.hh"
 #include "commitlog_replayer.hh"
@@ -61,8 +64,15 @@
 
 static logging::logger logger("commitlog_replayer");
 
+/*
+ * Segments are replayed in a pipeline. Each segment is read on the shard
+ * which wrote it, where its entries are decoded and filtered, and the
+ * mutations which survive are grouped into batches by the shard owning
+ * them. A batch is sent to its shard once large enough, and the reader
+ * goes on with the segment while it is being applied, up to a bound on
+ * the memory held by batches in flight.
+ */
 class db::commitlog_replayer::impl {
-    std::unordered_map<table_schema_version, column_mapping> _column_mappings;
 public:
     impl(seastar::sharded<cql3::query_processor>& db);
 
@@ -73,12 +83,14 @@ class db::commitlog_replayer::impl {
         uint64_t skipped_mutations = 0;
         uint64_t applied_mutations = 0;
         uint64_t corrupt_bytes = 0;
+        uint64_t bytes = 0;
 
         stats& operator+=(const stats& s) {
             invalid_mutations += s.invalid_mutations;
             skipped_mutations += s.skipped_mutations;
             applied_mutations += s.applied_mutations;
             corrupt_bytes += s.corrupt_bytes;
+            bytes += s.bytes;
             return *this;
         }
         stats operator+(const stats& s) const {
@@ -88,7 +100,34 @@ class db::commitlog_replayer::impl {
         }
     };
 
-    future<> process(stats*, temporary_buffer<char> buf, replay_position rp);
+    // A batch is sent to its shard when it holds this many bytes of mutations.
+    static constexpr size_t max_batch_bytes = 256 * 1024;
+    // Bytes of mutations a segment reader may have in flight.
+    static constexpr size_t max_pending_bytes = 16 * 1024 * 1024;
+
+    struct replay_entry {
+        commitlog_entry_reader cer;
+        const column_mapping* cm;
+        replay_position rp;
+    };
+    using batch = std::vector<replay_entry>;
+
+    // State of the replay of one segment, on the shard reading it.
+    struct segment_state {
+        stats s;
+        // Schema versions are written along with the first entry using
+        // them in each chunk, so the mappings of a segment suffice for it.
+        std::unordered_map<table_schema_version, column_mapping> column_mappings;
+        std::vector<batch> batches;
+        std::vector<size_t> batch_bytes;
+        semaphore memory{max_pending_bytes};
+        seastar::gate pending;
+
+        segment_state() : batches(smp::count), batch_bytes(smp::count) {}
+    };
+
+    future<> process(lw_shared_ptr<segment_state>, temporary_buffer<char> buf, replay_position rp);
+    future<> send_batch(lw_shared_ptr<segment_state>, unsigned shard);
     future<stats> recover(sstring file);
 
     typedef std::unordered_map<utils::UUID, replay_position> rp_map;
@@ -97,12 +136,22 @@ class db::commitlog_replayer::impl {
 
     seastar::sharded<cql3::query_processor>&
         _qp;
+    // Filled in by init() on the shard owning the replayer, and only read
+    // afterwards, by the shards reading segments.
     shard_rpm_map
         _rpm;
     shard_rp_map
         _min_pos;
+private:
+    replay_position min_pos(unsigned shard) const {
+        auto i = _min_pos.find(shard);
+        return i != _min_pos.end() ? i->second : replay_position();
+    }
 };
 
+constexpr size_t db::commitlog_replayer::impl::max_batch_bytes;
+constexpr size_t db::commitlog_replayer::impl::max_pending_bytes;
+
 db::commitlog_replayer::impl::impl(seastar::sharded<cql3::query_processor>& qp)
     : _qp(qp)
 {}
@@ -165,7 +214,7 @@ future<> db::commitlog_replayer::impl::init() {
 future<db::commitlog_replayer::impl::stats>
 db::commitlog_replayer::impl::recover(sstring file) {
     replay_position rp{commitlog::descriptor(file)};
-    auto gp = _min_pos[rp.shard_id()];
+    auto gp = min_pos(rp.shard_id());
 
     if (rp.id < gp.id) {
         logger.debug("skipping replay of fully-flushed {}", file);
@@ -176,89 +225,76 @@ db::commitlog_replayer::impl::recover(sstring file) {
         p = gp.pos;
     }
 
-    auto s = make_lw_shared<stats>();
+    auto st = make_lw_shared<segment_state>();
 
     return db::commitlog::read_log_file(file,
-            std::bind(&impl::process, this, s.get(), std::placeholders::_1,
+            std::bind(&impl::process, this, st, std::placeholders::_1,
                     std::placeholders::_2), p).then([](auto s) {
         auto f = s->done();
         return f.finally([s = std::move(s)] {});
-    }).then_wrapped([s](future<> f) {
+    }).then_wrapped([st](future<> f) {
         try {
             f.get();
         } catch (commitlog::segment_data_corruption_error& e) {
-            s->corrupt_bytes += e.bytes();
+            st->s.corrupt_bytes += e.bytes();
         } catch (...) {
             throw;
         }
-        return make_ready_future<stats>(*s);
+    }).finally([this, st] {
+        // Send what is left, and wait for all batches to be applied, even
+        // if reading failed, since they refer to the segment state.
+        return parallel_for_each(boost::irange(0u, smp::count), [this, st](unsigned shard) {
+            return send_batch(st, shard);
+        }).finally([st] {
+            return st->pending.close();
+        });
+    }).then([st] {
+        return make_ready_future<stats>(st->s);
     });
 }
 
-future<> db::commitlog_replayer::impl::process(stats* s, temporary_buffer<char> buf, replay_position rp) {
+future<> db::commitlog_replayer::impl::process(lw_shared_ptr<segment_state> st, temporary_buffer<char> buf, replay_position rp) {
+    auto s = &st->s;
+    s->bytes += buf.size();
     try {
 
         commitlog_entry_reader cer(buf);
         auto& fm = cer.mutation();
 
-        auto cm_it = _column_mappings.find(fm.schema_version());
-        if (cm_it == _column_mappings.end()) {
+        auto cm_it = st->column_mappings.find(fm.schema_version());
+        if (cm_it == st->column_mappings.end()) {
             if (!cer.get_column_mapping()) {
                 throw std::runtime_error(sprint("unknown schema version {}", fm.schema_version()));
             }
             logger.debug("new schema version {} in entry {}", fm.schema_version(), rp);
-            cm_it = _column_mappings.emplace(fm.schema_version(), *cer.get_column_mapping()).first;
+            cm_it = st->column_mappings.emplace(fm.schema_version(), *cer.get_column_mapping()).first;
         }
 
         auto shard_id = rp.shard_id();
-        if (rp < _min_pos[shard_id]) {
+        if (rp < min_pos(shard_id)) {
             logger.trace("entry {} is less than global min position. skipping", rp);
             s->skipped_mutations++;
             return make_ready_future<>();
         }
 
         auto uuid = fm.column_family_id();
-        auto& map = _rpm[shard_id];
-        auto i = map.find(uuid);
-        if (i != map.end() && rp <= i->second) {
-            logger.trace("entry {} at {} is younger than recorded replay position {}. skipping", fm.column_family_id(), rp, i->second);
-            s->skipped_mutations++;
-            return make_ready_future<>();
+        auto rpm = _rpm.find(shard_id);
+        if (rpm != _rpm.end()) {
+            auto i = rpm->second.find(uuid);
+            if (i != rpm->second.end() && rp <= i->second) {
+                logger.trace("entry {} at {} is younger than recorded replay position {}. skipping", fm.column_family_id(), rp, i->second);
+                s->skipped_mutations++;
+                return make_ready_future<>();
+            }
         }
 
         auto shard = _qp.local().db().local().shard_of(fm);
-        return _qp.local().db().invoke_on(shard, [this, cer = std::move(cer), cm_it, rp, shard, s] (database& db) -> future<> {
-            auto& fm = cer.mutation();
-            // TODO: might need better verification that the deserialized mutation
-            // is schema compatible. My guess is that just applying the mutation
-            // will not do this.
-            auto& cf = db.find_column_family(fm.column_family_id());
-
-            if (logger.is_enabled(logging::log_level::debug)) {
-                logger.debug("replaying at {} v={} {}:{} at {}", fm.column_family_id(), fm.schema_version(),
-                        cf.schema()->ks_name(), cf.schema()->cf_name(), rp);
-            }
-            // Removed forwarding "new" RP. Instead give none/empty.
-            // This is what origin does, and it should be fine.
-            // The end result should be that once sstables are flushed out
-            // their "replay_position" attribute will be empty, which is
-            // lower than anything the new session will produce.
-            if (cf.schema()->version() != fm.schema_version()) {
-                const column_mapping& cm = cm_it->second;
-                mutation m(fm.decorated_key(*cf.schema()), cf.schema());
-                converting_mutation_partition_applier v(cm, *cf.schema(), m.partition());
-                fm.partition().accept(cm, v);
-                cf.apply(std::move(m));
-            } else {
-                cf.apply(fm, cf.schema());
-            }
-            s->applied_mutations++;
-            return make_ready_future<>();
-        }).handle_exception([s](auto ep) {
-            s->invalid_mutations++;
-            // TODO: write mutation to file like origin.
-            logger.warn("error replaying: {}", ep);
-        });
+        auto size = fm.representation().size();
+        st->batches[shard].push_back(replay_entry{std::move(cer), &cm_it->second, rp});
+        st->batch_bytes[shard] += size;
+        if (st->batch_bytes[shard] >= max_batch_bytes) {
+            return send_batch(std::move(st), shard);
+        }
     } catch (no_such_column_family&) {
         // No such CF now? Origin just ignores this.
     } catch (...) {
@@ -270,6 +306,67 @@ future<> db::commitlog_replayer::impl::process(stats* s, temporary_buffer<char>
     return make_ready_future<>();
 }
 
+/*
+ * Sends the batch gathered for a shard to be applied there. Only waits for
+ * memory to be available for it, not for it to be applied, so that reading
+ * goes on meanwhile.
+ */
+future<> db::commitlog_replayer::impl::send_batch(lw_shared_ptr<segment_state> st, unsigned shard) {
+    if (st->batches[shard].empty()) {
+        return make_ready_future<>();
+    }
+    auto b = std::exchange(st->batches[shard], batch());
+    auto units = std::min(std::exchange(st->batch_bytes[shard], 0), max_pending_bytes);
+
+    return st->memory.wait(units).then([this, st, shard, units, b = std::move(b)] () mutable {
+        with_gate(st->pending, [this, st, shard, b = std::move(b)] () mutable {
+            return _qp.local().db().invoke_on(shard, [b = std::move(b)] (database& db) mutable {
+                return do_with(std::move(b), stats(), [&db] (batch& b, stats& s) {
+                    return do_for_each(b, [&db, &s] (replay_entry& e) {
+                        try {
+                            auto& fm = e.cer.mutation();
+                            // TODO: might need better verification that the deserialized mutation
+                            // is schema compatible. My guess is that just applying the mutation
+                            // will not do this.
+                            auto& cf = db.find_column_family(fm.column_family_id());
+
+                            if (logger.is_enabled(logging::log_level::debug)) {
+                                logger.debug("replaying at {} v={} {}:{} at {}", fm.column_family_id(), fm.schema_version(),
+                                        cf.schema()->ks_name(), cf.schema()->cf_name(), e.rp);
+                            }
+                            // Removed forwarding "new" RP. Instead give none/empty.
+                            // This is what origin does, and it should be fine.
+                            // The end result should be that once sstables are flushed out
+                            // their "replay_position" attribute will be empty, which is
+                            // lower than anything the new session will produce.
+                            if (cf.schema()->version() != fm.schema_version()) {
+                                const column_mapping& cm = *e.cm;
+                                mutation m(fm.decorated_key(*cf.schema()), cf.schema());
+                                converting_mutation_partition_applier v(cm, *cf.schema(), m.partition());
+                                fm.partition().accept(cm, v);
+                                cf.apply(std::move(m));
+                            } else {
+                                cf.apply(fm, cf.schema());
+                            }
+                            s.applied_mutations++;
+                        } catch (...) {
+                            s.invalid_mutations++;
+                            // TODO: write mutation to file like origin.
+                            logger.warn("error replaying: {}", std::current_exception());
+                        }
+                    }).then([&s] {
+                        return s;
+                    });
+                });
+            }).then([st] (stats s) {
+                st->s += s;
+            }).finally([st, units] {
+                st->memory.signal(units);
+            });
+        });
+    });
+}
+
 db::commitlog_replayer::commitlog_replayer(seastar::sharded<cql3::query_processor>& qp)
     : _impl(std::make_unique<impl>(qp))
 {}
@@ -292,35 +389,57 @@ future<db::commitlog_replayer> db::commitlog_replayer::create_replayer(seastar::
 
 future<> db::commitlog_replayer::recover(std::vector<sstring> files) {
     logger.info("Replaying {}", join(", ", files));
-    return map_reduce(files, [this](auto f) {
-        logger.debug("Replaying {}", f);
-        return _impl->recover(f).then([f](impl::stats stats) {
-            if (stats.corrupt_bytes != 0) {
-                logger.warn("Corrupted file: {}. {} bytes skipped.", f, stats.corrupt_bytes);
-            }
-            logger.debug("Log replay of {} complete, {} replayed mutations ({} invalid, {} skipped)"
-                            , f
-                            , stats.applied_mutations
-                            , stats.invalid_mutations
-                            , stats.skipped_mutations
-            );
-            return make_ready_future<impl::stats>(stats);
-        }).handle_exception([f](auto ep) -> future<impl::stats> {
-            logger.error("Error recovering {}: {}", f, ep);
-            try {
-                std::rethrow_exception(ep);
-            } catch (std::invalid_argument&) {
-                logger.error("Scylla cannot process {}. Make sure to fully flush all Cassandra commit log files to sstable before migrating.", f);
-                throw;
-            } catch (...) {
-                throw;
-            }
+
+    // Segments are read on the shard which wrote them, where most of their
+    // mutations belong, one at a time on each shard.
+    std::vector<std::vector<sstring>> shard_files(smp::count);
+    for (auto& f : files) {
+        replay_position rp{commitlog::descriptor(f)};
+        shard_files[rp.shard_id() % smp::count].push_back(f);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    return map_reduce(boost::irange(0u, smp::count), [this, shard_files = std::move(shard_files)] (unsigned shard) {
+        return smp::submit_to(shard, [this, files = shard_files[shard]] () mutable {
+            return do_with(std::move(files), impl::stats(), [this] (std::vector<sstring>& files, impl::stats& totals) {
+                return do_for_each(files, [this, &totals](const sstring& f) {
+                    logger.debug("Replaying {}", f);
+                    return _impl->recover(f).then([f, &totals](impl::stats stats) {
+                        if (stats.corrupt_bytes != 0) {
+                            logger.warn("Corrupted file: {}. {} bytes skipped.", f, stats.corrupt_bytes);
+                        }
+                        logger.debug("Log replay of {} complete, {} replayed mutations ({} invalid, {} skipped)"
+                                        , f
+                                        , stats.applied_mutations
+                                        , stats.invalid_mutations
+                                        , stats.skipped_mutations
+                        );
+                        totals += stats;
+                    }).handle_exception([f](auto ep) -> future<> {
+                        logger.error("Error recovering {}: {}", f, ep);
+                        try {
+                            std::rethrow_exception(ep);
+                        } catch (std::invalid_argument&) {
+                            logger.error("Scylla cannot process {}. Make sure to fully flush all Cassandra commit log files to sstable before migrating.", f);
+                            throw;
+                        } catch (...) {
+                            throw;
+                        }
+                    });
+                }).then([&totals] {
+                    return totals;
+                });
+            });
         });
-    }, impl::stats(), std::plus<impl::stats>()).then([](impl::stats totals) {
-        logger.info("Log replay complete, {} replayed mutations ({} invalid, {} skipped)"
+    }, impl::stats(), std::plus<impl::stats>()).then([start](impl::stats totals) {
+        auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        logger.info("Log replay complete, {} replayed mutations ({} invalid, {} skipped) in {:.2f} s ({:.2f} MB/s, {:.0f} mutations/s)"
                         , totals.applied_mutations
                         , totals.invalid_mutations
                         , totals.skipped_mutations
+                        , secs
+                        , secs > 0 ? totals.bytes / secs / (1024 * 1024) : 0
+                        , secs > 0 ? totals.applied_mutations / secs : 0
         );
     });
 }
@@ -186,6 +186,9 @@ class config {
     val(data_file_directories, string_list, { "/var/lib/scylla/data" }, Used,   \
             "The directory location where table data (SSTables) is stored"   \
     )                                           \
+    val(hints_directory, sstring, "/var/lib/scylla/hints", Used,   \
+            "The directory where hints are stored until they can be delivered to their target node."   \
+    )                                           \
     val(saved_caches_directory, sstring, "/var/lib/scylla/saved_caches", Unused, \
             "The directory location where table key and row caches are stored."  \
     )                                                   \
@@ -291,6 +294,7 @@ class config {
             "\n"    \
             "\tperiodic : Used with commitlog_sync_period_in_ms (Default: 10000 - 10 seconds ) to control how often the commit log is synchronized to disk. Periodic syncs are acknowledged immediately.\n"   \
             "\tbatch : Used with commitlog_sync_batch_window_in_ms (Default: disabled **) to control how long Cassandra waits for other writes before performing a sync. When using this method, writes are not acknowledged until fsynced to disk.\n"  \
+            "\tgroup : Used with commitlog_sync_group_window_in_ms to control how long the first write after a sync waits for other writes, which are then synchronized to disk together. Writes are not acknowledged until fsynced to disk.\n"  \
             "Related information: Durability"   \
     )                                                   \
     val(commitlog_segment_size_in_mb, uint32_t, 64, Used,     \
@@ -305,6 +309,12 @@ class config {
     val(commitlog_sync_batch_window_in_ms, uint32_t, 10000, Used,     \
             "Controls how long the system waits for other writes before performing a sync in \"batch\" mode."    \
     )   \
+    val(commitlog_sync_group_window_in_ms, uint32_t, 5, Used,     \
+            "Controls how long the first write after a sync waits for other writes to share the next sync with in \"group\" mode."    \
+    )   \
+    val(commitlog_compression, sstring, "", Used,     \
+            "Compressor used for commitlog segments. Leave empty to write them uncompressed, or set to LZ4Compressor. Compressed segments can only be replayed by versions which support them."    \
+    )   \
     val(commitlog_total_space_in_mb, int64_t, -1, Used,     \
             "Total space used for commitlogs. If the used space goes above this value, Cassandra rounds up to the next nearest segment multiple and flushes memtables to disk for the oldest commitlog segments, removing those log segments. This reduces the amount of data to replay on startup, and prevents infrequently-updated tables from indefinitely keeping commitlog segments. A small total commitlog space tends to cause more flush activity on less-active tables.\n"  \
             "Related information: Configuring memtable throughput"  \
@@ -317,6 +327,12 @@ class config {
     val(concurrent_compactors, uint32_t, 0, Invalid,     \
             "Sets the number of concurrent compaction processes allowed to run simultaneously on a node, not including validation compactions for anti-entropy repair. Simultaneous compactions help preserve read performance in a mixed read-write workload by mitigating the tendency of small SSTables to accumulate during a single long-running compaction. If compactions run too slowly or too fast, change compaction_throughput_mb_per_sec first."  \
     )                                                   \
+    val(compaction_parallel_ranges, uint32_t, 4, Used,     \
+            "Maximum number of token sub-ranges compacted concurrently by each shard. Large compactions are split into sub-ranges, each read and written concurrently with the others, into sstables which don't overlap. Setting the value to 1 disables splitting."  \
+    )                                                   \
+    val(incremental_compaction_sstable_size_in_mb, uint32_t, 1024, Used,     \
+            "Size of the sstables written by compactions, which replace their input sstables as they are written, instead of once the compaction is done. An input sstable is only replaced once all of its data is written, and only together with output sstables which overlap no input that is kept. Inputs which all overlap one another, as those of size-tiered compaction usually do, are therefore only replaced at the end, and such compactions neither split their output nor save disk space. Otherwise a compaction only needs free disk space for a few of its output sstables on top of its inputs. Setting the value to 0 makes compactions write sstables of unbounded size and release their inputs when done."  \
+    )                                                   \
     val(in_memory_compaction_limit_in_mb, uint32_t, 64, Invalid,     \
             "Size limit for rows being compacted in memory. Larger rows spill to disk and use a slower two-pass compaction process. When this occurs, a message is logged specifying the row key. The recommended value is 5 to 10 percent of the available Java heap size."  \
     )                                                   \
@@ -376,6 +392,15 @@ class config {
     val(inter_dc_stream_throughput_outbound_megabits_per_sec, uint32_t, 0, Unused,     \
             "Throttles all streaming file transfer between the data centers. This setting allows throttles streaming throughput betweens data centers in addition to throttling all network stream traffic as configured with stream_throughput_outbound_megabits_per_sec."  \
     )   \
+    val(stream_mutation_batch_size_in_kb, uint32_t, 256, Used,     \
+            "Streamed mutations are sent in batches of up to this size. Set to 0 to send them one by one."  \
+    )   \
+    val(stream_max_outstanding_batches, uint32_t, 16, Used,     \
+            "Maximum number of mutation batches each shard of a stream session may have sent without a reply."  \
+    )   \
+    val(stream_whole_sstables, bool, true, Used,     \
+            "Send sstables whose data lies entirely within a streamed range as files, without deserializing them, instead of as mutations."  \
+    )   \
     val(trickle_fsync, bool, false, Unused,     \
             "When doing sequential writing, enabling this option tells fsync to force the operating system to flush the dirty buffers at a set interval trickle_fsync_interval_in_kb. Enable this parameter to avoid sudden dirty buffer flushing from impacting read latencies. Recommended to use on SSDs, but not on HDDs."  \
     )   \
@@ -436,7 +461,7 @@ class config {
     val(key_cache_save_period, uint32_t, 14400, Unused,                \
             "Duration in seconds that keys are saved in cache. Caches are saved to saved_caches_directory. Saved caches greatly improve cold-start speeds and has relatively little effect on I/O."  \
     )   \
-    val(key_cache_size_in_mb, uint32_t, 100, Unused,                \
+    val(key_cache_size_in_mb, uint32_t, 100, Used,                \
             "A global cache setting for tables. It is the maximum size of the key cache in memory. To disable set to 0.\n"  \
             "Related information: nodetool setcachecapacity."   \
     )   \
@@ -548,6 +573,18 @@ class config {
     val(native_transport_max_frame_size_in_mb, uint32_t, 256, Unused,                \
             "The maximum size of allowed frame. Frame (requests) larger than this are rejected as invalid."  \
     )   \
+    val(native_transport_compression_threshold, uint32_t, 512, Used,                \
+            "Responses with a body smaller than this many bytes are sent uncompressed, even if the client negotiated compression."  \
+    )   \
+    val(native_transport_max_in_flight_reads, uint32_t, 0, Used,                \
+            "The maximum number of CQL reads in flight per shard. Further reads fail with OverloadedException. 0 means unlimited."  \
+    )   \
+    val(native_transport_max_in_flight_writes, uint32_t, 0, Used,                \
+            "The maximum number of CQL writes in flight per shard. Further writes fail with OverloadedException. 0 means unlimited."  \
+    )   \
+    val(native_transport_max_latency_in_ms, uint32_t, 0, Used,                \
+            "When the average latency of CQL requests on a shard exceeds this, new reads and writes fail with OverloadedException. 0 disables the check."  \
+    )   \
     /* RPC (remote procedure call) settings */  \
     /* Settings for configuring and tuning client connections. */   \
     val(broadcast_rpc_address, sstring, /* unset */, Used,    \
@@ -593,17 +630,17 @@ class config {
     val(dynamic_snitch_update_interval_in_ms, uint32_t, 100, Unused,     \
             "The time interval for how often the snitch calculates node scores. Because score calculation is CPU intensive, be careful when reducing this interval."  \
     )   \
-    val(hinted_handoff_enabled, bool, true, Unused,     \
+    val(hinted_handoff_enabled, bool, true, Used,     \
             "Enable or disable hinted handoff. To enable per data center, add data center list. For example: hinted_handoff_enabled: DC1,DC2. A hint indicates that the write needs to be replayed to an unavailable node. Where Cassandra writes the hint depends on the version:\n"  \
             "\n"    \
             "\tPrior to 1.0: Writes to a live replica node.\n"  \
             "\t1.0 and later: Writes to the coordinator node.\n"  \
             "Related information: About hinted handoff writes"  \
     )   \
-    val(hinted_handoff_throttle_in_kb, uint32_t, 1024, Unused,     \
+    val(hinted_handoff_throttle_in_kb, uint32_t, 1024, Used,     \
             "Maximum throttle per delivery thread in kilobytes per second. This rate reduces proportionally to the number of nodes in the cluster. For example, if there are two nodes in the cluster, each delivery thread will use the maximum rate. If there are three, each node will throttle to half of the maximum, since the two nodes are expected to deliver hints simultaneously."  \
     )   \
-    val(max_hint_window_in_ms, uint32_t, 10800000, Unused,     \
+    val(max_hint_window_in_ms, uint32_t, 10800000, Used,     \
             "Maximum amount of time that hints are generates hints for an unresponsive node. After this interval, new hints are no longer generated until the node is back up and responsive. If the node goes down again, a new interval begins. This setting can prevent a sudden demand for resources when a node is brought back online and the rest of the cluster attempts to replay a large volume of hinted writes.\n"  \
             "Related information: Failure detection and recovery"  \
     )   \
@@ -714,7 +751,7 @@ class config {
     val(api_address, sstring, "", Used, "Http Rest API address") \
     val(api_ui_dir, sstring, "swagger-ui/dist/", Used, "The directory location of the API GUI") \
     val(api_doc_dir, sstring, "api/api-doc/", Used, "The API definition file directory") \
-    val(load_balance, sstring, "none", Used, "CQL request load balancing: 'none' or round-robin'") \
+    val(load_balance, sstring, "none", Used, "CQL load balancing of requests which cannot be routed to the shard owning their partition: 'none' or 'round-robin'") \
     val(consistent_rangemovement, bool, true, Used, "When set to true, range movements will be consistent. It means: 1) it will refuse to bootstrap a new node if other bootstrapping/leaving/moving nodes detected. 2) data will be streamed to a new node only from the node which is no longer responsible for the token range. Same as -Dcassandra.consistent.rangemovement in cassandra") \
     val(join_ring, bool, true, Used, "When set to true, a node will join the token ring. When set to false, a node will not join the token ring. User can use nodetool join to initiate ring joinging later. Same as -Dcassandra.join_ring in cassandra.") \
     val(load_ring_state, bool, true, Used, "When set to true, load tokens and host_ids previously saved. Same as -Dcassandra.load_ring_state in cassandra.") \
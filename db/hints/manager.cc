@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <seastar/core/future-util.hh>
+#include <seastar/core/do_with.hh>
+#include <seastar/core/sleep.hh>
+#include <seastar/core/reactor.hh>
+
+#include "manager.hh"
+#include "db/config.hh"
+#include "db/commitlog/commitlog_entry.hh"
+#include "converting_mutation_partition_applier.hh"
+#include "service/storage_proxy.hh"
+#include "service/priority_manager.hh"
+#include "gms/gossiper.hh"
+#include "gms/failure_detector.hh"
+#include "database.hh"
+#include "disk-error-handler.hh"
+#include "checked-file-impl.hh"
+#include "log.hh"
+
+static logging::logger logger("hints_manager");
+
+namespace db {
+namespace hints {
+
+distributed<manager> _the_manager;
+
+const std::chrono::seconds manager::delivery_interval;
+const size_t manager::max_hints_in_flight;
+
+class proxy_sender final : public manager::sender {
+public:
+    virtual schema_ptr find_schema(const utils::UUID& cf_id) override {
+        return service::get_local_storage_proxy().get_db().local().find_column_family(cf_id).schema();
+    }
+    virtual future<> send(mutation m, gms::inet_address ep) override {
+        return service::get_local_storage_proxy().send_to_endpoint(std::move(m), ep, db::write_type::SIMPLE);
+    }
+};
+
+// State of the delivery of a single segment.
+struct manager::send_context {
+    std::unordered_map<table_schema_version, column_mapping> column_mappings;
+    semaphore in_flight{max_hints_in_flight};
+    bool failed = false;
+};
+
+// Returns the names of the visible entries of a directory.
+static future<std::vector<sstring>> list_directory(sstring dirname) {
+    return open_checked_directory(general_disk_error, dirname).then([] (file dir) {
+        auto names = make_lw_shared<std::vector<sstring>>();
+        auto listing = make_lw_shared<subscription<directory_entry>>(dir.list_directory([names] (directory_entry de) {
+            if (!de.name.empty() && de.name[0] != '.') {
+                names->push_back(de.name);
+            }
+            return make_ready_future<>();
+        }));
+        return listing->done().then([names] {
+            return std::move(*names);
+        }).finally([listing, dir] {});
+    });
+}
+
+manager::manager(const db::config& cfg, std::unique_ptr<sender> s)
+    : _hints_dir(cfg.hints_directory() + "/" + to_sstring(engine().cpu_id()))
+    , _cfg(cfg)
+    , _sender(s ? std::move(s) : std::make_unique<proxy_sender>())
+{
+    auto add = [this] (const char* name, uint64_t& value) {
+        _collectd_registrations.push_back(
+            scollectd::add_polled_metric(scollectd::type_instance_id("hints_manager"
+                , scollectd::per_cpu_plugin_instance
+                , "total_operations", name)
+                , scollectd::make_typed(scollectd::data_type::DERIVE, value)));
+    };
+    add("written", _stats.written);
+    add("errors", _stats.errors);
+    add("not_stored", _stats.not_stored);
+    add("sent", _stats.sent);
+    add("send_errors", _stats.send_errors);
+    add("discarded", _stats.discarded);
+}
+
+future<> manager::start() {
+    return io_check(recursive_touch_directory, _hints_dir).then([this] {
+        return list_directory(_hints_dir);
+    }).then([this] (std::vector<sstring> names) {
+        // Hints left behind by a previous run.
+        for (auto& name : names) {
+            try {
+                get_state(gms::inet_address(name))->pending = true;
+            } catch (...) {
+                logger.warn("Ignoring unexpected entry {} in {}", name, _hints_dir);
+            }
+        }
+        _timer.set_callback(std::bind(&manager::on_timer, this));
+        _timer.arm_periodic(delivery_interval);
+    });
+}
+
+future<> manager::stop() {
+    if (_stopping) {
+        return make_ready_future<>();
+    }
+    _stopping = true;
+    _timer.cancel();
+    return _gate.close().then([this] {
+        return parallel_for_each(_states, [] (auto& e) {
+            auto st = e.second;
+            if (!st->log) {
+                return make_ready_future<>();
+            }
+            return st->log->shutdown().finally([st] {
+                st->log = std::experimental::nullopt;
+            });
+        });
+    });
+}
+
+manager::end_point_state_ptr manager::get_state(gms::inet_address ep) {
+    auto i = _states.find(ep);
+    if (i == _states.end()) {
+        auto st = make_lw_shared<end_point_state>(ep, _hints_dir + "/" + ep.to_sstring());
+        i = _states.emplace(ep, std::move(st)).first;
+    }
+    return i->second;
+}
+
+commitlog::config manager::make_commitlog_config(const sstring& dir) const {
+    commitlog::config cfg;
+    cfg.commit_log_location = dir;
+    cfg.commitlog_segment_size_in_mb = _cfg.commitlog_segment_size_in_mb();
+    cfg.commitlog_sync_period_in_ms = _cfg.commitlog_sync_period_in_ms();
+    cfg.mode = commitlog::sync_mode::PERIODIC;
+    // Hint logs come and go with the endpoints, a reserve would only leave
+    // empty segments behind.
+    cfg.max_reserve_segments = 0;
+    cfg.register_metrics = false;
+    return cfg;
+}
+
+future<> manager::ensure_log(end_point_state_ptr st) {
+    if (st->log) {
+        return make_ready_future<>();
+    }
+    return with_semaphore(st->log_creation, 1, [this, st] {
+        if (st->log) {
+            return make_ready_future<>();
+        }
+        return io_check(recursive_touch_directory, st->dir).then([this, st] {
+            return commitlog::create_commitlog(make_commitlog_config(st->dir));
+        }).then([st] (commitlog log) {
+            st->log.emplace(std::move(log));
+        });
+    });
+}
+
+future<std::vector<sstring>> manager::close_log_and_list_segments(end_point_state_ptr st) {
+    // Writers are held off until the segments are listed, so that we never
+    // pick up a segment of the log which replaces the closed one.
+    return with_lock(st->log_lock.for_write(), [st] {
+        auto f = make_ready_future<>();
+        if (st->log) {
+            f = st->log->shutdown().finally([st] {
+                st->log = std::experimental::nullopt;
+            });
+        }
+        return f.then([st] {
+            return io_check(recursive_touch_directory, st->dir);
+        }).then([st] {
+            return commitlog::list_existing_segments(st->dir);
+        });
+    });
+}
+
+future<> manager::store_hint(gms::inet_address ep, schema_ptr s, lw_shared_ptr<const frozen_mutation> fm) {
+    if (_stopping) {
+        note_not_stored(ep);
+        return make_ready_future<>();
+    }
+    auto st = get_state(ep);
+    return with_gate(_gate, [this, st, s = std::move(s), fm = std::move(fm)] () mutable {
+        return with_lock(st->log_lock.for_read(), [this, st, s = std::move(s), fm] () mutable {
+            return ensure_log(st).then([st, s = std::move(s), fm] {
+                return st->log->add_entry(fm->column_family_id(), commitlog_entry_writer(s, *fm, gc_clock::now()));
+            }).then([this, st] (replay_position) {
+                st->pending = true;
+                ++st->hints_created;
+                ++_stats.written;
+            });
+        }).finally([fm] {});
+    }).handle_exception([this, ep] (auto eptr) {
+        ++_stats.errors;
+        logger.warn("Failed to store hint for {}: {}", ep, eptr);
+    });
+}
+
+void manager::note_not_stored(gms::inet_address ep) {
+    ++get_state(ep)->hints_not_stored;
+    ++_stats.not_stored;
+}
+
+future<> manager::throttle(size_t size) {
+    auto throttle_in_kb = _cfg.hinted_handoff_throttle_in_kb();
+    if (!throttle_in_kb) {
+        return make_ready_future<>();
+    }
+    // The configured rate is meant for the whole node, and is split further
+    // since the other live nodes are expected to deliver their hints to the
+    // same endpoint at the same time.
+    auto nodes = std::max<size_t>(gms::get_local_gossiper().get_live_members().size(), 2) - 1;
+    auto bytes_per_second = double(throttle_in_kb) * 1024 / nodes / smp::count;
+    auto delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(size / bytes_per_second));
+    auto now = std::chrono::steady_clock::now();
+    _next_send = std::max(_next_send, now) + delay;
+    if (_next_send <= now) {
+        return make_ready_future<>();
+    }
+    return sleep(_next_send - now);
+}
+
+future<> manager::send_one_hint(end_point_state_ptr st, lw_shared_ptr<send_context> ctx, temporary_buffer<char> buf) {
+    auto size = buf.size();
+    return ctx->in_flight.wait().then([this, st, ctx, buf = std::move(buf)] () mutable {
+        try {
+            commitlog_entry_reader cer(buf);
+            auto& fm = cer.mutation();
+
+            auto cm_it = ctx->column_mappings.find(fm.schema_version());
+            if (cm_it == ctx->column_mappings.end()) {
+                if (!cer.get_column_mapping()) {
+                    throw std::runtime_error(sprint("unknown schema version %s", fm.schema_version()));
+                }
+                cm_it = ctx->column_mappings.emplace(fm.schema_version(), *cer.get_column_mapping()).first;
+            }
+
+            auto s = _sender->find_schema(fm.column_family_id());
+            // A hint kept past the table's gc_grace_seconds could resurrect
+            // data whose tombstones were already purged, so drop it.
+            if (cer.creation_time() && *cer.creation_time() + s->gc_grace_seconds() <= gc_clock::now()) {
+                ++_stats.discarded;
+                ctx->in_flight.signal();
+                return;
+            }
+            auto m = [&] {
+                if (s->version() == fm.schema_version()) {
+                    return fm.unfreeze(s);
+                }
+                const column_mapping& cm = cm_it->second;
+                mutation m(fm.decorated_key(*s), s);
+                converting_mutation_partition_applier v(cm, *s, m.partition());
+                fm.partition().accept(cm, v);
+                return m;
+            }();
+
+            _sender->send(std::move(m), st->endpoint).then_wrapped([this, st, ctx] (future<> f) {
+                try {
+                    f.get();
+                    ++_stats.sent;
+                } catch (...) {
+                    ++_stats.send_errors;
+                    ctx->failed = true;
+                    logger.debug("Failed to send hint to {}: {}", st->endpoint, std::current_exception());
+                }
+                ctx->in_flight.signal();
+            });
+        } catch (no_such_column_family&) {
+            // The table was dropped, and so were its hints.
+            ++_stats.discarded;
+            ctx->in_flight.signal();
+        } catch (...) {
+            ++_stats.send_errors;
+            ctx->failed = true;
+            logger.warn("Failed to decode hint for {}: {}", st->endpoint, std::current_exception());
+            ctx->in_flight.signal();
+        }
+    }).then([this, size] {
+        return throttle(size);
+    });
+}
+
+// Resolves to true when all hints of the segment were delivered and the
+// segment was removed.
+future<bool> manager::send_segment(end_point_state_ptr st, sstring path) {
+    auto ctx = make_lw_shared<send_context>();
+    logger.debug("Sending hints from {}", path);
+    return commitlog::read_log_file(path, [this, st, ctx] (temporary_buffer<char> buf, replay_position) {
+        return send_one_hint(st, ctx, std::move(buf));
+    }, 0, service::get_local_hints_priority()).then([] (auto s) {
+        auto f = s->done();
+        return f.finally([s = std::move(s)] {});
+    }).then_wrapped([st, ctx, path] (future<> f) {
+        try {
+            f.get();
+        } catch (commitlog::segment_data_corruption_error& e) {
+            // What could be read was sent, the rest will never be.
+            logger.warn("Corrupted hints segment {} ({} bytes lost)", path, e.bytes());
+        } catch (...) {
+            logger.warn("Failed to read hints segment {}: {}", path, std::current_exception());
+            ctx->failed = true;
+        }
+        return ctx->in_flight.wait(max_hints_in_flight);
+    }).then([st, ctx, path] {
+        if (ctx->failed) {
+            return make_ready_future<bool>(false);
+        }
+        return io_check(remove_file, path).then([] {
+            return true;
+        });
+    });
+}
+
+future<> manager::deliver(end_point_state_ptr st) {
+    if (st->delivering || _paused || _stopping) {
+        return make_ready_future<>();
+    }
+    st->delivering = true;
+    return with_gate(_gate, [this, st] {
+        logger.debug("Delivering hints to {}", st->endpoint);
+        return close_log_and_list_segments(st).then([this, st] (std::vector<sstring> segments) {
+            return do_with(std::move(segments), true, [this, st] (auto& segments, bool& complete) {
+                return do_for_each(segments, [this, st, &complete] (const sstring& path) {
+                    if (_paused || _stopping) {
+                        complete = false;
+                        return make_ready_future<>();
+                    }
+                    return send_segment(st, path).then([&complete] (bool sent) {
+                        complete &= sent;
+                    });
+                }).then([st, &complete] {
+                    // A log is only opened again if new hints were stored.
+                    if (complete && !st->log) {
+                        st->pending = false;
+                    }
+                });
+            });
+        });
+    }).handle_exception([st] (auto ep) {
+        logger.warn("Failed to deliver hints to {}: {}", st->endpoint, ep);
+    }).finally([st] {
+        st->delivering = false;
+    });
+}
+
+void manager::on_timer() {
+    for (auto& e : _states) {
+        auto& st = e.second;
+        if (st->pending && gms::get_local_failure_detector().is_alive(st->endpoint)) {
+            deliver(st);
+        }
+    }
+}
+
+void manager::on_up(const gms::inet_address& endpoint) {
+    auto i = _states.find(endpoint);
+    if (i != _states.end() && i->second->pending) {
+        deliver(i->second);
+    }
+}
+
+future<> manager::schedule_delivery(gms::inet_address ep) {
+    auto st = get_state(ep);
+    st->pending = true;
+    return deliver(st);
+}
+
+future<> manager::truncate_hints(std::experimental::optional<gms::inet_address> ep) {
+    if (_stopping) {
+        return make_ready_future<>();
+    }
+    std::vector<end_point_state_ptr> states;
+    for (auto& e : _states) {
+        if (!ep || e.first == *ep) {
+            states.push_back(e.second);
+        }
+    }
+    return with_gate(_gate, [this, states = std::move(states)] {
+        return parallel_for_each(states, [this] (end_point_state_ptr st) {
+            return close_log_and_list_segments(st).then([] (std::vector<sstring> segments) {
+                return parallel_for_each(segments, [] (sstring path) {
+                    return io_check(remove_file, path);
+                });
+            }).then([st] {
+                if (!st->log) {
+                    st->pending = false;
+                }
+            });
+        });
+    });
+}
+
+std::vector<gms::inet_address> manager::endpoints_pending_hints() const {
+    std::vector<gms::inet_address> res;
+    for (auto& e : _states) {
+        if (e.second->pending) {
+            res.push_back(e.first);
+        }
+    }
+    return res;
+}
+
+uint64_t manager::get_create_hint_count(gms::inet_address ep) const {
+    auto i = _states.find(ep);
+    return i == _states.end() ? 0 : i->second->hints_created;
+}
+
+uint64_t manager::get_not_stored_hints_count(gms::inet_address ep) const {
+    auto i = _states.find(ep);
+    return i == _states.end() ? 0 : i->second->hints_not_stored;
+}
+
+}
+}
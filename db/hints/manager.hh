@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <experimental/optional>
+#include <seastar/core/future.hh>
+#include <seastar/core/distributed.hh>
+#include <seastar/core/timer.hh>
+#include <seastar/core/gate.hh>
+#include <seastar/core/rwlock.hh>
+#include <seastar/core/semaphore.hh>
+#include <seastar/core/scollectd.hh>
+
+#include "db/commitlog/commitlog.hh"
+#include "gms/inet_address.hh"
+#include "service/endpoint_lifecycle_subscriber.hh"
+#include "frozen_mutation.hh"
+#include "mutation.hh"
+#include "schema.hh"
+
+namespace db {
+
+class config;
+
+namespace hints {
+
+/*
+ * Hinted handoff.
+ *
+ * Writes which could not be delivered to a replica are stored by the
+ * coordinator and delivered once the replica comes back. Hints are kept
+ * per target endpoint in commitlog segments under
+ * <hints_directory>/<shard>/<endpoint>, so they survive a restart.
+ *
+ * Delivery of an endpoint's hints starts when gossip reports it up, and is
+ * retried periodically while hints remain. Before delivering, the active
+ * log of the endpoint is closed so that every segment on disk is complete;
+ * hints arriving meanwhile go to a new log. A segment is removed once all
+ * of its hints have been acknowledged, otherwise it is kept for the next
+ * attempt. Segments are read with the "hints" I/O priority class and the
+ * sending rate is bounded by hinted_handoff_throttle_in_kb.
+ */
+class manager : public service::endpoint_lifecycle_subscriber {
+public:
+    // Delivers hints to their endpoint. The default one goes through
+    // storage_proxy; tests use their own.
+    class sender {
+    public:
+        virtual ~sender() {}
+        // Returns the current schema of the table, or throws
+        // no_such_column_family if it was dropped.
+        virtual schema_ptr find_schema(const utils::UUID& cf_id) = 0;
+        virtual future<> send(mutation m, gms::inet_address ep) = 0;
+    };
+
+    struct stats {
+        uint64_t written = 0;
+        uint64_t errors = 0;
+        uint64_t not_stored = 0;
+        uint64_t sent = 0;
+        uint64_t send_errors = 0;
+        uint64_t discarded = 0;
+    };
+private:
+    using clock_type = lowres_clock;
+    static constexpr std::chrono::seconds delivery_interval{10};
+    static constexpr size_t max_hints_in_flight = 128;
+
+    struct end_point_state {
+        gms::inet_address endpoint;
+        sstring dir;
+        std::experimental::optional<commitlog> log;
+        // Taken shared by writers, and exclusively to close the log.
+        rwlock log_lock;
+        semaphore log_creation{1};
+        // Set when hints may be on disk, cleared by a complete delivery.
+        bool pending = false;
+        bool delivering = false;
+        uint64_t hints_created = 0;
+        uint64_t hints_not_stored = 0;
+
+        end_point_state(gms::inet_address ep, sstring d)
+            : endpoint(ep), dir(std::move(d)) {}
+    };
+    using end_point_state_ptr = lw_shared_ptr<end_point_state>;
+
+    struct send_context;
+
+    sstring _hints_dir;
+    const db::config& _cfg;
+    std::unique_ptr<sender> _sender;
+    std::unordered_map<gms::inet_address, end_point_state_ptr> _states;
+    stats _stats;
+    std::vector<scollectd::registration> _collectd_registrations;
+    timer<clock_type> _timer;
+    std::chrono::steady_clock::time_point _next_send;
+    seastar::gate _gate;
+    bool _paused = false;
+    bool _stopping = false;
+private:
+    end_point_state_ptr get_state(gms::inet_address ep);
+    commitlog::config make_commitlog_config(const sstring& dir) const;
+    future<> ensure_log(end_point_state_ptr st);
+    future<std::vector<sstring>> close_log_and_list_segments(end_point_state_ptr st);
+    future<> deliver(end_point_state_ptr st);
+    future<bool> send_segment(end_point_state_ptr st, sstring path);
+    future<> send_one_hint(end_point_state_ptr st, lw_shared_ptr<send_context> ctx, temporary_buffer<char> buf);
+    future<> throttle(size_t size);
+    void on_timer();
+public:
+    explicit manager(const db::config& cfg, std::unique_ptr<sender> s = {});
+
+    future<> start();
+    future<> stop();
+
+    // Stores a hint for the target endpoint. The returned future resolves
+    // once the hint was accepted by the endpoint's log.
+    future<> store_hint(gms::inet_address ep, schema_ptr s, lw_shared_ptr<const frozen_mutation> fm);
+    // Accounts for a hint which was not stored, e.g. because the endpoint
+    // has been down for longer than max_hint_window_in_ms.
+    void note_not_stored(gms::inet_address ep);
+
+    // Starts delivering the hints of an endpoint, unless already running.
+    // The returned future resolves once this attempt is over.
+    future<> schedule_delivery(gms::inet_address ep);
+    void pause_delivery(bool pause) {
+        _paused = pause;
+    }
+    // Drops the stored hints for one endpoint, or for all of them.
+    future<> truncate_hints(std::experimental::optional<gms::inet_address> ep = {});
+
+    std::vector<gms::inet_address> endpoints_pending_hints() const;
+    uint64_t get_create_hint_count(gms::inet_address ep) const;
+    uint64_t get_not_stored_hints_count(gms::inet_address ep) const;
+    const stats& get_stats() const {
+        return _stats;
+    }
+
+    virtual void on_join_cluster(const gms::inet_address& endpoint) override {}
+    virtual void on_leave_cluster(const gms::inet_address& endpoint) override {}
+    virtual void on_up(const gms::inet_address& endpoint) override;
+    virtual void on_down(const gms::inet_address& endpoint) override {}
+    virtual void on_move(const gms::inet_address& endpoint) override {}
+};
+
+extern distributed<manager> _the_manager;
+
+inline distributed<manager>& get_manager() {
+    return _the_manager;
+}
+
+inline manager& get_local_manager() {
+    return _the_manager.local();
+}
+
+}
+
+}
@@ -126,33 +126,12 @@ int i_partitioner::tri_compare(const token& t1, const token& t2) {
     return 0;
 }
 
-int tri_compare(const token& t1, const token& t2) {
-    if (t1._kind == t2._kind) {
-        return global_partitioner().tri_compare(t1, t2);
-    } else if (t1._kind < t2._kind) {
-        return -1;
-    }
-    return 1;
-}
-
-bool operator==(const token& t1, const token& t2)
-{
-    if (t1._kind != t2._kind) {
-        return false;
-    } else if (t1._kind == token::kind::key) {
-        return global_partitioner().is_equal(t1, t2);
-    }
-    return true;
+int tri_compare_slow(const token& t1, const token& t2) {
+    return global_partitioner().tri_compare(t1, t2);
 }
 
-bool operator<(const token& t1, const token& t2)
-{
-    if (t1._kind < t2._kind) {
-        return true;
-    } else if (t1._kind == token::kind::key && t2._kind == token::kind::key) {
-        return global_partitioner().is_less(t1, t2);
-    }
-    return false;
+bytes token::data() const {
+    return with_data([] (bytes_view v) { return bytes(v.begin(), v.end()); });
 }
 
 std::ostream& operator<<(std::ostream& out, const token& t) {
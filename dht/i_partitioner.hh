@@ -87,13 +87,26 @@ class token {
     //     [0x00, 0x80] == 1/512
     //     [0xff, 0x80] == 1 - 1/512
     managed_bytes _data;
-
+private:
+    // Partitioners with fixed-width 64-bit tokens (Murmur3Partitioner) keep
+    // the value inline, so that such tokens can be copied and compared
+    // without going through _data, which is then left empty.
+    int64_t _long_value = 0;
+    bool _has_long_value = false;
+public:
     token() : _kind(kind::before_all_keys) {
     }
 
     token(kind k, managed_bytes d) : _kind(std::move(k)), _data(std::move(d)) {
     }
 
+    static token from_long(int64_t value) {
+        token t(kind::key, managed_bytes());
+        t._long_value = value;
+        t._has_long_value = true;
+        return t;
+    }
+
     bool is_minimum() const {
         return _kind == kind::before_all_keys;
     }
@@ -101,14 +114,64 @@ class token {
     bool is_maximum() const {
         return _kind == kind::after_all_keys;
     }
+
+    bool has_long_value() const {
+        return _has_long_value;
+    }
+
+    int64_t long_value() const {
+        return _long_value;
+    }
+
+    // Returns the token's value as a big endian byte string, regardless of
+    // how it is stored.
+    bytes data() const;
+
+    // Calls func with a view of data(), without allocating.
+    template <typename Func>
+    decltype(auto) with_data(Func&& func) const {
+        if (_has_long_value) {
+            auto be = net::hton(_long_value);
+            return func(bytes_view(reinterpret_cast<const int8_t*>(&be), sizeof(be)));
+        }
+        return func(bytes_view(_data));
+    }
 };
 
 token midpoint_unsigned(const token& t1, const token& t2);
 token minimum_token();
 token maximum_token();
-bool operator==(const token& t1, const token& t2);
-bool operator<(const token& t1, const token& t2);
-int tri_compare(const token& t1, const token& t2);
+// Used by the comparisons below when at least one of the tokens doesn't
+// have an inline long value.
+int tri_compare_slow(const token& t1, const token& t2);
+
+inline int tri_compare(const token& t1, const token& t2) {
+    if (t1._kind != t2._kind) {
+        return t1._kind < t2._kind ? -1 : 1;
+    }
+    if (t1._kind != token::kind::key) {
+        return 0;
+    }
+    if (t1.has_long_value() && t2.has_long_value()) {
+        return (t1.long_value() > t2.long_value()) - (t1.long_value() < t2.long_value());
+    }
+    return tri_compare_slow(t1, t2);
+}
+
+inline bool operator==(const token& t1, const token& t2) {
+    if (t1.has_long_value() && t2.has_long_value()) {
+        return t1.long_value() == t2.long_value();
+    }
+    return tri_compare(t1, t2) == 0;
+}
+
+inline bool operator<(const token& t1, const token& t2) {
+    if (t1.has_long_value() && t2.has_long_value()) {
+        return t1.long_value() < t2.long_value();
+    }
+    return tri_compare(t1, t2) < 0;
+}
+
 inline bool operator!=(const token& t1, const token& t2) { return std::rel_ops::operator!=(t1, t2); }
 inline bool operator>(const token& t1, const token& t2) { return std::rel_ops::operator>(t1, t2); }
 inline bool operator<=(const token& t1, const token& t2) { return std::rel_ops::operator<=(t1, t2); }
@@ -259,7 +322,7 @@ class i_partitioner {
      * @return bytes that represent the token as required by get_token_validator().
      */
     virtual bytes token_to_bytes(const token& t) const {
-        return bytes(t._data.begin(), t._data.end());
+        return t.data();
     }
 protected:
     /**
@@ -279,9 +342,7 @@ class i_partitioner {
         return tri_compare(t1, t2) < 0;
     }
 
-    friend bool operator==(const token& t1, const token& t2);
-    friend bool operator<(const token& t1, const token& t2);
-    friend int tri_compare(const token& t1, const token& t2);
+    friend int tri_compare_slow(const token& t1, const token& t2);
 };
 
 //
@@ -423,7 +484,11 @@ namespace std {
 template<>
 struct hash<dht::token> {
     size_t operator()(const dht::token& t) const {
-        return (t._kind == dht::token::kind::key) ? std::hash<decltype(t._data)>()(t._data) : 0;
+        if (t._kind != dht::token::kind::key) {
+            return 0;
+        }
+        // Must hash equal tokens equally, whatever their representation.
+        return t.with_data([] (bytes_view v) { return std::hash<bytes_view>()(v); });
     }
 };
 }
@@ -50,10 +50,7 @@ murmur3_partitioner::get_token(uint64_t value) const {
     // We don't normalize() the value, since token includes an is-before-everything
     // indicator.
     // FIXME: will this require a repair when importing a database?
-    auto t = net::hton(normalize(value));
-    bytes b(bytes::initialized_later(), 8);
-    std::copy_n(reinterpret_cast<int8_t*>(&t), 8, b.begin());
-    return token{token::kind::key, std::move(b)};
+    return token::from_long(normalize(value));
 }
 
 token
@@ -79,6 +76,12 @@ inline int64_t long_token(const token& t) {
         return std::numeric_limits<long>::min();
     }
 
+    if (t.has_long_value()) {
+        return t.long_value();
+    }
+
+    // Tokens which were deserialized or built by hand from their byte
+    // representation.
     if (t._data.size() != sizeof(int64_t)) {
         throw runtime_exception(sprint("Invalid token. Should have size %ld, has size %ld\n", sizeof(int64_t), t._data.size()));
     }
@@ -124,7 +127,7 @@ token murmur3_partitioner::midpoint(const token& t1, const token& t2) const {
     auto l1 = long_token(t1);
     auto l2 = long_token(t2);
     int64_t mid;
-    if (l1 <= l2) {
+    if (l1 < l2) {
         // To find the midpoint, we cannot use the trivial formula (l1+l2)/2
         // because the addition can overflow the integer. To avoid this
         // overflow, we first notice that the above formula is equivalent to
@@ -138,7 +141,8 @@ token murmur3_partitioner::midpoint(const token& t1, const token& t2) const {
         // formula, because now l1 - l2 is positive.
         // Additionally, we consider this case is a "wrap around", so we need
         // to behave as if l2 + 2^64 was meant instead of l2, i.e., add 2^63
-        // to the average.
+        // to the average. As in Origin, equal tokens stand for the whole
+        // ring, e.g. (minimum_token(), minimum_token()].
         mid = l2 + positive_subtract(l1, l2)/2 + 0x8000'0000'0000'0000;
     }
     return get_token(mid);
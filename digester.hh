@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "md5_hasher.hh"
+#include "murmur3_hasher.hh"
+
+enum class digest_algorithm : uint8_t {
+    md5,
+    murmur3_128,
+};
+
+// A Hasher producing a 128-bit digest with the algorithm chosen at run time,
+// so that all replicas answering a query can be made to agree on it.
+class digester {
+    digest_algorithm _algorithm;
+    md5_hasher _md5;
+    murmur3_hasher _murmur3;
+public:
+    explicit digester(digest_algorithm algorithm = digest_algorithm::md5)
+        : _algorithm(algorithm)
+    { }
+
+    digest_algorithm algorithm() const {
+        return _algorithm;
+    }
+
+    void update(const char* ptr, size_t length) {
+        if (_algorithm == digest_algorithm::murmur3_128) {
+            _murmur3.update(ptr, length);
+        } else {
+            _md5.update(ptr, length);
+        }
+    }
+
+    std::array<uint8_t, 16> finalize_array() {
+        if (_algorithm == digest_algorithm::murmur3_128) {
+            return _murmur3.finalize_array();
+        }
+        return _md5.finalize_array();
+    }
+};
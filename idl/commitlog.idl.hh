@@ -22,4 +22,5 @@
 class commitlog_entry {
     std::experimental::optional<column_mapping> mapping();
     frozen_mutation mutation();
+    std::experimental::optional<gc_clock::time_point> creation_time() [[version 1.5]];
 };
\ No newline at end of file
@@ -4,6 +4,7 @@ class paging_state {
     partition_key get_partition_key();
     std::experimental::optional<clustering_key> get_clustering_key();
     uint32_t get_remaining();
+    std::experimental::optional<utils::UUID> get_query_uuid() [[version 1.4]];
 };
 }
 }
@@ -19,6 +19,11 @@
  * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+enum class repair_checksum : uint8_t {
+    sha256 = 0,
+    murmur3_128 = 1,
+};
+
 class partition_checksum {
   std::array<uint8_t, 32> digest();
 };
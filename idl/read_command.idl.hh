@@ -46,6 +46,7 @@ class read_command {
     uint32_t row_limit;
     std::chrono::time_point<gc_clock, gc_clock::duration> timestamp;
     std::experimental::optional<tracing::trace_info> trace_info [[version 1.3]];
+    std::experimental::optional<utils::UUID> query_id [[version 1.4]];
 };
 
 }
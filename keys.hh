@@ -341,18 +341,18 @@ class prefix_view_on_full_compound {
 
         bool operator()(const prefix_view_on_full_compound& k1, const PrefixTopLevel& k2) const {
             return lexicographical_tri_compare(
-                prefix_type->types().begin(), prefix_type->types().end(),
+                prefix_type->comparators().begin(), prefix_type->comparators().end(),
                 k1.begin(), k1.end(),
                 prefix_type->begin(k2), prefix_type->end(k2),
-                tri_compare) < 0;
+                value_comparator_tri_compare()) < 0;
         }
 
         bool operator()(const PrefixTopLevel& k1, const prefix_view_on_full_compound& k2) const {
             return lexicographical_tri_compare(
-                prefix_type->types().begin(), prefix_type->types().end(),
+                prefix_type->comparators().begin(), prefix_type->comparators().end(),
                 prefix_type->begin(k1), prefix_type->end(k1),
                 k2.begin(), k2.end(),
-                tri_compare) < 0;
+                value_comparator_tri_compare()) < 0;
         }
     };
 };
@@ -388,18 +388,18 @@ class prefix_view_on_prefix_compound {
 
         bool operator()(const prefix_view_on_prefix_compound& k1, const TopLevel& k2) const {
             return lexicographical_tri_compare(
-                prefix_type->types().begin(), prefix_type->types().end(),
+                prefix_type->comparators().begin(), prefix_type->comparators().end(),
                 k1.begin(), k1.end(),
                 prefix_type->begin(k2), prefix_type->end(k2),
-                tri_compare) < 0;
+                value_comparator_tri_compare()) < 0;
         }
 
         bool operator()(const TopLevel& k1, const prefix_view_on_prefix_compound& k2) const {
             return lexicographical_tri_compare(
-                prefix_type->types().begin(), prefix_type->types().end(),
+                prefix_type->comparators().begin(), prefix_type->comparators().end(),
                 prefix_type->begin(k1), prefix_type->end(k1),
                 k2.begin(), k2.end(),
-                tri_compare) < 0;
+                value_comparator_tri_compare()) < 0;
         }
     };
 };
@@ -432,18 +432,18 @@ class prefixable_full_compound : public compound_wrapper<TopLevel, TopLevelView>
 
         bool operator()(const TopLevel& k1, const PrefixTopLevel& k2) const {
             return lexicographical_tri_compare(
-                prefix_type->types().begin(), prefix_type->types().end(),
+                prefix_type->comparators().begin(), prefix_type->comparators().end(),
                 full_type->begin(k1), full_type->end(k1),
                 prefix_type->begin(k2), prefix_type->end(k2),
-                tri_compare) < 0;
+                value_comparator_tri_compare()) < 0;
         }
 
         bool operator()(const PrefixTopLevel& k1, const TopLevel& k2) const {
             return lexicographical_tri_compare(
-                prefix_type->types().begin(), prefix_type->types().end(),
+                prefix_type->comparators().begin(), prefix_type->comparators().end(),
                 prefix_type->begin(k1), prefix_type->end(k1),
                 full_type->begin(k2), full_type->end(k2),
-                tri_compare) < 0;
+                value_comparator_tri_compare()) < 0;
         }
     };
 
@@ -461,17 +461,17 @@ class prefixable_full_compound : public compound_wrapper<TopLevel, TopLevelView>
         { }
 
         bool operator()(const TopLevel& k1, const PrefixTopLevel& k2) const {
-            return prefix_equality_tri_compare(prefix_type->types().begin(),
+            return prefix_equality_tri_compare(prefix_type->comparators().begin(),
                 full_type->begin(k1), full_type->end(k1),
                 prefix_type->begin(k2), prefix_type->end(k2),
-                tri_compare) < 0;
+                value_comparator_tri_compare()) < 0;
         }
 
         bool operator()(const PrefixTopLevel& k1, const TopLevel& k2) const {
-            return prefix_equality_tri_compare(prefix_type->types().begin(),
+            return prefix_equality_tri_compare(prefix_type->comparators().begin(),
                 prefix_type->begin(k1), prefix_type->end(k1),
                 full_type->begin(k2), full_type->end(k2),
-                tri_compare) < 0;
+                value_comparator_tri_compare()) < 0;
         }
     };
 
@@ -529,10 +529,10 @@ class prefix_compound_wrapper : public compound_wrapper<TopLevel, TopLevelView>
         { }
 
         bool operator()(const TopLevel& k1, const TopLevel& k2) const {
-            return prefix_equality_tri_compare(prefix_type->types().begin(),
+            return prefix_equality_tri_compare(prefix_type->comparators().begin(),
                 prefix_type->begin(k1), prefix_type->end(k1),
                 prefix_type->begin(k2), prefix_type->end(k2),
-                tri_compare) < 0;
+                value_comparator_tri_compare()) < 0;
         }
     };
 
@@ -545,10 +545,10 @@ class prefix_compound_wrapper : public compound_wrapper<TopLevel, TopLevelView>
         { }
 
         int operator()(const TopLevel& k1, const TopLevel& k2) const {
-            return prefix_equality_tri_compare(prefix_type->types().begin(),
+            return prefix_equality_tri_compare(prefix_type->comparators().begin(),
                 prefix_type->begin(k1), prefix_type->end(k1),
                 prefix_type->begin(k2), prefix_type->end(k2),
-                tri_compare);
+                value_comparator_tri_compare());
         }
     };
 };
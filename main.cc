@@ -34,6 +34,7 @@
 #include "streaming/stream_session.hh"
 #include "db/system_keyspace.hh"
 #include "db/batchlog_manager.hh"
+#include "db/hints/manager.hh"
 #include "db/commitlog/commitlog.hh"
 #include "db/commitlog/commitlog_replayer.hh"
 #include "utils/runtime.hh"
@@ -434,11 +435,14 @@ int main(int ac, char** av) {
             dirs.touch_and_lock(db.local().get_config().data_file_directories()).get();
             supervisor_notify("creating commitlog directory");
             dirs.touch_and_lock(db.local().get_config().commitlog_directory()).get();
+            supervisor_notify("creating hints directory");
+            dirs.touch_and_lock(db.local().get_config().hints_directory()).get();
             supervisor_notify("verifying data and commitlog directories");
             std::unordered_set<sstring> directories;
             directories.insert(db.local().get_config().data_file_directories().cbegin(),
                     db.local().get_config().data_file_directories().cend());
             directories.insert(db.local().get_config().commitlog_directory());
+            directories.insert(db.local().get_config().hints_directory());
             parallel_for_each(directories, [&db] (sstring pathname) {
                 return disk_sanity(pathname, db.local().get_config().developer_mode());
             }).get();
@@ -501,6 +505,18 @@ int main(int ac, char** av) {
             db::get_batchlog_manager().start(std::ref(qp)).get();
             // #293 - do not stop anything
             // engine().at_exit([] { return db::get_batchlog_manager().stop(); });
+            supervisor_notify("starting hints manager");
+            db::hints::get_manager().start(std::ref(*cfg)).get();
+            db::hints::get_manager().invoke_on_all([] (db::hints::manager& m) {
+                service::get_local_storage_service().register_subscriber(&m);
+                return m.start();
+            }).get();
+            engine().at_exit([] {
+                return db::hints::get_manager().invoke_on_all([] (db::hints::manager& m) {
+                    service::get_local_storage_service().unregister_subscriber(&m);
+                    return m.stop();
+                });
+            });
             supervisor_notify("loading sstables");
             auto& ks = db.local().find_keyspace(db::system_keyspace::NAME);
             parallel_for_each(ks.metadata()->cf_meta_data(), [&ks] (auto& pair) {
@@ -554,12 +570,19 @@ int main(int ac, char** av) {
             supervisor_notify("starting streaming service");
             streaming::stream_session::init_streaming_service(db).get();
             api::set_server_stream_manager(ctx).get();
-            // Start handling REPAIR_CHECKSUM_RANGE messages
+            // Start handling REPAIR_CHECKSUM_RANGE and REPAIR_CHECKSUM_TREE messages
             net::get_messaging_service().invoke_on_all([&db] (auto& ms) {
-                ms.register_repair_checksum_range([&db] (sstring keyspace, sstring cf, query::range<dht::token> range) {
+                ms.register_repair_checksum_range([&db] (sstring keyspace, sstring cf, query::range<dht::token> range, rpc::optional<repair_checksum> hash_algorithm) {
+                    auto hash = hash_algorithm ? *hash_algorithm : repair_checksum::sha256;
+                    return do_with(std::move(keyspace), std::move(cf), std::move(range),
+                            [&db, hash] (auto& keyspace, auto& cf, auto& range) {
+                        return checksum_range(db, keyspace, cf, range, hash);
+                    });
+                });
+                ms.register_repair_checksum_tree([&db] (sstring keyspace, sstring cf, query::range<dht::token> range, uint32_t depth, repair_checksum hash_algorithm) {
                     return do_with(std::move(keyspace), std::move(cf), std::move(range),
-                            [&db] (auto& keyspace, auto& cf, auto& range) {
-                        return checksum_range(db, keyspace, cf, range);
+                            [&db, depth, hash_algorithm] (auto& keyspace, auto& cf, auto& range) {
+                        return checksum_range_leaves(db, keyspace, cf, range, depth, hash_algorithm);
                     });
                 });
             }).get();
@@ -22,6 +22,7 @@
 #include "memtable.hh"
 #include "frozen_mutation.hh"
 #include "sstable_mutation_readers.hh"
+#include "mutation_partition_visitor.hh"
 
 namespace stdx = std::experimental;
 
@@ -217,6 +218,132 @@ memtable::make_reader(schema_ptr s,
     }
 }
 
+// Streams a partition of a memtable, copying a buffer worth of its rows and
+// range tombstones at a time, so that flushing a large partition doesn't need
+// a copy of all of it. The partition is looked up again for each buffer, as
+// LSA compaction may have moved it in the meantime, and reading resumes after
+// the last row and range tombstone which were copied.
+class partition_streamer final : public streamed_mutation::impl {
+    lw_shared_ptr<memtable> _memtable;
+    bool _static_row_done = false;
+    stdx::optional<clustering_key> _last_row;
+    stdx::optional<range_tombstone> _last_rt;
+private:
+    // Fragments copied from an entry of another schema are converted to
+    // the schema of the stream through a mutation.
+    future<> push_upgraded(std::vector<mutation_fragment> mfs, schema_ptr from) {
+        mutation m(_key, from);
+        for (auto&& mf : mfs) {
+            if (mf.is_static_row()) {
+                m.partition().static_row().apply_reversibly(*from, column_kind::static_column, mf.as_static_row().cells());
+            } else if (mf.is_clustering_row()) {
+                auto& cr = mf.as_clustering_row();
+                m.partition().clustered_row(std::move(cr.key())).apply_reversibly(*from, cr.as_deletable_row());
+            } else {
+                m.partition().apply_delete(*from, std::move(mf.as_range_tombstone()));
+            }
+        }
+        m.upgrade(_schema);
+        return do_with(streamed_mutation_from_mutation(std::move(m)), [this] (streamed_mutation& sm) {
+            return repeat([this, &sm] {
+                return sm().then([this] (mutation_fragment_opt mf) {
+                    if (!mf) {
+                        return stop_iteration::yes;
+                    }
+                    push_mutation_fragment(std::move(*mf));
+                    return stop_iteration::no;
+                });
+            });
+        });
+    }
+public:
+    partition_streamer(schema_ptr s, lw_shared_ptr<memtable> mt, const partition_entry& e)
+        : streamed_mutation::impl(std::move(s), e.key(), e.partition().partition_tombstone())
+        , _memtable(std::move(mt))
+    { }
+
+    virtual future<> fill_buffer() override {
+        std::vector<mutation_fragment> mfs;
+        size_t size = 0;
+        schema_ptr entry_schema;
+        {
+            logalloc::reclaim_lock _(_memtable->_region);
+            managed_bytes::linearization_context_guard lcg;
+            auto i = _memtable->partitions.find(_key, partition_entry::compare(_memtable->_schema));
+            assert(i != _memtable->partitions.end());
+            auto& s = *i->schema();
+            auto& p = i->partition();
+            entry_schema = i->schema();
+            auto push = [&] (mutation_fragment mf) {
+                size += mf.memory_usage();
+                mfs.emplace_back(std::move(mf));
+            };
+            if (!_static_row_done) {
+                _static_row_done = true;
+                if (!p.static_row().empty()) {
+                    push(static_row(p.static_row()));
+                }
+            }
+            auto& rows = p.clustered_rows();
+            auto& rts = p.row_tombstones().tombstones();
+            auto ri = _last_row ? rows.upper_bound(*_last_row, rows_entry::compare(s)) : rows.begin();
+            auto ti = _last_rt ? rts.upper_bound(*_last_rt, range_tombstone::compare(s)) : rts.begin();
+            position_in_partition_view::less_compare less(s);
+            while (size < streamed_mutation::max_buffer_size_in_bytes && (ri != rows.end() || ti != rts.end())) {
+                if (ti != rts.end() && (ri == rows.end()
+                        || less(position_in_partition_view(ti->start_bound()), position_in_partition_view(ri->key())))) {
+                    _last_rt = *ti;
+                    push(range_tombstone(*ti));
+                    ++ti;
+                } else {
+                    _last_row = ri->key();
+                    push(clustering_row(*ri));
+                    ++ri;
+                }
+            }
+            _end_of_stream = ri == rows.end() && ti == rts.end();
+        }
+        if (entry_schema != _schema) {
+            return push_upgraded(std::move(mfs), std::move(entry_schema));
+        }
+        for (auto&& mf : mfs) {
+            push_mutation_fragment(std::move(mf));
+        }
+        return make_ready_future<>();
+    }
+};
+
+// Returns the partitions of a memtable which is being flushed as
+// partition_streamers.
+class flush_reader final : public streamed_mutation_reader::impl {
+    schema_ptr _schema;
+    lw_shared_ptr<memtable> _memtable;
+    stdx::optional<dht::decorated_key> _last;
+public:
+    flush_reader(schema_ptr s, lw_shared_ptr<memtable> m)
+        : _schema(std::move(s))
+        , _memtable(std::move(m))
+    { }
+
+    virtual future<streamed_mutation_opt> operator()() override {
+        logalloc::reclaim_lock _(_memtable->_region);
+        managed_bytes::linearization_context_guard lcg;
+        auto cmp = partition_entry::compare(_memtable->_schema);
+        auto i = _last ? _memtable->partitions.upper_bound(*_last, cmp) : _memtable->partitions.begin();
+        if (i == _memtable->partitions.end()) {
+            return make_ready_future<streamed_mutation_opt>();
+        }
+        _last = i->key();
+        return make_ready_future<streamed_mutation_opt>(
+            make_streamed_mutation<partition_streamer>(_schema, _memtable, *i));
+    }
+};
+
+streamed_mutation_reader
+memtable::make_flush_reader(schema_ptr s) {
+    return make_streamed_mutation_reader<flush_reader>(std::move(s), shared_from_this());
+}
+
 void
 memtable::update(const db::replay_position& rp) {
     if (_replay_position < rp) {
@@ -234,6 +361,57 @@ memtable::apply(memtable& mt) {
     });
 }
 
+// Finds the lowest timestamp of the data and tombstones of a partition.
+class min_timestamp_visitor final : public mutation_partition_visitor {
+    const schema& _s;
+    api::timestamp_type _min = api::max_timestamp;
+private:
+    void apply(tombstone t) {
+        if (t) {
+            _min = std::min(_min, t.timestamp);
+        }
+    }
+    void apply(const column_definition& def, collection_mutation_view cm) {
+        auto ctype = static_pointer_cast<const collection_type_impl>(def.type);
+        auto mv = ctype->deserialize_mutation_form(cm);
+        apply(mv.tomb);
+        for (auto&& c : mv.cells) {
+            _min = std::min(_min, c.second.timestamp());
+        }
+    }
+public:
+    explicit min_timestamp_visitor(const schema& s) : _s(s) { }
+
+    api::timestamp_type min_timestamp() const {
+        return _min;
+    }
+
+    virtual void accept_partition_tombstone(tombstone t) override {
+        apply(t);
+    }
+    virtual void accept_static_cell(column_id, atomic_cell_view cell) override {
+        _min = std::min(_min, cell.timestamp());
+    }
+    virtual void accept_static_cell(column_id id, collection_mutation_view cm) override {
+        apply(_s.static_column_at(id), cm);
+    }
+    virtual void accept_row_tombstone(const range_tombstone& rt) override {
+        apply(rt.tomb);
+    }
+    virtual void accept_row(clustering_key_view, tombstone deleted_at, const row_marker& rm) override {
+        apply(deleted_at);
+        if (!rm.is_missing()) {
+            _min = std::min(_min, rm.timestamp());
+        }
+    }
+    virtual void accept_row_cell(column_id, atomic_cell_view cell) override {
+        _min = std::min(_min, cell.timestamp());
+    }
+    virtual void accept_row_cell(column_id id, collection_mutation_view cm) override {
+        apply(_s.regular_column_at(id), cm);
+    }
+};
+
 void
 memtable::apply(const mutation& m, const db::replay_position& rp) {
     with_allocator(_region.allocator(), [this, &m] {
@@ -244,6 +422,9 @@ memtable::apply(const mutation& m, const db::replay_position& rp) {
           });
         });
     });
+    min_timestamp_visitor v(*m.schema());
+    m.partition().accept(*m.schema(), v);
+    _min_timestamp = std::min(_min_timestamp, v.min_timestamp());
     update(rp);
 }
 
@@ -257,6 +438,9 @@ memtable::apply(const frozen_mutation& m, const schema_ptr& m_schema, const db::
           });
         });
     });
+    min_timestamp_visitor v(*m_schema);
+    m.partition().accept(*m_schema, v);
+    _min_timestamp = std::min(_min_timestamp, v.min_timestamp());
     update(rp);
 }
 
@@ -102,6 +102,8 @@ class memtable final : public enable_lw_shared_from_this<memtable> {
     logalloc::allocating_section _allocating_section;
     partitions_type partitions;
     db::replay_position _replay_position;
+    // Lowest timestamp of the data and tombstones applied to this memtable.
+    api::timestamp_type _min_timestamp = api::max_timestamp;
     lw_shared_ptr<sstables::sstable> _sstable;
     void update(const db::replay_position&);
     friend class row_cache;
@@ -141,6 +143,13 @@ class memtable final : public enable_lw_shared_from_this<memtable> {
                                 const query::clustering_key_filtering_context& ck_filtering = query::no_clustering_key_filtering,
                                 const io_priority_class& pc = default_priority_class());
 
+    // Creates a reader of all partitions in this memtable, which streams
+    // them a buffer at a time rather than copying each of them whole, for
+    // flushing the memtable.
+    //
+    // The memtable must no longer be written to.
+    streamed_mutation_reader make_flush_reader(schema_ptr);
+
     mutation_source as_data_source();
     key_source as_key_source();
 
@@ -152,5 +161,12 @@ class memtable final : public enable_lw_shared_from_this<memtable> {
         return _replay_position;
     }
 
+    // Returns api::max_timestamp if the memtable is empty.
+    api::timestamp_type min_timestamp() const {
+        return _min_timestamp;
+    }
+
     friend class scanning_reader;
+    friend class partition_streamer;
+    friend class flush_reader;
 };
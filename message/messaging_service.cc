@@ -329,6 +329,8 @@ static unsigned get_rpc_client_idx(messaging_verb verb) {
     } else if (verb == messaging_verb::PREPARE_MESSAGE ||
                verb == messaging_verb::PREPARE_DONE_MESSAGE ||
                verb == messaging_verb::STREAM_MUTATION ||
+               verb == messaging_verb::STREAM_MUTATION_BATCH ||
+               verb == messaging_verb::STREAM_SSTABLE_FILE_CHUNK ||
                verb == messaging_verb::STREAM_MUTATION_DONE ||
                verb == messaging_verb::COMPLETE_MESSAGE) {
         idx = 2;
@@ -636,6 +638,28 @@ future<> messaging_service::send_stream_mutation(msg_addr id, UUID plan_id, froz
         plan_id, std::move(fm), dst_cpu_id);
 }
 
+// STREAM_MUTATION_BATCH
+void messaging_service::register_stream_mutation_batch(std::function<future<> (const rpc::client_info& cinfo, UUID plan_id, std::vector<frozen_mutation> fms, unsigned dst_cpu_id)>&& func) {
+    register_handler(this, messaging_verb::STREAM_MUTATION_BATCH, std::move(func));
+}
+future<> messaging_service::send_stream_mutation_batch(msg_addr id, UUID plan_id, std::vector<frozen_mutation> fms, unsigned dst_cpu_id) {
+    return send_message_timeout_and_retry<void>(this, messaging_verb::STREAM_MUTATION_BATCH, id,
+        streaming_timeout, streaming_nr_retry, streaming_wait_before_retry,
+        plan_id, std::move(fms), dst_cpu_id);
+}
+
+// STREAM_SSTABLE_FILE_CHUNK
+void messaging_service::register_stream_sstable_file_chunk(std::function<future<> (const rpc::client_info& cinfo, UUID plan_id, UUID cf_id,
+        sstring file_name, uint64_t offset, bytes data, bool last, unsigned dst_cpu_id)>&& func) {
+    register_handler(this, messaging_verb::STREAM_SSTABLE_FILE_CHUNK, std::move(func));
+}
+future<> messaging_service::send_stream_sstable_file_chunk(msg_addr id, UUID plan_id, UUID cf_id, sstring file_name, uint64_t offset,
+        bytes data, bool last, unsigned dst_cpu_id) {
+    return send_message_timeout_and_retry<void>(this, messaging_verb::STREAM_SSTABLE_FILE_CHUNK, id,
+        streaming_timeout, streaming_nr_retry, streaming_wait_before_retry,
+        plan_id, cf_id, std::move(file_name), offset, std::move(data), last, dst_cpu_id);
+}
+
 // STREAM_MUTATION_DONE
 void messaging_service::register_stream_mutation_done(std::function<future<> (const rpc::client_info& cinfo,
         UUID plan_id, std::vector<range<dht::token>> ranges, UUID cf_id, unsigned dst_cpu_id)>&& func) {
@@ -831,18 +855,35 @@ future<> messaging_service::send_replication_finished(msg_addr id, inet_address
 // Wrapper for REPAIR_CHECKSUM_RANGE
 void messaging_service::register_repair_checksum_range(
         std::function<future<partition_checksum> (sstring keyspace,
-                sstring cf, query::range<dht::token> range)>&& f) {
+                sstring cf, query::range<dht::token> range, rpc::optional<repair_checksum> hash_algorithm)>&& f) {
     register_handler(this, messaging_verb::REPAIR_CHECKSUM_RANGE, std::move(f));
 }
 void messaging_service::unregister_repair_checksum_range() {
     _rpc->unregister_handler(messaging_verb::REPAIR_CHECKSUM_RANGE);
 }
 future<partition_checksum> messaging_service::send_repair_checksum_range(
-        msg_addr id, sstring keyspace, sstring cf, ::range<dht::token> range)
+        msg_addr id, sstring keyspace, sstring cf, ::range<dht::token> range, repair_checksum hash_algorithm)
 {
     return send_message<partition_checksum>(this,
             messaging_verb::REPAIR_CHECKSUM_RANGE, std::move(id),
-            std::move(keyspace), std::move(cf), std::move(range));
+            std::move(keyspace), std::move(cf), std::move(range), hash_algorithm);
+}
+
+// Wrapper for REPAIR_CHECKSUM_TREE
+void messaging_service::register_repair_checksum_tree(
+        std::function<future<std::vector<partition_checksum>> (sstring keyspace,
+                sstring cf, query::range<dht::token> range, uint32_t depth, repair_checksum hash_algorithm)>&& f) {
+    register_handler(this, messaging_verb::REPAIR_CHECKSUM_TREE, std::move(f));
+}
+void messaging_service::unregister_repair_checksum_tree() {
+    _rpc->unregister_handler(messaging_verb::REPAIR_CHECKSUM_TREE);
+}
+future<std::vector<partition_checksum>> messaging_service::send_repair_checksum_tree(
+        msg_addr id, sstring keyspace, sstring cf, ::range<dht::token> range, uint32_t depth, repair_checksum hash_algorithm)
+{
+    return send_message<std::vector<partition_checksum>>(this,
+            messaging_verb::REPAIR_CHECKSUM_TREE, std::move(id),
+            std::move(keyspace), std::move(cf), std::move(range), depth, hash_algorithm);
 }
 
 } // namespace net
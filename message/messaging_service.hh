@@ -55,6 +55,7 @@ class seed_provider_type;
 class frozen_mutation;
 class frozen_schema;
 class partition_checksum;
+enum class repair_checksum : uint8_t;
 
 namespace dht {
     class token;
@@ -97,7 +98,10 @@ enum class messaging_verb : int32_t {
     REPAIR_CHECKSUM_RANGE = 20,
     GET_SCHEMA_VERSION = 21,
     SCHEMA_CHECK = 22,
-    LAST = 23,
+    REPAIR_CHECKSUM_TREE = 23,
+    STREAM_MUTATION_BATCH = 24,
+    STREAM_SSTABLE_FILE_CHUNK = 25,
+    LAST = 26,
 };
 
 } // namespace net
@@ -216,6 +220,16 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     void register_stream_mutation(std::function<future<> (const rpc::client_info& cinfo, UUID plan_id, frozen_mutation fm, unsigned dst_cpu_id)>&& func);
     future<> send_stream_mutation(msg_addr id, UUID plan_id, frozen_mutation fm, unsigned dst_cpu_id);
 
+    // Wrapper for STREAM_MUTATION_BATCH verb
+    void register_stream_mutation_batch(std::function<future<> (const rpc::client_info& cinfo, UUID plan_id, std::vector<frozen_mutation> fms, unsigned dst_cpu_id)>&& func);
+    future<> send_stream_mutation_batch(msg_addr id, UUID plan_id, std::vector<frozen_mutation> fms, unsigned dst_cpu_id);
+
+    // Wrapper for STREAM_SSTABLE_FILE_CHUNK verb
+    void register_stream_sstable_file_chunk(std::function<future<> (const rpc::client_info& cinfo, UUID plan_id, UUID cf_id,
+            sstring file_name, uint64_t offset, bytes data, bool last, unsigned dst_cpu_id)>&& func);
+    future<> send_stream_sstable_file_chunk(msg_addr id, UUID plan_id, UUID cf_id, sstring file_name, uint64_t offset,
+            bytes data, bool last, unsigned dst_cpu_id);
+
     void register_stream_mutation_done(std::function<future<> (const rpc::client_info& cinfo, UUID plan_id, std::vector<range<dht::token>> ranges, UUID cf_id, unsigned dst_cpu_id)>&& func);
     future<> send_stream_mutation_done(msg_addr id, UUID plan_id, std::vector<range<dht::token>> ranges, UUID cf_id, unsigned dst_cpu_id);
 
@@ -223,9 +237,14 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     future<> send_complete_message(msg_addr id, UUID plan_id, unsigned dst_cpu_id);
 
     // Wrapper for REPAIR_CHECKSUM_RANGE verb
-    void register_repair_checksum_range(std::function<future<partition_checksum> (sstring keyspace, sstring cf, range<dht::token> range)>&& func);
+    void register_repair_checksum_range(std::function<future<partition_checksum> (sstring keyspace, sstring cf, range<dht::token> range, rpc::optional<repair_checksum> hash_algorithm)>&& func);
     void unregister_repair_checksum_range();
-    future<partition_checksum> send_repair_checksum_range(msg_addr id, sstring keyspace, sstring cf, range<dht::token> range);
+    future<partition_checksum> send_repair_checksum_range(msg_addr id, sstring keyspace, sstring cf, range<dht::token> range, repair_checksum hash_algorithm);
+
+    // Wrapper for REPAIR_CHECKSUM_TREE verb
+    void register_repair_checksum_tree(std::function<future<std::vector<partition_checksum>> (sstring keyspace, sstring cf, range<dht::token> range, uint32_t depth, repair_checksum hash_algorithm)>&& func);
+    void unregister_repair_checksum_tree();
+    future<std::vector<partition_checksum>> send_repair_checksum_tree(msg_addr id, sstring keyspace, sstring cf, range<dht::token> range, uint32_t depth, repair_checksum hash_algorithm);
 
     // Wrapper for GOSSIP_ECHO verb
     void register_gossip_echo(std::function<future<> ()>&& func);
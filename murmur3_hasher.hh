@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <seastar/core/byteorder.hh>
+#include "utils/murmur_hash.hh"
+
+// Incremental version of utils::murmur_hash::hash3_x64_128(): the result is
+// the same as hashing the concatenation of everything passed to update().
+// It is several times faster than md5_hasher, but not cryptographic, so it
+// is only suitable where collisions are not deliberately sought, like
+// digests compared between replicas.
+class murmur3_hasher {
+    static constexpr uint64_t c1 = 0x87c37b91114253d5L;
+    static constexpr uint64_t c2 = 0x4cf5ad432745937fL;
+
+    uint64_t _h1;
+    uint64_t _h2;
+    uint64_t _length = 0;
+    // Holds the last (_length % 16) bytes, which do not form a full block yet.
+    int8_t _buf[16];
+private:
+    static uint64_t load_le64(const char* p) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return le_to_cpu(v);
+    }
+    void process_block(const char* p) {
+        using namespace utils::murmur_hash;
+        uint64_t k1 = load_le64(p);
+        uint64_t k2 = load_le64(p + 8);
+
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; _h1 ^= k1;
+
+        _h1 = rotl64(_h1, 27); _h1 += _h2; _h1 = _h1 * 5 + 0x52dce729;
+
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; _h2 ^= k2;
+
+        _h2 = rotl64(_h2, 31); _h2 += _h1; _h2 = _h2 * 5 + 0x38495ab5;
+    }
+public:
+    explicit murmur3_hasher(uint64_t seed = 0) : _h1(seed), _h2(seed) { }
+
+    void update(const char* ptr, size_t length) {
+        auto buffered = _length & 15;
+        _length += length;
+        if (buffered) {
+            auto n = std::min<size_t>(16 - buffered, length);
+            std::memcpy(_buf + buffered, ptr, n);
+            ptr += n;
+            length -= n;
+            if (buffered + n < 16) {
+                return;
+            }
+            process_block(reinterpret_cast<const char*>(_buf));
+        }
+        for (; length >= 16; ptr += 16, length -= 16) {
+            process_block(ptr);
+        }
+        std::memcpy(_buf, ptr, length);
+    }
+
+    void finalize(std::array<uint64_t, 2>& result) {
+        using namespace utils::murmur_hash;
+        uint64_t h1 = _h1;
+        uint64_t h2 = _h2;
+        uint64_t k1 = 0;
+        uint64_t k2 = 0;
+        // Like hash3_x64_128(), the tail bytes are sign-extended.
+        const int8_t* tmp = _buf;
+        switch (_length & 15) {
+        case 15: k2 ^= ((uint64_t) tmp[14]) << 48;
+        case 14: k2 ^= ((uint64_t) tmp[13]) << 40;
+        case 13: k2 ^= ((uint64_t) tmp[12]) << 32;
+        case 12: k2 ^= ((uint64_t) tmp[11]) << 24;
+        case 11: k2 ^= ((uint64_t) tmp[10]) << 16;
+        case 10: k2 ^= ((uint64_t) tmp[9]) << 8;
+        case  9: k2 ^= ((uint64_t) tmp[8]) << 0;
+            k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        case  8: k1 ^= ((uint64_t) tmp[7]) << 56;
+        case  7: k1 ^= ((uint64_t) tmp[6]) << 48;
+        case  6: k1 ^= ((uint64_t) tmp[5]) << 40;
+        case  5: k1 ^= ((uint64_t) tmp[4]) << 32;
+        case  4: k1 ^= ((uint64_t) tmp[3]) << 24;
+        case  3: k1 ^= ((uint64_t) tmp[2]) << 16;
+        case  2: k1 ^= ((uint64_t) tmp[1]) << 8;
+        case  1: k1 ^= ((uint64_t) tmp[0]);
+            k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        };
+
+        h1 ^= _length;
+        h2 ^= _length;
+
+        h1 += h2;
+        h2 += h1;
+
+        h1 = fmix(h1);
+        h2 = fmix(h2);
+
+        h1 += h2;
+        h2 += h1;
+
+        result[0] = h1;
+        result[1] = h2;
+    }
+
+    std::array<uint8_t, 16> finalize_array() {
+        std::array<uint64_t, 2> h;
+        finalize(h);
+        std::array<uint8_t, 16> array;
+        auto h1 = cpu_to_le(h[0]);
+        auto h2 = cpu_to_le(h[1]);
+        std::memcpy(array.data(), &h1, 8);
+        std::memcpy(array.data() + 8, &h2, 8);
+        return array;
+    }
+};
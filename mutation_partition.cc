@@ -550,7 +550,7 @@ void write_cell(RowWriter& w, const query::partition_slice& slice, const data_ty
 }
 
 // returns the timestamp of a latest update to the row
-static api::timestamp_type hash_row_slice(md5_hasher& hasher,
+static api::timestamp_type hash_row_slice(digester& hasher,
     const schema& s,
     column_kind kind,
     const row& cells,
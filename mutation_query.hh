@@ -135,5 +135,16 @@ class querying_reader {
                     gc_clock::time_point query_time,
                     std::function<void(uint32_t, mutation&&)> consumer);
 
+    // Continues with a reader released by an earlier querying_reader over
+    // the same range and slice, instead of creating a new one on read().
+    void resume(mutation_reader reader) {
+        _reader = std::move(reader);
+    }
+    // Releases the reader, positioned after the last partition consumed.
+    // Must be called after read().
+    mutation_reader release_reader() {
+        return std::move(*_reader);
+    }
+
     future<> read();
 };
@@ -109,6 +109,98 @@ make_combined_reader(std::vector<mutation_reader> readers) {
     return make_mutation_reader<combined_reader>(std::move(readers));
 }
 
+// Combines multiple streamed_mutation_readers into one.
+class combined_streamed_reader final : public streamed_mutation_reader::impl {
+    std::vector<streamed_mutation_reader> _readers;
+    struct mutation_and_reader {
+        streamed_mutation m;
+        streamed_mutation_reader* read;
+    };
+    // Heap of the next partition of each reader.
+    std::vector<mutation_and_reader> _ptables;
+    // Readers whose partitions were returned and which need to be advanced
+    // before the next partition can be determined. We can't do that earlier,
+    // as the returned streamed_mutation may still be reading from them.
+    std::vector<streamed_mutation_reader*> _next;
+    // comparison function for std::make_heap()/std::push_heap()
+    static bool heap_compare(const mutation_and_reader& a, const mutation_and_reader& b) {
+        auto&& s = a.m.schema();
+        // order of comparison is inverted, because heaps produce greatest value first
+        return b.m.decorated_key().less_compare(*s, a.m.decorated_key());
+    }
+public:
+    combined_streamed_reader(std::vector<streamed_mutation_reader> readers)
+        : _readers(std::move(readers))
+    {
+        for (auto&& r : _readers) {
+            _next.push_back(&r);
+        }
+    }
+
+    virtual future<streamed_mutation_opt> operator()() override {
+        return parallel_for_each(_next, [this] (streamed_mutation_reader* reader) {
+            return (*reader)().then([this, reader] (streamed_mutation_opt&& m) {
+                if (m) {
+                    _ptables.push_back({std::move(*m), reader});
+                    boost::range::push_heap(_ptables, &heap_compare);
+                }
+            });
+        }).then([this] () -> streamed_mutation_opt {
+            _next.clear();
+            if (_ptables.empty()) {
+                return { };
+            }
+            std::vector<streamed_mutation> current;
+            do {
+                boost::range::pop_heap(_ptables, &heap_compare);
+                auto& candidate = _ptables.back();
+                current.emplace_back(std::move(candidate.m));
+                _next.push_back(candidate.read);
+                _ptables.pop_back();
+            } while (!_ptables.empty() && _ptables.front().m.decorated_key().equal(*current.front().schema(), current.front().decorated_key()));
+            return merge_mutations(std::move(current));
+        });
+    }
+};
+
+streamed_mutation_reader
+make_combined_streamed_reader(std::vector<streamed_mutation_reader> readers) {
+    return make_streamed_mutation_reader<combined_streamed_reader>(std::move(readers));
+}
+
+class streamed_reader_adaptor final : public streamed_mutation_reader::impl {
+    mutation_reader _reader;
+public:
+    explicit streamed_reader_adaptor(mutation_reader reader) : _reader(std::move(reader)) { }
+    virtual future<streamed_mutation_opt> operator()() override {
+        return _reader().then([] (mutation_opt m) -> streamed_mutation_opt {
+            if (!m) {
+                return { };
+            }
+            return streamed_mutation_from_mutation(std::move(*m));
+        });
+    }
+};
+
+streamed_mutation_reader streamed_reader_from_mutation_reader(mutation_reader reader) {
+    return make_streamed_mutation_reader<streamed_reader_adaptor>(std::move(reader));
+}
+
+class mutation_reader_adaptor final : public mutation_reader::impl {
+    streamed_mutation_reader _reader;
+public:
+    explicit mutation_reader_adaptor(streamed_mutation_reader reader) : _reader(std::move(reader)) { }
+    virtual future<mutation_opt> operator()() override {
+        return _reader().then([] (streamed_mutation_opt sm) {
+            return mutation_from_streamed_mutation(std::move(sm));
+        });
+    }
+};
+
+mutation_reader mutation_reader_from_streamed_reader(streamed_mutation_reader reader) {
+    return make_mutation_reader<mutation_reader_adaptor>(std::move(reader));
+}
+
 class joining_reader final : public mutation_reader::impl {
     std::vector<mutation_reader> _readers;
     std::vector<mutation_reader>::iterator _current;
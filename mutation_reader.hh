@@ -24,6 +24,7 @@
 #include <vector>
 
 #include "mutation.hh"
+#include "streamed_mutation.hh"
 #include "core/future.hh"
 #include "core/future-util.hh"
 #include "core/do_with.hh"
@@ -85,6 +86,48 @@ mutation_reader make_empty_reader();
 // when creating the reader involves disk I/O or a shard call
 mutation_reader make_lazy_reader(std::function<mutation_reader ()> make_reader);
 
+// A streamed_mutation_reader is like a mutation_reader, but it returns each
+// partition as a streamed_mutation, so that partitions don't have to fit in
+// memory as a whole.
+//
+// A streamed_mutation returned by the reader must be fully consumed or
+// destroyed before the reader is invoked again, as they may share the
+// underlying source of data.
+class streamed_mutation_reader final {
+public:
+    class impl {
+    public:
+        virtual ~impl() {}
+        virtual future<streamed_mutation_opt> operator()() = 0;
+    };
+private:
+    std::unique_ptr<impl> _impl;
+public:
+    streamed_mutation_reader(std::unique_ptr<impl> impl) noexcept : _impl(std::move(impl)) {}
+    streamed_mutation_reader(streamed_mutation_reader&&) = default;
+    streamed_mutation_reader(const streamed_mutation_reader&) = delete;
+    streamed_mutation_reader& operator=(streamed_mutation_reader&&) = default;
+    streamed_mutation_reader& operator=(const streamed_mutation_reader&) = delete;
+    future<streamed_mutation_opt> operator()() { return _impl->operator()(); }
+};
+
+// Impl: derived from streamed_mutation_reader::impl; Args/args: arguments for Impl's constructor
+template <typename Impl, typename... Args>
+inline
+streamed_mutation_reader
+make_streamed_mutation_reader(Args&&... args) {
+    return streamed_mutation_reader(std::make_unique<Impl>(std::forward<Args>(args)...));
+}
+
+// Streamed counterpart of make_combined_reader(). Partitions with equal keys
+// are merged fragment by fragment with merge_mutations(), so only a buffer
+// worth of each of them needs to be in memory at a time.
+streamed_mutation_reader make_combined_streamed_reader(std::vector<streamed_mutation_reader>);
+// Adapts a mutation_reader, streaming the mutations it returns.
+streamed_mutation_reader streamed_reader_from_mutation_reader(mutation_reader);
+// Adapts a streamed_mutation_reader, building whole mutations from the streams.
+mutation_reader mutation_reader_from_streamed_reader(streamed_mutation_reader);
+
 template <typename MutationFilter>
 class filtering_reader : public mutation_reader::impl {
     mutation_reader _rd;
@@ -125,6 +168,40 @@ mutation_reader make_filtering_reader(mutation_reader rd, MutationFilter&& filte
     return make_mutation_reader<filtering_reader<MutationFilter>>(std::move(rd), std::forward<MutationFilter>(filter));
 }
 
+template <typename MutationFilter>
+class filtering_streamed_reader : public streamed_mutation_reader::impl {
+    streamed_mutation_reader _rd;
+    MutationFilter _filter;
+    streamed_mutation_opt _current;
+    static_assert(std::is_same<bool, std::result_of_t<MutationFilter(const streamed_mutation&)>>::value, "bad MutationFilter signature");
+public:
+    filtering_streamed_reader(streamed_mutation_reader rd, MutationFilter&& filter)
+            : _rd(std::move(rd)), _filter(std::forward<MutationFilter>(filter)) {
+    }
+    virtual future<streamed_mutation_opt> operator()() override {
+        return repeat([this] {
+            return _rd().then([this] (streamed_mutation_opt&& smo) mutable {
+                if (!smo || _filter(*smo)) {
+                    _current = std::move(smo);
+                    return stop_iteration::yes;
+                }
+                // Dropping the streamed_mutation skips the rest of it.
+                return stop_iteration::no;
+            });
+        }).then([this] {
+            return make_ready_future<streamed_mutation_opt>(std::move(_current));
+        });
+    };
+};
+
+// Streamed counterpart of make_filtering_reader(). The filter accepts
+// streamed_mutation const&, and can only look at the partition key and
+// tombstone.
+template <typename MutationFilter>
+streamed_mutation_reader make_filtering_streamed_reader(streamed_mutation_reader rd, MutationFilter&& filter) {
+    return make_streamed_mutation_reader<filtering_streamed_reader<MutationFilter>>(std::move(rd), std::forward<MutationFilter>(filter));
+}
+
 // Calls the consumer for each element of the reader's stream until end of stream
 // is reached or the consumer requests iteration to stop by returning stop_iteration::yes.
 // The consumer should accept mutation as the argument and return stop_iteration.
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "querier.hh"
+#include "frozen_mutation.hh"
+#include <seastar/core/memory.hh>
+
+constexpr std::chrono::seconds querier_cache::default_entry_ttl;
+constexpr size_t querier_cache::max_entries;
+constexpr size_t querier_cache::reader_memory_estimate;
+
+size_t querier_cache::default_max_memory() {
+    return memory::stats().total_memory() / 50;
+}
+
+querier_cache::querier_cache(clock_type::duration entry_ttl, size_t max_memory)
+    : _entry_ttl(entry_ttl)
+    , _max_memory(max_memory)
+    , _expiry_timer([this] { evict_expired(); })
+{ }
+
+static size_t memory_usage(const querier& q) {
+    if (q.partition) {
+        return sizeof(querier) + freeze(*q.partition).representation().size();
+    }
+    return sizeof(querier) + querier_cache::reader_memory_estimate;
+}
+
+void querier_cache::erase(entries::iterator it) {
+    auto range = _index.equal_range(it->key);
+    for (auto i = range.first; i != range.second; ++i) {
+        if (i->second == it) {
+            _index.erase(i);
+            break;
+        }
+    }
+    _stats.memory_usage -= it->memory_usage;
+    _entries.erase(it);
+    --_stats.population;
+}
+
+void querier_cache::evict_expired() {
+    auto now = clock_type::now();
+    while (!_entries.empty() && _entries.front().expires <= now) {
+        erase(_entries.begin());
+        ++_stats.evictions;
+    }
+    if (!_entries.empty()) {
+        _expiry_timer.arm(_entries.front().expires);
+    }
+}
+
+void querier_cache::insert(utils::UUID key, querier q) {
+    auto memory = memory_usage(q);
+    if (memory > _max_memory) {
+        ++_stats.evictions;
+        return;
+    }
+    while (!_entries.empty() && (_entries.size() >= max_entries || _stats.memory_usage + memory > _max_memory)) {
+        erase(_entries.begin());
+        ++_stats.evictions;
+    }
+    auto it = _entries.insert(_entries.end(), entry{key, std::move(q), clock_type::now() + _entry_ttl, memory});
+    _index.emplace(std::move(key), it);
+    ++_stats.population;
+    _stats.memory_usage += memory;
+    if (!_expiry_timer.armed()) {
+        _expiry_timer.arm(it->expires);
+    }
+}
+
+template<typename Bound>
+static bool equal_bounds(const schema& s, const std::experimental::optional<Bound>& a, const std::experimental::optional<Bound>& b) {
+    if (!a || !b) {
+        return !a && !b;
+    }
+    return a->is_inclusive() == b->is_inclusive() && a->value().equal(s, b->value());
+}
+
+std::experimental::optional<querier>
+querier_cache::lookup(const utils::UUID& key, const schema& s, const query::partition_range& range) {
+    auto candidates = _index.equal_range(key);
+    for (auto i = candidates.first; i != candidates.second; ++i) {
+        auto& q = i->second->q;
+        if (q.schema->version() != s.version()
+                || bool(q.partition) != range.is_singular()
+                || !range.start()
+                || !range.start()->value().equal(s, dht::ring_position(q.last_key))
+                || !equal_bounds(s, range.end(), q.range->end())) {
+            continue;
+        }
+        auto found = std::move(q);
+        erase(i->second);
+        ++_stats.hits;
+        return { std::move(found) };
+    }
+    ++_stats.misses;
+    return {};
+}
+
+void querier_cache::evict_all_for_table(const utils::UUID& cf_id) {
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        auto next = std::next(it);
+        if (it->q.schema->id() == cf_id) {
+            erase(it);
+            ++_stats.evictions;
+        }
+        it = next;
+    }
+}
+
+void querier_cache::clear() {
+    _stats.population -= _entries.size();
+    _stats.memory_usage = 0;
+    _index.clear();
+    _entries.clear();
+    _expiry_timer.cancel();
+}
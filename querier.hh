@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <experimental/optional>
+#include <seastar/core/timer.hh>
+
+#include "mutation_reader.hh"
+#include "query-request.hh"
+#include "dht/i_partitioner.hh"
+#include "utils/UUID.hh"
+
+// A reader parked between two pages of a paged range scan, together with
+// the range and slice it was created for, which it refers to.
+//
+// Readers return whole partitions, so a single-partition query parks the
+// partition read by its first page instead, as read, before it was
+// compacted and trimmed to the page; the reader is then unused.
+struct querier {
+    schema_ptr schema;
+    std::unique_ptr<query::partition_range> range;
+    std::unique_ptr<query::partition_slice> slice;
+    mutation_reader reader;
+    // The last partition returned by the reader.
+    dht::decorated_key last_key;
+    mutation_opt partition;
+};
+
+// Keeps the readers of paged queries between pages, keyed by the query id
+// of read_command, so that the next page continues where the previous one
+// stopped instead of opening new readers and seeking again.
+//
+// A query may park several readers on a shard, one for each range
+// storage_proxy split it into. Entries expire after a while, since the
+// client may never ask for the next page, and the oldest entries are
+// evicted when there are too many or when they take more memory than
+// allowed. A parked reader is assumed to take reader_memory_estimate,
+// mostly its read-ahead buffers; a parked partition its serialized size.
+class querier_cache {
+public:
+    using clock_type = lowres_clock;
+    static constexpr std::chrono::seconds default_entry_ttl{10};
+    static constexpr size_t max_entries = 1000;
+    static constexpr size_t reader_memory_estimate = 128 * 1024;
+
+    struct stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t population = 0;
+        uint64_t memory_usage = 0;
+    };
+private:
+    struct entry {
+        utils::UUID key;
+        querier q;
+        clock_type::time_point expires;
+        size_t memory_usage;
+    };
+    using entries = std::list<entry>;
+
+    // Oldest first.
+    entries _entries;
+    std::unordered_multimap<utils::UUID, entries::iterator> _index;
+    clock_type::duration _entry_ttl;
+    size_t _max_memory;
+    timer<clock_type> _expiry_timer;
+    stats _stats;
+private:
+    void erase(entries::iterator it);
+    void evict_expired();
+public:
+    // A small share of the shard's memory.
+    static size_t default_max_memory();
+
+    explicit querier_cache(clock_type::duration entry_ttl = default_entry_ttl, size_t max_memory = default_max_memory());
+    querier_cache(const querier_cache&) = delete;
+
+    // Entries taking more than max_memory on their own are dropped.
+    void insert(utils::UUID key, querier q);
+
+    // Takes out the querier parked under key whose reader continues the
+    // given range: one created for the same schema version and range end,
+    // whose last partition is where the range starts. Parked partitions
+    // only continue singular ranges, and parked readers the others.
+    std::experimental::optional<querier> lookup(const utils::UUID& key, const schema& s, const query::partition_range& range);
+
+    // Drops the readers of a table, e.g. because it is being truncated.
+    void evict_all_for_table(const utils::UUID& cf_id);
+    void clear();
+
+    const stats& get_stats() const {
+        return _stats;
+    }
+};
@@ -101,7 +101,10 @@ class specific_ranges {
 // Schema-dependent.
 class partition_slice {
 public:
-    enum class option { send_clustering_key, send_partition_key, send_timestamp, send_expiry, reversed, distinct, collections_as_maps };
+    // murmur3_digest: compute the result digest with murmur3_hasher instead
+    // of MD5. Only set when all nodes support it.
+    enum class option { send_clustering_key, send_partition_key, send_timestamp, send_expiry, reversed, distinct, collections_as_maps,
+        murmur3_digest };
     using option_set = enum_set<super_enum<option,
         option::send_clustering_key,
         option::send_partition_key,
@@ -109,7 +112,8 @@ class partition_slice {
         option::send_expiry,
         option::reversed,
         option::distinct,
-        option::collections_as_maps>>;
+        option::collections_as_maps,
+        option::murmur3_digest>>;
     clustering_row_ranges _row_ranges;
 public:
     std::vector<column_id> static_columns; // TODO: consider using bitmap
@@ -158,6 +162,9 @@ class read_command {
     uint32_t row_limit;
     gc_clock::time_point timestamp;
     std::experimental::optional<tracing::trace_info> trace_info;
+    // Identifies the pages of a paged query, so that replicas can resume
+    // the reader they used for the previous page.
+    std::experimental::optional<utils::UUID> query_id;
     api::timestamp_type read_timestamp; // not serialized
 public:
     read_command(utils::UUID cf_id,
@@ -166,6 +173,7 @@ class read_command {
                  uint32_t row_limit = max_rows,
                  gc_clock::time_point now = gc_clock::now(),
                  std::experimental::optional<tracing::trace_info> ti = std::experimental::nullopt,
+                 std::experimental::optional<utils::UUID> query_id = std::experimental::nullopt,
                  api::timestamp_type rt = api::missing_timestamp)
         : cf_id(std::move(cf_id))
         , schema_version(std::move(schema_version))
@@ -173,6 +181,7 @@ class read_command {
         , row_limit(row_limit)
         , timestamp(now)
         , trace_info(ti)
+        , query_id(std::move(query_id))
         , read_timestamp(rt)
     { }
 
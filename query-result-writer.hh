@@ -48,8 +48,8 @@ class result::partition_writer {
     ser::query_result__partitions& _pw;
     ser::vector_position _pos;
     bool _static_row_added = false;
-    md5_hasher& _digest;
-    md5_hasher _digest_pos;
+    digester& _digest;
+    digester _digest_pos;
     uint32_t& _row_count;
     api::timestamp_type& _last_modified;
 public:
@@ -60,7 +60,7 @@ class result::partition_writer {
         ser::query_result__partitions& pw,
         ser::vector_position pos,
         ser::after_qr_partition__key w,
-        md5_hasher& digest,
+        digester& digest,
         uint32_t& row_count,
         api::timestamp_type& last_modified)
         : _request(request)
@@ -101,7 +101,7 @@ class result::partition_writer {
     const partition_slice& slice() const {
         return _slice;
     }
-    md5_hasher& digest() {
+    digester& digest() {
         return _digest;
     }
     uint32_t& row_count() {
@@ -115,7 +115,7 @@ class result::partition_writer {
 
 class result::builder {
     bytes_ostream _out;
-    md5_hasher _digest;
+    digester _digest;
     const partition_slice& _slice;
     ser::query_result__partitions _w;
     result_request _request;
@@ -123,7 +123,9 @@ class result::builder {
     api::timestamp_type _last_modified = api::missing_timestamp;
 public:
     builder(const partition_slice& slice, result_request request)
-        : _slice(slice)
+        : _digest(slice.options.contains<partition_slice::option::murmur3_digest>()
+                ? digest_algorithm::murmur3_128 : digest_algorithm::md5)
+        , _slice(slice)
         , _w(ser::writer_of_query_result(_out).start_partitions())
         , _request(request)
     { }
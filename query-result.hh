@@ -25,7 +25,7 @@
 #include <cryptopp/md5.h>
 #include "bytes_ostream.hh"
 #include "query-request.hh"
-#include "md5_hasher.hh"
+#include "digester.hh"
 #include <experimental/optional>
 
 namespace stdx = std::experimental;
@@ -27,12 +27,14 @@
 #include "db/config.hh"
 #include "service/storage_service.hh"
 #include "service/priority_manager.hh"
+#include "murmur3_hasher.hh"
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
 
 #include <cryptopp/sha.h>
+#include <set>
 #include <seastar/core/gate.hh>
 
 static logging::logger logger("repair");
@@ -264,10 +266,24 @@ class sha256_hasher {
 };
 
 
-partition_checksum::partition_checksum(const mutation& m) {
-    sha256_hasher h;
-    feed_hash(h, m);
-    h.finalize(_digest);
+partition_checksum::partition_checksum(const mutation& m, repair_checksum hash_algorithm) {
+    switch (hash_algorithm) {
+    case repair_checksum::sha256: {
+        sha256_hasher h;
+        feed_hash(h, m);
+        h.finalize(_digest);
+        return;
+    }
+    case repair_checksum::murmur3_128: {
+        murmur3_hasher h;
+        feed_hash(h, m);
+        auto digest = h.finalize_array();
+        std::copy(digest.begin(), digest.end(), _digest.begin());
+        std::fill(_digest.begin() + digest.size(), _digest.end(), 0);
+        return;
+    }
+    }
+    throw std::runtime_error(sprint("Unknown repair checksum algorithm %d", unsigned(hash_algorithm)));
 }
 
 static inline unaligned<uint64_t>& qword(std::array<uint8_t, 32>& b, int n) {
@@ -324,19 +340,19 @@ std::ostream& operator<<(std::ostream& out, const partition_checksum& c) {
 // data is coming in).
 static future<partition_checksum> checksum_range_shard(database &db,
         const sstring& keyspace_name, const sstring& cf_name,
-        const ::range<dht::token>& range) {
+        const ::range<dht::token>& range, repair_checksum hash_algorithm) {
     auto& cf = db.find_column_family(keyspace_name, cf_name);
-    return do_with(query::to_partition_range(range), [&cf] (const auto& partition_range) {
+    return do_with(query::to_partition_range(range), [&cf, hash_algorithm] (const auto& partition_range) {
         auto reader = cf.make_reader(cf.schema(),
                                      partition_range,
                                      query::no_clustering_key_filtering,
                                      service::get_local_streaming_read_priority());
         return do_with(std::move(reader), partition_checksum(),
-            [] (auto& reader, auto& checksum) {
-            return repeat([&reader, &checksum] () {
-                return reader().then([&checksum] (auto mopt) {
+            [hash_algorithm] (auto& reader, auto& checksum) {
+            return repeat([&reader, &checksum, hash_algorithm] () {
+                return reader().then([&checksum, hash_algorithm] (auto mopt) {
                     if (mopt) {
-                        checksum.add(partition_checksum(*mopt));
+                        checksum.add(partition_checksum(*mopt, hash_algorithm));
                         return stop_iteration::no;
                     } else {
                         return stop_iteration::yes;
@@ -362,17 +378,17 @@ static future<partition_checksum> checksum_range_shard(database &db,
 // function is not resolved.
 future<partition_checksum> checksum_range(seastar::sharded<database> &db,
         const sstring& keyspace, const sstring& cf,
-        const ::range<dht::token>& range) {
+        const ::range<dht::token>& range, repair_checksum hash_algorithm) {
     unsigned shard_begin = range.start() ?
             dht::shard_of(range.start()->value()) : 0;
     unsigned shard_end = range.end() ?
             dht::shard_of(range.end()->value())+1 : smp::count;
-    return do_with(partition_checksum(), [shard_begin, shard_end, &db, &keyspace, &cf, &range] (auto& result) {
+    return do_with(partition_checksum(), [shard_begin, shard_end, &db, &keyspace, &cf, &range, hash_algorithm] (auto& result) {
         return parallel_for_each(boost::counting_iterator<int>(shard_begin),
                 boost::counting_iterator<int>(shard_end),
-                [&db, &keyspace, &cf, &range, &result] (unsigned shard) {
-            return db.invoke_on(shard, [&keyspace, &cf, &range] (database& db) {
-                return checksum_range_shard(db, keyspace, cf, range);
+                [&db, &keyspace, &cf, &range, &result, hash_algorithm] (unsigned shard) {
+            return db.invoke_on(shard, [&keyspace, &cf, &range, hash_algorithm] (database& db) {
+                return checksum_range_shard(db, keyspace, cf, range, hash_algorithm);
             }).then([&result] (partition_checksum sum) {
                 result.add(sum);
             });
@@ -382,6 +398,158 @@ future<partition_checksum> checksum_range(seastar::sharded<database> &db,
     });
 }
 
+checksum_tree::checksum_tree(const std::vector<partition_checksum>& leaves)
+        : _depth(0) {
+    while ((size_t(1) << _depth) < leaves.size()) {
+        ++_depth;
+    }
+    assert(leaves.size() == (size_t(1) << _depth));
+    auto inner = leaves.size() - 1;
+    _nodes.reserve(inner + leaves.size());
+    _nodes.resize(inner);
+    _nodes.insert(_nodes.end(), leaves.begin(), leaves.end());
+    for (auto i = inner; i-- > 0;) {
+        sha256_hasher h;
+        auto& left = _nodes[2 * i + 1].digest();
+        auto& right = _nodes[2 * i + 2].digest();
+        h.update(reinterpret_cast<const char*>(left.data()), left.size());
+        h.update(reinterpret_cast<const char*>(right.data()), right.size());
+        std::array<uint8_t, 32> digest;
+        h.finalize(digest);
+        _nodes[i] = partition_checksum(digest);
+    }
+}
+
+std::vector<unsigned> checksum_tree::differing_leaves(const checksum_tree& other) const {
+    assert(_depth == other._depth);
+    std::vector<unsigned> result;
+    auto first_leaf = _nodes.size() / 2;
+    std::vector<size_t> to_visit{0};
+    while (!to_visit.empty()) {
+        auto i = to_visit.back();
+        to_visit.pop_back();
+        if (_nodes[i] == other._nodes[i]) {
+            continue;
+        }
+        if (i >= first_leaf) {
+            result.push_back(i - first_leaf);
+        } else {
+            // Right first, so that leaves come out in ascending order.
+            to_visit.push_back(2 * i + 2);
+            to_visit.push_back(2 * i + 1);
+        }
+    }
+    return result;
+}
+
+// Returns a split point of the token range (left, right], where the minimum
+// token stands for an unbounded end, as in split_and_add(). The result is
+// kept within the range, so that the halves of a range too narrow to be
+// split are still ordered (one of them is then empty).
+static dht::token midpoint_within(const dht::token& left, const dht::token& right) {
+    auto mid = dht::global_partitioner().midpoint(left, right);
+    bool after_left = left.is_minimum() || left < mid;
+    bool within_right = right.is_minimum() || mid <= right;
+    if (after_left && within_right) {
+        return mid;
+    }
+    return right.is_minimum() ? left : right;
+}
+
+static void add_split_points(const dht::token& left, const dht::token& right,
+        unsigned depth, std::vector<dht::token>& out) {
+    if (depth == 0) {
+        return;
+    }
+    auto mid = midpoint_within(left, right);
+    add_split_points(left, mid, depth - 1, out);
+    out.push_back(mid);
+    add_split_points(mid, right, depth - 1, out);
+}
+
+std::vector<dht::token> checksum_tree::split_points(const ::range<dht::token>& range, unsigned depth) {
+    std::vector<dht::token> points;
+    points.reserve((size_t(1) << depth) - 1);
+    add_split_points(range.start() ? range.start()->value() : dht::minimum_token(),
+            range.end() ? range.end()->value() : dht::minimum_token(),
+            depth, points);
+    return points;
+}
+
+::range<dht::token> checksum_tree::leaves_range(const ::range<dht::token>& range,
+        const std::vector<dht::token>& split_points, unsigned first, unsigned last) {
+    using bound = ::range<dht::token>::bound;
+    auto start = range.start();
+    if (first != 0) {
+        start = bound(split_points[first - 1], false);
+    }
+    auto end = range.end();
+    if (last != split_points.size()) {
+        end = bound(split_points[last], true);
+    }
+    return ::range<dht::token>(std::move(start), std::move(end));
+}
+
+// Calculate the checksums of the leaves of a checksum_tree over the data
+// held *on this shard* of a column family, in the given token range.
+// The same caveats as for checksum_range_shard() apply.
+static future<std::vector<partition_checksum>> checksum_range_leaves_shard(database &db,
+        const sstring& keyspace_name, const sstring& cf_name,
+        const ::range<dht::token>& range, const std::vector<dht::token>& split_points,
+        repair_checksum hash_algorithm) {
+    auto& cf = db.find_column_family(keyspace_name, cf_name);
+    return do_with(query::to_partition_range(range), [&cf, &split_points, hash_algorithm] (const auto& partition_range) {
+        auto reader = cf.make_reader(cf.schema(),
+                                     partition_range,
+                                     query::no_clustering_key_filtering,
+                                     service::get_local_streaming_read_priority());
+        return do_with(std::move(reader), std::vector<partition_checksum>(split_points.size() + 1),
+            [&split_points, hash_algorithm] (auto& reader, auto& leaves) {
+            return repeat([&reader, &leaves, &split_points, hash_algorithm] () {
+                return reader().then([&leaves, &split_points, hash_algorithm] (auto mopt) {
+                    if (!mopt) {
+                        return stop_iteration::yes;
+                    }
+                    // Partitions come in token order, but a binary search
+                    // is cheap compared with hashing the partition.
+                    auto leaf = std::lower_bound(split_points.begin(), split_points.end(), mopt->token()) - split_points.begin();
+                    leaves[leaf].add(partition_checksum(*mopt, hash_algorithm));
+                    return stop_iteration::no;
+                });
+            }).then([&leaves] {
+                return std::move(leaves);
+            });
+        });
+    });
+}
+
+future<std::vector<partition_checksum>> checksum_range_leaves(seastar::sharded<database> &db,
+        const sstring& keyspace, const sstring& cf,
+        const ::range<dht::token>& range, unsigned depth, repair_checksum hash_algorithm) {
+    depth = std::min(depth, max_checksum_tree_depth);
+    unsigned shard_begin = range.start() ?
+            dht::shard_of(range.start()->value()) : 0;
+    unsigned shard_end = range.end() ?
+            dht::shard_of(range.end()->value())+1 : smp::count;
+    auto leaves = std::vector<partition_checksum>(size_t(1) << depth);
+    return do_with(checksum_tree::split_points(range, depth), std::move(leaves),
+            [shard_begin, shard_end, &db, &keyspace, &cf, &range, hash_algorithm] (const auto& split_points, auto& result) {
+        return parallel_for_each(boost::counting_iterator<int>(shard_begin),
+                boost::counting_iterator<int>(shard_end),
+                [&db, &keyspace, &cf, &range, &split_points, &result, hash_algorithm] (unsigned shard) {
+            return db.invoke_on(shard, [&keyspace, &cf, &range, &split_points, hash_algorithm] (database& db) {
+                return checksum_range_leaves_shard(db, keyspace, cf, range, split_points, hash_algorithm);
+            }).then([&result] (std::vector<partition_checksum> leaves) {
+                for (size_t i = 0; i < result.size(); i++) {
+                    result[i].add(leaves[i]);
+                }
+            });
+        }).then([&result] {
+            return std::move(result);
+        });
+    });
+}
+
 static future<> sync_range(seastar::sharded<database>& db,
         const sstring& keyspace, const sstring& cf,
         const ::range<dht::token>& range,
@@ -420,6 +588,169 @@ static void split_and_add(std::vector<::range<dht::token>>& ranges,
     ranges.push_back(halves.first);
     ranges.push_back(halves.second);
 }
+
+// Ask this node, and all neighbors, to calculate checksums in this range.
+// When all are done, compare the results, and if there are any differences,
+// sync the content of this range.
+static future<> checksum_and_sync_range(seastar::sharded<database>& db,
+        const sstring& keyspace, const sstring& cf,
+        const ::range<dht::token>& range, repair_checksum hash_algorithm,
+        std::vector<gms::inet_address>& neighbors, bool& success) {
+    std::vector<future<partition_checksum>> checksums;
+    checksums.reserve(1 + neighbors.size());
+    checksums.push_back(checksum_range(db, keyspace, cf, range, hash_algorithm));
+    for (auto&& neighbor : neighbors) {
+        checksums.push_back(
+                net::get_local_messaging_service().send_repair_checksum_range(
+                        net::msg_addr{neighbor},keyspace, cf, range, hash_algorithm));
+    }
+
+    return when_all(checksums.begin(), checksums.end()).then(
+            [&db, &keyspace, &cf, &range, &neighbors, &success]
+            (std::vector<future<partition_checksum>> checksums) {
+        // If only some of the replicas of this range are alive,
+        // we set success=false so repair will fail, but we can
+        // still do our best to repair available replicas.
+        std::vector<gms::inet_address> live_neighbors;
+        for (unsigned i = 0; i < checksums.size(); i++) {
+            if (checksums[i].failed()) {
+                logger.warn(
+                    "Checksum of range {} on {} failed: {}",
+                    range,
+                    (i ? neighbors[i-1] :
+                     utils::fb_utilities::get_broadcast_address()),
+                    checksums[i].get_exception());
+                success = false;
+                // Do not break out of the loop here, so we can log
+                // (and discard) all the exceptions.
+            } else if (i > 0) {
+                live_neighbors.push_back(neighbors[i - 1]);
+            }
+        }
+        if (!checksums[0].available() || live_neighbors.empty()) {
+            return make_ready_future<>();
+        }
+        // If one of the available checksums is different, repair
+        // all the neighbors which returned a checksum.
+        auto checksum0 = checksums[0].get();
+        for (unsigned i = 1; i < checksums.size(); i++) {
+            if (checksums[i].available() && checksum0 != checksums[i].get()) {
+                logger.info("Found differing range {} on nodes {}", range, live_neighbors);
+                return do_with(std::move(live_neighbors), [&db, &keyspace, &cf, &range] (auto& live_neighbors) {
+                    return sync_range(db, keyspace, cf, range, live_neighbors);
+                });
+            }
+        }
+        return make_ready_future<>();
+    });
+}
+
+// Converts ascending leaf indexes of a checksum_tree over the range into
+// token ranges, merging adjacent leaves.
+static std::vector<::range<dht::token>> leaf_ranges(const ::range<dht::token>& range,
+        const std::vector<dht::token>& split_points, const std::vector<unsigned>& leaves) {
+    std::vector<::range<dht::token>> ranges;
+    for (size_t i = 0; i < leaves.size();) {
+        auto j = i;
+        while (j + 1 < leaves.size() && leaves[j + 1] == leaves[j] + 1) {
+            ++j;
+        }
+        ranges.push_back(checksum_tree::leaves_range(range, split_points, leaves[i], leaves[j]));
+        i = j + 1;
+    }
+    return ranges;
+}
+
+// Stream in from each peer the ranges on which it differs from this node,
+// and then stream the union of those ranges out to all peers, so that
+// what one peer had is passed on to the others too.
+static future<> sync_ranges(const sstring& keyspace, const sstring& cf,
+        std::unordered_map<gms::inet_address, std::vector<::range<dht::token>>> ranges_in,
+        std::vector<::range<dht::token>> ranges_out,
+        std::vector<gms::inet_address> neighbors) {
+    return do_with(streaming::stream_plan("repair-in"),
+                   streaming::stream_plan("repair-out"),
+                   std::move(ranges_in), std::move(ranges_out), std::move(neighbors),
+            [&keyspace, &cf] (auto& sp_in, auto& sp_out, auto& ranges_in, auto& ranges_out, auto& neighbors) {
+        for (auto& peer_ranges : ranges_in) {
+            sp_in.request_ranges(peer_ranges.first, keyspace, peer_ranges.second, {cf});
+        }
+        for (const auto& peer : neighbors) {
+            sp_out.transfer_ranges(peer, keyspace, ranges_out, {cf});
+        }
+        return sp_in.execute().discard_result().then([&sp_out] {
+                return sp_out.execute().discard_result();
+        }).handle_exception([] (auto ep) {
+            logger.error("repair's stream failed: {}", ep);
+            return make_exception_future(ep);
+        });
+    });
+}
+
+// Like checksum_and_sync_range(), but compares checksum trees of the given
+// depth, and syncs only the parts of the range where they differ.
+static future<> checksum_tree_and_sync_range(seastar::sharded<database>& db,
+        const sstring& keyspace, const sstring& cf,
+        const ::range<dht::token>& range, unsigned depth, repair_checksum hash_algorithm,
+        std::vector<gms::inet_address>& neighbors, bool& success) {
+    std::vector<future<std::vector<partition_checksum>>> trees;
+    trees.reserve(1 + neighbors.size());
+    trees.push_back(checksum_range_leaves(db, keyspace, cf, range, depth, hash_algorithm));
+    for (auto&& neighbor : neighbors) {
+        trees.push_back(
+                net::get_local_messaging_service().send_repair_checksum_tree(
+                        net::msg_addr{neighbor}, keyspace, cf, range, depth, hash_algorithm));
+    }
+
+    return when_all(trees.begin(), trees.end()).then(
+            [&keyspace, &cf, &range, &neighbors, &success]
+            (std::vector<future<std::vector<partition_checksum>>> trees) {
+        for (unsigned i = 0; i < trees.size(); i++) {
+            if (trees[i].failed()) {
+                logger.warn(
+                    "Checksum tree of range {} on {} failed: {}",
+                    range,
+                    (i ? neighbors[i-1] :
+                     utils::fb_utilities::get_broadcast_address()),
+                    trees[i].get_exception());
+                success = false;
+            }
+        }
+        if (!trees[0].available()) {
+            return make_ready_future<>();
+        }
+        checksum_tree local(trees[0].get0());
+        auto split_points = checksum_tree::split_points(range, local.depth());
+        std::vector<gms::inet_address> live_neighbors;
+        std::unordered_map<gms::inet_address, std::vector<::range<dht::token>>> ranges_in;
+        std::set<unsigned> differing;
+        for (unsigned i = 1; i < trees.size(); i++) {
+            if (!trees[i].available()) {
+                continue;
+            }
+            auto leaves = trees[i].get0();
+            if (leaves.size() != split_points.size() + 1) {
+                logger.warn("Checksum tree of range {} on {} has {} leaves, expected {}",
+                        range, neighbors[i-1], leaves.size(), split_points.size() + 1);
+                success = false;
+                continue;
+            }
+            live_neighbors.push_back(neighbors[i - 1]);
+            auto diff = local.differing_leaves(checksum_tree(leaves));
+            if (!diff.empty()) {
+                differing.insert(diff.begin(), diff.end());
+                ranges_in.emplace(neighbors[i - 1], leaf_ranges(range, split_points, diff));
+            }
+        }
+        if (differing.empty()) {
+            return make_ready_future<>();
+        }
+        auto ranges_out = leaf_ranges(range, split_points, std::vector<unsigned>(differing.begin(), differing.end()));
+        logger.info("Found {} differing leaves of range {} on nodes {}", differing.size(), range, live_neighbors);
+        return sync_ranges(keyspace, cf, std::move(ranges_in), std::move(ranges_out), std::move(live_neighbors));
+    });
+}
+
 // We don't need to wait for one checksum to finish before we start the
 // next, but doing too many of these operations in parallel also doesn't
 // make sense, so we limit the number of concurrent ongoing checksum
@@ -472,74 +803,40 @@ static future<> repair_cf_range(seastar::sharded<database>& db,
     estimated_partitions /= db.local().get_config().num_tokens();
     estimated_partitions /= db.local().find_keyspace(keyspace).get_replication_strategy().get_replication_factor();
 
-    // FIXME: we should have an on-the-fly iterator generator here, not
-    // fill a vector in advance.
-    std::vector<::range<dht::token>> tosplit;
-    ranges.swap(tosplit);
-    for (const auto& range : tosplit) {
-        // FIXME: this "100" needs to be a parameter.
-        split_and_add(ranges, range, estimated_partitions, 100);
+    // When all nodes can compute checksum trees, each range is compared with
+    // a single tree whose leaves hold roughly as many partitions as the
+    // sub-ranges below would.
+    // FIXME: this "100" needs to be a parameter.
+    unsigned depth = 0;
+    if (service::get_local_storage_service().cluster_supports_repair_checksum_tree()) {
+        while (depth < max_checksum_tree_depth && (estimated_partitions >> depth) >= 100) {
+            ++depth;
+        }
+    }
+    auto hash_algorithm = service::get_local_storage_service().cluster_supports_murmur3_digest()
+            ? repair_checksum::murmur3_128 : repair_checksum::sha256;
+
+    if (!depth) {
+        // FIXME: we should have an on-the-fly iterator generator here, not
+        // fill a vector in advance.
+        std::vector<::range<dht::token>> tosplit;
+        ranges.swap(tosplit);
+        for (const auto& range : tosplit) {
+            split_and_add(ranges, range, estimated_partitions, 100);
+        }
     }
 
     return do_with(seastar::gate(), true, std::move(keyspace), std::move(cf), std::move(ranges),
-        [&db, &neighbors] (auto& completion, auto& success, const auto& keyspace, const auto& cf, const auto& ranges) {
-        return do_for_each(ranges, [&completion, &success, &db, &neighbors, &keyspace, &cf]
+        [&db, &neighbors, depth, hash_algorithm] (auto& completion, auto& success, const auto& keyspace, const auto& cf, const auto& ranges) {
+        return do_for_each(ranges, [&completion, &success, &db, &neighbors, &keyspace, &cf, depth, hash_algorithm]
                            (const auto& range) {
 
             check_in_shutdown();
-            return parallelism_semaphore.wait(1).then([&completion, &success, &db, &neighbors, &keyspace, &cf, &range] {
-
-                // Ask this node, and all neighbors, to calculate checksums in
-                // this range. When all are done, compare the results, and if
-                // there are any differences, sync the content of this range.
-                std::vector<future<partition_checksum>> checksums;
-                checksums.reserve(1 + neighbors.size());
-                checksums.push_back(checksum_range(db, keyspace, cf, range));
-                for (auto&& neighbor : neighbors) {
-                    checksums.push_back(
-                            net::get_local_messaging_service().send_repair_checksum_range(
-                                    net::msg_addr{neighbor},keyspace, cf, range));
-                }
-
+            return parallelism_semaphore.wait(1).then([&completion, &success, &db, &neighbors, &keyspace, &cf, &range, depth, hash_algorithm] {
                 completion.enter();
-                when_all(checksums.begin(), checksums.end()).then(
-                        [&db, &keyspace, &cf, &range, &neighbors, &success]
-                        (std::vector<future<partition_checksum>> checksums) {
-                    // If only some of the replicas of this range are alive,
-                    // we set success=false so repair will fail, but we can
-                    // still do our best to repair available replicas.
-                    std::vector<gms::inet_address> live_neighbors;
-                    for (unsigned i = 0; i < checksums.size(); i++) {
-                        if (checksums[i].failed()) {
-                            logger.warn(
-                                "Checksum of range {} on {} failed: {}",
-                                range,
-                                (i ? neighbors[i-1] :
-                                 utils::fb_utilities::get_broadcast_address()),
-                                checksums[i].get_exception());
-                            success = false;
-                            // Do not break out of the loop here, so we can log
-                            // (and discard) all the exceptions.
-                        } else if (i > 0) {
-                            live_neighbors.push_back(neighbors[i - 1]);
-                        }
-                    }
-                    if (!checksums[0].available() || live_neighbors.empty()) {
-                        return make_ready_future<>();
-                    }
-                    // If one of the available checksums is different, repair
-                    // all the neighbors which returned a checksum.
-                    auto checksum0 = checksums[0].get();
-                    for (unsigned i = 1; i < checksums.size(); i++) {
-                        if (checksums[i].available() && checksum0 != checksums[i].get()) {
-                            logger.info("Found differing range {} on nodes {}", range, live_neighbors);
-                            return do_with(std::move(live_neighbors), [&db, &keyspace, &cf, &range] (auto& live_neighbors) {
-                                return sync_range(db, keyspace, cf, range, live_neighbors);
-                            });
-                        }
-                    }
-                    return make_ready_future<>();
-                }).handle_exception([&success, &range] (std::exception_ptr eptr) {
+                auto f = depth ? checksum_tree_and_sync_range(db, keyspace, cf, range, depth, hash_algorithm, neighbors, success)
+                        : checksum_and_sync_range(db, keyspace, cf, range, hash_algorithm, neighbors, success);
+                f.handle_exception([&success, &range] (std::exception_ptr eptr) {
                     // Something above (e.g., sync_range) failed. We could
                     // stop the repair immediately, or let it continue with
                     // other ranges (at the moment, we do the latter). But in
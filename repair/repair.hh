@@ -78,13 +78,22 @@ future<> repair_shutdown(seastar::sharded<database>& db);
 // independently calculate the checksums of different subsets of the original
 // set, and then combine the results into one checksum with the add() method.
 // The hash of an individual partition uses both its key and value.
+//
+// The hash function is selected by repair_checksum. murmur3_128 is much
+// cheaper than SHA-256, and is used when all nodes in the cluster support it;
+// its 128-bit result fills the first half of the digest.
+enum class repair_checksum : uint8_t {
+    sha256 = 0,
+    murmur3_128 = 1,
+};
+
 class partition_checksum {
 private:
     std::array<uint8_t, 32> _digest; // 256 bits
 public:
     constexpr partition_checksum() : _digest{} { }
     explicit partition_checksum(std::array<uint8_t, 32> digest) : _digest(std::move(digest)) { }
-    partition_checksum(const mutation& m);
+    partition_checksum(const mutation& m, repair_checksum hash_algorithm);
     void add(const partition_checksum& other);
     bool operator==(const partition_checksum& other) const;
     bool operator!=(const partition_checksum& other) const { return !operator==(other); }
@@ -99,4 +108,51 @@ class partition_checksum {
 // not resolved.
 future<partition_checksum> checksum_range(seastar::sharded<database> &db,
         const sstring& keyspace, const sstring& cf,
-        const ::range<dht::token>& range);
+        const ::range<dht::token>& range, repair_checksum hash_algorithm);
+
+// A checksum_tree is a hash tree (Merkle tree) over a token range, used to
+// find the parts of the range on which two replicas differ. The range is
+// split into 2^depth leaves by halving it repeatedly at the token midpoint,
+// and each leaf holds the partition_checksum of the partitions in it. An
+// inner node is the hash of its two children, so equal subtrees are
+// recognized without looking at their leaves.
+class checksum_tree {
+    unsigned _depth;
+    // Nodes in breadth-first order: node i has children 2i+1 and 2i+2, and
+    // the last 2^depth nodes are the leaves.
+    std::vector<partition_checksum> _nodes;
+public:
+    // The number of leaves must be a power of two.
+    explicit checksum_tree(const std::vector<partition_checksum>& leaves);
+    unsigned depth() const {
+        return _depth;
+    }
+    const partition_checksum& root() const {
+        return _nodes.front();
+    }
+    // Returns the indexes, in ascending order, of the leaves on which this
+    // tree and the other one (of the same depth) differ.
+    std::vector<unsigned> differing_leaves(const checksum_tree& other) const;
+
+    // Returns the 2^depth - 1 tokens splitting the non-wrapping range into
+    // the leaves of a tree of the given depth. Leaf i ends at (and includes)
+    // split point i. The split points are non-decreasing, ranges too narrow
+    // to be split further yield empty leaves.
+    static std::vector<dht::token> split_points(const ::range<dht::token>& range, unsigned depth);
+    // Returns the token range covered by leaves [first, last].
+    static ::range<dht::token> leaves_range(const ::range<dht::token>& range,
+            const std::vector<dht::token>& split_points, unsigned first, unsigned last);
+};
+
+// Deepest tree a node will compute, i.e. 64K leaves of 32 bytes each.
+constexpr unsigned max_checksum_tree_depth = 16;
+
+// Calculate the checksums of the leaves of a checksum_tree of the given
+// depth over the data held on all shards of a column family, in the given
+// non-wrapping token range. The depth is capped at max_checksum_tree_depth.
+// All parameters to this function are constant references, and the caller
+// must ensure they live as long as the future returned by this function is
+// not resolved.
+future<std::vector<partition_checksum>> checksum_range_leaves(seastar::sharded<database> &db,
+        const sstring& keyspace, const sstring& cf,
+        const ::range<dht::token>& range, unsigned depth, repair_checksum hash_algorithm);
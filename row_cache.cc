@@ -27,6 +27,7 @@
 #include <seastar/util/defer.hh>
 #include "memtable.hh"
 #include <chrono>
+#include <boost/algorithm/cxx11/all_of.hpp>
 #include "utils/move.hh"
 
 using namespace std::chrono_literals;
@@ -38,6 +39,122 @@ static logging::logger logger("cache");
 thread_local seastar::thread_scheduling_group row_cache::_update_thread_scheduling_group(1ms, 0.2);
 
 
+using clustering_bound_opt = stdx::optional<query::clustering_range::bound>;
+
+static bound_view start_bound(const clustering_bound_opt& b) {
+    if (!b) {
+        return bound_view::bottom();
+    }
+    return bound_view(b->value(), b->is_inclusive() ? bound_kind::incl_start : bound_kind::excl_start);
+}
+
+static bound_view end_bound(const clustering_bound_opt& b) {
+    if (!b) {
+        return bound_view::top();
+    }
+    return bound_view(b->value(), b->is_inclusive() ? bound_kind::incl_end : bound_kind::excl_end);
+}
+
+partition_continuity::partition_continuity(const schema& s, const query::clustering_row_ranges& ranges)
+    : _complete(false)
+{
+    add(s, ranges);
+}
+
+void partition_continuity::add(const schema& s, const query::clustering_range& r) {
+    if (_complete) {
+        return;
+    }
+    bound_view::compare less(s);
+    if (less(end_bound(r.end()), start_bound(r.start()))) {
+        return;
+    }
+    // Ranges overlapping with r, or adjacent to it, are merged with it.
+    auto first = std::find_if(_ranges.begin(), _ranges.end(), [&] (const query::clustering_range& x) {
+        return !less(end_bound(x.end()), start_bound(r.start()));
+    });
+    auto last = std::find_if(first, _ranges.end(), [&] (const query::clustering_range& x) {
+        return less(end_bound(r.end()), start_bound(x.start()));
+    });
+    clustering_bound_opt start = r.start();
+    clustering_bound_opt end = r.end();
+    if (first != last) {
+        if (less(start_bound(first->start()), start_bound(start))) {
+            start = first->start();
+        }
+        if (less(end_bound(end), end_bound(std::prev(last)->end()))) {
+            end = std::prev(last)->end();
+        }
+    }
+    auto merged = query::clustering_range(std::move(start), std::move(end));
+    // If the insertion below fails, we are left with less continuity than
+    // before, which is safe.
+    auto i = _ranges.erase(first, last);
+    if (merged.is_full()) {
+        set_complete();
+    } else {
+        _ranges.insert(i, std::move(merged));
+    }
+}
+
+void partition_continuity::add(const schema& s, const query::clustering_row_ranges& ranges) {
+    for (auto&& r : ranges) {
+        add(s, r);
+    }
+}
+
+bool partition_continuity::contains(const schema& s, const query::clustering_row_ranges& ranges) const {
+    if (_complete) {
+        return true;
+    }
+    bound_view::compare less(s);
+    return boost::algorithm::all_of(ranges, [&] (const query::clustering_range& r) {
+        if (less(end_bound(r.end()), start_bound(r.start()))) {
+            return true;
+        }
+        auto i = std::find_if(_ranges.begin(), _ranges.end(), [&] (const query::clustering_range& x) {
+            return !less(end_bound(x.end()), start_bound(r.start()));
+        });
+        return i != _ranges.end()
+            && !less(start_bound(r.start()), start_bound(i->start()))
+            && !less(end_bound(i->end()), end_bound(r.end()));
+    });
+}
+
+query::clustering_row_ranges partition_continuity::missing(const schema& s, const query::clustering_row_ranges& ranges) const {
+    query::clustering_row_ranges result;
+    if (_complete) {
+        return result;
+    }
+    using bound = query::clustering_range::bound;
+    bound_view::compare less(s);
+    for (auto&& r : ranges) {
+        // The part of r which is yet to be checked starts at start.
+        clustering_bound_opt start = r.start();
+        bool done = false;
+        for (auto&& x : _ranges) {
+            if (less(end_bound(x.end()), start_bound(start))) {
+                continue;
+            }
+            if (less(end_bound(r.end()), start_bound(x.start()))) {
+                break;
+            }
+            if (less(start_bound(start), start_bound(x.start()))) {
+                result.emplace_back(start, clustering_bound_opt(bound(x.start()->value(), !x.start()->is_inclusive())));
+            }
+            if (!x.end()) {
+                done = true;
+                break;
+            }
+            start = bound(x.end()->value(), !x.end()->is_inclusive());
+        }
+        if (!done && !less(end_bound(r.end()), start_bound(start))) {
+            result.emplace_back(std::move(start), r.end());
+        }
+    }
+    return result;
+}
+
 cache_tracker& global_cache_tracker() {
     static thread_local cache_tracker instance;
     return instance;
@@ -187,6 +304,49 @@ class populating_reader final : public mutation_reader::impl {
     }
 };
 
+// Reader of a single partition of which cache holds only some clustering
+// ranges, or nothing at all. Returns the cached rows merged with the rows
+// read from the underlying data source for the remaining ranges, and
+// populates cache with the latter.
+class partial_populating_reader final : public mutation_reader::impl {
+    schema_ptr _schema;
+    row_cache& _cache;
+    mutation_opt _cached;
+    mutation_reader _delegate;
+    query::clustering_row_ranges _ck_ranges;
+    utils::phased_barrier::phase_type _phase;
+    bool _done = false;
+public:
+    partial_populating_reader(schema_ptr s, row_cache& cache, mutation_opt cached,
+                              mutation_reader delegate, query::clustering_row_ranges ck_ranges)
+        : _schema(std::move(s))
+        , _cache(cache)
+        , _cached(std::move(cached))
+        , _delegate(std::move(delegate))
+        , _ck_ranges(std::move(ck_ranges))
+        , _phase(cache._populate_phaser.phase())
+    { }
+
+    virtual future<mutation_opt> operator()() override {
+        if (_done) {
+            return make_ready_future<mutation_opt>();
+        }
+        _done = true;
+        return _delegate().then([this, op = _cache._populate_phaser.start()] (mutation_opt&& mo) {
+            if (mo) {
+                // The delegate may not have seen data which was moved to
+                // cache by update() in the meantime.
+                if (_phase == _cache._populate_phaser.phase()) {
+                    _cache.populate(*mo, _ck_ranges);
+                }
+                mo->upgrade(_schema);
+            }
+            apply(_cached, std::move(mo));
+            return std::move(_cached);
+        });
+    }
+};
+
 void row_cache::on_hit() {
     _stats.hits.mark();
     _tracker.on_hit();
@@ -197,12 +357,16 @@ void row_cache::on_miss() {
     _tracker.on_miss();
 }
 
+// Returns cached partitions which have all the clustering rows selected by
+// the filtering context. Those which don't are skipped, so that the caller
+// reads them from the underlying data source.
 class just_cache_scanning_reader final : public mutation_reader::impl {
     schema_ptr _schema;
     row_cache& _cache;
     row_cache::partitions_type::iterator _it;
     row_cache::partitions_type::iterator _end;
     const query::partition_range& _range;
+    query::clustering_key_filtering_context _ck_filtering;
     stdx::optional<dht::decorated_key> _last;
     uint64_t _last_reclaim_count;
     size_t _last_modification_count;
@@ -242,13 +406,18 @@ class just_cache_scanning_reader final : public mutation_reader::impl {
         _last_modification_count = modification_count;
     }
 public:
-    just_cache_scanning_reader(schema_ptr s, row_cache& cache, const query::partition_range& range)
-        : _schema(std::move(s)), _cache(cache), _range(range)
+    just_cache_scanning_reader(schema_ptr s, row_cache& cache, const query::partition_range& range,
+                               query::clustering_key_filtering_context ck_filtering)
+        : _schema(std::move(s)), _cache(cache), _range(range), _ck_filtering(std::move(ck_filtering))
     { }
     virtual future<mutation_opt> operator()() override {
         return _cache._read_section(_cache._tracker.region(), [this] {
           return with_linearized_managed_bytes([&] {
             update_iterators();
+            while (_it != _end && !_it->continuity().contains(*_cache._schema, _ck_filtering.get_ranges(_it->key().key()))) {
+                _last = _it->key();
+                ++_it;
+            }
             if (_it == _end) {
                 return make_ready_future<mutation_opt>();
             }
@@ -282,9 +451,10 @@ class scanning_and_populating_reader final : public mutation_reader::impl {
     scanning_and_populating_reader(schema_ptr s,
                                    row_cache& cache,
                                    const query::partition_range& range,
+                                   query::clustering_key_filtering_context ck_filtering,
                                    const io_priority_class& pc)
         : _cache(cache), _schema(s),
-          _primary(make_mutation_reader<just_cache_scanning_reader>(s, cache, range)),
+          _primary(make_mutation_reader<just_cache_scanning_reader>(s, cache, range, std::move(ck_filtering))),
           _underlying(cache._underlying), _original_range(range), _underlying_keys(cache._underlying_keys),
           _keys(_underlying_keys(range, pc)),
           _pc(pc)
@@ -366,12 +536,13 @@ class scanning_and_populating_reader final : public mutation_reader::impl {
 mutation_reader
 row_cache::make_scanning_reader(schema_ptr s,
                                 const query::partition_range& range,
+                                query::clustering_key_filtering_context ck_filtering,
                                 const io_priority_class& pc) {
     if (range.is_wrap_around(dht::ring_position_comparator(*s))) {
         warn(unimplemented::cause::WRAP_AROUND);
         throw std::runtime_error("row_cache doesn't support wrap-around ranges");
     }
-    return make_mutation_reader<scanning_and_populating_reader>(std::move(s), *this, range, pc);
+    return make_mutation_reader<scanning_and_populating_reader>(std::move(s), *this, range, std::move(ck_filtering), pc);
 }
 
 class slicing_reader : public mutation_reader::impl {
@@ -416,30 +587,45 @@ row_cache::make_reader(schema_ptr s,
         const query::ring_position& pos = range.start()->value();
 
         if (!pos.has_key()) {
-            return make_mutation_reader<slicing_reader>(make_scanning_reader(std::move(s), range, pc), ck_filtering);
+            return make_mutation_reader<slicing_reader>(make_scanning_reader(std::move(s), range, ck_filtering, pc), ck_filtering);
         }
 
         return _read_section(_tracker.region(), [&] {
           return with_linearized_managed_bytes([&] {
             const dht::decorated_key& dk = pos.as_decorated_key();
             auto i = _partitions.find(dk, cache_entry::compare(_schema));
+            auto& ck_ranges = ck_filtering.get_ranges(dk.key());
             if (i != _partitions.end()) {
                 cache_entry& e = *i;
                 _tracker.touch(e);
-                on_hit();
                 upgrade_entry(e);
-                return make_reader_returning(e.read(s, ck_filtering));
+                if (e.continuity().contains(*_schema, ck_ranges)) {
+                    on_hit();
+                    return make_reader_returning(e.read(s, ck_filtering));
+                }
+                // Serve the rows we have, and read only the missing ranges.
+                on_miss();
+                auto missing = e.continuity().missing(*_schema, ck_ranges);
+                auto missing_filtering = query::clustering_key_filtering_context::create_for_ranges(_schema, missing);
+                return make_mutation_reader<partial_populating_reader>(s, *this, e.read(s, ck_filtering),
+                    _underlying(_schema, range, std::move(missing_filtering), pc), std::move(missing));
             } else {
                 on_miss();
-                return make_mutation_reader<slicing_reader>(
-                    make_mutation_reader<populating_reader>(s, *this, _underlying(_schema, range, query::no_clustering_key_filtering, pc)),
-                    ck_filtering);
+                if (ck_ranges.size() == 1 && ck_ranges[0].is_full()) {
+                    return make_mutation_reader<slicing_reader>(
+                        make_mutation_reader<populating_reader>(s, *this, _underlying(_schema, range, query::no_clustering_key_filtering, pc)),
+                        ck_filtering);
+                }
+                // Don't bring the whole partition into cache when only some
+                // of its rows were asked for.
+                return make_mutation_reader<partial_populating_reader>(s, *this, mutation_opt(),
+                    _underlying(_schema, range, ck_filtering, pc), ck_ranges);
             }
           });
         });
     }
 
-    return make_mutation_reader<slicing_reader>(make_scanning_reader(std::move(s), range, pc), ck_filtering);
+    return make_mutation_reader<slicing_reader>(make_scanning_reader(std::move(s), range, ck_filtering, pc), ck_filtering);
 }
 
 row_cache::~row_cache() {
@@ -458,9 +644,39 @@ void row_cache::populate(const mutation& m) {
                 _tracker.insert(*entry);
                 _partitions.insert(i, *entry);
             } else {
-                _tracker.touch(*i);
-                // We cache whole partitions right now, so if cache already has this partition,
-                // it must be complete, so do nothing.
+                cache_entry& entry = *i;
+                _tracker.touch(entry);
+                // If cache already has the whole partition, there is nothing to do.
+                if (!entry.continuity().is_complete()) {
+                    upgrade_entry(entry);
+                    entry.partition().apply(*_schema, m.partition(), *m.schema());
+                    entry.continuity().set_complete();
+                }
+            }
+          });
+        });
+    });
+}
+
+void row_cache::populate(const mutation& m, const query::clustering_row_ranges& ck_ranges) {
+    with_allocator(_tracker.allocator(), [this, &m, &ck_ranges] {
+        _populate_section(_tracker.region(), [&] {
+          with_linearized_managed_bytes([&] {
+            auto i = _partitions.lower_bound(m.decorated_key(), cache_entry::compare(_schema));
+            if (i == _partitions.end() || !i->key().equal(*_schema, m.decorated_key())) {
+                cache_entry* entry = current_allocator().construct<cache_entry>(
+                        m.schema(), m.decorated_key(), m.partition(), partition_continuity(*m.schema(), ck_ranges));
+                upgrade_entry(*entry);
+                _tracker.insert(*entry);
+                _partitions.insert(i, *entry);
+            } else {
+                cache_entry& entry = *i;
+                _tracker.touch(entry);
+                if (!entry.continuity().contains(*_schema, ck_ranges)) {
+                    upgrade_entry(entry);
+                    entry.partition().apply(*_schema, m.partition(), *m.schema());
+                    entry.continuity().add(*_schema, ck_ranges);
+                }
             }
           });
         });
@@ -637,6 +853,7 @@ cache_entry::cache_entry(cache_entry&& o) noexcept
     : _schema(std::move(o._schema))
     , _key(std::move(o._key))
     , _p(std::move(o._p))
+    , _continuity(std::move(o._continuity))
     , _lru_link()
     , _cache_link()
 {
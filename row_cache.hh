@@ -42,6 +42,36 @@ struct registrations;
 
 namespace bi = boost::intrusive;
 
+// Describes which clustering ranges of a cached partition are continuous,
+// i.e. for which the cache entry holds all the rows present in the
+// underlying data source. Rows outside of those ranges may be present in
+// the entry too, but don't have to be. The partition tombstone, static row
+// and range tombstones are always complete.
+class partition_continuity {
+    bool _complete = true;
+    // Disjoint and non-adjacent ranges, in clustering order. Not used when
+    // the partition is complete.
+    query::clustering_row_ranges _ranges;
+public:
+    // Creates continuity of a complete partition.
+    partition_continuity() = default;
+    // Creates continuity of a partition for which only the given ranges are complete.
+    partition_continuity(const schema&, const query::clustering_row_ranges&);
+
+    bool is_complete() const { return _complete; }
+    void set_complete() {
+        _complete = true;
+        _ranges.clear();
+    }
+    void add(const schema&, const query::clustering_range&);
+    void add(const schema&, const query::clustering_row_ranges&);
+    // Returns true iff all of the given ranges are continuous.
+    bool contains(const schema&, const query::clustering_row_ranges&) const;
+    // Returns the parts of the given ranges which are not continuous.
+    query::clustering_row_ranges missing(const schema&, const query::clustering_row_ranges&) const;
+    const query::clustering_row_ranges& ranges() const { return _ranges; }
+};
+
 // Intrusive set entry which holds partition data.
 //
 // TODO: Make memtables use this format too.
@@ -58,6 +88,7 @@ class cache_entry {
     schema_ptr _schema;
     dht::decorated_key _key;
     mutation_partition _p;
+    partition_continuity _continuity;
     lru_link_type _lru_link;
     cache_link_type _cache_link;
     friend class size_calculator;
@@ -77,11 +108,20 @@ class cache_entry {
         , _p(std::move(p))
     { }
 
+    cache_entry(schema_ptr s, const dht::decorated_key& key, const mutation_partition& p, partition_continuity continuity)
+        : _schema(std::move(s))
+        , _key(key)
+        , _p(p)
+        , _continuity(std::move(continuity))
+    { }
+
     cache_entry(cache_entry&&) noexcept;
 
     const dht::decorated_key& key() const { return _key; }
     const mutation_partition& partition() const { return _p; }
     mutation_partition& partition() { return _p; }
+    const partition_continuity& continuity() const { return _continuity; }
+    partition_continuity& continuity() { return _continuity; }
     const schema_ptr& schema() const { return _schema; }
     schema_ptr& schema() { return _schema; }
     mutation read(const schema_ptr&);
@@ -171,6 +211,7 @@ class row_cache final {
         bi::constant_time_size<false>, // we need this to have bi::auto_unlink on hooks
         bi::compare<cache_entry::compare>>;
     friend class populating_reader;
+    friend class partial_populating_reader;
 public:
     struct stats {
         utils::timed_rate_moving_average hits;
@@ -180,7 +221,9 @@ class row_cache final {
     cache_tracker& _tracker;
     stats _stats{};
     schema_ptr _schema;
-    partitions_type _partitions; // Cached partitions are complete.
+    // Cached partitions are complete, except for those populated by reads
+    // of a subset of clustering rows; see partition_continuity.
+    partitions_type _partitions;
     mutation_source _underlying;
     key_source _underlying_keys;
 
@@ -199,6 +242,7 @@ class row_cache final {
     logalloc::allocating_section _read_section;
     mutation_reader make_scanning_reader(schema_ptr,
                                          const query::partition_range&,
+                                         query::clustering_key_filtering_context,
                                          const io_priority_class& pc);
     void on_hit();
     void on_miss();
@@ -227,6 +271,11 @@ class row_cache final {
     // information there is for its partition in the underlying data sources.
     void populate(const mutation& m);
 
+    // Populate cache from given mutation, which must contain all information
+    // there is for its partition in the underlying data sources, except for
+    // clustering rows outside of the given ranges.
+    void populate(const mutation& m, const query::clustering_row_ranges& ck_ranges);
+
     // Clears the cache.
     void clear();
 
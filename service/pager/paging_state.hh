@@ -45,6 +45,7 @@
 
 #include "bytes.hh"
 #include "keys.hh"
+#include "utils/UUID.hh"
 
 namespace service {
 
@@ -54,9 +55,11 @@ class paging_state final {
     partition_key _partition_key;
     std::experimental::optional<clustering_key> _clustering_key;
     uint32_t _remaining;
+    std::experimental::optional<utils::UUID> _query_uuid;
 
 public:
-    paging_state(partition_key pk, std::experimental::optional<clustering_key> ck, uint32_t rem);
+    paging_state(partition_key pk, std::experimental::optional<clustering_key> ck, uint32_t rem,
+            std::experimental::optional<utils::UUID> query_uuid = std::experimental::nullopt);
 
     /**
      * Last processed key, i.e. where to start from in next paging round
@@ -77,6 +80,12 @@ class paging_state final {
     uint32_t get_remaining() const {
         return _remaining;
     }
+    /**
+     * Identifies the query across its pages, see read_command::query_id.
+     */
+    const std::experimental::optional<utils::UUID>& get_query_uuid() const {
+        return _query_uuid;
+    }
 
     static ::shared_ptr<paging_state> deserialize(bytes_opt bytes);
     bytes_opt serialize() const;
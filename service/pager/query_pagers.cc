@@ -72,7 +72,12 @@ class service::pager::query_pagers::impl : public query_pager {
             _max = state->get_remaining();
             _last_pkey = state->get_partition_key();
             _last_ckey = state->get_clustering_key();
+            _query_uuid = state->get_query_uuid();
         }
+        if (!_query_uuid) {
+            _query_uuid = utils::make_random_uuid();
+        }
+        _cmd->query_id = _query_uuid;
 
         if (_last_pkey) {
             auto dpk = dht::global_partitioner().decorate_key(*_schema, *_last_pkey);
@@ -320,7 +325,7 @@ class service::pager::query_pagers::impl : public query_pager {
         return _exhausted ?
                         nullptr :
                         ::make_shared<const paging_state>(*_last_pkey,
-                                        _last_ckey, _max);
+                                        _last_ckey, _max, _query_uuid);
     }
 
 private:
@@ -332,6 +337,7 @@ class service::pager::query_pagers::impl : public query_pager {
 
     std::experimental::optional<partition_key> _last_pkey;
     std::experimental::optional<clustering_key> _last_ckey;
+    std::experimental::optional<utils::UUID> _query_uuid;
 
     schema_ptr _schema;
     ::shared_ptr<cql3::selection::selection> _selection;
@@ -30,6 +30,7 @@ class priority_manager {
     ::io_priority_class _stream_write_priority;
     ::io_priority_class _sstable_query_read;
     ::io_priority_class _compaction_priority;
+    ::io_priority_class _hints_priority;
 
 public:
     const ::io_priority_class&
@@ -62,6 +63,11 @@ class priority_manager {
         return _compaction_priority;
     }
 
+    const ::io_priority_class&
+    hints_priority() {
+        return _hints_priority;
+    }
+
     priority_manager()
         : _commitlog_priority(engine().register_one_priority_class("commitlog", 100))
         , _mt_flush_priority(engine().register_one_priority_class("memtable_flush", 100))
@@ -69,6 +75,7 @@ class priority_manager {
         , _stream_write_priority(engine().register_one_priority_class("streaming_write", 20))
         , _sstable_query_read(engine().register_one_priority_class("query", 100))
         , _compaction_priority(engine().register_one_priority_class("compaction", 100))
+        , _hints_priority(engine().register_one_priority_class("hints", 10))
 
     {}
 };
@@ -103,4 +110,9 @@ const inline ::io_priority_class&
 get_local_compaction_priority() {
     return get_local_priority_manager().compaction_priority();
 }
+
+const inline ::io_priority_class&
+get_local_hints_priority() {
+    return get_local_priority_manager().hints_priority();
+}
 }
@@ -54,6 +54,7 @@
 #include "db/read_repair_decision.hh"
 #include "db/config.hh"
 #include "db/batchlog_manager.hh"
+#include "db/hints/manager.hh"
 #include "exceptions/exceptions.hh"
 #include <boost/range/algorithm_ext/push_back.hpp>
 #include <boost/range/adaptor/transformed.hpp>
@@ -67,6 +68,7 @@
 #include <boost/range/algorithm/heap_algorithm.hpp>
 #include <boost/range/numeric.hpp>
 #include <boost/range/algorithm/sort.hpp>
+#include <boost/range/irange.hpp>
 #include "utils/latency.hh"
 #include "schema.hh"
 #include "schema_registry.hh"
@@ -285,7 +287,7 @@ storage_proxy::response_id_type storage_proxy::register_response_handler(std::un
             // we are here because either cl was achieved, but targets left in the handler are not
             // responding, so a hint should be written for them, or cl == any in which case
             // hints are counted towards consistency, so we need to write hints and count how much was written
-            auto hints = hint_to_dead_endpoints(e.handler->get_mutation(), e.handler->get_targets());
+            auto hints = hint_to_dead_endpoints(e.handler->get_schema(), e.handler->get_mutation(), e.handler->get_targets());
             e.handler->signal(hints);
             if (e.handler->_cl == db::consistency_level::ANY && hints) {
                 logger.trace("Wrote hint to satisfy CL.ANY after no replicas acknowledged the write");
@@ -430,6 +432,16 @@ storage_proxy::storage_proxy(distributed<database>& db) : _db(db) {
                 , "total_operations", "read retries")
                 , scollectd::make_typed(scollectd::data_type::DERIVE, _stats.read_retries)
         ),
+        scollectd::add_polled_metric(scollectd::type_instance_id("storage_proxy"
+                , scollectd::per_cpu_plugin_instance
+                , "total_operations", "speculative retries")
+                , scollectd::make_typed(scollectd::data_type::DERIVE, _stats.speculative_retries)
+        ),
+        scollectd::add_polled_metric(scollectd::type_instance_id("storage_proxy"
+                , scollectd::per_cpu_plugin_instance
+                , "total_operations", "speculative retries won")
+                , scollectd::make_typed(scollectd::data_type::DERIVE, _stats.speculative_retries_won)
+        ),
         scollectd::add_polled_metric(scollectd::type_instance_id("storage_proxy"
                 , scollectd::per_cpu_plugin_instance
                 , "total_operations", "global_read_repairs_canceled_due_to_concurrent_write")
@@ -914,6 +926,24 @@ storage_proxy::mutate_streaming_mutation(const schema_ptr& s, const frozen_mutat
     });
 }
 
+future<>
+storage_proxy::mutate_streaming_mutations(const schema_ptr& s, const std::vector<const frozen_mutation*>& ms) {
+    std::vector<std::vector<const frozen_mutation*>> per_shard(smp::count);
+    for (auto m : ms) {
+        per_shard[_db.local().shard_of(*m)].push_back(m);
+    }
+    return do_with(std::move(per_shard), [this, s] (std::vector<std::vector<const frozen_mutation*>>& per_shard) {
+        return parallel_for_each(boost::irange(0u, smp::count), [this, s, &per_shard] (unsigned shard) {
+            if (per_shard[shard].empty()) {
+                return make_ready_future<>();
+            }
+            return _db.invoke_on(shard, [&ms = per_shard[shard], gs = global_schema_ptr(s)] (database& db) mutable -> future<> {
+                return db.apply_streaming_mutations(gs, ms);
+            });
+        });
+    });
+}
+
 
 /**
  * Helper for create_write_response_handler, shared across mutate/mutate_atomically.
@@ -968,7 +998,7 @@ void
 storage_proxy::hint_to_dead_endpoints(response_id_type id, db::consistency_level cl) {
     auto& h = get_write_response_handler(id);
 
-    size_t hints = hint_to_dead_endpoints(h.get_mutation(), h.get_dead_endpoints());
+    size_t hints = hint_to_dead_endpoints(h.get_schema(), h.get_mutation(), h.get_dead_endpoints());
 
     if (cl == db::consistency_level::ANY) {
         // for cl==ANY hints are counted towards consistency
@@ -1275,10 +1305,10 @@ void storage_proxy::send_to_live_endpoints(storage_proxy::response_id_type respo
 
 // returns number of hints stored
 template<typename Range>
-size_t storage_proxy::hint_to_dead_endpoints(lw_shared_ptr<const frozen_mutation> m, const Range& targets) noexcept
+size_t storage_proxy::hint_to_dead_endpoints(const schema_ptr& s, lw_shared_ptr<const frozen_mutation> m, const Range& targets) noexcept
 {
     return boost::count_if(targets | boost::adaptors::filtered(std::bind1st(std::mem_fn(&storage_proxy::should_hint), this)),
-            std::bind(std::mem_fn(&storage_proxy::submit_hint), this, m, std::placeholders::_1));
+            std::bind(std::mem_fn(&storage_proxy::submit_hint), this, std::cref(s), m, std::placeholders::_1));
 }
 
 size_t storage_proxy::get_hints_in_progress_for(gms::inet_address target) {
@@ -1291,34 +1321,17 @@ size_t storage_proxy::get_hints_in_progress_for(gms::inet_address target) {
     return it->second;
 }
 
-bool storage_proxy::submit_hint(lw_shared_ptr<const frozen_mutation> m, gms::inet_address target)
+bool storage_proxy::submit_hint(const schema_ptr& s, lw_shared_ptr<const frozen_mutation> m, gms::inet_address target)
 {
-    warn(unimplemented::cause::HINT);
-    // local write that time out should be handled by LocalMutationRunnable
-    assert(is_me(target));
-    return false;
-#if 0
-    HintRunnable runnable = new HintRunnable(target)
-    {
-        public void runMayThrow()
-        {
-            int ttl = HintedHandOffManager.calculateHintTTL(mutation);
-            if (ttl > 0)
-            {
-                logger.debug("Adding hint for {}", target);
-                writeHintForMutation(mutation, System.currentTimeMillis(), ttl, target);
-                // Notify the handler only for CL == ANY
-                if (responseHandler != null && responseHandler.consistencyLevel == ConsistencyLevel.ANY)
-                    responseHandler.response(null);
-            } else
-            {
-                logger.debug("Skipped writing hint for {} (ttl {})", target, ttl);
-            }
+    ++_total_hints_in_progress;
+    ++_hints_in_progress[target];
+    db::hints::get_local_manager().store_hint(target, s, std::move(m)).finally([this, target, p = shared_from_this()] {
+        --_total_hints_in_progress;
+        if (!--_hints_in_progress[target]) {
+            _hints_in_progress.erase(target);
         }
-    };
-
-    return submitHint(runnable);
-#endif
+    });
+    return true;
 }
 
 #if 0
@@ -1473,6 +1486,20 @@ bool storage_proxy::submit_hint(lw_shared_ptr<const frozen_mutation> m, gms::ine
     }
 #endif
 
+future<> storage_proxy::send_to_endpoint(mutation m, gms::inet_address target, db::write_type type) {
+    utils::latency_counter lc;
+    lc.start();
+
+    return mutate_prepare<>(std::array<mutation, 1>{std::move(m)}, db::consistency_level::ONE, type, [this, target] (const mutation& m, db::consistency_level cl, db::write_type type) {
+        auto& ks = _db.local().find_keyspace(m.schema()->ks_name());
+        return create_write_response_handler(m.schema(), ks, cl, type, freeze(m), std::unordered_set<gms::inet_address>({target}, 1), {}, {});
+    }).then([this] (std::vector<unique_response_handler> ids) {
+        return mutate_begin(std::move(ids), db::consistency_level::ONE);
+    }).then_wrapped([this, lc] (future<> f) {
+        return mutate_end(std::move(f), lc);
+    });
+}
+
 future<> storage_proxy::schedule_repair(std::unordered_map<gms::inet_address, std::vector<mutation>> diffs) {
     return parallel_for_each(diffs, [this] (std::pair<const gms::inet_address, std::vector<mutation>>& i) {
         auto type = i.second.size() == 1 ? db::write_type::SIMPLE : db::write_type::UNLOGGED_BATCH;
@@ -1542,6 +1569,7 @@ class digest_read_resolver : public abstract_read_resolver {
     size_t _cl_responses = 0;
     promise<foreign_ptr<lw_shared_ptr<query::result>>, bool> _cl_promise; // cl is reached
     bool _cl_reported = false;
+    gms::inet_address _cl_reached_by; // the replica whose response completed cl
     foreign_ptr<lw_shared_ptr<query::result>> _data_result;
     std::vector<query::result_digest> _digest_results;
     api::timestamp_type _last_modified = api::missing_timestamp;
@@ -1595,6 +1623,7 @@ class digest_read_resolver : public abstract_read_resolver {
             }
             if (_cl_responses >= _block_for && _data_result) {
                 _cl_reported = true;
+                _cl_reached_by = ep;
                 _cl_promise.set_value(std::move(_data_result), digests_match());
             }
         }
@@ -1618,6 +1647,9 @@ class digest_read_resolver : public abstract_read_resolver {
     api::timestamp_type last_modified() const {
         return _last_modified;
     }
+    gms::inet_address cl_reached_by() const {
+        return _cl_reached_by;
+    }
 };
 
 class data_read_resolver : public abstract_read_resolver {
@@ -2111,11 +2143,19 @@ class always_speculating_read_executor : public abstract_read_executor {
 // this executor sends request to an additional replica after some time below timeout
 class speculating_read_executor : public abstract_read_executor {
     timer<> _speculate_timer;
+    clock_type::duration _speculate_after;
+    digest_resolver_ptr _resolver;
+    bool _speculated = false;
 public:
-    using abstract_read_executor::abstract_read_executor;
+    speculating_read_executor(schema_ptr s, shared_ptr<storage_proxy> proxy, lw_shared_ptr<query::read_command> cmd, query::partition_range pr, db::consistency_level cl, size_t block_for,
+            std::vector<gms::inet_address> targets, clock_type::duration speculate_after) :
+                abstract_read_executor(std::move(s), std::move(proxy), std::move(cmd), std::move(pr), cl, block_for, std::move(targets)), _speculate_after(speculate_after) {}
     virtual future<> make_requests(digest_resolver_ptr resolver, std::chrono::steady_clock::time_point timeout) {
+        _resolver = resolver;
         _speculate_timer.set_callback([this, resolver, timeout] {
             if (!resolver->is_completed()) { // at the time the callback runs request may be completed already
+                _speculated = true;
+                _proxy->_stats.speculative_retries++;
                 resolver->add_wait_targets(1); // we send one more request so wait for it too
                 future<> f = resolver->has_data() ?
                         make_digest_requests(resolver, _targets.end() - 1, _targets.end(), timeout) :
@@ -2123,9 +2163,7 @@ class speculating_read_executor : public abstract_read_executor {
                 f.finally([exec = shared_from_this()]{});
             }
         });
-        // FIXME: the timeout should come from previous latency statistics for a partition
-        auto speculate_timeout = std::chrono::steady_clock::now() + std::chrono::milliseconds(_proxy->get_db().local().get_config().read_request_timeout_in_ms()/2);
-        _speculate_timer.arm(speculate_timeout);
+        _speculate_timer.arm(_speculate_after);
 
         // if CL + RR result in covering all replicas, getReadExecutor forces AlwaysSpeculating.  So we know
         // that the last replica in our list is "extra."
@@ -2145,6 +2183,11 @@ class speculating_read_executor : public abstract_read_executor {
     }
     virtual void got_cl() override {
         _speculate_timer.cancel();
+        // The extra replica is the last target. If its response is the one
+        // that completed cl, speculating saved us from waiting any longer.
+        if (_speculated && _resolver->cl_reached_by() == _targets.back()) {
+            _proxy->_stats.speculative_retries_won++;
+        }
     }
 };
 
@@ -2189,9 +2232,6 @@ ::shared_ptr<abstract_read_executor> storage_proxy::get_read_executor(lw_shared_
         _stats.read_repair_attempts++;
     }
 
-#if 0
-    ColumnFamilyStore cfs = keyspace.getColumnFamilyStore(command.cfName);
-#endif
     speculative_retry::type retry_type = schema->speculative_retry().get_type();
 
     size_t block_for = db::block_for(ks, cl);
@@ -2225,7 +2265,26 @@ ::shared_ptr<abstract_read_executor> storage_proxy::get_read_executor(lw_shared_
     if (retry_type == speculative_retry::type::ALWAYS) {
         return ::make_shared<always_speculating_read_executor>(schema, p, cmd, std::move(pr), cl, block_for, std::move(target_replicas));
     } else {// PERCENTILE or CUSTOM.
-        return ::make_shared<speculating_read_executor>(schema, p, cmd, std::move(pr), cl, block_for, std::move(target_replicas));
+        std::chrono::steady_clock::duration read_timeout = std::chrono::milliseconds(_db.local().get_config().read_request_timeout_in_ms());
+        // Until there are latency statistics to go by.
+        std::chrono::steady_clock::duration speculate_after = read_timeout / 2;
+        // Delays are clamped to the timeout before being converted to
+        // steady_clock's resolution, which they could overflow.
+        if (retry_type == speculative_retry::type::CUSTOM) {
+            auto custom = std::chrono::duration<double, std::milli>(schema->speculative_retry().get_value());
+            speculate_after = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::min(custom, std::chrono::duration<double, std::milli>(read_timeout)));
+        } else {
+            auto& cf = _db.local().find_column_family(schema->id());
+            // The percentile is INT64_MAX when it falls in the overflow bucket
+            // of the latency histogram.
+            auto latency = cf.get_coordinator_read_latency_percentile(schema->speculative_retry().get_value());
+            if (latency.count()) {
+                speculate_after = std::min(latency, std::chrono::duration_cast<std::chrono::microseconds>(read_timeout));
+            }
+        }
+        speculate_after = std::min(speculate_after, read_timeout);
+        return ::make_shared<speculating_read_executor>(schema, p, cmd, std::move(pr), cl, block_for, std::move(target_replicas), speculate_after);
     }
 }
 
@@ -2273,9 +2332,17 @@ storage_proxy::query_singular(lw_shared_ptr<query::read_command> cmd, std::vecto
     query::result_merger merger;
     merger.reserve(exec.size());
 
+    auto start = std::chrono::steady_clock::now();
     auto f = ::map_reduce(exec.begin(), exec.end(), [timeout] (::shared_ptr<abstract_read_executor>& rex) {
         return rex->execute(timeout);
-    }, std::move(merger));
+    }, std::move(merger)).then([p = shared_from_this(), cf_id = cmd->cf_id, start] (foreign_ptr<lw_shared_ptr<query::result>> result) {
+        // Feeds the percentile based speculative retry.
+        auto& db = p->_db.local();
+        if (db.column_family_exists(cf_id)) {
+            db.find_column_family(cf_id).add_coordinator_read_latency(std::chrono::steady_clock::now() - start);
+        }
+        return std::move(result);
+    });
 
     return f.handle_exception([exec = std::move(exec), p = shared_from_this()] (std::exception_ptr eptr) {
         // hold onto exec until read is complete
@@ -2450,6 +2517,12 @@ storage_proxy::do_query(schema_ptr s,
     lc.start();
     auto p = shared_from_this();
 
+    // All replicas must compute the digest the same way, so the cheaper
+    // hash is only requested once every node supports it.
+    if (get_local_storage_service().cluster_supports_murmur3_digest()) {
+        cmd->slice.options.set<query::partition_slice::option::murmur3_digest>();
+    }
+
     if (query::is_single_partition(partition_ranges[0])) { // do not support mixed partitions (yet?)
         try {
             return query_singular(cmd, std::move(partition_ranges), cl).finally([lc, p] () mutable {
@@ -2712,32 +2785,20 @@ bool storage_proxy::should_hint(gms::inet_address ep) noexcept {
         return false;
     }
 
-    return false;
-#if 0
-    if (DatabaseDescriptor.shouldHintByDC())
-    {
-        final String dc = DatabaseDescriptor.getEndpointSnitch().getDatacenter(ep);
-        //Disable DC specific hints
-        if(!DatabaseDescriptor.hintedHandoffEnabled(dc))
-        {
-            HintedHandOffManager.instance.metrics.incrPastWindow(ep);
-            return false;
-        }
-    }
-    else if (!DatabaseDescriptor.hintedHandoffEnabled())
-    {
-        HintedHandOffManager.instance.metrics.incrPastWindow(ep);
+    auto& cfg = _db.local().get_config();
+    if (!cfg.hinted_handoff_enabled()) {
+        db::hints::get_local_manager().note_not_stored(ep);
         return false;
     }
 
-    boolean hintWindowExpired = Gossiper.instance.getEndpointDowntime(ep) > DatabaseDescriptor.getMaxHintWindow();
-    if (hintWindowExpired)
-    {
-        HintedHandOffManager.instance.metrics.incrPastWindow(ep);
-        Tracing.trace("Not hinting {} which has been down {}ms", ep, Gossiper.instance.getEndpointDowntime(ep));
+    auto downtime = std::chrono::microseconds(gms::get_local_gossiper().get_endpoint_downtime(ep));
+    if (downtime > std::chrono::milliseconds(cfg.max_hint_window_in_ms())) {
+        db::hints::get_local_manager().note_not_stored(ep);
+        logger.trace("Not hinting {} which has been down {}ms", ep,
+                std::chrono::duration_cast<std::chrono::milliseconds>(downtime).count());
+        return false;
     }
-    return !hintWindowExpired;
-#endif
+    return true;
 }
 
 future<> storage_proxy::truncate_blocking(sstring keyspace, sstring cfname) {
@@ -149,6 +149,8 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy> /*imp
         uint64_t reads = 0;
         uint64_t background_reads = 0; // client no longer waits for the read
         uint64_t read_retries = 0; // read is retried with new limit
+        uint64_t speculative_retries = 0; // an extra replica was queried because the read was slow
+        uint64_t speculative_retries_won = 0; // the extra replica's response completed the read
 
         // Data read attempts
         split_stats data_read_attempts;
@@ -202,12 +204,12 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy> /*imp
     response_id_type create_write_response_handler(const mutation&, db::consistency_level cl, db::write_type type);
     void send_to_live_endpoints(response_id_type response_id, clock_type::time_point timeout);
     template<typename Range>
-    size_t hint_to_dead_endpoints(lw_shared_ptr<const frozen_mutation> m, const Range& targets) noexcept;
+    size_t hint_to_dead_endpoints(const schema_ptr& s, lw_shared_ptr<const frozen_mutation> m, const Range& targets) noexcept;
     void hint_to_dead_endpoints(response_id_type, db::consistency_level);
     bool cannot_hint(gms::inet_address target);
     size_t get_hints_in_progress_for(gms::inet_address target);
     bool should_hint(gms::inet_address ep) noexcept;
-    bool submit_hint(lw_shared_ptr<const frozen_mutation> m, gms::inet_address target);
+    bool submit_hint(const schema_ptr& s, lw_shared_ptr<const frozen_mutation> m, gms::inet_address target);
     std::vector<gms::inet_address> get_live_sorted_endpoints(keyspace& ks, const dht::token& token);
     db::read_repair_decision new_read_repair_decision(const schema& s);
     ::shared_ptr<abstract_read_executor> get_read_executor(lw_shared_ptr<query::read_command> cmd, query::partition_range pr, db::consistency_level cl);
@@ -250,6 +252,13 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy> /*imp
     future<> mutate_locally(std::vector<mutation> mutations);
 
     future<> mutate_streaming_mutation(const schema_ptr&, const frozen_mutation& m);
+    // Applies a batch of streamed mutations sharing a schema, with one
+    // call into each shard owning some of them.
+    future<> mutate_streaming_mutations(const schema_ptr&, const std::vector<const frozen_mutation*>& ms);
+
+    // Sends a mutation to a single endpoint, regardless of whether it is a
+    // replica of it. Used to deliver hints, so a failure is not hinted again.
+    future<> send_to_endpoint(mutation m, gms::inet_address target, db::write_type type);
 
     /**
     * Use this method to have these Mutations applied
@@ -313,6 +322,7 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy> /*imp
     }
 
     friend class abstract_read_executor;
+    friend class speculating_read_executor;
     friend class abstract_write_response_handler;
 };
 
@@ -79,6 +79,10 @@ namespace service {
 static logging::logger logger("storage_service");
 
 static const sstring RANGE_TOMBSTONES_FEATURE = "RANGE_TOMBSTONES";
+static const sstring REPAIR_CHECKSUM_TREE_FEATURE = "REPAIR_CHECKSUM_TREE";
+static const sstring MURMUR3_DIGEST_FEATURE = "MURMUR3_DIGEST";
+static const sstring STREAM_MUTATION_BATCH_FEATURE = "STREAM_MUTATION_BATCH";
+static const sstring STREAM_SSTABLE_FILES_FEATURE = "STREAM_SSTABLE_FILES";
 
 distributed<storage_service> _the_storage_service;
 
@@ -97,7 +101,8 @@ sstring storage_service::get_config_supported_features() {
     // Add features supported by this local node. When a new feature is
     // introduced in scylla, update it here, e.g.,
     // return sstring("FEATURE1,FEATURE2")
-    return RANGE_TOMBSTONES_FEATURE;
+    return RANGE_TOMBSTONES_FEATURE + "," + REPAIR_CHECKSUM_TREE_FEATURE + "," + MURMUR3_DIGEST_FEATURE + ","
+            + STREAM_MUTATION_BATCH_FEATURE + "," + STREAM_SSTABLE_FILES_FEATURE;
 }
 
 std::set<inet_address> get_seeds() {
@@ -1153,6 +1158,10 @@ future<> storage_service::init_server(int delay) {
 
         get_storage_service().invoke_on_all([] (auto& ss) {
             ss._range_tombstones_feature = gms::feature(RANGE_TOMBSTONES_FEATURE);
+            ss._repair_checksum_tree_feature = gms::feature(REPAIR_CHECKSUM_TREE_FEATURE);
+            ss._murmur3_digest_feature = gms::feature(MURMUR3_DIGEST_FEATURE);
+            ss._stream_mutation_batch_feature = gms::feature(STREAM_MUTATION_BATCH_FEATURE);
+            ss._stream_sstable_files_feature = gms::feature(STREAM_SSTABLE_FILES_FEATURE);
         }).get();
     });
 }
@@ -1799,9 +1808,14 @@ future<> storage_service::start_native_transport() {
         auto ceo = cfg.client_encryption_options();
         auto keepalive = cfg.rpc_keepalive();
         transport::cql_load_balance lb = transport::parse_load_balance(cfg.load_balance());
-        return dns::gethostbyname(addr).then([cserver, addr, port, lb, keepalive, ceo = std::move(ceo)] (dns::hostent e) {
+        size_t compression_threshold = cfg.native_transport_compression_threshold();
+        transport::admission_controller::config admission_cfg;
+        admission_cfg.max_in_flight_reads = cfg.native_transport_max_in_flight_reads();
+        admission_cfg.max_in_flight_writes = cfg.native_transport_max_in_flight_writes();
+        admission_cfg.max_latency = std::chrono::milliseconds(cfg.native_transport_max_latency_in_ms());
+        return dns::gethostbyname(addr).then([cserver, addr, port, lb, compression_threshold, admission_cfg, keepalive, ceo = std::move(ceo)] (dns::hostent e) {
             auto ip = e.addresses[0].in.s_addr;
-            return cserver->start(std::ref(service::get_storage_proxy()), std::ref(cql3::get_query_processor()), lb).then([cserver, port, addr, ip, ceo, keepalive]() {
+            return cserver->start(std::ref(*cserver), std::ref(service::get_storage_proxy()), std::ref(cql3::get_query_processor()), lb, compression_threshold, admission_cfg).then([cserver, port, addr, ip, ceo, keepalive]() {
                 // #293 - do not stop anything
                 //engine().at_exit([cserver] {
                 //    return cserver->stop();
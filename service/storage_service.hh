@@ -268,6 +268,10 @@ class storage_service : public service::migration_listener, public gms::i_endpoi
     std::unordered_set<token> _bootstrap_tokens;
 
     gms::feature _range_tombstones_feature;
+    gms::feature _repair_checksum_tree_feature;
+    gms::feature _murmur3_digest_feature;
+    gms::feature _stream_mutation_batch_feature;
+    gms::feature _stream_sstable_files_feature;
 
 public:
     void finish_bootstrapping() {
@@ -2363,6 +2367,22 @@ class storage_service : public service::migration_listener, public gms::i_endpoi
     bool cluster_supports_range_tombstones() {
         return bool(_range_tombstones_feature);
     }
+
+    bool cluster_supports_repair_checksum_tree() {
+        return bool(_repair_checksum_tree_feature);
+    }
+
+    bool cluster_supports_murmur3_digest() {
+        return bool(_murmur3_digest_feature);
+    }
+
+    bool cluster_supports_stream_mutation_batch() {
+        return bool(_stream_mutation_batch_feature);
+    }
+
+    bool cluster_supports_stream_sstable_files() {
+        return bool(_stream_sstable_files_feature);
+    }
 };
 
 inline future<> init_storage_service(distributed<database>& db) {
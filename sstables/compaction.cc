@@ -38,17 +38,20 @@
  */
 
 #include <vector>
+#include <deque>
 #include <map>
 #include <functional>
+#include <unordered_set>
 #include <utility>
 #include <assert.h>
 #include <algorithm>
 
 #include <boost/range/algorithm.hpp>
 #include <boost/range/adaptors.hpp>
+#include <boost/range/irange.hpp>
+#include <boost/algorithm/cxx11/all_of.hpp>
 
 #include "core/future-util.hh"
-#include "core/pipe.hh"
 
 #include "sstables.hh"
 #include "compaction.hh"
@@ -65,23 +68,118 @@ namespace sstables {
 
 logging::logger logger("compaction");
 
-class sstable_reader final : public ::mutation_reader::impl {
+class sstable_reader final : public ::streamed_mutation_reader::impl {
     shared_sstable _sst;
-    mutation_reader _reader;
+    std::experimental::optional<::streamed_mutation_reader> _reader;
 public:
-    sstable_reader(shared_sstable sst, schema_ptr schema)
+    sstable_reader(shared_sstable sst, schema_ptr schema, const query::partition_range& range)
             : _sst(std::move(sst))
-            , _reader(_sst->read_rows(schema, service::get_local_compaction_priority()))
+            , _reader(_sst->read_range_rows_streamed(schema, range, query::no_clustering_key_filtering,
+                    service::get_local_compaction_priority()))
             {}
-    virtual future<mutation_opt> operator()() override {
-        return _reader.read().handle_exception([sst = _sst] (auto ep) {
+    virtual future<streamed_mutation_opt> operator()() override {
+        if (!_reader) {
+            return make_ready_future<streamed_mutation_opt>();
+        }
+        return (*_reader)().then([this] (streamed_mutation_opt sm) {
+            if (!sm) {
+                // Let go of the sstable once it's read, so that its files
+                // are closed as soon as an incremental compaction releases it.
+                _reader = { };
+                _sst = { };
+            }
+            return std::move(sm);
+        }).handle_exception([sst = _sst] (auto ep) {
             logger.error("Compaction found an exception when reading sstable {} : {}",
                     sst->get_filename(), ep);
-            return make_exception_future<mutation_opt>(ep);
+            return make_exception_future<streamed_mutation_opt>(ep);
         });
     }
 };
 
+// Compacts the fragments of a partition as they are read, the way
+// mutation_partition::compact_for_compaction() compacts whole partitions,
+// so that compaction doesn't need to hold whole partitions in memory.
+class compacted_streamed_mutation final : public streamed_mutation::impl {
+    streamed_mutation _sm;
+    gc_clock::time_point _now;
+    api::timestamp_type _max_purgeable;
+    gc_clock::time_point _gc_before;
+    // Tombstones still shadow the data they cover even if they are purged
+    // themselves.
+    tombstone _shadowing_tombstone;
+    range_tombstone_list _range_tombstones;
+private:
+    bool can_purge_tombstone(const tombstone& t) const {
+        return t.timestamp < _max_purgeable && t.deletion_time < _gc_before;
+    }
+
+    void consume(mutation_fragment&& mf) {
+        if (mf.is_static_row()) {
+            auto& sr = mf.as_static_row();
+            sr.cells().compact_and_expire(*_schema, column_kind::static_column, _shadowing_tombstone,
+                _now, _max_purgeable, _gc_before);
+            if (!sr.empty()) {
+                push_mutation_fragment(std::move(mf));
+            }
+        } else if (mf.is_range_tombstone()) {
+            auto& rt = mf.as_range_tombstone();
+            if (rt.tomb.timestamp <= _shadowing_tombstone.timestamp) {
+                return;
+            }
+            _range_tombstones.apply(*_schema, rt);
+            if (!can_purge_tombstone(rt.tomb)) {
+                push_mutation_fragment(std::move(mf));
+            }
+        } else {
+            auto& cr = mf.as_clustering_row();
+            auto tomb = _shadowing_tombstone;
+            tomb.apply(_range_tombstones.search_tombstone_covering(*_schema, cr.key()));
+            tomb.apply(cr.tomb());
+            cr.cells().compact_and_expire(*_schema, column_kind::regular_column, tomb, _now, _max_purgeable, _gc_before);
+            cr.marker().compact_and_expire(tomb, _now, _max_purgeable, _gc_before);
+            if (can_purge_tombstone(cr.tomb())) {
+                cr.as_deletable_row().remove_tombstone();
+            }
+            if (!cr.empty()) {
+                push_mutation_fragment(std::move(mf));
+            }
+        }
+    }
+public:
+    compacted_streamed_mutation(streamed_mutation sm, gc_clock::time_point now, api::timestamp_type max_purgeable)
+        : streamed_mutation::impl(sm.schema(), sm.decorated_key(), sm.partition_tombstone())
+        , _sm(std::move(sm))
+        , _now(now)
+        , _max_purgeable(max_purgeable)
+        , _gc_before(now - _schema->gc_grace_seconds())
+        , _shadowing_tombstone(_partition_tombstone)
+        , _range_tombstones(*_schema)
+    {
+        if (can_purge_tombstone(_partition_tombstone)) {
+            _partition_tombstone = tombstone();
+        }
+    }
+
+    virtual future<> fill_buffer() override {
+        return repeat([this] {
+            return _sm().then([this] (mutation_fragment_opt mf) {
+                if (!mf) {
+                    _end_of_stream = true;
+                    return stop_iteration::yes;
+                }
+                consume(std::move(*mf));
+                return is_buffer_full() ? stop_iteration::yes : stop_iteration::no;
+            });
+        });
+    }
+
+    // Nothing is left of the partition after compaction.
+    bool empty() const {
+        return is_end_of_stream() && is_buffer_empty() && !_partition_tombstone;
+    }
+};
+
 static api::timestamp_type get_max_purgeable_timestamp(schema_ptr schema,
     const std::vector<shared_sstable>& not_compacted_sstables, const dht::decorated_key& dk)
 {
@@ -94,6 +192,37 @@ static api::timestamp_type get_max_purgeable_timestamp(schema_ptr schema,
     return timestamp;
 }
 
+std::vector<shared_sstable>
+get_fully_expired_sstables(column_family& cf, const std::vector<shared_sstable>& candidates, gc_clock::time_point gc_before) {
+    std::unordered_set<shared_sstable> candidates_set(candidates.begin(), candidates.end());
+    // Tombstones of an expired sstable may still shadow older data in other
+    // sstables or in the memtables, in which case it has to go through a
+    // regular compaction.
+    auto min_timestamp = cf.min_memtable_timestamp();
+    for (auto&& sst : *cf.get_sstables_including_compacted_undeleted() | boost::adaptors::map_values) {
+        if (!candidates_set.count(sst)) {
+            min_timestamp = std::min(min_timestamp, sst->get_stats_metadata().min_timestamp);
+        }
+    }
+
+    // Data in the other expired candidates is dead anyway, so shadowing
+    // it doesn't matter.
+    std::vector<shared_sstable> expired;
+    auto gc_before_seconds = uint64_t(gc_before.time_since_epoch().count());
+    for (auto&& sst : candidates) {
+        if (sst->get_stats_metadata().max_local_deletion_time < gc_before_seconds) {
+            expired.push_back(sst);
+        } else {
+            min_timestamp = std::min(min_timestamp, sst->get_stats_metadata().min_timestamp);
+        }
+    }
+
+    expired.erase(std::remove_if(expired.begin(), expired.end(), [min_timestamp] (const shared_sstable& sst) {
+        return sst->get_stats_metadata().max_timestamp >= min_timestamp;
+    }), expired.end());
+    return expired;
+}
+
 static bool belongs_to_current_node(const dht::token& t, const std::vector<range<dht::token>>& sorted_owned_ranges) {
     auto low = std::lower_bound(sorted_owned_ranges.begin(), sorted_owned_ranges.end(), t,
             [] (const range<dht::token>& a, const dht::token& b) {
@@ -109,6 +238,93 @@ static bool belongs_to_current_node(const dht::token& t, const std::vector<range
     return false;
 }
 
+// Splits the token span of the sstables into at most n sub-ranges holding
+// about the same number of partitions, using the keys sampled in the
+// summaries as an estimate of the distribution of partitions.
+static std::vector<query::partition_range>
+split_for_parallel_compaction(const std::vector<shared_sstable>& sstables, unsigned n) {
+    if (n <= 1) {
+        return { query::full_partition_range };
+    }
+    std::vector<dht::token> tokens;
+    for (auto&& sst : sstables) {
+        for (auto&& e : sst->get_summary().entries) {
+            tokens.push_back(dht::global_partitioner().get_token(e.get_key()));
+        }
+    }
+    boost::sort(tokens);
+
+    std::vector<dht::token> split_points;
+    for (unsigned i = 1; i < n && !tokens.empty(); ++i) {
+        auto& t = tokens[tokens.size() * i / n];
+        if (split_points.empty() || split_points.back() < t) {
+            split_points.push_back(t);
+        }
+    }
+    if (split_points.empty()) {
+        return { query::full_partition_range };
+    }
+
+    // Sub-ranges end after all the keys of a split token, so that they
+    // don't overlap and produce sstables which don't overlap either.
+    std::vector<query::partition_range> ranges;
+    ranges.push_back(query::partition_range::make_ending_with({dht::ring_position::ending_at(split_points.front()), true}));
+    for (size_t i = 1; i < split_points.size(); ++i) {
+        ranges.push_back(query::partition_range::make({dht::ring_position::ending_at(split_points[i - 1]), false},
+                {dht::ring_position::ending_at(split_points[i]), true}));
+    }
+    ranges.push_back(query::partition_range::make_starting_with({dht::ring_position::ending_at(split_points.back()), false}));
+    return ranges;
+}
+
+static std::experimental::optional<hll::HyperLogLog> cardinality_estimator(const shared_sstable& sst) {
+    if (!sst->has_compaction_metadata()) {
+        return {};
+    }
+    auto& cardinality = sst->get_compaction_metadata().cardinality.elements;
+    if (cardinality.empty()) {
+        return {};
+    }
+    temporary_buffer<uint8_t> bytes(cardinality.size());
+    std::copy(cardinality.begin(), cardinality.end(), bytes.get_write());
+    try {
+        return hll::HyperLogLog::from_bytes(std::move(bytes));
+    } catch (std::invalid_argument& e) {
+        logger.debug("Ignoring the cardinality of {}: {}", sst->get_filename(), e.what());
+        return {};
+    }
+}
+
+// Estimates the number of partitions the sstables hold together, merging
+// the cardinality estimators of their compaction metadata, so that keys
+// present in several of them are only counted once. Sstables without a
+// usable estimator are counted for their own number of keys. The estimate
+// is kept between the largest sstable's and the sum of their numbers of keys.
+static uint64_t estimate_merged_partitions(const std::vector<shared_sstable>& sstables) {
+    std::experimental::optional<hll::HyperLogLog> merged;
+    uint64_t not_merged = 0;
+    uint64_t sum = 0;
+    uint64_t largest = 0;
+    for (auto& sst : sstables) {
+        auto keys = sst->get_estimated_key_count();
+        sum += keys;
+        largest = std::max(largest, keys);
+        auto estimator = cardinality_estimator(sst);
+        if (!estimator || (merged && merged->registerSize() != estimator->registerSize())) {
+            not_merged += keys;
+        } else if (!merged) {
+            merged = std::move(estimator);
+        } else {
+            merged->merge(*estimator);
+        }
+    }
+    if (!merged) {
+        return sum;
+    }
+    auto estimate = uint64_t(ceil(merged->estimate())) + not_merged;
+    return std::min(sum, std::max(largest, estimate));
+}
+
 static void delete_sstables_for_interrupted_compaction(std::vector<shared_sstable>& new_sstables, sstring& ks, sstring& cf) {
     // Delete either partially or fully written sstables of a compaction that
     // was either stopped abruptly (e.g. out of disk space) or deliberately
@@ -119,14 +335,206 @@ static void delete_sstables_for_interrupted_compaction(std::vector<shared_sstabl
     }
 }
 
-// compact_sstables compacts the given list of sstables creating one
-// (currently) or more (in the future) new sstables. The new sstables
-// are created using the "sstable_creator" object passed by the caller.
+// Releases the outputs of an incremental compaction, and the inputs whose
+// data they hold, while the compaction is still running.
+//
+// The outputs of each sub-range are sealed in key order, so an input whose
+// data within every sub-range precedes the last key sealed there is fully
+// written. Such inputs are released, so that their space can be reclaimed,
+// together with the outputs which hold their data. Outputs are only released
+// if they don't overlap any input which is kept, so that reads never see
+// data of a kept input next to its compacted version, where a purged
+// tombstone could no longer shadow it. Shared sstables are only released
+// by the end of the compaction.
+class incremental_release {
+    struct input {
+        shared_sstable sst;
+        dht::decorated_key first;
+        dht::decorated_key last;
+    };
+    struct sub_range {
+        query::partition_range range;
+        // Sealed outputs which weren't released yet, in key order, with
+        // their last key.
+        std::deque<std::pair<shared_sstable, dht::decorated_key>> sealed;
+        std::experimental::optional<dht::decorated_key> sealed_up_to;
+        std::experimental::optional<dht::decorated_key> released_up_to;
+        bool done = false;
+    };
+    schema_ptr _schema;
+    compaction_release_fn _release;
+    std::vector<input> _inputs;
+    std::vector<sub_range> _ranges;
+    std::unordered_set<shared_sstable> _released;
+private:
+    dht::decorated_key decorate(const partition_key& key) const {
+        return dht::global_partitioner().decorate_key(*_schema, key);
+    }
+
+    // Whether the data of the input within the sub-range is in outputs which
+    // are either all of those of the sub-range or end at up_to.
+    bool covered(const input& in, const sub_range& r, bool whole, const dht::decorated_key* up_to) const {
+        dht::ring_position_comparator cmp(*_schema);
+        if (r.range.before(dht::ring_position(in.last), cmp) || r.range.after(dht::ring_position(in.first), cmp)) {
+            return true;
+        }
+        return whole || (up_to && in.last.tri_compare(*_schema, *up_to) <= 0);
+    }
+
+    bool exhausted(const input& in) const {
+        return !in.sst->is_shared() && boost::algorithm::all_of(_ranges, [&] (const sub_range& r) {
+            return covered(in, r, r.done, r.sealed_up_to ? &*r.sealed_up_to : nullptr);
+        });
+    }
+
+    // Outputs of a sub-range which can be released if inputs from the
+    // frontier on are kept.
+    size_t releasable_outputs(const sub_range& r, const std::experimental::optional<dht::decorated_key>& frontier) const {
+        if (!frontier) {
+            return r.sealed.size();
+        }
+        return boost::range::find_if(r.sealed, [&] (auto& o) {
+            return !o.second.less_compare(*_schema, *frontier);
+        }) - r.sealed.begin();
+    }
+
+    bool releasable(const input& in, const std::experimental::optional<dht::decorated_key>& frontier) const {
+        return boost::algorithm::all_of(_ranges, [&] (const sub_range& r) {
+            auto n = releasable_outputs(r, frontier);
+            auto whole = r.done && n == r.sealed.size();
+            auto up_to = n ? &r.sealed[n - 1].second : (r.released_up_to ? &*r.released_up_to : nullptr);
+            return covered(in, r, whole, up_to);
+        });
+    }
+
+    void maybe_release() {
+        std::experimental::optional<dht::decorated_key> frontier;
+        std::vector<bool> kept(_inputs.size());
+        auto keep = [&] (size_t i) {
+            kept[i] = true;
+            if (!frontier || _inputs[i].first.less_compare(*_schema, *frontier)) {
+                frontier = _inputs[i].first;
+            }
+        };
+        for (size_t i = 0; i < _inputs.size(); ++i) {
+            if (!exhausted(_inputs[i])) {
+                keep(i);
+            }
+        }
+        // Keeping an input may hold back outputs which other inputs need.
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t i = 0; i < _inputs.size(); ++i) {
+                if (!kept[i] && !releasable(_inputs[i], frontier)) {
+                    keep(i);
+                    changed = true;
+                }
+            }
+        }
+        // Once no input is kept, the compaction is done with all of them,
+        // and replaces them when it returns.
+        if (boost::algorithm::all_of(kept, [] (bool k) { return k; }) || !frontier) {
+            return;
+        }
+
+        std::vector<shared_sstable> sealed;
+        for (auto& r : _ranges) {
+            auto n = releasable_outputs(r, frontier);
+            for (size_t i = 0; i < n; ++i) {
+                r.released_up_to = std::move(r.sealed.front().second);
+                sealed.push_back(std::move(r.sealed.front().first));
+                r.sealed.pop_front();
+            }
+        }
+        std::vector<shared_sstable> exhausted;
+        std::vector<input> inputs;
+        for (size_t i = 0; i < _inputs.size(); ++i) {
+            if (kept[i]) {
+                inputs.push_back(std::move(_inputs[i]));
+            } else {
+                exhausted.push_back(std::move(_inputs[i].sst));
+            }
+        }
+        _inputs = std::move(inputs);
+        _released.insert(sealed.begin(), sealed.end());
+        logger.debug("Releasing {} compacted sstable(s) and {} new sstable(s) of {}.{}", exhausted.size(), sealed.size(),
+                _schema->ks_name(), _schema->cf_name());
+        _release(std::move(sealed), std::move(exhausted));
+    }
+public:
+    incremental_release(schema_ptr schema, const std::vector<shared_sstable>& inputs,
+            const std::vector<query::partition_range>& ranges, compaction_release_fn release)
+        : _schema(std::move(schema))
+        , _release(std::move(release))
+    {
+        for (auto&& sst : inputs) {
+            _inputs.push_back({sst, decorate(sst->get_first_partition_key(*_schema)), decorate(sst->get_last_partition_key(*_schema))});
+        }
+        for (auto&& r : ranges) {
+            _ranges.push_back({r});
+        }
+    }
+
+    // An output of the given sub-range was written and opened.
+    void sealed(unsigned range, shared_sstable sst) {
+        auto& r = _ranges[range];
+        auto last = decorate(sst->get_last_partition_key(*_schema));
+        r.sealed_up_to = last;
+        r.sealed.emplace_back(std::move(sst), std::move(last));
+        maybe_release();
+    }
+
+    // All outputs of the given sub-range were written. What's left once
+    // all are is returned by the compaction rather than released.
+    void finished(unsigned range) {
+        _ranges[range].done = true;
+        if (!boost::algorithm::all_of(_ranges, [] (const sub_range& r) { return r.done; })) {
+            maybe_release();
+        }
+    }
+
+    bool released(const shared_sstable& sst) const {
+        return _released.count(sst);
+    }
+};
+
+static std::vector<shared_sstable>
+unreleased_sstables(const std::vector<shared_sstable>& sstables, const lw_shared_ptr<incremental_release>& releaser) {
+    std::vector<shared_sstable> unreleased;
+    boost::copy(sstables | boost::adaptors::filtered([&releaser] (const shared_sstable& sst) {
+        return !releaser || !releaser->released(sst);
+    }), std::back_inserter(unreleased));
+    return unreleased;
+}
+
+bool can_release_incrementally(const schema& s, const std::vector<shared_sstable>& sstables) {
+    // Some unshared input has to end before another one starts.
+    std::experimental::optional<dht::decorated_key> min_last;
+    std::experimental::optional<dht::decorated_key> max_first;
+    for (auto&& sst : sstables) {
+        auto first = dht::global_partitioner().decorate_key(s, sst->get_first_partition_key(s));
+        if (!max_first || max_first->less_compare(s, first)) {
+            max_first = std::move(first);
+        }
+        if (sst->is_shared()) {
+            continue;
+        }
+        auto last = dht::global_partitioner().decorate_key(s, sst->get_last_partition_key(s));
+        if (!min_last || last.less_compare(s, *min_last)) {
+            min_last = std::move(last);
+        }
+    }
+    return min_last && min_last->less_compare(s, *max_first);
+}
+
+// compact_sstables compacts the given list of sstables creating one or
+// more new sstables. The new sstables are created using the
+// "sstable_creator" object passed by the caller.
 future<std::vector<shared_sstable>>
 compact_sstables(std::vector<shared_sstable> sstables, column_family& cf, std::function<shared_sstable()> creator,
-                 uint64_t max_sstable_size, uint32_t sstable_level, bool cleanup) {
-    std::vector<::mutation_reader> readers;
-    uint64_t estimated_partitions = 0;
+                 uint64_t max_sstable_size, uint32_t sstable_level, bool cleanup, unsigned parallelism,
+                 compaction_release_fn release) {
     auto ancestors = make_lw_shared<std::vector<unsigned long>>();
     auto info = make_lw_shared<compaction_info>();
     auto& cm = cf.get_compaction_manager();
@@ -152,12 +560,6 @@ compact_sstables(std::vector<shared_sstable> sstables, column_family& cf, std::f
 
     auto schema = cf.schema();
     for (auto sst : sstables) {
-        // We also capture the sstable, so we keep it alive while the read isn't done
-        readers.emplace_back(make_mutation_reader<sstable_reader>(sst, schema));
-        // FIXME: If the sstables have cardinality estimation bitmaps, use that
-        // for a better estimate for the number of partitions in the merged
-        // sstable than just adding up the lengths of individual sstables.
-        estimated_partitions += sst->get_estimated_key_count();
         info->total_partitions += sst->get_estimated_key_count();
         // Compacted sstable keeps track of its ancestors.
         ancestors->push_back(sst->generation());
@@ -173,52 +575,78 @@ compact_sstables(std::vector<shared_sstable> sstables, column_family& cf, std::f
         rp = std::max(rp, sst->get_stats_metadata().position);
     }
 
-    uint64_t estimated_sstables = std::max(1UL, uint64_t(ceil(double(info->start_size) / max_sstable_size)));
-    uint64_t partitions_per_sstable = ceil(double(estimated_partitions) / estimated_sstables);
+    // Sizes the bloom filters of the new sstables.
+    auto estimated_partitions = estimate_merged_partitions(sstables);
+
+    auto ranges = make_lw_shared<std::vector<query::partition_range>>(split_for_parallel_compaction(sstables, parallelism));
+    // Each sub-range holds about the same share of the partitions and data.
+    uint64_t range_size = info->start_size / ranges->size();
+    uint64_t estimated_sstables = std::max(1UL, uint64_t(ceil(double(range_size) / max_sstable_size)));
+    uint64_t partitions_per_sstable = ceil(double(estimated_partitions) / ranges->size() / estimated_sstables);
 
     sstable_logger_msg += "]";
     info->sstables = sstables.size();
     info->ks = schema->ks_name();
     info->cf = schema->cf_name();
-    logger.info("{} {}", (!cleanup) ? "Compacting" : "Cleaning", sstable_logger_msg);
+    logger.info("{} {}{}", (!cleanup) ? "Compacting" : "Cleaning", sstable_logger_msg,
+            ranges->size() > 1 ? sprint(" in %d sub-ranges", ranges->size()) : sstring());
+
+    lw_shared_ptr<incremental_release> releaser;
+    if (release) {
+        releaser = make_lw_shared<incremental_release>(schema, sstables, *ranges, std::move(release));
+    }
 
-    class compacting_reader final : public ::mutation_reader::impl {
+    class compacting_reader final : public ::streamed_mutation_reader::impl {
     private:
         schema_ptr _schema;
-        ::mutation_reader _reader;
+        ::streamed_mutation_reader _reader;
         std::vector<shared_sstable> _not_compacted_sstables;
         gc_clock::time_point _now;
         std::vector<range<dht::token>> _sorted_owned_ranges;
         bool _cleanup;
+        lw_shared_ptr<compaction_info> _info;
     public:
-        compacting_reader(schema_ptr schema, std::vector<::mutation_reader> readers, std::vector<shared_sstable> not_compacted_sstables,
-                std::vector<range<dht::token>> sorted_owned_ranges, bool cleanup)
+        compacting_reader(schema_ptr schema, std::vector<::streamed_mutation_reader> readers, std::vector<shared_sstable> not_compacted_sstables,
+                std::vector<range<dht::token>> sorted_owned_ranges, bool cleanup, lw_shared_ptr<compaction_info> info)
             : _schema(std::move(schema))
-            , _reader(make_combined_reader(std::move(readers)))
+            , _reader(make_combined_streamed_reader(std::move(readers)))
             , _not_compacted_sstables(std::move(not_compacted_sstables))
             , _now(gc_clock::now())
             , _sorted_owned_ranges(std::move(sorted_owned_ranges))
             , _cleanup(cleanup)
+            , _info(std::move(info))
         { }
 
-        virtual future<mutation_opt> operator()() override {
-            return _reader().then([this] (mutation_opt m) {
-                if (!bool(m)) {
-                    return make_ready_future<mutation_opt>(std::move(m));
+        virtual future<streamed_mutation_opt> operator()() override {
+            if (_info->is_stop_requested()) {
+                // Compaction manager will catch this exception and re-schedule the compaction.
+                throw compaction_stop_exception(_info->ks, _info->cf, _info->stop_requested);
+            }
+            return _reader().then([this] (streamed_mutation_opt sm) {
+                if (!bool(sm)) {
+                    return make_ready_future<streamed_mutation_opt>(std::move(sm));
                 }
                 // Filter out mutation that doesn't belong to current shard.
-                if (dht::shard_of(m->token()) != engine().cpu_id()) {
+                if (dht::shard_of(sm->token()) != engine().cpu_id()) {
                     return operator()();
                 }
-                if (_cleanup && !belongs_to_current_node(m->token(), _sorted_owned_ranges)) {
+                if (_cleanup && !belongs_to_current_node(sm->token(), _sorted_owned_ranges)) {
                     return operator()();
                 }
-                auto max_purgeable = get_max_purgeable_timestamp(_schema, _not_compacted_sstables, m->decorated_key());
-                m->partition().compact_for_compaction(*_schema, max_purgeable, _now);
-                if (!m->partition().empty()) {
-                    return make_ready_future<mutation_opt>(std::move(m));
-                }
-                return operator()();
+                auto max_purgeable = get_max_purgeable_timestamp(_schema, _not_compacted_sstables, sm->decorated_key());
+                auto c = std::make_unique<compacted_streamed_mutation>(std::move(*sm), _now, max_purgeable);
+                // Read until the first fragment which survives compaction,
+                // so that partitions with nothing left are dropped.
+                auto& cr = *c;
+                return do_until([&cr] { return !cr.is_buffer_empty() || cr.is_end_of_stream(); }, [&cr] {
+                    return cr.fill_buffer();
+                }).then([this, c = std::move(c)] () mutable {
+                    if (c->empty()) {
+                        return operator()();
+                    }
+                    _info->total_keys_written++;
+                    return make_ready_future<streamed_mutation_opt>(streamed_mutation(std::move(c)));
+                });
             });
         }
     };
@@ -226,116 +654,101 @@ compact_sstables(std::vector<shared_sstable> sstables, column_family& cf, std::f
     if (cleanup) {
         owned_ranges = service::get_local_storage_service().get_local_ranges(schema->ks_name());
     }
-    auto reader = make_mutation_reader<compacting_reader>(schema, std::move(readers), std::move(not_compacted_sstables),
-        std::move(owned_ranges), cleanup);
-
     auto start_time = db_clock::now();
 
-    // We use a fixed-sized pipe between the producer fiber (which reads the
-    // individual sstables and merges them) and the consumer fiber (which
-    // only writes to the sstable). Things would have worked without this
-    // pipe (the writing fiber would have also performed the reads), but we
-    // prefer to do less work in the writer (which is a seastar::thread),
-    // and also want the extra buffer to ensure we do fewer context switches
-    // to that seastar::thread.
-    // TODO: better tuning for the size of the pipe. Perhaps should take into
-    // account the size of the individual mutations?
-    seastar::pipe<mutation> output{16};
-    auto output_reader = make_lw_shared<seastar::pipe_reader<mutation>>(std::move(output.reader));
-    auto output_writer = make_lw_shared<seastar::pipe_writer<mutation>>(std::move(output.writer));
-
-    future<> read_done = repeat([output_writer, reader = std::move(reader), info] () mutable {
-        if (info->is_stop_requested()) {
-            // Compaction manager will catch this exception and re-schedule the compaction.
-            throw compaction_stop_exception(info->ks, info->cf, info->stop_requested);
-        }
-        return reader().then([output_writer, info] (auto mopt) {
-            if (mopt) {
-                info->total_keys_written++;
-                return output_writer->write(std::move(*mopt)).then([] {
-                    return make_ready_future<stop_iteration>(stop_iteration::no);
-                });
-            } else {
-                return make_ready_future<stop_iteration>(stop_iteration::yes);
+    // Passes on a partition which was already read from the compacting
+    // reader, followed by the rest of its partitions.
+    struct partition_queue_reader final : public ::streamed_mutation_reader::impl {
+        streamed_mutation_opt first;
+        lw_shared_ptr<::streamed_mutation_reader> reader;
+        partition_queue_reader(streamed_mutation first, lw_shared_ptr<::streamed_mutation_reader> reader)
+            : first(std::move(first)), reader(std::move(reader)) {}
+        virtual future<streamed_mutation_opt> operator()() override {
+            if (first) {
+                auto sm = std::move(first);
+                first = { };
+                return make_ready_future<streamed_mutation_opt>(std::move(sm));
             }
-        });
-    }).then([output_writer] {});
-
-    struct queue_reader final : public ::mutation_reader::impl {
-        lw_shared_ptr<seastar::pipe_reader<mutation>> pr;
-        queue_reader(lw_shared_ptr<seastar::pipe_reader<mutation>> pr) : pr(std::move(pr)) {}
-        virtual future<mutation_opt> operator()() override {
-            return pr->read().then([] (std::experimental::optional<mutation> m) mutable {
-                return make_ready_future<mutation_opt>(std::move(m));
-            });
+            return (*reader)();
         }
     };
 
     bool backup = cf.incremental_backups_enabled();
-    // If there is a maximum size for a sstable, it's possible that more than
-    // one sstable will be generated for all partitions to be written.
-    future<> write_done = repeat([creator, ancestors, rp, max_sstable_size, sstable_level, output_reader, info, partitions_per_sstable, schema, backup] {
-        return output_reader->read().then(
-                [creator, ancestors, rp, max_sstable_size, sstable_level, output_reader, info, partitions_per_sstable, schema, backup] (auto mut) {
-            // Check if mutation is available from the pipe for a new sstable to be written. If not, just stop writing.
-            if (!mut) {
-                return make_ready_future<stop_iteration>(stop_iteration::yes);
-            }
-            // If a mutation is available, we must unread it for write_components to read it afterwards.
-            output_reader->unread(std::move(*mut));
-
-            auto newtab = creator();
-            info->new_sstables.push_back(newtab);
-            newtab->get_metadata_collector().set_replay_position(rp);
-            newtab->get_metadata_collector().sstable_level(sstable_level);
-            for (auto ancestor : *ancestors) {
-                newtab->add_ancestor(ancestor);
-            }
+    // Partitions are compacted as they are read by the writer, one fragment
+    // at a time, so there is no need to buffer whole partitions between
+    // reading and writing. If there is a maximum size for a sstable, it's
+    // possible that more than one sstable will be generated for all
+    // partitions to be written.
+    //
+    // The sub-ranges are compacted concurrently, each by its own reader and
+    // writers, so that the reads and writes of one overlap with those of the
+    // others. The sstables written for different sub-ranges don't overlap.
+    auto compact_range = [sstables, not_compacted_sstables = std::move(not_compacted_sstables), owned_ranges = std::move(owned_ranges),
+            creator, ancestors, rp, max_sstable_size, sstable_level, info, partitions_per_sstable, schema, backup, cleanup, ranges, releaser]
+            (unsigned idx) {
+        auto& range = (*ranges)[idx];
+        std::vector<::streamed_mutation_reader> readers;
+        for (auto sst : sstables) {
+            // We also capture the sstable, so we keep it alive while the read isn't done
+            readers.emplace_back(make_streamed_mutation_reader<sstable_reader>(sst, schema, range));
+        }
+        auto reader = make_lw_shared<::streamed_mutation_reader>(make_streamed_mutation_reader<compacting_reader>(schema,
+            std::move(readers), not_compacted_sstables, owned_ranges, cleanup, info));
+
+        return repeat([creator, ancestors, rp, max_sstable_size, sstable_level, reader, info, partitions_per_sstable, schema, backup, releaser, idx] {
+            return (*reader)().then(
+                    [creator, ancestors, rp, max_sstable_size, sstable_level, reader, info, partitions_per_sstable, schema, backup, releaser, idx] (streamed_mutation_opt sm) {
+                // Check if a partition is available for a new sstable to be written. If not, just stop writing.
+                if (!sm) {
+                    return make_ready_future<stop_iteration>(stop_iteration::yes);
+                }
 
-            ::mutation_reader mutation_queue_reader = make_mutation_reader<queue_reader>(output_reader);
+                auto newtab = creator();
+                info->new_sstables.push_back(newtab);
+                newtab->get_metadata_collector().set_replay_position(rp);
+                newtab->get_metadata_collector().sstable_level(sstable_level);
+                for (auto ancestor : *ancestors) {
+                    newtab->add_ancestor(ancestor);
+                }
 
-            auto&& priority = service::get_local_compaction_priority();
-            return newtab->write_components(std::move(mutation_queue_reader), partitions_per_sstable, schema, max_sstable_size, backup, priority).then([newtab, info] {
-                return newtab->open_data().then([newtab, info] {
-                    info->end_size += newtab->data_size();
-                    return make_ready_future<stop_iteration>(stop_iteration::no);
+                auto partitions = make_streamed_mutation_reader<partition_queue_reader>(std::move(*sm), reader);
+
+                auto&& priority = service::get_local_compaction_priority();
+                return newtab->write_components(std::move(partitions), partitions_per_sstable, schema, max_sstable_size, backup, priority).then([newtab, info, releaser, idx] {
+                    return newtab->open_data().then([newtab, info, releaser, idx] {
+                        info->end_size += newtab->data_size();
+                        if (releaser) {
+                            releaser->sealed(idx, newtab);
+                        }
+                        return make_ready_future<stop_iteration>(stop_iteration::no);
+                    });
+                }).handle_exception([sst = newtab] (auto ep) {
+                    logger.error("Compaction found an exception when writing sstable {} : {}",
+                            sst->get_filename(), ep);
+                    return make_exception_future<stop_iteration>(ep);
                 });
-            }).handle_exception([sst = newtab] (auto ep) {
-                logger.error("Compaction found an exception when writing sstable {} : {}",
-                        sst->get_filename(), ep);
-                return make_exception_future<stop_iteration>(ep);
             });
+        }).then([releaser, idx] {
+            if (releaser) {
+                releaser->finished(idx);
+            }
         });
-    }).then([output_reader] {});
+    };
 
-    // Wait for both read_done and write_done fibers to finish.
-    return when_all(std::move(read_done), std::move(write_done)).then([&cm, info] (std::tuple<future<>, future<>> t) {
+    return parallel_for_each(boost::irange<unsigned>(0, ranges->size()), std::move(compact_range)).then_wrapped([&cm, info, releaser] (future<> f) {
         // deregister compaction_stats of finished compaction from compaction manager.
         cm.deregister_compaction(info);
 
-        sstring ex;
         try {
-            std::get<0>(t).get();
-        } catch(compaction_stop_exception& e) {
-
-            std::get<1>(t).ignore_ready_future(); // ignore result of write fiber if compaction was asked to stop.
-            delete_sstables_for_interrupted_compaction(info->new_sstables, info->ks, info->cf);
+            f.get();
+        } catch (compaction_stop_exception& e) {
+            auto new_sstables = unreleased_sstables(info->new_sstables, releaser);
+            delete_sstables_for_interrupted_compaction(new_sstables, info->ks, info->cf);
             throw;
-        } catch(...) {
-
-            ex += sprint("read exception: %s", std::current_exception());
-        }
-
-        try {
-            std::get<1>(t).get();
-        } catch(...) {
-            ex += sprint("%swrite_exception: %s", (ex.size() ? ", " : ""), std::current_exception());
-        }
-
-        if (ex.size()) {
-            delete_sstables_for_interrupted_compaction(info->new_sstables, info->ks, info->cf);
-
-            throw std::runtime_error(ex);
+        } catch (...) {
+            auto new_sstables = unreleased_sstables(info->new_sstables, releaser);
+            delete_sstables_for_interrupted_compaction(new_sstables, info->ks, info->cf);
+            throw std::runtime_error(sprint("compaction exception: %s", std::current_exception()));
         }
     }).then([start_time, info, cleanup] {
         double ratio = double(info->end_size) / double(info->start_size);
@@ -380,9 +793,9 @@ compact_sstables(std::vector<shared_sstable> sstables, column_family& cf, std::f
         // for example, by adding a reducer method.
         return db::system_keyspace::update_compaction_history(info->ks, info->cf, compacted_at,
                 info->start_size, info->end_size, std::unordered_map<int32_t, int64_t>{});
-    }).then([info] {
-        // Return vector with newly created sstable(s).
-        return std::move(info->new_sstables);
+    }).then([info, releaser] {
+        // Return vector with newly created sstable(s) which weren't released.
+        return unreleased_sstables(info->new_sstables, releaser);
     });
 }
 
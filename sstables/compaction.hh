@@ -27,6 +27,10 @@
 
 namespace sstables {
 
+    // Takes new sstables sealed by an incremental compaction, and the input
+    // sstables whose data they hold, to replace the latter with the former.
+    using compaction_release_fn = std::function<void (std::vector<shared_sstable> sealed, std::vector<shared_sstable> exhausted)>;
+
     struct compaction_descriptor {
         // List of sstables to be compacted.
         std::vector<sstables::shared_sstable> sstables;
@@ -34,6 +38,15 @@ namespace sstables {
         int level = 0;
         // Threshold size for sstable(s) to be created.
         uint64_t max_sstable_bytes = std::numeric_limits<uint64_t>::max();
+        // If set, the sstables only hold expired data and are dropped as
+        // they are, without being compacted. See get_fully_expired_sstables().
+        bool drop_expired = false;
+        // Number of token sub-ranges to be compacted concurrently, as
+        // granted by the compaction manager.
+        unsigned parallelism = 1;
+        // Called with the input sstables released by an incremental
+        // compaction, once they are replaced by its outputs.
+        std::function<void (const std::vector<sstables::shared_sstable>&)> on_release;
 
         compaction_descriptor() = default;
 
@@ -103,9 +116,26 @@ namespace sstables {
     // If cleanup is true, mutation that doesn't belong to current node will be
     // cleaned up, log messages will inform the user that compact_sstables runs for
     // cleaning operation, and compaction history will not be updated.
+    // If release is given, the compaction is incremental: outputs are passed
+    // to it as soon as they hold all the data of some inputs, together with
+    // those inputs, and only the new sstables which weren't released are
+    // returned. See incremental_release in compaction.cc.
+    // The token span of the sstables is split into up to parallelism
+    // sub-ranges, which are compacted concurrently into sstables that
+    // don't overlap. These share the compaction's ancestors, so that
+    // compaction strategies take them for a single run of sstables rather
+    // than for sstables to be compacted together.
     future<std::vector<shared_sstable>> compact_sstables(std::vector<shared_sstable> sstables,
             column_family& cf, std::function<shared_sstable()> creator,
-            uint64_t max_sstable_size, uint32_t sstable_level, bool cleanup = false);
+            uint64_t max_sstable_size, uint32_t sstable_level, bool cleanup = false, unsigned parallelism = 1,
+            compaction_release_fn release = {});
+
+    // Returns whether an incremental compaction of the sstables could
+    // release any of them before it is done. An input can only be released
+    // with outputs which overlap no input that is kept, so none can be if
+    // the inputs all overlap one another, as size-tiered inputs of a random
+    // partitioner usually do: all are then released at the end.
+    bool can_release_incrementally(const schema& s, const std::vector<shared_sstable>& sstables);
 
     // Return the most interesting bucket applying the size-tiered strategy.
     std::vector<sstables::shared_sstable>
@@ -113,4 +143,11 @@ namespace sstables {
 
     std::vector<sstables::shared_sstable>
     size_tiered_most_interesting_bucket(const std::list<sstables::shared_sstable>& candidates);
+
+    // Returns the sstables among candidates whose data all expired before
+    // gc_before, and which can't shadow data in any other sstable of the
+    // column family, so that they can be deleted without being compacted.
+    std::vector<sstables::shared_sstable>
+    get_fully_expired_sstables(column_family& cf, const std::vector<sstables::shared_sstable>& candidates,
+            gc_clock::time_point gc_before);
 }
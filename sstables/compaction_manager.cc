@@ -24,6 +24,7 @@
 #include "core/scollectd.hh"
 #include "exceptions.hh"
 #include <cmath>
+#include <boost/range/algorithm/remove_if.hpp>
 
 static logging::logger cmlog("compaction_manager");
 
@@ -112,6 +113,20 @@ void compaction_manager::deregister_weight(column_family* cf, int weight) {
     it->second.erase(weight);
 }
 
+unsigned compaction_manager::reserve_parallel_ranges(int weight) {
+    // Sub-ranges of compaction jobs lighter than that (about 1GB) aren't
+    // worth the additional sstables. Each step of weight above it allows
+    // for another sub-range.
+    static constexpr int MIN_WEIGHT_FOR_PARALLEL_RANGES = 15;
+
+    if (weight < MIN_WEIGHT_FOR_PARALLEL_RANGES || _parallel_ranges + 1 >= _max_parallel_ranges) {
+        return 1;
+    }
+    auto ranges = std::min(unsigned(weight - MIN_WEIGHT_FOR_PARALLEL_RANGES) + 2, _max_parallel_ranges - _parallel_ranges);
+    _parallel_ranges += ranges;
+    return ranges;
+}
+
 lw_shared_ptr<compaction_manager::task> compaction_manager::task_start(column_family* cf, bool cleanup) {
     // NOTE: Compaction code runs in parallel to the rest of the system.
     // When it's time to shutdown, we need to prevent any new compaction
@@ -149,14 +164,26 @@ lw_shared_ptr<compaction_manager::task> compaction_manager::task_start(column_fa
 
             sstables::compaction_descriptor descriptor;
             // Created to erase sstables from _compacting_sstables after compaction finishes.
-            std::vector<sstables::shared_sstable> sstables_to_compact;
+            auto sstables_to_compact = make_lw_shared<std::vector<sstables::shared_sstable>>();
             int weight = -1;
-            auto keep_track_of_compacting_sstables = [this, &sstables_to_compact, &descriptor] {
-                sstables_to_compact.reserve(descriptor.sstables.size());
+            unsigned parallelism = 1;
+            auto keep_track_of_compacting_sstables = [this, sstables_to_compact, &descriptor] {
+                sstables_to_compact->reserve(descriptor.sstables.size());
                 for (auto& sst : descriptor.sstables) {
-                    sstables_to_compact.push_back(sst);
+                    sstables_to_compact->push_back(sst);
                     _compacting_sstables.insert(sst);
                 }
+                // Inputs released by an incremental compaction are gone
+                // already, and mustn't be kept alive until it's done.
+                descriptor.on_release = [this, sstables_to_compact] (const std::vector<sstables::shared_sstable>& released) {
+                    for (auto& sst : released) {
+                        _compacting_sstables.erase(sst);
+                    }
+                    std::unordered_set<sstables::shared_sstable> s(released.begin(), released.end());
+                    sstables_to_compact->erase(boost::range::remove_if(*sstables_to_compact, [&s] (auto& sst) {
+                        return s.count(sst);
+                    }), sstables_to_compact->end());
+                };
             };
 
             future<> operation = make_ready_future<>();
@@ -176,8 +203,10 @@ lw_shared_ptr<compaction_manager::task> compaction_manager::task_start(column_fa
                     return make_ready_future<>();
                 }
                 keep_track_of_compacting_sstables();
-                cmlog.debug("Accepted compaction job ({} sstable(s)) of weight {} for {}.{}",
-                    descriptor.sstables.size(), weight, cf.schema()->ks_name(), cf.schema()->cf_name());
+                descriptor.parallelism = reserve_parallel_ranges(weight);
+                parallelism = descriptor.parallelism;
+                cmlog.debug("Accepted compaction job ({} sstable(s)) of weight {} in {} sub-range(s) for {}.{}",
+                    descriptor.sstables.size(), weight, parallelism, cf.schema()->ks_name(), cf.schema()->cf_name());
                 operation = cf.run_compaction(std::move(descriptor));
             }
 
@@ -187,14 +216,17 @@ lw_shared_ptr<compaction_manager::task> compaction_manager::task_start(column_fa
                 _stats.completed_tasks++;
                 task->compaction_retry.reset();
                 return make_ready_future<>();
-            }).finally([this, task, weight, sstables_to_compact = std::move(sstables_to_compact)] {
+            }).finally([this, task, weight, parallelism, sstables_to_compact] {
                 // Remove compacted sstables from the set of compacting sstables.
-                for (auto& sst : sstables_to_compact) {
+                for (auto& sst : *sstables_to_compact) {
                     _compacting_sstables.erase(sst);
                 }
                 if (weight != -1) {
                     deregister_weight(task->compacting_cf, weight);
                 }
+                if (parallelism > 1) {
+                    _parallel_ranges -= parallelism;
+                }
                 _stats.active_tasks--;
             });
         }).then_wrapped([this, task] (future<> f) {
@@ -31,6 +31,7 @@
 #include <vector>
 #include <list>
 #include <functional>
+#include <algorithm>
 #include "sstables/compaction.hh"
 
 class column_family;
@@ -73,6 +74,11 @@ class compaction_manager {
     // Keep track of weight of ongoing compaction for each column family.
     // That's used to allow parallel compaction on the same column family.
     std::unordered_map<column_family*, std::unordered_set<int>> _weight_tracker;
+
+    // Token sub-ranges which may be compacted concurrently on this shard,
+    // shared by all compaction jobs, and the number of those in use.
+    unsigned _max_parallel_ranges = 1;
+    unsigned _parallel_ranges = 0;
 private:
     lw_shared_ptr<task> task_start(column_family* cf, bool cleanup);
     future<> task_stop(lw_shared_ptr<task> task);
@@ -91,12 +97,21 @@ class compaction_manager {
     // weight is not taken or its size is equal to minimum threshold.
     // Return weight of compaction job.
     int trim_to_compact(column_family* cf, sstables::compaction_descriptor& descriptor);
+
+    // Returns the number of sub-ranges a compaction job of the given weight
+    // is split into, at least one, and reserves them until the job is done.
+    // Only heavy jobs are split, and no more than allowed in total.
+    unsigned reserve_parallel_ranges(int weight);
 public:
     compaction_manager();
     ~compaction_manager();
 
     void register_collectd_metrics();
 
+    void set_max_parallel_ranges(unsigned n) {
+        _max_parallel_ranges = std::max(n, 1U);
+    }
+
     // Start compaction manager.
     void start();
 
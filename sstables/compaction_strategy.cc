@@ -38,6 +38,11 @@
  */
 
 #include <vector>
+#include <deque>
+#include <map>
+
+#include <boost/range/algorithm/copy.hpp>
+#include <boost/range/adaptor/map.hpp>
 
 #include "sstables.hh"
 #include "compaction.hh"
@@ -52,13 +57,33 @@ namespace sstables {
 extern logging::logger logger;
 
 class compaction_strategy_impl {
+    static constexpr double DEFAULT_TOMBSTONE_THRESHOLD = 0.2;
+    static constexpr long DEFAULT_TOMBSTONE_COMPACTION_INTERVAL = 86400;
+    const sstring TOMBSTONE_THRESHOLD_OPTION = "tombstone_threshold";
+    const sstring TOMBSTONE_COMPACTION_INTERVAL_OPTION = "tombstone_compaction_interval";
+protected:
+    double _tombstone_threshold = DEFAULT_TOMBSTONE_THRESHOLD;
+    std::chrono::seconds _tombstone_compaction_interval = std::chrono::seconds(DEFAULT_TOMBSTONE_COMPACTION_INTERVAL);
 public:
+    compaction_strategy_impl() = default;
+    explicit compaction_strategy_impl(const std::map<sstring, sstring>& options);
     virtual ~compaction_strategy_impl() {}
     virtual compaction_descriptor get_sstables_for_compaction(column_family& cfs, std::vector<sstables::shared_sstable> candidates) = 0;
     virtual compaction_strategy_type type() const = 0;
     virtual bool parallel_compaction() const {
         return true;
     }
+protected:
+    // Whether compacting the sstable on its own is worth it to purge its
+    // tombstones: the estimated ratio of its droppable tombstones is over
+    // tombstone_threshold, it wasn't just written, and the sstables whose
+    // keys overlap with it only hold newer data, which the tombstones can't
+    // shadow.
+    bool worth_dropping_tombstones(column_family& cf, const sstables::shared_sstable& sst, gc_clock::time_point gc_before);
+
+    // Returns the candidate most worth compacting on its own to purge its
+    // tombstones, if any.
+    sstables::shared_sstable get_tombstone_compaction_candidate(column_family& cf, const std::vector<sstables::shared_sstable>& candidates);
 };
 
 //
@@ -187,35 +212,119 @@ class size_tiered_compaction_strategy_options {
     friend class size_tiered_compaction_strategy;
 };
 
+compaction_strategy_impl::compaction_strategy_impl(const std::map<sstring, sstring>& options) {
+    using namespace cql3::statements;
+
+    auto tmp_value = size_tiered_compaction_strategy_options::get_value(options, TOMBSTONE_THRESHOLD_OPTION);
+    _tombstone_threshold = property_definitions::to_double(TOMBSTONE_THRESHOLD_OPTION, tmp_value, DEFAULT_TOMBSTONE_THRESHOLD);
+
+    tmp_value = size_tiered_compaction_strategy_options::get_value(options, TOMBSTONE_COMPACTION_INTERVAL_OPTION);
+    _tombstone_compaction_interval = std::chrono::seconds(property_definitions::to_long(TOMBSTONE_COMPACTION_INTERVAL_OPTION, tmp_value,
+            DEFAULT_TOMBSTONE_COMPACTION_INTERVAL));
+}
+
+bool compaction_strategy_impl::worth_dropping_tombstones(column_family& cf, const sstables::shared_sstable& sst, gc_clock::time_point gc_before) {
+    if (gc_clock::now() - sst->max_data_age() < _tombstone_compaction_interval) {
+        return false;
+    }
+    if (sst->estimate_droppable_tombstone_ratio(gc_before) <= _tombstone_threshold) {
+        return false;
+    }
+    auto& s = *cf.schema();
+    auto first = sst->get_first_decorated_key(s);
+    auto last = sst->get_last_decorated_key(s);
+    auto max_timestamp = sst->get_stats_metadata().max_timestamp;
+    for (auto&& other : *cf.get_sstables() | boost::adaptors::map_values) {
+        if (other == sst || other->get_stats_metadata().min_timestamp > max_timestamp) {
+            continue;
+        }
+        auto other_first = other->get_first_decorated_key(s);
+        auto other_last = other->get_last_decorated_key(s);
+        if (!other_last.less_compare(s, first) && !last.less_compare(s, other_first)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+sstables::shared_sstable
+compaction_strategy_impl::get_tombstone_compaction_candidate(column_family& cf, const std::vector<sstables::shared_sstable>& candidates) {
+    auto gc_before = gc_clock::now() - cf.schema()->gc_grace_seconds();
+    sstables::shared_sstable best;
+    double best_ratio = 0;
+    for (auto&& sst : candidates) {
+        auto ratio = sst->estimate_droppable_tombstone_ratio(gc_before);
+        if (ratio > best_ratio && worth_dropping_tombstones(cf, sst, gc_before)) {
+            best = sst;
+            best_ratio = ratio;
+        }
+    }
+    return best;
+}
+
+// The sstables written by a compaction which split its output, into
+// sstables of bounded size or into sub-ranges, hold disjoint parts of it and
+// share its ancestors. Strategies treat such a run like a single sstable, or
+// they would find its parts worth compacting together again.
+using sstable_run = std::vector<sstables::shared_sstable>;
+
+// Groups the sstables into runs of those sharing their ancestors, each with
+// the total size of its data.
+static std::vector<std::pair<sstable_run, uint64_t>> group_into_runs(const std::vector<sstables::shared_sstable>& sstables) {
+    std::vector<std::pair<sstable_run, uint64_t>> runs;
+    runs.reserve(sstables.size());
+    std::map<std::deque<uint32_t>, size_t> runs_by_ancestors;
+
+    for (auto& sstable : sstables) {
+        auto sstable_size = sstable->data_size();
+        if (sstable->has_compaction_metadata() && !sstable->get_compaction_metadata().ancestors.elements.empty()) {
+            auto& ancestors = sstable->get_compaction_metadata().ancestors.elements;
+            auto it = runs_by_ancestors.find(ancestors);
+            if (it != runs_by_ancestors.end()) {
+                auto& p = runs[it->second];
+                p.first.push_back(sstable);
+                p.second += sstable_size;
+                continue;
+            }
+            runs_by_ancestors.emplace(ancestors, runs.size());
+        }
+        runs.emplace_back(sstable_run{sstable}, sstable_size);
+    }
+
+    return runs;
+}
+
 class size_tiered_compaction_strategy : public compaction_strategy_impl {
     size_tiered_compaction_strategy_options _options;
 
-    // Return a list of pair of shared_sstable and its respective size.
-    std::vector<std::pair<sstables::shared_sstable, uint64_t>> create_sstable_and_length_pairs(const std::vector<sstables::shared_sstable>& sstables);
+    // Runs are tiered like a single sstable of their total size.
+    using run = sstable_run;
 
-    // Group files of similar size into buckets.
-    std::vector<std::vector<sstables::shared_sstable>> get_buckets(const std::vector<sstables::shared_sstable>& sstables, unsigned max_threshold);
+    // Group runs of similar size into buckets.
+    std::vector<std::vector<run>> get_buckets(const std::vector<sstables::shared_sstable>& sstables, unsigned max_threshold);
 
     // Maybe return a bucket of sstables to compact
     std::vector<sstables::shared_sstable>
-    most_interesting_bucket(std::vector<std::vector<sstables::shared_sstable>> buckets, unsigned min_threshold, unsigned max_threshold);
+    most_interesting_bucket(std::vector<std::vector<run>> buckets, unsigned min_threshold, unsigned max_threshold);
 
-    // Return the average size of a given list of sstables.
-    uint64_t avg_size(std::vector<sstables::shared_sstable>& sstables) {
-        assert(sstables.size() > 0); // this should never fail
+    // Return the average size of a given list of runs.
+    uint64_t avg_size(std::vector<run>& runs) {
+        assert(runs.size() > 0); // this should never fail
         uint64_t n = 0;
 
-        for (auto& sstable : sstables) {
-            // FIXME: Switch to sstable->bytes_on_disk() afterwards. That's what C* uses.
-            n += sstable->data_size();
+        for (auto& r : runs) {
+            for (auto& sstable : r) {
+                // FIXME: Switch to sstable->bytes_on_disk() afterwards. That's what C* uses.
+                n += sstable->data_size();
+            }
         }
 
-        return n / sstables.size();
+        return n / runs.size();
     }
 public:
     size_tiered_compaction_strategy() = default;
     size_tiered_compaction_strategy(const std::map<sstring, sstring>& options) :
-        _options(options) {}
+        compaction_strategy_impl(options), _options(options) {}
 
     virtual compaction_descriptor get_sstables_for_compaction(column_family& cfs, std::vector<sstables::shared_sstable> candidates) override;
 
@@ -227,32 +336,16 @@ class size_tiered_compaction_strategy : public compaction_strategy_impl {
     }
 };
 
-std::vector<std::pair<sstables::shared_sstable, uint64_t>>
-size_tiered_compaction_strategy::create_sstable_and_length_pairs(const std::vector<sstables::shared_sstable>& sstables) {
-
-    std::vector<std::pair<sstables::shared_sstable, uint64_t>> sstable_length_pairs;
-    sstable_length_pairs.reserve(sstables.size());
-
-    for(auto& sstable : sstables) {
-        auto sstable_size = sstable->data_size();
-        assert(sstable_size != 0);
-
-        sstable_length_pairs.emplace_back(sstable, sstable_size);
-    }
-
-    return sstable_length_pairs;
-}
-
-std::vector<std::vector<sstables::shared_sstable>>
+std::vector<std::vector<size_tiered_compaction_strategy::run>>
 size_tiered_compaction_strategy::get_buckets(const std::vector<sstables::shared_sstable>& sstables, unsigned max_threshold) {
-    // sstables sorted by size of its data file.
-    auto sorted_sstables = create_sstable_and_length_pairs(sstables);
+    // runs sorted by size of their data files.
+    auto sorted_sstables = group_into_runs(sstables);
 
     std::sort(sorted_sstables.begin(), sorted_sstables.end(), [] (auto& i, auto& j) {
         return i.second < j.second;
     });
 
-    std::map<size_t, std::vector<sstables::shared_sstable>> buckets;
+    std::map<size_t, std::vector<run>> buckets;
 
     bool found;
     for (auto& pair : sorted_sstables) {
@@ -263,7 +356,7 @@ size_tiered_compaction_strategy::get_buckets(const std::vector<sstables::shared_
         // group in the same bucket if it's w/in 50% of the average for this bucket,
         // or this file and the bucket are all considered "small" (less than `minSSTableSize`)
         for (auto& entry : buckets) {
-            std::vector<sstables::shared_sstable> bucket = entry.second;
+            std::vector<run> bucket = entry.second;
             size_t old_average_size = entry.first;
 
             if (((size > (old_average_size * _options.bucket_low) && size < (old_average_size * _options.bucket_high))
@@ -284,13 +377,13 @@ size_tiered_compaction_strategy::get_buckets(const std::vector<sstables::shared_
 
         // no similar bucket found; put it in a new one
         if (!found) {
-            std::vector<sstables::shared_sstable> new_bucket;
+            std::vector<run> new_bucket;
             new_bucket.push_back(pair.first);
             buckets.insert({ size, std::move(new_bucket) });
         }
     }
 
-    std::vector<std::vector<sstables::shared_sstable>> bucket_list;
+    std::vector<std::vector<run>> bucket_list;
     bucket_list.reserve(buckets.size());
 
     for (auto& entry : buckets) {
@@ -301,10 +394,10 @@ size_tiered_compaction_strategy::get_buckets(const std::vector<sstables::shared_
 }
 
 std::vector<sstables::shared_sstable>
-size_tiered_compaction_strategy::most_interesting_bucket(std::vector<std::vector<sstables::shared_sstable>> buckets,
+size_tiered_compaction_strategy::most_interesting_bucket(std::vector<std::vector<run>> buckets,
         unsigned min_threshold, unsigned max_threshold)
 {
-    std::vector<std::pair<std::vector<sstables::shared_sstable>, uint64_t>> pruned_buckets_and_hotness;
+    std::vector<std::pair<std::vector<run>, uint64_t>> pruned_buckets_and_hotness;
     pruned_buckets_and_hotness.reserve(buckets.size());
 
     // FIXME: add support to get hotness for each bucket.
@@ -329,7 +422,10 @@ size_tiered_compaction_strategy::most_interesting_bucket(std::vector<std::vector
 
         return i.second < j.second;
     });
-    auto hottest = std::move(min.first);
+    std::vector<sstables::shared_sstable> hottest;
+    for (auto& r : min.first) {
+        boost::copy(r, std::back_inserter(hottest));
+    }
 
     return hottest;
 }
@@ -345,8 +441,15 @@ compaction_descriptor size_tiered_compaction_strategy::get_sstables_for_compacti
 
     std::vector<sstables::shared_sstable> most_interesting = most_interesting_bucket(std::move(buckets), min_threshold, max_threshold);
     if (most_interesting.empty()) {
-        // nothing to do
-        return sstables::compaction_descriptor();
+        // No bucket to compact, but an sstable may be worth compacting on
+        // its own to purge its tombstones.
+        auto sst = get_tombstone_compaction_candidate(cfs, candidates);
+        if (!sst) {
+            // nothing to do
+            return sstables::compaction_descriptor();
+        }
+        logger.debug("size_tiered: Compacting sstable {} to purge its tombstones", sst->get_filename());
+        return sstables::compaction_descriptor({ sst });
     }
 
     return sstables::compaction_descriptor(std::move(most_interesting));
@@ -389,7 +492,9 @@ class leveled_compaction_strategy : public compaction_strategy_impl {
 
     int32_t _max_sstable_size_in_mb = DEFAULT_MAX_SSTABLE_SIZE_IN_MB;
 public:
-    leveled_compaction_strategy(const std::map<sstring, sstring>& options) {
+    leveled_compaction_strategy(const std::map<sstring, sstring>& options)
+        : compaction_strategy_impl(options)
+    {
         using namespace cql3::statements;
 
         auto tmp_value = size_tiered_compaction_strategy_options::get_value(options, SSTABLE_SIZE_OPTION);
@@ -424,7 +529,14 @@ compaction_descriptor leveled_compaction_strategy::get_sstables_for_compaction(c
     auto candidate = manifest.get_compaction_candidates();
 
     if (candidate.sstables.empty()) {
-        return sstables::compaction_descriptor();
+        // No level needs compaction, but an sstable may be worth compacting
+        // on its own, within its level, to purge its tombstones.
+        auto sst = get_tombstone_compaction_candidate(cfs, candidates);
+        if (!sst) {
+            return sstables::compaction_descriptor();
+        }
+        logger.debug("leveled: Compacting sstable {} to purge its tombstones", sst->get_filename());
+        return sstables::compaction_descriptor({ sst }, sst->get_sstable_level(), uint64_t(_max_sstable_size_in_mb) * 1024 * 1024);
     }
 
     logger.debug("leveled: Compacting {} out of {} sstables", candidate.sstables.size(), cfs.get_sstables()->size());
@@ -432,6 +544,174 @@ compaction_descriptor leveled_compaction_strategy::get_sstables_for_compaction(c
     return std::move(candidate);
 }
 
+class time_window_compaction_strategy_options {
+    static constexpr int DEFAULT_COMPACTION_WINDOW_SIZE = 1;
+    static constexpr int DEFAULT_EXPIRED_SSTABLE_CHECK_FREQUENCY_SECONDS = 60 * 10;
+    const sstring COMPACTION_WINDOW_UNIT_KEY = "compaction_window_unit";
+    const sstring COMPACTION_WINDOW_SIZE_KEY = "compaction_window_size";
+    const sstring TIMESTAMP_RESOLUTION_KEY = "timestamp_resolution";
+    const sstring EXPIRED_SSTABLE_CHECK_FREQUENCY_SECONDS_KEY = "expired_sstable_check_frequency_seconds";
+
+    std::chrono::seconds sstable_window_size = std::chrono::hours(24) * DEFAULT_COMPACTION_WINDOW_SIZE;
+    // Number of microseconds in a unit of the timestamps written by clients.
+    int64_t timestamp_resolution = 1;
+    std::chrono::seconds expired_sstable_check_frequency = std::chrono::seconds(DEFAULT_EXPIRED_SSTABLE_CHECK_FREQUENCY_SECONDS);
+public:
+    time_window_compaction_strategy_options(const std::map<sstring, sstring>& options) {
+        using namespace cql3::statements;
+
+        static const std::map<sstring, std::chrono::seconds> valid_window_units = {
+            { "MINUTES", std::chrono::minutes(1) },
+            { "HOURS", std::chrono::hours(1) },
+            { "DAYS", std::chrono::hours(24) },
+        };
+        static const std::map<sstring, int64_t> valid_timestamp_resolutions = {
+            { "MICROSECONDS", 1 },
+            { "MILLISECONDS", 1000 },
+            { "SECONDS", 1000 * 1000 },
+        };
+
+        auto window_unit = std::chrono::seconds(std::chrono::hours(24));
+        auto tmp_value = size_tiered_compaction_strategy_options::get_value(options, COMPACTION_WINDOW_UNIT_KEY);
+        if (tmp_value) {
+            auto it = valid_window_units.find(*tmp_value);
+            if (it == valid_window_units.end()) {
+                throw exceptions::configuration_exception(sprint("%s is not valid for %s", *tmp_value, COMPACTION_WINDOW_UNIT_KEY));
+            }
+            window_unit = it->second;
+        }
+
+        tmp_value = size_tiered_compaction_strategy_options::get_value(options, COMPACTION_WINDOW_SIZE_KEY);
+        auto window_size = property_definitions::to_int(COMPACTION_WINDOW_SIZE_KEY, tmp_value, DEFAULT_COMPACTION_WINDOW_SIZE);
+        if (window_size <= 0) {
+            throw exceptions::configuration_exception(sprint("%d must be greater than 0 for %s", window_size, COMPACTION_WINDOW_SIZE_KEY));
+        }
+        sstable_window_size = window_unit * window_size;
+
+        tmp_value = size_tiered_compaction_strategy_options::get_value(options, TIMESTAMP_RESOLUTION_KEY);
+        if (tmp_value) {
+            auto it = valid_timestamp_resolutions.find(*tmp_value);
+            if (it == valid_timestamp_resolutions.end()) {
+                throw exceptions::configuration_exception(sprint("%s is not valid for %s", *tmp_value, TIMESTAMP_RESOLUTION_KEY));
+            }
+            timestamp_resolution = it->second;
+        }
+
+        tmp_value = size_tiered_compaction_strategy_options::get_value(options, EXPIRED_SSTABLE_CHECK_FREQUENCY_SECONDS_KEY);
+        expired_sstable_check_frequency = std::chrono::seconds(property_definitions::to_long(EXPIRED_SSTABLE_CHECK_FREQUENCY_SECONDS_KEY,
+            tmp_value, DEFAULT_EXPIRED_SSTABLE_CHECK_FREQUENCY_SECONDS));
+    }
+
+    friend class time_window_compaction_strategy;
+};
+
+//
+// Time window compaction strategy is meant for time series data, which is
+// written in timestamp order and often has a TTL. SSTables are grouped in
+// windows of fixed size by the maximum timestamp of their data, and only
+// sstables of the same window are compacted together, so data is written
+// once within its window and once more when the window is over. SSTables
+// of the newest window are compacted with the size-tiered strategy.
+//
+// Because windows are not mixed, all data of an old window tends to expire
+// at the same time, so whole sstables can be dropped instead of compacted.
+//
+class time_window_compaction_strategy : public compaction_strategy_impl {
+    time_window_compaction_strategy_options _options;
+    size_tiered_compaction_strategy _stcs;
+    db_clock::time_point _last_expired_check;
+private:
+    // Returns the start of the window the given timestamp belongs to, in microseconds.
+    int64_t window_start(api::timestamp_type timestamp) const {
+        int64_t ts = timestamp * _options.timestamp_resolution;
+        int64_t window = std::chrono::duration_cast<std::chrono::microseconds>(_options.sstable_window_size).count();
+        auto r = ts % window;
+        return ts - (r < 0 ? r + window : r);
+    }
+
+    // Groups sstables into windows, newest first.
+    std::map<int64_t, std::vector<sstables::shared_sstable>, std::greater<int64_t>>
+    get_buckets(const std::vector<sstables::shared_sstable>& sstables) const {
+        std::map<int64_t, std::vector<sstables::shared_sstable>, std::greater<int64_t>> buckets;
+        for (auto&& sst : sstables) {
+            buckets[window_start(sst->get_stats_metadata().max_timestamp)].push_back(sst);
+        }
+        return buckets;
+    }
+public:
+    time_window_compaction_strategy(const std::map<sstring, sstring>& options)
+        : compaction_strategy_impl(options)
+        , _options(options)
+        , _stcs(options)
+    { }
+
+    virtual compaction_descriptor get_sstables_for_compaction(column_family& cfs, std::vector<sstables::shared_sstable> candidates) override;
+
+    virtual compaction_strategy_type type() const {
+        return compaction_strategy_type::time_window;
+    }
+};
+
+compaction_descriptor time_window_compaction_strategy::get_sstables_for_compaction(column_family& cfs, std::vector<sstables::shared_sstable> candidates) {
+    if (candidates.empty()) {
+        return sstables::compaction_descriptor();
+    }
+
+    // Looking for expired sstables means going through all the sstables of
+    // the column family, so it isn't done on every call.
+    auto now = db_clock::now();
+    if (now - _last_expired_check >= _options.expired_sstable_check_frequency) {
+        _last_expired_check = now;
+        auto gc_before = gc_clock::now() - cfs.schema()->gc_grace_seconds();
+        auto expired = get_fully_expired_sstables(cfs, candidates, gc_before);
+        if (!expired.empty()) {
+            logger.debug("time_window: Dropping {} fully expired sstables", expired.size());
+            auto descriptor = sstables::compaction_descriptor(std::move(expired));
+            descriptor.drop_expired = true;
+            return descriptor;
+        }
+    }
+
+    size_t min_threshold = cfs.schema()->min_compaction_threshold();
+    size_t max_threshold = cfs.schema()->max_compaction_threshold();
+    auto buckets = get_buckets(candidates);
+    auto newest_window = buckets.begin()->first;
+
+    for (auto&& entry : buckets) {
+        auto& bucket = entry.second;
+        if (entry.first == newest_window) {
+            // The newest window is still being written to.
+            if (bucket.size() >= min_threshold) {
+                auto descriptor = _stcs.get_sstables_for_compaction(cfs, bucket);
+                if (!descriptor.sstables.empty()) {
+                    return descriptor;
+                }
+            }
+        } else {
+            // Windows which are over are compacted into a single run of
+            // sstables, smallest runs first if there are too many of them.
+            // A window already compacted into a run is left alone.
+            auto runs = group_into_runs(bucket);
+            if (runs.size() < 2) {
+                continue;
+            }
+            if (runs.size() > max_threshold) {
+                std::sort(runs.begin(), runs.end(), [] (auto& x, auto& y) {
+                    return x.second < y.second;
+                });
+                runs.resize(max_threshold);
+            }
+            std::vector<sstables::shared_sstable> sstables;
+            for (auto& r : runs) {
+                sstables.insert(sstables.end(), r.first.begin(), r.first.end());
+            }
+            logger.debug("time_window: Compacting {} sstables in {} runs of window starting at {}", sstables.size(), runs.size(), entry.first);
+            return sstables::compaction_descriptor(std::move(sstables));
+        }
+    }
+    return sstables::compaction_descriptor();
+}
+
 compaction_strategy::compaction_strategy(::shared_ptr<compaction_strategy_impl> impl)
     : _compaction_strategy_impl(std::move(impl)) {}
 compaction_strategy::compaction_strategy() = default;
@@ -466,6 +746,9 @@ compaction_strategy make_compaction_strategy(compaction_strategy_type strategy,
     case compaction_strategy_type::leveled:
         impl = make_shared<leveled_compaction_strategy>(leveled_compaction_strategy(options));
         break;
+    case compaction_strategy_type::time_window:
+        impl = make_shared<time_window_compaction_strategy>(time_window_compaction_strategy(options));
+        break;
     default:
         throw std::runtime_error("strategy not supported");
     }
@@ -118,7 +118,8 @@ struct estimated_histogram {
     }
 
     void clear() {
-        buckets.resize(buckets.size(), 0);
+        std::fill(buckets.begin(), buckets.end(), 0);
+        _count = 0;
     }
     /**
      * Increments the count of the bucket closest to n, rounding UP.
@@ -266,31 +267,6 @@ struct estimated_histogram {
         return 0;
     }
 
-    /**
-     * @param percentile
-     * @return estimated value at given percentile
-     */
-    public long percentile(double percentile)
-    {
-        assert percentile >= 0 && percentile <= 1.0;
-        int lastBucket = buckets.length() - 1;
-        if (buckets.get(lastBucket) > 0)
-            throw new IllegalStateException("Unable to compute when histogram overflowed");
-
-        long pcount = (long) Math.floor(count() * percentile);
-        if (pcount == 0)
-            return 0;
-
-        long elements = 0;
-        for (int i = 0; i < lastBucket; i++)
-        {
-            elements += buckets.get(i);
-            if (elements >= pcount)
-                return bucketOffsets[i];
-        }
-        return 0;
-    }
-
 #endif
 
     /**
@@ -319,6 +295,28 @@ struct estimated_histogram {
         }
         return sum;
     }
+
+    /**
+     * @param percentile
+     * @return estimated value at given percentile. If the percentile falls
+     * into the overflow bucket, returns INT64_MAX.
+     */
+    int64_t percentile(double percentile) const {
+        assert(percentile >= 0 && percentile <= 1.0);
+        int64_t pcount = std::floor(count() * percentile);
+        if (pcount == 0) {
+            return 0;
+        }
+        auto last_bucket = buckets.size() - 1;
+        int64_t elements = 0;
+        for (size_t i = 0; i < last_bucket; i++) {
+            elements += buckets[i];
+            if (elements >= pcount) {
+                return bucket_offsets[i];
+            }
+        }
+        return INT64_MAX;
+    }
 #if 0
     /**
      * @return true if this histogram has overflowed -- that is, a value larger than our largest bucket could bound was added
@@ -97,6 +97,22 @@ static inline size_t write_unsigned_var_int(unsigned int value, uint8_t* to) {
     return size;
 }
 
+// Reads a value written by write_unsigned_var_int() from [from, end), and
+// advances from past it.
+static inline unsigned int read_unsigned_var_int(const uint8_t*& from, const uint8_t* end) {
+    unsigned int value = 0;
+    unsigned int shift = 0;
+    while (from != end && shift < 32) {
+        uint8_t b = *from++;
+        value |= unsigned(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return value;
+        }
+        shift += 7;
+    }
+    throw std::invalid_argument("truncated or malformed variable length integer");
+}
+
 /** @class HyperLogLog
  *  @brief Implement of 'HyperLogLog' estimate cardinality algorithm
  */
@@ -136,11 +152,35 @@ class HyperLogLog {
         alphaMM_ = alpha * m_ * m_;
     }
 
+    /**
+     * Creates an estimator from the output of get_bytes(), as found in the
+     * cardinality of the compaction metadata.
+     *
+     * @exception std::invalid_argument the bytes aren't in the format written
+     *            by get_bytes().
+     */
     static HyperLogLog from_bytes(temporary_buffer<uint8_t> bytes) {
-        // FIXME: implement class that creates a HyperLogLog from an array of bytes.
-        // This will useful if we need to work with the cardinality data from the
-        // compaction metadata.
-        abort();
+        static constexpr int version = 2;
+
+        const uint8_t* p = bytes.get();
+        const uint8_t* end = p + bytes.size();
+        if (bytes.size() < sizeof(int) || int(ntohl(*unaligned_cast<const int*>(p))) != -version) {
+            throw std::invalid_argument("unsupported cardinality format");
+        }
+        p += sizeof(int);
+        auto b = read_unsigned_var_int(p, end);
+        auto sp = read_unsigned_var_int(p, end);
+        auto type = read_unsigned_var_int(p, end);
+        auto size = read_unsigned_var_int(p, end);
+        if (b < 4 || 16 < b || sp != 0 || type != 0) {
+            throw std::invalid_argument("unsupported cardinality format");
+        }
+        HyperLogLog hll(b);
+        if (size != hll.m_ || size_t(end - p) != size) {
+            throw std::invalid_argument("cardinality register size doesn't match");
+        }
+        std::copy(p, end, hll.M_.begin());
+        return hll;
     }
 
     /**
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <seastar/core/scollectd.hh>
+#include "index_cache.hh"
+
+namespace sstables {
+
+index_cache& global_index_cache() {
+    static thread_local index_cache instance;
+    return instance;
+}
+
+index_cache_entry::index_cache_entry(index_cache_entry&& o) noexcept
+    : _sstable_id(o._sstable_id)
+    , _summary_idx(o._summary_idx)
+    , _page(std::move(o._page))
+    , _lru_link()
+    , _cache_link()
+{
+    {
+        auto prev = o._lru_link.prev_;
+        o._lru_link.unlink();
+        index_cache::lru_type::node_algorithms::link_after(prev, _lru_link.this_ptr());
+    }
+
+    {
+        using container_type = index_cache::entries_type;
+        container_type::node_algorithms::replace_node(o._cache_link.this_ptr(), _cache_link.this_ptr());
+        container_type::node_algorithms::init(o._cache_link.this_ptr());
+    }
+}
+
+index_cache::index_cache() {
+    setup_collectd();
+
+    _region.make_evictable([this] {
+        return evict() ? memory::reclaiming_result::reclaimed_something : memory::reclaiming_result::reclaimed_nothing;
+    });
+}
+
+uint64_t index_cache::entry_size(const index_cache_entry& e) {
+    return sizeof(index_cache_entry) + e._page.size();
+}
+
+// Must be called with the allocator of the region. The links of the entry
+// unlink themselves.
+void index_cache::erase(index_cache_entry& e) {
+    _size -= entry_size(e);
+    --_pages;
+    current_deleter<index_cache_entry>()(&e);
+}
+
+bool index_cache::evict() {
+    if (_lru.empty()) {
+        return false;
+    }
+    with_allocator(_region.allocator(), [this] {
+        erase(_lru.back());
+    });
+    ++_stats.evictions;
+    return true;
+}
+
+void index_cache::set_max_size(uint64_t max_size) {
+    _max_size = max_size;
+    while (_size > _max_size && evict()) { }
+}
+
+index_cache::~index_cache() {
+    clear();
+}
+
+void index_cache::setup_collectd() {
+    _collectd_registrations = std::make_unique<scollectd::registrations>(scollectd::registrations({
+        scollectd::add_polled_metric(scollectd::type_instance_id("index_cache"
+                , scollectd::per_cpu_plugin_instance
+                , "bytes", "used")
+                , scollectd::make_typed(scollectd::data_type::GAUGE, [this] { return _region.occupancy().used_space(); })
+        ),
+        scollectd::add_polled_metric(scollectd::type_instance_id("index_cache"
+                , scollectd::per_cpu_plugin_instance
+                , "bytes", "total")
+                , scollectd::make_typed(scollectd::data_type::GAUGE, [this] { return _region.occupancy().total_space(); })
+        ),
+        scollectd::add_polled_metric(scollectd::type_instance_id("index_cache"
+                , scollectd::per_cpu_plugin_instance
+                , "total_operations", "hits")
+                , scollectd::make_typed(scollectd::data_type::DERIVE, _stats.hits)
+        ),
+        scollectd::add_polled_metric(scollectd::type_instance_id("index_cache"
+                , scollectd::per_cpu_plugin_instance
+                , "total_operations", "misses")
+                , scollectd::make_typed(scollectd::data_type::DERIVE, _stats.misses)
+        ),
+        scollectd::add_polled_metric(scollectd::type_instance_id("index_cache"
+                , scollectd::per_cpu_plugin_instance
+                , "total_operations", "insertions")
+                , scollectd::make_typed(scollectd::data_type::DERIVE, _stats.insertions)
+        ),
+        scollectd::add_polled_metric(scollectd::type_instance_id("index_cache"
+                , scollectd::per_cpu_plugin_instance
+                , "total_operations", "evictions")
+                , scollectd::make_typed(scollectd::data_type::DERIVE, _stats.evictions)
+        ),
+        scollectd::add_polled_metric(scollectd::type_instance_id("index_cache"
+                , scollectd::per_cpu_plugin_instance
+                , "objects", "pages")
+                , scollectd::make_typed(scollectd::data_type::GAUGE, _pages)
+        ),
+    }));
+}
+
+template <typename T>
+static void write_native(bytes::value_type*& p, T v) {
+    std::memcpy(p, &v, sizeof(v));
+    p += sizeof(v);
+}
+
+template <typename T>
+static T read_native(const bytes::value_type*& p) {
+    T v;
+    std::memcpy(&v, p, sizeof(v));
+    p += sizeof(v);
+    return v;
+}
+
+static temporary_buffer<char> read_buffer(const bytes::value_type*& p) {
+    auto size = read_native<uint32_t>(p);
+    temporary_buffer<char> buf(reinterpret_cast<const char*>(p), size);
+    p += size;
+    return buf;
+}
+
+static bytes serialize_page(const std::vector<index_entry>& page) {
+    size_t size = 0;
+    for (auto&& e : page) {
+        size += sizeof(uint64_t) + sizeof(uint32_t) + e.get_key_bytes().size() + sizeof(uint32_t) + e.get_promoted_index_bytes().size();
+    }
+    bytes b(bytes::initialized_later(), size);
+    auto p = b.begin();
+    for (auto&& e : page) {
+        write_native<uint64_t>(p, e.position());
+        for (auto&& v : { e.get_key_bytes(), e.get_promoted_index_bytes() }) {
+            write_native<uint32_t>(p, v.size());
+            p = std::copy(v.begin(), v.end(), p);
+        }
+    }
+    return b;
+}
+
+static std::vector<index_entry> deserialize_page(bytes_view b) {
+    std::vector<index_entry> page;
+    auto p = b.begin();
+    while (p != b.end()) {
+        auto position = read_native<uint64_t>(p);
+        auto key = read_buffer(p);
+        auto promoted_index = read_buffer(p);
+        page.emplace_back(std::move(key), position, std::move(promoted_index));
+    }
+    return page;
+}
+
+std::experimental::optional<std::vector<index_entry>> index_cache::get(uint64_t sstable_id, uint64_t summary_idx) {
+    return _read_section(_region, [&] () -> std::experimental::optional<std::vector<index_entry>> {
+        auto i = _entries.find(index_cache_entry::compare::key_type(sstable_id, summary_idx), index_cache_entry::compare());
+        if (i == _entries.end()) {
+            ++_stats.misses;
+            return {};
+        }
+        auto page = with_linearized_managed_bytes([&] {
+            return deserialize_page(i->_page);
+        });
+        ++_stats.hits;
+        _lru.erase(_lru.iterator_to(*i));
+        _lru.push_front(*i);
+        return { std::move(page) };
+    });
+}
+
+void index_cache::insert(uint64_t sstable_id, uint64_t summary_idx, const std::vector<index_entry>& page) {
+    auto b = serialize_page(page);
+    if (sizeof(index_cache_entry) + b.size() > _max_size) {
+        return;
+    }
+    _insert_section(_region, [&] {
+        with_allocator(_region.allocator(), [&] {
+            auto key = index_cache_entry::compare::key_type(sstable_id, summary_idx);
+            auto i = _entries.lower_bound(key, index_cache_entry::compare());
+            if (i != _entries.end() && index_cache_entry::compare::key(*i) == key) {
+                // Populated by a concurrent read.
+                return;
+            }
+            auto e = current_allocator().construct<index_cache_entry>(sstable_id, summary_idx, managed_bytes(bytes_view(b)));
+            _entries.insert(i, *e);
+            _lru.push_front(*e);
+            _size += entry_size(*e);
+            ++_pages;
+            ++_stats.insertions;
+        });
+    });
+    while (_size > _max_size && evict()) { }
+}
+
+void index_cache::invalidate(uint64_t sstable_id) {
+    with_allocator(_region.allocator(), [&] {
+        auto i = _entries.lower_bound(index_cache_entry::compare::key_type(sstable_id, 0), index_cache_entry::compare());
+        while (i != _entries.end() && i->sstable_id() == sstable_id) {
+            erase(*i++);
+        }
+    });
+}
+
+void index_cache::clear() {
+    with_allocator(_region.allocator(), [this] {
+        _lru.clear_and_dispose(current_deleter<index_cache_entry>());
+    });
+    _pages = 0;
+    _size = 0;
+}
+
+}
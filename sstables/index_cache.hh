@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <experimental/optional>
+#include <limits>
+#include <boost/intrusive/list.hpp>
+#include <boost/intrusive/set.hpp>
+
+#include "types.hh"
+#include "utils/logalloc.hh"
+#include "utils/managed_bytes.hh"
+
+namespace scollectd {
+
+struct registrations;
+
+}
+
+namespace sstables {
+
+namespace bi = boost::intrusive;
+
+// A page of the index file, i.e. the index entries covered by one summary
+// entry, in parsed form. Lives in the LSA region of index_cache.
+class index_cache_entry {
+    // See cache_entry for why both links are auto_unlink.
+    using lru_link_type = bi::list_member_hook<bi::link_mode<bi::auto_unlink>>;
+    using cache_link_type = bi::set_member_hook<bi::link_mode<bi::auto_unlink>>;
+
+    uint64_t _sstable_id;
+    uint64_t _summary_idx;
+    // Entries of the page, each stored as its position followed by the
+    // size-prefixed key and promoted index, in native byte order.
+    managed_bytes _page;
+    lru_link_type _lru_link;
+    cache_link_type _cache_link;
+public:
+    friend class index_cache;
+
+    index_cache_entry(uint64_t sstable_id, uint64_t summary_idx, managed_bytes&& page) noexcept
+        : _sstable_id(sstable_id)
+        , _summary_idx(summary_idx)
+        , _page(std::move(page))
+    { }
+
+    index_cache_entry(index_cache_entry&&) noexcept;
+
+    uint64_t sstable_id() const { return _sstable_id; }
+    uint64_t summary_idx() const { return _summary_idx; }
+
+    struct compare {
+        using key_type = std::pair<uint64_t, uint64_t>;
+
+        static key_type key(const index_cache_entry& e) {
+            return { e._sstable_id, e._summary_idx };
+        }
+
+        bool operator()(const index_cache_entry& e1, const index_cache_entry& e2) const {
+            return key(e1) < key(e2);
+        }
+
+        bool operator()(const key_type& k1, const index_cache_entry& e2) const {
+            return k1 < key(e2);
+        }
+
+        bool operator()(const index_cache_entry& e1, const key_type& k2) const {
+            return key(e1) < k2;
+        }
+    };
+};
+
+// Per-shard cache of parsed index pages, keyed by sstable and summary index,
+// which lets single-partition lookups skip reading and parsing the index
+// file. Entries are kept in an evictable LSA region and evicted in LRU order
+// under memory pressure, like the row cache (see cache_tracker).
+//
+// Sstables are identified by an id obtained from new_sstable_id() rather
+// than by address, so that a new sstable can never see the pages of a dead
+// one. Sstables drop their pages with invalidate() when destroyed.
+class index_cache final {
+public:
+    using lru_type = bi::list<index_cache_entry,
+        bi::member_hook<index_cache_entry, index_cache_entry::lru_link_type, &index_cache_entry::_lru_link>,
+        bi::constant_time_size<false>>; // we need this to have bi::auto_unlink on hooks.
+    using entries_type = bi::set<index_cache_entry,
+        bi::member_hook<index_cache_entry, index_cache_entry::cache_link_type, &index_cache_entry::_cache_link>,
+        bi::constant_time_size<false>, // we need this to have bi::auto_unlink on hooks
+        bi::compare<index_cache_entry::compare>>;
+
+    struct stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+    };
+private:
+    stats _stats;
+    uint64_t _pages = 0;
+    // Memory taken by the pages, which is kept below _max_size by evicting
+    // the least recently used ones on insertion.
+    uint64_t _size = 0;
+    uint64_t _max_size = std::numeric_limits<uint64_t>::max();
+    uint64_t _next_sstable_id = 0;
+    std::unique_ptr<scollectd::registrations> _collectd_registrations;
+    logalloc::region _region;
+    logalloc::allocating_section _read_section;
+    logalloc::allocating_section _insert_section;
+    lru_type _lru;
+    entries_type _entries;
+private:
+    void setup_collectd();
+    static uint64_t entry_size(const index_cache_entry&);
+    void erase(index_cache_entry&);
+    // Evicts the least recently used page. Returns false if there was none.
+    bool evict();
+public:
+    index_cache();
+    ~index_cache();
+    index_cache(const index_cache&) = delete;
+    index_cache& operator=(const index_cache&) = delete;
+
+    uint64_t new_sstable_id() {
+        return _next_sstable_id++;
+    }
+
+    // Returns a copy of the given page, if cached.
+    std::experimental::optional<std::vector<index_entry>> get(uint64_t sstable_id, uint64_t summary_idx);
+    void insert(uint64_t sstable_id, uint64_t summary_idx, const std::vector<index_entry>& page);
+    // Drops all pages of the given sstable.
+    void invalidate(uint64_t sstable_id);
+    void clear();
+
+    const stats& get_stats() const {
+        return _stats;
+    }
+    uint64_t pages() const {
+        return _pages;
+    }
+    uint64_t size() const {
+        return _size;
+    }
+    uint64_t max_size() const {
+        return _max_size;
+    }
+    // Sets the limit on the memory taken by the cached pages, evicting
+    // pages if needed. The cache is unbounded, except by memory pressure,
+    // until this is called. A limit of 0 disables caching.
+    void set_max_size(uint64_t max_size);
+    const logalloc::region& region() const {
+        return _region;
+    }
+};
+
+// Returns a reference to shard-wide index_cache.
+index_cache& global_index_cache();
+
+}
@@ -19,6 +19,7 @@
  * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "mutation.hh"
+#include "streamed_mutation.hh"
 #include "sstables.hh"
 #include "types.hh"
 #include "core/future-util.hh"
@@ -26,6 +27,7 @@
 #include "keys.hh"
 #include "core/do_with.hh"
 #include "unimplemented.hh"
+#include "utils/data_input.hh"
 
 #include "dht/i_partitioner.hh"
 
@@ -97,6 +99,8 @@ static inline bytes pop_back(std::vector<bytes>& vec) {
 }
 
 class mp_row_consumer : public row_consumer {
+    friend class mp_fragment_consumer;
+
     schema_ptr _schema;
     key_view _key;
     const io_priority_class* _pc = nullptr;
@@ -290,7 +294,7 @@ class mp_row_consumer : public row_consumer {
 
     mp_row_consumer() : _ck_filtering(query::no_clustering_key_filtering) {}
 
-    virtual void consume_row_start(sstables::key_view key, sstables::deletion_time deltime) override {
+    virtual proceed consume_row_start(sstables::key_view key, sstables::deletion_time deltime) override {
         if (_key.empty()) {
             mut = mutation(partition_key::from_exploded(*_schema, key.explode(*_schema)), _schema);
             _filter = _ck_filtering.get_filter_for_sorted(mut->key());
@@ -301,9 +305,10 @@ class mp_row_consumer : public row_consumer {
         if (!deltime.live()) {
             mut->partition().apply(tombstone(deltime));
         }
+        return proceed::yes;
     }
 
-    atomic_cell make_atomic_cell(uint64_t timestamp, bytes_view value, uint32_t ttl, uint32_t expiration) {
+    static atomic_cell make_atomic_cell(uint64_t timestamp, bytes_view value, uint32_t ttl, uint32_t expiration) {
         if (ttl) {
             return atomic_cell::make_live(timestamp, value,
                 gc_clock::time_point(gc_clock::duration(expiration)), gc_clock::duration(ttl));
@@ -312,7 +317,7 @@ class mp_row_consumer : public row_consumer {
         }
     }
 
-    virtual void consume_cell(bytes_view col_name, bytes_view value, int64_t timestamp, int32_t ttl, int32_t expiration) override {
+    virtual proceed consume_cell(bytes_view col_name, bytes_view value, int64_t timestamp, int32_t ttl, int32_t expiration) override {
         struct column col(*_schema, col_name);
 
         auto clustering_prefix = exploded_clustering_prefix(std::move(col.clustering));
@@ -322,27 +327,27 @@ class mp_row_consumer : public row_consumer {
             auto& dr = mut->partition().clustered_row(clustering_key);
             row_marker rm(timestamp, gc_clock::duration(ttl), gc_clock::time_point(gc_clock::duration(expiration)));
             dr.apply(rm);
-            return;
+            return proceed::yes;
         }
 
         if (!col.is_present(timestamp)) {
-            return;
+            return proceed::yes;
         }
 
         auto ac = make_atomic_cell(timestamp, value, ttl, expiration);
 
         bool is_multi_cell = col.collection_extra_data.size();
         if (is_multi_cell != col.cdef->type->is_multi_cell()) {
-            return;
+            return proceed::yes;
         }
         if (is_multi_cell) {
             update_pending_collection(clustering_prefix, col.cdef, std::move(col.collection_extra_data), std::move(ac));
-            return;
+            return proceed::yes;
         }
 
         if (col.is_static) {
             mut->set_static_cell(*(col.cdef), std::move(ac));
-            return;
+            return proceed::yes;
         }
         auto clustering_key = clustering_key::from_clustering_prefix(*_schema, clustering_prefix);
         if (!_last_clustering_key || !_clustering_key_equality(clustering_key, *_last_clustering_key)) {
@@ -352,13 +357,15 @@ class mp_row_consumer : public row_consumer {
         if (_last_clustering_key_filter_result) {
             mut->set_cell(clustering_prefix, *(col.cdef), atomic_cell_or_collection(std::move(ac)));
         }
+        return proceed::yes;
     }
 
-    virtual void consume_deleted_cell(bytes_view col_name, sstables::deletion_time deltime) override {
+    virtual proceed consume_deleted_cell(bytes_view col_name, sstables::deletion_time deltime) override {
         struct column col(*_schema, col_name);
         gc_clock::duration secs(deltime.local_deletion_time);
 
         consume_deleted_cell(col, deltime.marked_for_delete_at, gc_clock::time_point(secs));
+        return proceed::yes;
     }
 
     void consume_deleted_cell(column &col, int64_t timestamp, gc_clock::time_point ttl) {
@@ -435,7 +442,7 @@ class mp_row_consumer : public row_consumer {
         }
     }
 
-    virtual void consume_range_tombstone(
+    virtual proceed consume_range_tombstone(
             bytes_view start_col, bytes_view end_col,
             sstables::deletion_time deltime) override {
 
@@ -460,6 +467,7 @@ class mp_row_consumer : public row_consumer {
                 update_pending_collection(clustering_prefix, cdef, tombstone(deltime));
             }
         }
+        return proceed::yes;
     }
     virtual const io_priority_class& io_priority() override {
         assert (_pc != nullptr);
@@ -467,6 +475,283 @@ class mp_row_consumer : public row_consumer {
     }
 };
 
+// Consumes the atoms of sstable partitions into mutation_fragments, for
+// streamed_mutations returned by sstable::read_rows_streamed() et al.
+//
+// Cells are accumulated into the row they belong to until an atom of another
+// row or a range tombstone shows up, so that only the row being read and the
+// fragments which weren't consumed yet are held in memory. Processing is
+// paused after each partition start, at each partition end and whenever
+// enough fragments are ready to fill the buffer of a streamed_mutation.
+class mp_fragment_consumer : public row_consumer {
+    using column = mp_row_consumer::column;
+
+    schema_ptr _schema;
+    const io_priority_class& _pc;
+    query::clustering_key_filtering_context _ck_filtering;
+    query::clustering_key_filter _filter;
+    position_in_partition_view::less_compare _less;
+
+    std::experimental::optional<dht::decorated_key> _key;
+    tombstone _partition_tombstone;
+    bool _partition_end = false;
+    bool _skip_partition = false;
+
+    // Static or clustering row being read.
+    mutation_fragment_opt _in_progress;
+    // Collection of the row being read, see mp_row_consumer::collection_mutation.
+    const column_definition* _pending_cdef = nullptr;
+    collection_type_impl::mutation _pending_cm;
+    std::experimental::optional<position_in_partition> _last_position;
+    circular_buffer<mutation_fragment> _ready;
+    size_t _ready_size = 0;
+private:
+    proceed flow() const {
+        return _ready_size >= streamed_mutation::max_buffer_size_in_bytes ? proceed::no : proceed::yes;
+    }
+
+    void emit(mutation_fragment mf) {
+        _last_position = position_in_partition(mf.position());
+        _ready_size += mf.memory_usage();
+        _ready.emplace_back(std::move(mf));
+    }
+
+    void flush_pending_collection() {
+        if (!_pending_cdef) {
+            return;
+        }
+        auto ctype = static_pointer_cast<const collection_type_impl>(_pending_cdef->type);
+        auto ac = atomic_cell_or_collection::from_collection_mutation(ctype->serialize_mutation_form(_pending_cm));
+        auto& cells = _pending_cdef->is_static() ? _in_progress->as_static_row().cells() : _in_progress->as_clustering_row().cells();
+        cells.apply(*_pending_cdef, std::move(ac));
+        _pending_cdef = nullptr;
+        _pending_cm = { };
+    }
+
+    void finish_row() {
+        if (!_in_progress) {
+            return;
+        }
+        flush_pending_collection();
+        auto mf = std::move(*_in_progress);
+        _in_progress = { };
+        if (mf.is_clustering_row() && !_filter(mf.as_clustering_row().key())) {
+            return;
+        }
+        emit(std::move(mf));
+    }
+
+    clustering_row& clustering_row_for(clustering_key key) {
+        if (!_in_progress || !_in_progress->is_clustering_row() || !_in_progress->as_clustering_row().key().equal(*_schema, key)) {
+            finish_row();
+            _in_progress = mutation_fragment(clustering_row(std::move(key)));
+        }
+        return _in_progress->as_clustering_row();
+    }
+
+    // Returns the cells of the row the atom with the given name belongs to,
+    // finishing the previous row if it is a different one.
+    row& cells_for(bool is_static, const exploded_clustering_prefix& prefix) {
+        if (!is_static) {
+            return clustering_row_for(clustering_key::from_clustering_prefix(*_schema, prefix)).cells();
+        }
+        if (!_in_progress) {
+            _in_progress = mutation_fragment(static_row());
+        } else if (!_in_progress->is_static_row()) {
+            throw malformed_sstable_exception("Static cell found after a clustering row");
+        }
+        return _in_progress->as_static_row().cells();
+    }
+
+    collection_type_impl::mutation& pending_collection(const column_definition* cdef) {
+        if (_pending_cdef != cdef) {
+            flush_pending_collection();
+            if (!cdef->type->is_multi_cell()) {
+                throw malformed_sstable_exception("frozen set should behave like a cell\n");
+            }
+            _pending_cdef = cdef;
+        }
+        return _pending_cm;
+    }
+
+    void emit_range_tombstone(range_tombstone&& rt) {
+        if (_last_position) {
+            auto last = _last_position->view();
+            if (_less(position_in_partition_view(rt.start_bound()), last)) {
+                // Origin repeats the range tombstones which are still open
+                // at the start of each promoted index block. Trim them, so
+                // that fragments are emitted in order.
+                if (!_less(last, position_in_partition_view(rt.end_bound()))) {
+                    return;
+                }
+                rt.start = *last.key();
+                rt.start_kind = last.bound_weight() < 0 ? bound_kind::incl_start : bound_kind::excl_start;
+            }
+        }
+        emit(mutation_fragment(std::move(rt)));
+    }
+public:
+    mp_fragment_consumer(schema_ptr schema, query::clustering_key_filtering_context ck_filtering, const io_priority_class& pc)
+        : _schema(std::move(schema))
+        , _pc(pc)
+        , _ck_filtering(ck_filtering)
+        , _less(*_schema)
+    { }
+
+    // Prepares the consumer for the next partition. A partition which was
+    // started, but not fully read, is skipped.
+    void next_partition() {
+        _key = { };
+        _skip_partition = false;
+    }
+    void skip_partition() {
+        _skip_partition = true;
+        _in_progress = { };
+        _pending_cdef = nullptr;
+        _pending_cm = { };
+        _ready.clear();
+        _ready_size = 0;
+    }
+    bool in_partition() const {
+        return _key && !_partition_end;
+    }
+    const std::experimental::optional<dht::decorated_key>& key() const {
+        return _key;
+    }
+    tombstone partition_tombstone() const {
+        return _partition_tombstone;
+    }
+    bool partition_end() const {
+        return _partition_end;
+    }
+    bool has_fragments() const {
+        return !_ready.empty();
+    }
+    mutation_fragment pop_fragment() {
+        auto mf = std::move(_ready.front());
+        _ready.pop_front();
+        _ready_size -= mf.memory_usage();
+        return mf;
+    }
+
+    virtual proceed consume_row_start(sstables::key_view key, sstables::deletion_time deltime) override {
+        auto pk = partition_key::from_exploded(*_schema, key.explode(*_schema));
+        _filter = _ck_filtering.get_filter_for_sorted(pk);
+        _key = dht::global_partitioner().decorate_key(*_schema, std::move(pk));
+        _partition_tombstone = deltime.live() ? tombstone() : tombstone(deltime);
+        _partition_end = false;
+        _last_position = { };
+        return proceed::no;
+    }
+
+    virtual proceed consume_cell(bytes_view col_name, bytes_view value, int64_t timestamp, int32_t ttl, int32_t expiration) override {
+        if (_skip_partition) {
+            return proceed::yes;
+        }
+        column col(*_schema, col_name);
+        auto clustering_prefix = exploded_clustering_prefix(std::move(col.clustering));
+
+        if (col.cell.size() == 0) {
+            row_marker rm(timestamp, gc_clock::duration(ttl), gc_clock::time_point(gc_clock::duration(expiration)));
+            clustering_row_for(clustering_key::from_clustering_prefix(*_schema, clustering_prefix)).apply(rm);
+            return flow();
+        }
+        if (!col.is_present(timestamp)) {
+            return flow();
+        }
+
+        auto ac = mp_row_consumer::make_atomic_cell(timestamp, value, ttl, expiration);
+
+        bool is_multi_cell = col.collection_extra_data.size();
+        if (is_multi_cell != col.cdef->type->is_multi_cell()) {
+            return flow();
+        }
+        auto& cells = cells_for(col.is_static, clustering_prefix);
+        if (is_multi_cell) {
+            pending_collection(col.cdef).cells.emplace_back(std::move(col.collection_extra_data), std::move(ac));
+        } else {
+            cells.apply(*col.cdef, atomic_cell_or_collection(std::move(ac)));
+        }
+        return flow();
+    }
+
+    virtual proceed consume_deleted_cell(bytes_view col_name, sstables::deletion_time deltime) override {
+        if (_skip_partition) {
+            return proceed::yes;
+        }
+        column col(*_schema, col_name);
+        auto clustering_prefix = exploded_clustering_prefix(std::move(col.clustering));
+        auto timestamp = deltime.marked_for_delete_at;
+        auto ttl = gc_clock::time_point(gc_clock::duration(deltime.local_deletion_time));
+
+        if (col.cell.size() == 0) {
+            row_marker rm(tombstone(timestamp, ttl));
+            clustering_row_for(clustering_key::from_clustering_prefix(*_schema, clustering_prefix)).apply(rm);
+            return flow();
+        }
+        if (!col.is_present(timestamp)) {
+            return flow();
+        }
+
+        auto ac = atomic_cell::make_dead(timestamp, ttl);
+
+        bool is_multi_cell = col.collection_extra_data.size();
+        if (is_multi_cell != col.cdef->type->is_multi_cell()) {
+            return flow();
+        }
+        auto& cells = cells_for(col.is_static, clustering_prefix);
+        if (is_multi_cell) {
+            pending_collection(col.cdef).cells.emplace_back(std::move(col.collection_extra_data), std::move(ac));
+        } else {
+            cells.apply(*col.cdef, atomic_cell_or_collection(std::move(ac)));
+        }
+        return flow();
+    }
+
+    virtual proceed consume_range_tombstone(bytes_view start_col, bytes_view end_col, sstables::deletion_time deltime) override {
+        if (_skip_partition) {
+            return proceed::yes;
+        }
+        auto start = composite_view(column::fix_static_name(start_col)).explode();
+
+        // See mp_row_consumer::consume_range_tombstone().
+        if (start.size() <= _schema->clustering_key_size()) {
+            auto start_kind = mp_row_consumer::start_marker_to_bound_kind(start_col);
+            auto end = clustering_key_prefix::from_exploded(composite_view(column::fix_static_name(end_col)).explode());
+            auto end_kind = mp_row_consumer::end_marker_to_bound_kind(end_col);
+            range_tombstone rt(clustering_key_prefix::from_exploded(std::move(start)), start_kind, std::move(end), end_kind, tombstone(deltime));
+            if (rt.start.is_full(*_schema) && rt.start_kind == bound_kind::incl_start
+                    && rt.end_kind == bound_kind::incl_end && rt.start.equal(*_schema, rt.end)) {
+                // Deletion of a single row, which is written before its cells.
+                clustering_row_for(std::move(rt.start)).apply(rt.tomb);
+                return flow();
+            }
+            finish_row();
+            emit_range_tombstone(std::move(rt));
+        } else {
+            auto&& column = pop_back(start);
+            auto cdef = _schema->get_column_definition(column);
+            if (cdef && cdef->type->is_multi_cell() && deltime.marked_for_delete_at > cdef->dropped_at()) {
+                cells_for(cdef->is_static(), exploded_clustering_prefix(std::move(start)));
+                pending_collection(cdef).tomb = tombstone(deltime);
+            }
+        }
+        return flow();
+    }
+
+    virtual proceed consume_row_end() override {
+        if (!_skip_partition) {
+            finish_row();
+        }
+        _partition_end = true;
+        return proceed::no;
+    }
+
+    virtual const io_priority_class& io_priority() override {
+        return _pc;
+    }
+};
+
 static int adjust_binary_search_index(int idx) {
     if (idx < 0) {
         // binary search gives us the first index _greater_ than the key searched for,
@@ -483,10 +768,11 @@ future<uint64_t> sstables::sstable::data_end_position(uint64_t summary_idx, uint
         return make_ready_future<uint64_t>(il[index_idx + 1].position());
     }
 
-    return data_end_position(summary_idx, pc);
+    return data_end_position(summary_idx, pc, index_cache_policy::populate);
 }
 
-future<uint64_t> sstables::sstable::data_end_position(uint64_t summary_idx, const io_priority_class& pc) {
+future<uint64_t> sstables::sstable::data_end_position(uint64_t summary_idx, const io_priority_class& pc,
+                                                      index_cache_policy policy) {
     // We should only go to the end of the file if we are in the last summary group.
     // Otherwise, we will determine the end position of the current data read by looking
     // at the first index in the next summary group.
@@ -494,11 +780,129 @@ future<uint64_t> sstables::sstable::data_end_position(uint64_t summary_idx, cons
         return make_ready_future<uint64_t>(data_size());
     }
 
-    return read_indexes(summary_idx + 1, pc).then([] (auto next_il) {
+    return read_indexes(summary_idx + 1, pc, policy).then([] (auto next_il) {
         return next_il.front().position();
     });
 }
 
+// Converts a column name found in a promoted index to the clustering prefix
+// it belongs to. Names can be those of cells, of range tombstone bounds, or
+// row names written by us, so only the clustering components are kept.
+// Names of non-compound tables are the clustering key itself, if there is
+// one, or a column name otherwise.
+static clustering_key_prefix promoted_index_name_to_prefix(const schema& s, bytes_view name) {
+    if (!s.is_compound()) {
+        if (!s.clustering_key_size() || name.empty()) {
+            return clustering_key_prefix::make_empty();
+        }
+        return clustering_key_prefix::from_exploded(std::vector<bytes>{to_bytes(name)});
+    }
+    auto components = composite_view(name).explode();
+    if (components.size() > s.clustering_key_size()) {
+        components.resize(s.clustering_key_size());
+    }
+    return clustering_key_prefix::from_exploded(std::move(components));
+}
+
+// Uses the promoted index of a partition to find the byte ranges of the data
+// file which need to be read to satisfy the given clustering ranges, one for
+// each run of matching blocks. The first block is always read, as it holds
+// the partition's static row. Range
+// tombstones covering the rows of a block are repeated at its start, see
+// promoted_index_builder. Returns a disengaged optional if the whole partition
+// needs to be read, for example because it has no promoted index.
+static std::experimental::optional<std::vector<std::pair<uint64_t, uint64_t>>>
+promoted_index_parts(const schema& s, const std::vector<query::clustering_range>& ranges,
+                     bytes_view promoted_index, uint64_t partition_position) {
+    if (promoted_index.empty()) {
+        return {};
+    }
+
+    struct block {
+        bytes_view first_name;
+        bytes_view last_name;
+        uint64_t offset;
+        uint64_t width;
+    };
+    data_input in(promoted_index);
+    // Skip the partition tombstone, we read it from the data file.
+    in.skip(sizeof(int32_t) + sizeof(int64_t));
+    auto nr_blocks = in.read<uint32_t>();
+    std::vector<block> blocks;
+    blocks.reserve(nr_blocks);
+    for (uint32_t i = 0; i < nr_blocks; ++i) {
+        auto first_name = in.read_view_to_blob<uint16_t>();
+        auto last_name = in.read_view_to_blob<uint16_t>();
+        auto offset = in.read<uint64_t>();
+        auto width = in.read<uint64_t>();
+        blocks.push_back({first_name, last_name, offset, width});
+    }
+    if (blocks.size() < 2) {
+        return {};
+    }
+
+    // Comparisons are strict and treat prefixes as equal to the keys they
+    // prefix, so a block is only skipped if none of its rows can match.
+    clustering_key_prefix::prefix_equal_tri_compare cmp(s);
+    auto block_before = [&] (size_t i, const query::clustering_range& r) {
+        return r.start() && cmp(promoted_index_name_to_prefix(s, blocks[i].last_name), r.start()->value()) < 0;
+    };
+    auto block_after = [&] (size_t i, const query::clustering_range& r) {
+        return r.end() && cmp(promoted_index_name_to_prefix(s, blocks[i].first_name), r.end()->value()) > 0;
+    };
+    // Returns the first block in [1, blocks.size()) for which pred is false.
+    auto partition_point = [&] (auto&& pred) {
+        size_t lo = 1, hi = blocks.size();
+        while (lo < hi) {
+            auto mid = lo + (hi - lo) / 2;
+            if (pred(mid)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    };
+
+    // The blocks [lo, hi) matching each of the ranges.
+    std::vector<std::pair<size_t, size_t>> runs;
+    for (auto&& r : ranges) {
+        if (r.is_wrap_around(cmp)) {
+            return {};
+        }
+        auto lo = partition_point([&] (size_t i) { return block_before(i, r); });
+        auto hi = partition_point([&] (size_t i) { return !block_after(i, r); });
+        if (lo < hi) {
+            runs.emplace_back(lo, hi);
+        }
+    }
+    std::sort(runs.begin(), runs.end());
+
+    // Runs which are adjacent or overlap are read as one part, and so is
+    // the first block when the first run follows it.
+    auto block_start = [&] (size_t i) {
+        return partition_position + blocks[i].offset;
+    };
+    auto block_end = [&] (size_t i) {
+        return partition_position + blocks[i].offset + blocks[i].width;
+    };
+    std::vector<std::pair<uint64_t, uint64_t>> parts;
+    parts.emplace_back(partition_position, block_end(0));
+    size_t parts_end = 1;
+    for (auto&& run : runs) {
+        if (run.first <= parts_end) {
+            if (run.second > parts_end) {
+                parts.back().second = block_end(run.second - 1);
+                parts_end = run.second;
+            }
+        } else {
+            parts.emplace_back(block_start(run.first), block_end(run.second - 1));
+            parts_end = run.second;
+        }
+    }
+    return { std::move(parts) };
+}
+
 future<mutation_opt>
 sstables::sstable::read_row(schema_ptr schema,
                             const sstables::key& key,
@@ -528,7 +932,7 @@ sstables::sstable::read_row(schema_ptr schema,
         return make_ready_future<mutation_opt>();
     }
 
-    return read_indexes(summary_idx, pc).then([this, schema, ck_filtering, &key, token, summary_idx, &pc] (auto index_list) {
+    return read_indexes(summary_idx, pc, index_cache_policy::populate).then([this, schema, ck_filtering, &key, token, summary_idx, &pc] (auto index_list) {
         auto index_idx = this->binary_search(index_list, key, token);
         if (index_idx < 0) {
             _filter_tracker.add_false_positive();
@@ -537,6 +941,15 @@ sstables::sstable::read_row(schema_ptr schema,
         _filter_tracker.add_true_positive();
 
         auto position = index_list[index_idx].position();
+        auto& ranges = ck_filtering.get_ranges(partition_key::from_exploded(*schema, key.explode(*schema)));
+        auto parts = promoted_index_parts(*schema, ranges, index_list[index_idx].get_promoted_index_bytes(), position);
+        if (parts) {
+            return do_with(mp_row_consumer(key, schema, ck_filtering, pc), [this, parts = std::move(*parts)] (auto& c) mutable {
+                return this->data_consume_partition_parts(c, std::move(parts)).then([&c] {
+                    return make_ready_future<mutation_opt>(std::move(c.mut));
+                });
+            });
+        }
         return this->data_end_position(summary_idx, index_idx, index_list, pc).then([&key, schema, ck_filtering, this, position, &pc] (uint64_t end) {
             return do_with(mp_row_consumer(key, schema, ck_filtering, pc), [this, position, end] (auto& c) {
                 return this->data_consume_rows_at_once(c, position, end).then([&c] {
@@ -738,6 +1151,140 @@ sstable::read_range_rows(schema_ptr schema,
         *this, std::move(schema), std::move(start), std::move(end), ck_filtering, pc);
 }
 
+// State shared by a streamed reader of sstable partitions and the
+// streamed_mutations it returns.
+struct sstable_streamed_read_context {
+    mp_fragment_consumer consumer;
+    std::experimental::optional<data_consume_context> context;
+
+    sstable_streamed_read_context(schema_ptr schema, query::clustering_key_filtering_context ck_filtering, const io_priority_class& pc)
+        : consumer(std::move(schema), ck_filtering, pc)
+    { }
+
+    // Reference to consumer is passed to data_consume_rows() so we must not allow move/copy
+    sstable_streamed_read_context(sstable_streamed_read_context&&) = delete;
+    sstable_streamed_read_context(const sstable_streamed_read_context&) = delete;
+};
+
+class sstable_streamed_mutation : public streamed_mutation::impl {
+    lw_shared_ptr<sstable_streamed_read_context> _ctx;
+public:
+    sstable_streamed_mutation(schema_ptr s, lw_shared_ptr<sstable_streamed_read_context> ctx)
+        : streamed_mutation::impl(std::move(s), *ctx->consumer.key(), ctx->consumer.partition_tombstone())
+        , _ctx(std::move(ctx))
+    { }
+
+    virtual future<> fill_buffer() override {
+        return repeat([this] {
+            auto& c = _ctx->consumer;
+            while (c.has_fragments() && !is_buffer_full()) {
+                push_mutation_fragment(c.pop_fragment());
+            }
+            if (is_buffer_full()) {
+                return make_ready_future<stop_iteration>(stop_iteration::yes);
+            }
+            if (c.partition_end()) {
+                _end_of_stream = true;
+                return make_ready_future<stop_iteration>(stop_iteration::yes);
+            }
+            return _ctx->context->read().then([] {
+                return stop_iteration::no;
+            });
+        });
+    }
+};
+
+class sstable_streamed_reader : public streamed_mutation_reader::impl {
+    schema_ptr _schema;
+    lw_shared_ptr<sstable_streamed_read_context> _ctx;
+    std::function<future<data_consume_context> ()> _get_context;
+private:
+    future<> skip_partition() {
+        auto& c = _ctx->consumer;
+        c.skip_partition();
+        return do_until([&c] { return !c.in_partition(); }, [this] {
+            return _ctx->context->read();
+        });
+    }
+
+    future<streamed_mutation_opt> do_read() {
+        return skip_partition().then([this] {
+            _ctx->consumer.next_partition();
+            return _ctx->context->read();
+        }).then([this] {
+            if (!_ctx->consumer.key()) {
+                return streamed_mutation_opt();
+            }
+            return streamed_mutation_opt(make_streamed_mutation<sstable_streamed_mutation>(_schema, _ctx));
+        });
+    }
+public:
+    sstable_streamed_reader(sstable& sst,
+                            schema_ptr schema,
+                            std::function<future<uint64_t>()> start,
+                            std::function<future<uint64_t>()> end,
+                            query::clustering_key_filtering_context ck_filtering,
+                            const io_priority_class& pc)
+        : _schema(schema)
+        , _ctx(make_lw_shared<sstable_streamed_read_context>(schema, ck_filtering, pc))
+        , _get_context([ctx = _ctx, &sst, start = std::move(start), end = std::move(end)] () {
+            return start().then([ctx, &sst, end = std::move(end)] (uint64_t start) {
+                return end().then([ctx, &sst, start] (uint64_t end) {
+                    return make_ready_future<data_consume_context>(sst.data_consume_rows(ctx->consumer, start, end));
+                });
+            });
+        }) { }
+    sstable_streamed_reader(sstable& sst, schema_ptr schema, const io_priority_class& pc)
+        : _schema(schema)
+        , _ctx(make_lw_shared<sstable_streamed_read_context>(schema, query::no_clustering_key_filtering, pc))
+        , _get_context([ctx = _ctx, &sst] {
+            return make_ready_future<data_consume_context>(sst.data_consume_rows(ctx->consumer));
+        }) { }
+
+    // Returns the next partition. Any part of the previous one which wasn't
+    // consumed yet is skipped.
+    virtual future<streamed_mutation_opt> operator()() override {
+        if (_ctx->context) {
+            return do_read();
+        }
+        return _get_context().then([this] (data_consume_context context) {
+            _ctx->context = std::move(context);
+            return do_read();
+        });
+    }
+};
+
+streamed_mutation_reader sstable::read_rows_streamed(schema_ptr schema, const io_priority_class& pc) {
+    return make_streamed_mutation_reader<sstable_streamed_reader>(*this, std::move(schema), pc);
+}
+
+streamed_mutation_reader
+sstable::read_range_rows_streamed(schema_ptr schema,
+                                  const query::partition_range& range,
+                                  query::clustering_key_filtering_context ck_filtering,
+                                  const io_priority_class& pc) {
+    if (query::is_wrap_around(range, *schema)) {
+        fail(unimplemented::cause::WRAP_AROUND);
+    }
+
+    auto start = [this, range, schema, &pc] {
+        return range.start() ? (range.start()->is_inclusive()
+                 ? lower_bound(schema, range.start()->value(), pc)
+                 : upper_bound(schema, range.start()->value(), pc))
+        : make_ready_future<uint64_t>(0);
+    };
+
+    auto end = [this, range, schema, &pc] {
+        return range.end() ? (range.end()->is_inclusive()
+                 ? upper_bound(schema, range.end()->value(), pc)
+                 : lower_bound(schema, range.end()->value(), pc))
+        : make_ready_future<uint64_t>(data_size());
+    };
+
+    return make_streamed_mutation_reader<sstable_streamed_reader>(
+        *this, std::move(schema), std::move(start), std::move(end), ck_filtering, pc);
+}
+
 
 class key_reader final : public ::key_reader::impl {
     schema_ptr _s;
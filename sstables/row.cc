@@ -21,6 +21,8 @@
 
 #include "sstables.hh"
 #include "consumer.hh"
+#include "core/future-util.hh"
+#include "core/do_with.hh"
 
 namespace sstables {
 
@@ -130,11 +132,14 @@ class data_consume_rows_context : public data_consumer::continuous_data_consumer
             deletion_time del;
             del.local_deletion_time = _u32;
             del.marked_for_delete_at = _u64;
-            _consumer.consume_row_start(to_bytes_view(_key), del);
+            auto ret = _consumer.consume_row_start(to_bytes_view(_key), del);
             // after calling the consume function, we can release the
             // buffers we held for it.
             _key.release();
             _state = state::ATOM_START;
+            if (ret == row_consumer::proceed::no) {
+                return row_consumer::proceed::no;
+            }
         }
         case state::ATOM_START:
             if (read_16(data) == read_status::ready) {
@@ -236,6 +241,7 @@ class data_consume_rows_context : public data_consumer::continuous_data_consumer
                 // need to copy, and can skip the CELL_VALUE_BYTES_2 state.
                 //
                 // finally pass it to the consumer:
+                row_consumer::proceed ret;
                 if (_deleted) {
                     if (_val.size() != 4) {
                         throw malformed_sstable_exception("deleted cell expects local_deletion_time value");
@@ -243,9 +249,9 @@ class data_consume_rows_context : public data_consumer::continuous_data_consumer
                     deletion_time del;
                     del.local_deletion_time = consume_be<uint32_t>(_val);
                     del.marked_for_delete_at = _u64;
-                    _consumer.consume_deleted_cell(to_bytes_view(_key), del);
+                    ret = _consumer.consume_deleted_cell(to_bytes_view(_key), del);
                 } else {
-                    _consumer.consume_cell(to_bytes_view(_key),
+                    ret = _consumer.consume_cell(to_bytes_view(_key),
                             to_bytes_view(_val), _u64, _ttl, _expiration);
                 }
                 // after calling the consume function, we can release the
@@ -253,11 +259,16 @@ class data_consume_rows_context : public data_consumer::continuous_data_consumer
                 _key.release();
                 _val.release();
                 _state = state::ATOM_START;
+                if (ret == row_consumer::proceed::no) {
+                    return row_consumer::proceed::no;
+                }
             } else {
                 _state = state::CELL_VALUE_BYTES_2;
             }
             break;
         case state::CELL_VALUE_BYTES_2:
+        {
+            row_consumer::proceed ret;
             if (_deleted) {
                 if (_val.size() != 4) {
                     throw malformed_sstable_exception("deleted cell expects local_deletion_time value");
@@ -265,9 +276,9 @@ class data_consume_rows_context : public data_consumer::continuous_data_consumer
                 deletion_time del;
                 del.local_deletion_time = consume_be<uint32_t>(_val);
                 del.marked_for_delete_at = _u64;
-                _consumer.consume_deleted_cell(to_bytes_view(_key), del);
+                ret = _consumer.consume_deleted_cell(to_bytes_view(_key), del);
             } else {
-                _consumer.consume_cell(to_bytes_view(_key),
+                ret = _consumer.consume_cell(to_bytes_view(_key),
                         to_bytes_view(_val), _u64, _ttl, _expiration);
             }
             // after calling the consume function, we can release the
@@ -275,7 +286,11 @@ class data_consume_rows_context : public data_consumer::continuous_data_consumer
             _key.release();
             _val.release();
             _state = state::ATOM_START;
+            if (ret == row_consumer::proceed::no) {
+                return row_consumer::proceed::no;
+            }
             break;
+        }
         case state::RANGE_TOMBSTONE:
             if (read_16(data) != read_status::ready) {
                 _state = state::RANGE_TOMBSTONE_2;
@@ -302,11 +317,14 @@ class data_consume_rows_context : public data_consumer::continuous_data_consumer
             deletion_time del;
             del.local_deletion_time = _u32;
             del.marked_for_delete_at = _u64;
-            _consumer.consume_range_tombstone(to_bytes_view(_key),
+            auto ret = _consumer.consume_range_tombstone(to_bytes_view(_key),
                     to_bytes_view(_val), del);
             _key.release();
             _val.release();
             _state = state::ATOM_START;
+            if (ret == row_consumer::proceed::no) {
+                return row_consumer::proceed::no;
+            }
             break;
         }
         default:
@@ -384,4 +402,30 @@ future<> sstable::data_consume_rows_at_once(row_consumer& consumer,
     });
 }
 
+future<> sstable::data_consume_partition_parts(row_consumer& consumer,
+        std::vector<std::pair<uint64_t, uint64_t>> parts) {
+    return do_with(std::move(parts), std::vector<temporary_buffer<char>>(), [this, &consumer] (auto& parts, auto& bufs) {
+        return do_for_each(parts, [this, &consumer, &bufs] (auto& part) {
+            return this->data_read(part.first, part.second - part.first, consumer.io_priority()).then([&bufs] (temporary_buffer<char> buf) {
+                bufs.push_back(std::move(buf));
+            });
+        }).then([&consumer, &bufs] {
+            static constexpr size_t end_of_row_size = sizeof(int16_t);
+            size_t size = end_of_row_size;
+            for (auto&& b : bufs) {
+                size += b.size();
+            }
+            temporary_buffer<char> buf(size);
+            auto p = buf.get_write();
+            for (auto&& b : bufs) {
+                p = std::copy(b.begin(), b.end(), p);
+            }
+            std::fill_n(p, end_of_row_size, 0);
+            data_consume_rows_context ctx(consumer, input_stream<char>(), -1);
+            ctx.process(buf);
+            ctx.verify_end_state();
+        });
+    });
+}
+
 }
@@ -36,6 +36,11 @@
 // * Finally, consume_row_end() is called. A consumer written for a single
 //   column will likely not want to do anything here.
 //
+// Each of the consume_* functions returns a flag saying whether the feeder
+// should stop after it, or proceed consuming more data. When stopped, the
+// feeder will continue from the next atom once it is asked to read again,
+// which allows a consumer to pause in the middle of a large row.
+//
 // Important note: the row key, column name and column value, passed to the
 // consume_* functions, are passed as a "bytes_view" object, which points to
 // internal data held by the feeder. This internal data is only valid for the
@@ -54,7 +59,7 @@ class row_consumer {
     // (according to the schema) before use.
     // As explained above, the key object is only valid during this call, and
     // if the implementation wishes to save it, it must copy the *contents*.
-    virtual void consume_row_start(sstables::key_view key, sstables::deletion_time deltime) = 0;
+    virtual proceed consume_row_start(sstables::key_view key, sstables::deletion_time deltime) = 0;
 
     // Consume one cell (column name and value). Both are serialized, and need
     // to be deserialized according to the schema.
@@ -62,22 +67,20 @@ class row_consumer {
     // (in seconds) originally set for this cell, and "expiration" is the
     // absolute time (in seconds since the UNIX epoch) when this cell will
     // expire. Typical cells, not set to expire, will get expiration = 0.
-    virtual void consume_cell(bytes_view col_name, bytes_view value,
+    virtual proceed consume_cell(bytes_view col_name, bytes_view value,
             int64_t timestamp,
             int32_t ttl, int32_t expiration) = 0;
 
 
     // Consume a deleted cell (i.e., a cell tombstone).
-    virtual void consume_deleted_cell(bytes_view col_name, sstables::deletion_time deltime) = 0;
+    virtual proceed consume_deleted_cell(bytes_view col_name, sstables::deletion_time deltime) = 0;
 
     // Consume one range tombstone.
-    virtual void consume_range_tombstone(
+    virtual proceed consume_range_tombstone(
             bytes_view start_col, bytes_view end_col,
             sstables::deletion_time deltime) = 0;
 
     // Called at the end of the row, after all cells.
-    // Returns a flag saying whether the sstable consumer should stop now, or
-    // proceed consuming more data.
     virtual proceed consume_row_end() = 0;
 
     // Under which priority class to place I/O coming from this consumer
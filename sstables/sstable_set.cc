@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ *
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <boost/range/adaptor/map.hpp>
+#include "sstable_set.hh"
+
+namespace sstables {
+
+static bool before_range_start(const schema& s, const dht::decorated_key& dk, const query::partition_range& range) {
+    auto& start = range.start();
+    if (!start) {
+        return false;
+    }
+    auto r = dk.tri_compare(s, start->value());
+    return r < 0 || (r == 0 && !start->is_inclusive());
+}
+
+static bool after_range_end(const schema& s, const dht::decorated_key& dk, const query::partition_range& range) {
+    auto& end = range.end();
+    if (!end) {
+        return false;
+    }
+    auto r = dk.tri_compare(s, end->value());
+    return r > 0 || (r == 0 && !end->is_inclusive());
+}
+
+sstable_set::sstable_set(schema_ptr s)
+    : _schema(std::move(s))
+{ }
+
+sstable_set::sstable_set(schema_ptr s, const sstable_list& sstables)
+    : sstable_set(std::move(s))
+{
+    for (auto&& sst : sstables | boost::adaptors::map_values) {
+        insert(sst);
+    }
+}
+
+void sstable_set::rebuild_max_last(run& r, size_t from) {
+    r.max_last.resize(r.entries.size());
+    for (size_t i = from; i < r.entries.size(); ++i) {
+        if (i == 0) {
+            r.max_last[i] = i;
+            continue;
+        }
+        auto prev = r.max_last[i - 1];
+        r.max_last[i] = r.entries[i].last.tri_compare(*_schema, r.entries[prev].last) > 0 ? i : prev;
+    }
+}
+
+void sstable_set::insert(shared_sstable sst) {
+    ++_size;
+    auto& summary = sst->get_summary();
+    if (summary.first_key.value.empty() || summary.last_key.value.empty()) {
+        _unbounded.push_back(std::move(sst));
+        return;
+    }
+    auto level = sst->get_sstable_level();
+    if (level >= _levels.size()) {
+        _levels.resize(level + 1);
+    }
+    auto& r = _levels[level];
+    auto first = sst->get_first_decorated_key(*_schema);
+    auto last = sst->get_last_decorated_key(*_schema);
+    auto it = std::upper_bound(r.entries.begin(), r.entries.end(), first, [this] (const dht::decorated_key& k, const entry& e) {
+        return k.less_compare(*_schema, e.first);
+    });
+    auto pos = std::distance(r.entries.begin(), it);
+    r.entries.insert(it, entry{std::move(first), std::move(last), std::move(sst)});
+    rebuild_max_last(r, pos);
+}
+
+void sstable_set::select_from(const run& r, const query::partition_range& range, std::vector<shared_sstable>& out) const {
+    auto hi = std::partition_point(r.entries.begin(), r.entries.end(), [&] (const entry& e) {
+        return !after_range_end(*_schema, e.first, range);
+    });
+    for (auto i = std::distance(r.entries.begin(), hi); i-- > 0;) {
+        if (before_range_start(*_schema, r.entries[r.max_last[i]].last, range)) {
+            // No sstable at or before i reaches the range.
+            break;
+        }
+        if (!before_range_start(*_schema, r.entries[i].last, range)) {
+            out.push_back(r.entries[i].sst);
+        }
+    }
+}
+
+std::vector<shared_sstable> sstable_set::select(const query::partition_range& range) const {
+    std::vector<shared_sstable> ret;
+    ret.insert(ret.end(), _unbounded.begin(), _unbounded.end());
+    if (range.is_wrap_around(dht::ring_position_comparator(*_schema))) {
+        auto unwrapped = range.unwrap();
+        for (auto&& r : _levels) {
+            select_from(r, unwrapped.first, ret);
+            select_from(r, unwrapped.second, ret);
+        }
+        // An sstable can overlap both halves.
+        std::sort(ret.begin(), ret.end(), [] (const shared_sstable& a, const shared_sstable& b) {
+            return a.get() < b.get();
+        });
+        ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+        return ret;
+    }
+    for (auto&& r : _levels) {
+        select_from(r, range, ret);
+    }
+    return ret;
+}
+
+}
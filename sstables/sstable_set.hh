@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ *
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "sstables.hh"
+#include "query-request.hh"
+
+namespace sstables {
+
+// A set of sstables indexed by the partition range they cover, used to find
+// the sstables which may contain data for a given query::partition_range
+// without having to open a reader for each sstable of a column family.
+//
+// Sstables are grouped by their level. Within a level, they are kept sorted
+// by first key, and for each position we also remember which of the sstables
+// up to and including it reaches furthest into the ring. For levels whose
+// sstables don't overlap (levels >= 1 of leveled compaction) a lookup is then
+// a binary search followed by a walk over the matching sstables only. Levels
+// with overlapping sstables are still handled correctly, they just need to
+// walk more entries.
+//
+// The set is copied on update (like sstable_list), so that on-going reads can
+// continue using the old one.
+class sstable_set {
+    struct entry {
+        dht::decorated_key first;
+        dht::decorated_key last;
+        shared_sstable sst;
+    };
+    struct run {
+        // Sorted by first key.
+        std::vector<entry> entries;
+        // max_last[i] is the index of the entry with greatest last key
+        // among entries[0..i].
+        std::vector<size_t> max_last;
+    };
+    schema_ptr _schema;
+    std::vector<run> _levels;
+    // Sstables for which key boundaries are not known. They are returned
+    // for every query.
+    std::vector<shared_sstable> _unbounded;
+    size_t _size = 0;
+private:
+    void rebuild_max_last(run& r, size_t from);
+    void select_from(const run& r, const query::partition_range& range, std::vector<shared_sstable>& out) const;
+public:
+    explicit sstable_set(schema_ptr s);
+    sstable_set(schema_ptr s, const sstable_list& sstables);
+
+    void insert(shared_sstable sst);
+
+    // Returns all sstables which may contain partitions from the given range.
+    std::vector<shared_sstable> select(const query::partition_range& range) const;
+
+    size_t size() const {
+        return _size;
+    }
+};
+
+}
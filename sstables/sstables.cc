@@ -868,11 +868,19 @@ void write_digest(const sstring file_path, uint32_t full_checksum) {
 thread_local std::array<std::vector<int>, downsampling::BASE_SAMPLING_LEVEL> downsampling::_sample_pattern_cache;
 thread_local std::array<std::vector<int>, downsampling::BASE_SAMPLING_LEVEL> downsampling::_original_index_cache;
 
-future<index_list> sstable::read_indexes(uint64_t summary_idx, const io_priority_class& pc) {
+future<index_list> sstable::read_indexes(uint64_t summary_idx, const io_priority_class& pc, index_cache_policy policy) {
     if (summary_idx >= _summary.header.size) {
         return make_ready_future<index_list>(index_list());
     }
 
+    if (policy == index_cache_policy::populate) {
+        auto cached = global_index_cache().get(_index_cache_id, summary_idx);
+        if (cached) {
+            return make_ready_future<index_list>(std::move(*cached));
+        }
+    }
+
+    uint64_t page = summary_idx;
     uint64_t position = _summary.entries[summary_idx].position;
     uint64_t quantity = downsampling::get_effective_index_interval_after_index(summary_idx, _summary.header.sampling_level,
         _summary.header.min_index_interval);
@@ -884,7 +892,7 @@ future<index_list> sstable::read_indexes(uint64_t summary_idx, const io_priority
         end = _summary.entries[summary_idx].position;
     }
 
-    return do_with(index_consumer(quantity), [this, position, end, &pc] (index_consumer& ic) {
+    return do_with(index_consumer(quantity), [this, page, position, end, &pc, policy] (index_consumer& ic) {
         file_input_stream_options options;
         options.buffer_size = sstable_buffer_size;
         options.io_priority_class = pc;
@@ -892,7 +900,10 @@ future<index_list> sstable::read_indexes(uint64_t summary_idx, const io_priority
         // TODO: it's redundant to constrain the consumer here to stop at
         // index_size()-position, the input stream is already constrained.
         auto ctx = make_lw_shared<index_consume_entry_context<index_consumer>>(ic, std::move(stream), this->index_size() - position);
-        return ctx->consume_input(*ctx).then([ctx, &ic] {
+        return ctx->consume_input(*ctx).then([this, page, ctx, &ic, policy] {
+            if (policy == index_cache_policy::populate) {
+                global_index_cache().insert(_index_cache_id, page, ic.indexes);
+            }
             return make_ready_future<index_list>(std::move(ic.indexes));
         });
     });
@@ -1123,6 +1134,7 @@ void sstable::write_cell(file_writer& out, atomic_cell_view cell) {
         uint32_t deletion_time = cell.deletion_time().time_since_epoch().count();
 
         _c_stats.tombstone_histogram.update(deletion_time);
+        _c_stats.update_max_local_deletion_time(deletion_time);
 
         write(out, mask, timestamp, deletion_time_size, deletion_time);
     } else if (cell.is_live_and_has_ttl()) {
@@ -1133,6 +1145,8 @@ void sstable::write_cell(file_writer& out, atomic_cell_view cell) {
         uint32_t expiration = cell.expiry().time_since_epoch().count();
         disk_string_view<uint32_t> cell_value { cell.value() };
 
+        _c_stats.update_max_local_deletion_time(expiration);
+
         write(out, mask, ttl, expiration, timestamp, cell_value);
     } else {
         // regular cell
@@ -1140,12 +1154,14 @@ void sstable::write_cell(file_writer& out, atomic_cell_view cell) {
         column_mask mask = column_mask::none;
         disk_string_view<uint32_t> cell_value { cell.value() };
 
+        _c_stats.update_max_local_deletion_time(std::numeric_limits<int>::max());
+
         write(out, mask, timestamp, cell_value);
     }
 }
 
-void sstable::write_row_marker(file_writer& out, const rows_entry& clustered_row, const composite& clustering_key) {
-    const auto& marker = clustered_row.row().marker();
+void sstable::write_row_marker(file_writer& out, const clustering_row& clustered_row, const composite& clustering_key) {
+    const auto& marker = clustered_row.marker();
     if (marker.is_missing()) {
         return;
     }
@@ -1163,15 +1179,18 @@ void sstable::write_row_marker(file_writer& out, const rows_entry& clustered_row
         uint32_t deletion_time = marker.deletion_time().time_since_epoch().count();
 
         _c_stats.tombstone_histogram.update(deletion_time);
+        _c_stats.update_max_local_deletion_time(deletion_time);
 
         write(out, mask, timestamp, deletion_time_size, deletion_time);
     } else if (marker.is_expiring()) {
         column_mask mask = column_mask::expiration;
         uint32_t ttl = marker.ttl().count();
         uint32_t expiration = marker.expiry().time_since_epoch().count();
+        _c_stats.update_max_local_deletion_time(expiration);
         write(out, mask, ttl, expiration, timestamp, value_length);
     } else {
         column_mask mask = column_mask::none;
+        _c_stats.update_max_local_deletion_time(std::numeric_limits<int>::max());
         write(out, mask, timestamp, value_length);
     }
 }
@@ -1202,6 +1221,7 @@ void sstable::write_range_tombstone(file_writer& out,
 
     update_cell_stats(_c_stats, timestamp);
     _c_stats.tombstone_histogram.update(deletion_time);
+    _c_stats.update_max_local_deletion_time(deletion_time);
 
     write(out, deletion_time, timestamp);
 }
@@ -1220,19 +1240,19 @@ void sstable::write_collection(file_writer& out, const composite& clustering_key
 
 // write_datafile_clustered_row() is about writing a clustered_row to data file according to SSTables format.
 // clustered_row contains a set of cells sharing the same clustering key.
-void sstable::write_clustered_row(file_writer& out, const schema& schema, const rows_entry& clustered_row) {
+void sstable::write_clustered_row(file_writer& out, const schema& schema, const clustering_row& clustered_row) {
     auto clustering_key = composite::from_clustering_element(schema, clustered_row.key());
 
     if (schema.is_compound() && !schema.is_dense()) {
         write_row_marker(out, clustered_row, clustering_key);
     }
     // Before writing cells, range tombstone must be written if the row has any (deletable_row::t).
-    if (clustered_row.row().deleted_at()) {
-        write_range_tombstone(out, clustering_key, clustering_key, {}, clustered_row.row().deleted_at());
+    if (clustered_row.tomb()) {
+        write_range_tombstone(out, clustering_key, clustering_key, {}, clustered_row.tomb());
     }
 
     // Write all cells of a partition's row.
-    clustered_row.row().cells().for_each_cell([&] (column_id id, const atomic_cell_or_collection& c) {
+    clustered_row.cells().for_each_cell([&] (column_id id, const atomic_cell_or_collection& c) {
         auto&& column_definition = schema.regular_column_at(id);
         // non atomic cell isn't supported yet. atomic cell maps to a single trift cell.
         // non atomic cell maps to multiple trift cell, e.g. collection.
@@ -1277,11 +1297,109 @@ void sstable::write_static_row(file_writer& out, const schema& schema, const row
     });
 }
 
-static void write_index_entry(file_writer& out, disk_string_view<uint16_t>& key, uint64_t pos) {
-    // FIXME: support promoted indexes.
-    uint32_t promoted_index_size = 0;
+// Granularity of the promoted index: a new block is started once the current
+// one spans that many bytes of the data file. Matches the default of Origin's
+// column_index_size_in_kb.
+static constexpr uint64_t column_index_size = 64 * 1024;
+
+// Builds the promoted index of a partition being written. Atoms of the
+// partition are grouped into blocks of about column_index_size bytes, and for
+// each block we remember the names of its first and last atom together with
+// its position (relative to the start of the partition) and width.
+//
+// Blocks are only closed between clustering rows, so a row never spans two
+// blocks. The first block starts with the partition header, and the range
+// tombstones which are still open at the start of each of the following
+// blocks are written again at its beginning, so that readers which skip to
+// a block see all tombstones covering its rows.
+class promoted_index_builder {
+    struct block {
+        bytes first_name;
+        bytes last_name;
+        uint64_t offset;
+        uint64_t width;
+    };
+    uint64_t _partition_start;
+    std::vector<block> _blocks;
+    bool _open = false;
+    bytes _first_name;
+    uint64_t _block_start;
+public:
+    explicit promoted_index_builder(uint64_t partition_start)
+        : _partition_start(partition_start)
+    { }
+
+    bool block_open() const {
+        return _open;
+    }
+
+    void open_block(bytes first_name, uint64_t pos) {
+        _first_name = std::move(first_name);
+        _block_start = pos;
+        _open = true;
+    }
+
+    bool block_full(uint64_t pos) const {
+        return _open && pos - _block_start >= column_index_size;
+    }
+
+    void close_block(bytes last_name, uint64_t pos) {
+        _blocks.push_back({std::move(_first_name), std::move(last_name), _block_start - _partition_start, pos - _block_start});
+        _open = false;
+    }
+
+    // Origin only writes a promoted index for partitions with more than
+    // one block, as there is nothing to skip otherwise.
+    bool needed() const {
+        return _blocks.size() > 1;
+    }
 
+    uint32_t serialized_size() const {
+        uint32_t size = sizeof(int32_t) + sizeof(int64_t) + sizeof(uint32_t);
+        for (auto&& b : _blocks) {
+            size += sizeof(uint16_t) + b.first_name.size() + sizeof(uint16_t) + b.last_name.size() + 2 * sizeof(uint64_t);
+        }
+        return size;
+    }
+
+    void write(file_writer& out, deletion_time d) {
+        sstables::write(out, d);
+        uint32_t nr_blocks = _blocks.size();
+        sstables::write(out, nr_blocks);
+        for (auto&& b : _blocks) {
+            disk_string_view<uint16_t> first_name;
+            first_name.value = b.first_name;
+            disk_string_view<uint16_t> last_name;
+            last_name.value = b.last_name;
+            sstables::write(out, first_name, last_name, b.offset, b.width);
+        }
+    }
+};
+
+// Name of a clustering row as used in the promoted index. With
+// composite_marker::none it sorts before all cells of the row, and with
+// composite_marker::end_range after all of them.
+static bytes promoted_index_name(const schema& s, const clustering_key_prefix& ck, composite_marker m) {
+    if (!s.is_compound()) {
+        return ck.size(s) ? to_bytes(ck.get_component(s, 0)) : bytes();
+    }
+    auto b = to_bytes(bytes_view(composite::from_clustering_element(s, ck)));
+    if (!b.empty()) {
+        b.back() = bytes::value_type(m);
+    }
+    return b;
+}
+
+static void write_index_entry(file_writer& out, disk_string_view<uint16_t>& key, uint64_t pos,
+        deletion_time d, promoted_index_builder& promoted_index) {
+    if (!promoted_index.needed()) {
+        uint32_t promoted_index_size = 0;
+        write(out, key, pos, promoted_index_size);
+        return;
+    }
+    uint32_t promoted_index_size = promoted_index.serialized_size();
     write(out, key, pos, promoted_index_size);
+    promoted_index.write(out, d);
 }
 
 static void prepare_summary(summary& s, uint64_t expected_partition_count, uint32_t min_index_interval) {
@@ -1381,7 +1499,7 @@ static void seal_statistics(statistics& s, metadata_collector& collector,
 ///
 ///  @param out holds an output stream to data file.
 ///
-void sstable::do_write_components(::mutation_reader mr,
+void sstable::do_write_components(::streamed_mutation_reader mr,
         uint64_t estimated_partitions, schema_ptr schema, uint64_t max_sstable_size, file_writer& out,
         const io_priority_class& pc) {
     file_output_stream_options options;
@@ -1412,15 +1530,15 @@ void sstable::do_write_components(::mutation_reader mr,
     // Iterate through CQL partitions, then CQL rows, then CQL columns.
     // Each mt.all_partitions() entry is a set of clustered rows sharing the same partition key.
     while (get_offset() < max_sstable_size) {
-        mutation_opt mut = mr().get0();
-        if (!mut) {
+        streamed_mutation_opt sm = mr().get0();
+        if (!sm) {
             break;
         }
 
         // Set current index of data to later compute row size.
         _c_stats.start_offset = out.offset();
 
-        auto partition_key = key::from_partition_key(*schema, mut->key());
+        auto partition_key = key::from_partition_key(*schema, sm->key());
 
         maybe_add_summary_entry(_summary, bytes_view(partition_key), index->offset());
         _filter->add(bytes_view(partition_key));
@@ -1429,13 +1547,13 @@ void sstable::do_write_components(::mutation_reader mr,
         auto p_key = disk_string_view<uint16_t>();
         p_key.value = bytes_view(partition_key);
 
-        // Write index file entry from partition key into index file.
-        write_index_entry(*index, p_key, out.offset());
+        auto partition_start = out.offset();
+        promoted_index_builder promoted_index(partition_start);
 
         // Write partition key into data file.
         write(out, p_key);
 
-        auto tombstone = mut->partition().partition_tombstone();
+        auto tombstone = sm->partition_tombstone();
         deletion_time d;
 
         if (tombstone) {
@@ -1453,23 +1571,83 @@ void sstable::do_write_components(::mutation_reader mr,
         }
         write(out, d);
 
-        auto& partition = mut->partition();
-        auto& static_row = partition.static_row();
-
-        write_static_row(out, *schema, static_row);
-        for (const auto& rt: partition.row_tombstones()) {
-            auto start = composite::from_clustering_element(*schema, rt.start);
-            auto end = composite::from_clustering_element(*schema, rt.end);
-            write_range_tombstone(out, std::move(start), rt.start_kind, std::move(end), rt.end_kind, {}, rt.tomb);
+        // Range tombstones already written which may still cover the
+        // fragments which follow, see promoted_index_builder.
+        std::vector<range_tombstone> open_tombstones;
+        position_in_partition_view::less_compare less(*schema);
+        bytes last_name;
+        position_in_partition last_pos(position_in_partition_view::static_row_tag_t{});
+        auto open_block = [&] (position_in_partition_view pos, bytes first_name) {
+            open_tombstones.erase(std::remove_if(open_tombstones.begin(), open_tombstones.end(), [&] (const range_tombstone& rt) {
+                return !less(pos, position_in_partition_view(rt.end_bound()));
+            }), open_tombstones.end());
+            if (!open_tombstones.empty()) {
+                first_name = promoted_index_name(*schema, open_tombstones.front().start, composite_marker::none);
+            }
+            promoted_index.open_block(std::move(first_name), out.offset());
+            for (auto&& rt : open_tombstones) {
+                write_range_tombstone(out, composite::from_clustering_element(*schema, rt.start), rt.start_kind,
+                        composite::from_clustering_element(*schema, rt.end), rt.end_kind, {}, rt.tomb);
+            }
+        };
+        // The block's contents extend to the end of the range tombstones
+        // written in it, which may be past its last fragment. Readers skip
+        // blocks which end before the slice they read, so recording the
+        // last fragment would hide tombstones from slices starting in them.
+        auto close_block = [&] {
+            const range_tombstone* last_rt = nullptr;
+            for (auto&& rt : open_tombstones) {
+                if (!last_rt || less(position_in_partition_view(last_rt->end_bound()), position_in_partition_view(rt.end_bound()))) {
+                    last_rt = &rt;
+                }
+            }
+            if (last_rt && less(last_pos, position_in_partition_view(last_rt->end_bound()))) {
+                last_name = promoted_index_name(*schema, last_rt->end, composite_marker::end_range);
+            }
+            promoted_index.close_block(std::move(last_name), out.offset());
+        };
+
+        // Fragments come in clustering order: the static row, followed by
+        // clustering rows and range tombstones.
+        while (mutation_fragment_opt mf = (*sm)().get0()) {
+            if (mf->is_static_row()) {
+                auto sp = to_bytes(bytes_view(composite::static_prefix(*schema)));
+                promoted_index.open_block(sp, out.offset());
+                write_static_row(out, *schema, mf->as_static_row().cells());
+                last_name = std::move(sp);
+            } else if (mf->is_range_tombstone()) {
+                auto& rt = mf->as_range_tombstone();
+                auto name = promoted_index_name(*schema, rt.start, composite_marker::none);
+                if (!promoted_index.block_open()) {
+                    open_block(mf->position(), name);
+                }
+                write_range_tombstone(out, composite::from_clustering_element(*schema, rt.start), rt.start_kind,
+                        composite::from_clustering_element(*schema, rt.end), rt.end_kind, {}, rt.tomb);
+                last_name = std::move(name);
+                open_tombstones.emplace_back(rt);
+            } else {
+                auto& cr = mf->as_clustering_row();
+                if (!promoted_index.block_open()) {
+                    open_block(mf->position(), promoted_index_name(*schema, cr.key(), composite_marker::none));
+                }
+                write_clustered_row(out, *schema, cr);
+                last_name = promoted_index_name(*schema, cr.key(), composite_marker::end_range);
+            }
+            last_pos = position_in_partition(mf->position());
+            if (promoted_index.block_full(out.offset())) {
+                close_block();
+            }
         }
-
-        // Write all CQL rows from a given mutation partition.
-        for (auto& clustered_row: partition.clustered_rows()) {
-            write_clustered_row(out, *schema, clustered_row);
+        if (promoted_index.block_open()) {
+            close_block();
         }
         int16_t end_of_row = 0;
         write(out, end_of_row);
 
+        // Write index file entry from partition key into index file. It has
+        // to follow the partition, as it contains its promoted index.
+        write_index_entry(*index, p_key, partition_start, d, promoted_index);
+
         // compute size of the current row.
         _c_stats.row_size = out.offset() - _c_stats.start_offset;
         // update is about merging column_stats with the data being stored by collector.
@@ -1497,7 +1675,7 @@ void sstable::do_write_components(::mutation_reader mr,
     seal_statistics(_statistics, _collector, dht::global_partitioner().name(), filter_fp_chance);
 }
 
-void sstable::prepare_write_components(::mutation_reader mr, uint64_t estimated_partitions, schema_ptr schema,
+void sstable::prepare_write_components(::streamed_mutation_reader mr, uint64_t estimated_partitions, schema_ptr schema,
         uint64_t max_sstable_size, const io_priority_class& pc) {
     // CRC component must only be present when compression isn't enabled.
     bool checksum_file = has_component(sstable::component_type::CRC);
@@ -1530,12 +1708,18 @@ void sstable::prepare_write_components(::mutation_reader mr, uint64_t estimated_
 
 future<> sstable::write_components(memtable& mt, bool backup, const io_priority_class& pc) {
     _collector.set_replay_position(mt.replay_position());
-    return write_components(mt.make_reader(mt.schema()),
+    return write_components(mt.make_flush_reader(mt.schema()),
             mt.partition_count(), mt.schema(), std::numeric_limits<uint64_t>::max(), backup, pc);
 }
 
 future<> sstable::write_components(::mutation_reader mr,
         uint64_t estimated_partitions, schema_ptr schema, uint64_t max_sstable_size, bool backup, const io_priority_class& pc) {
+    return write_components(streamed_reader_from_mutation_reader(std::move(mr)),
+            estimated_partitions, std::move(schema), max_sstable_size, backup, pc);
+}
+
+future<> sstable::write_components(::streamed_mutation_reader mr,
+        uint64_t estimated_partitions, schema_ptr schema, uint64_t max_sstable_size, bool backup, const io_priority_class& pc) {
     return seastar::async([this, mr = std::move(mr), estimated_partitions, schema = std::move(schema), max_sstable_size, backup, &pc] () mutable {
         generate_toc(schema->get_compressor_params().get_compressor(), schema->bloom_filter_fp_chance());
         write_toc(pc);
@@ -1879,7 +2063,19 @@ int sstable::compare_by_max_timestamp(const sstable& other) const {
     return (ts1 > ts2 ? 1 : (ts1 == ts2 ? 0 : -1));
 }
 
+double sstable::estimate_droppable_tombstone_ratio(gc_clock::time_point gc_before) const {
+    auto& st = get_stats_metadata();
+    auto& columns = st.estimated_column_count;
+    double estimated_count = columns.count() ? double(columns.mean()) * columns.count() : 0;
+    if (estimated_count <= 0) {
+        return 0;
+    }
+    return st.estimated_tombstone_drop_time.sum(gc_before.time_since_epoch().count()) / estimated_count;
+}
+
 sstable::~sstable() {
+    global_index_cache().invalidate(_index_cache_id);
+
     if (_index_file) {
         _index_file.close().handle_exception([save = _index_file, op = background_jobs().start()] (auto ep) {
             sstlog.warn("sstable close index_file failed: {}", ep);
@@ -32,6 +32,7 @@
 #include <unordered_set>
 #include <unordered_map>
 #include "types.hh"
+#include "index_cache.hh"
 #include "core/enum.hh"
 #include "compress.hh"
 #include "row.hh"
@@ -153,6 +154,14 @@ class sstable {
     // object lives until then (e.g., using the do_with() idiom).
     future<> data_consume_rows_at_once(row_consumer& consumer, uint64_t pos, uint64_t end);
 
+    // Like data_consume_rows_at_once(), but reads a single partition from
+    // several disjoint byte ranges of the data file. The first range must
+    // start at the beginning of the partition, and the others must start
+    // and end at atom boundaries within it, such as those recorded in the
+    // partition's promoted index. The end of partition marker is supplied
+    // by this function, so the last range doesn't need to include it.
+    future<> data_consume_partition_parts(row_consumer& consumer, std::vector<std::pair<uint64_t, uint64_t>> parts);
+
 
     // data_consume_rows() iterates over rows in the data file from
     // a particular range, feeding them into the consumer. The iteration is
@@ -230,6 +239,20 @@ class sstable {
     // progress (i.e., returned a future which hasn't completed yet).
     mutation_reader read_rows(schema_ptr schema, const io_priority_class& pc = default_priority_class());
 
+    // Like read_rows() and read_range_rows(), but each partition is returned
+    // as a streamed_mutation, which reads its fragments from the data file
+    // only as they are consumed, so that partitions needn't fit in memory.
+    //
+    // A streamed_mutation returned by the reader must be consumed, or
+    // destroyed, before the reader is asked for the next one. The remaining
+    // fragments of a partition which wasn't fully consumed are skipped.
+    ::streamed_mutation_reader read_rows_streamed(schema_ptr schema, const io_priority_class& pc = default_priority_class());
+    ::streamed_mutation_reader read_range_rows_streamed(
+        schema_ptr schema,
+        const query::partition_range& range,
+        query::clustering_key_filtering_context ck_filtering = query::no_clustering_key_filtering,
+        const io_priority_class& pc = default_priority_class());
+
     // Write sstable components from a memtable.
     future<> write_components(memtable& mt, bool backup = false,
                               const io_priority_class& pc = default_priority_class());
@@ -238,6 +261,10 @@ class sstable {
             uint64_t estimated_partitions, schema_ptr schema, uint64_t max_sstable_size, bool backup = false,
             const io_priority_class& pc = default_priority_class());
 
+    future<> write_components(::streamed_mutation_reader mr,
+            uint64_t estimated_partitions, schema_ptr schema, uint64_t max_sstable_size, bool backup = false,
+            const io_priority_class& pc = default_priority_class());
+
     uint64_t get_estimated_key_count() const {
         return ((uint64_t)_summary.header.size_at_full_sampling + 1) *
                 _summary.header.min_index_interval;
@@ -300,6 +327,10 @@ class sstable {
     // Return values are those of a trichotomic comparison.
     int compare_by_max_timestamp(const sstable& other) const;
 
+    // Estimates the ratio of the tombstones which can be purged, having
+    // been deleted before gc_before, to the cells of the sstable.
+    double estimate_droppable_tombstone_ratio(gc_clock::time_point gc_before) const;
+
     const sstring get_filename() const {
         return filename(component_type::Data);
     }
@@ -342,10 +373,10 @@ class sstable {
 
     size_t sstable_buffer_size = 128*1024;
 
-    void do_write_components(::mutation_reader mr,
+    void do_write_components(::streamed_mutation_reader mr,
             uint64_t estimated_partitions, schema_ptr schema, uint64_t max_sstable_size,
             file_writer& out, const io_priority_class& pc);
-    void prepare_write_components(::mutation_reader mr,
+    void prepare_write_components(::streamed_mutation_reader mr,
             uint64_t estimated_partitions, schema_ptr schema, uint64_t max_sstable_size,
             const io_priority_class& pc);
     static std::unordered_map<version_types, sstring, enum_hash<version_types>> _version_string;
@@ -379,6 +410,9 @@ class sstable {
 
     filter_tracker _filter_tracker;
 
+    // Identifies this sstable's pages in the shard's index_cache.
+    uint64_t _index_cache_id = global_index_cache().new_sstable_id();
+
     bool _marked_for_deletion = false;
 
     gc_clock::time_point _now;
@@ -422,7 +456,13 @@ class sstable {
 
     future<> create_data();
 
-    future<index_list> read_indexes(uint64_t summary_idx, const io_priority_class& pc);
+    // Single-partition lookups go through the index cache. Scans and
+    // compaction bypass it, so that they neither evict the pages of hot
+    // partitions nor skew its hit rate.
+    enum class index_cache_policy { populate, bypass };
+
+    future<index_list> read_indexes(uint64_t summary_idx, const io_priority_class& pc,
+            index_cache_policy policy = index_cache_policy::bypass);
 
     input_stream<char> data_stream_at(uint64_t pos, uint64_t buf_size, const io_priority_class& pc);
 
@@ -447,7 +487,8 @@ class sstable {
     future<uint64_t> data_end_position(uint64_t summary_idx, uint64_t index_idx, const index_list& il, const io_priority_class& pc);
 
     // Returns data file position for an entry right after all entries mapped by given summary page.
-    future<uint64_t> data_end_position(uint64_t summary_idx, const io_priority_class& pc);
+    future<uint64_t> data_end_position(uint64_t summary_idx, const io_priority_class& pc,
+            index_cache_policy policy = index_cache_policy::bypass);
 
     template <typename T>
     int binary_search(const T& entries, const key& sk, const dht::token& token);
@@ -478,8 +519,8 @@ class sstable {
     bool filter_has_key(const schema& s, const dht::decorated_key& dk) { return filter_has_key(key::from_partition_key(s, dk._key)); }
 
     // NOTE: functions used to generate sstable components.
-    void write_row_marker(file_writer& out, const rows_entry& clustered_row, const composite& clustering_key);
-    void write_clustered_row(file_writer& out, const schema& schema, const rows_entry& clustered_row);
+    void write_row_marker(file_writer& out, const clustering_row& clustered_row, const composite& clustering_key);
+    void write_clustered_row(file_writer& out, const schema& schema, const clustering_row& clustered_row);
     void write_static_row(file_writer& out, const schema& schema, const row& static_row);
     void write_cell(file_writer& out, atomic_cell_view cell);
     void write_column_name(file_writer& out, const composite& clustering_key, const std::vector<bytes_view>& column_names, composite_marker m = composite_marker::none);
@@ -525,6 +566,9 @@ class sstable {
         const stats_metadata& s = *static_cast<stats_metadata *>(p.get());
         return s;
     }
+    bool has_compaction_metadata() const {
+        return _statistics.contents.count(metadata_type::Compaction);
+    }
     const compaction_metadata& get_compaction_metadata() const {
         auto entry = _statistics.contents.find(metadata_type::Compaction);
         if (entry == _statistics.contents.end()) {
@@ -42,6 +42,7 @@
 #pragma once
 
 #include "disk_types.hh"
+#include <map>
 
 namespace sstables {
 
@@ -139,49 +140,50 @@ struct streaming_histogram {
         }
     }
 
-    /**
-     * Function used to describe the type.
-     */
-    template <typename Describer>
-    auto describe_type(Describer f) { return f(max_bin_size, bin); }
-
-    // FIXME: convert Java code below.
-#if 0
     /**
      * Calculates estimated number of points in interval [-inf,b].
      *
      * @param b upper bound of a interval to calculate sum
      * @return estimated number of points in a interval [-inf,b].
      */
-    public double sum(double b)
-    {
+    double sum(double b) const {
+        // The bins aren't kept sorted.
+        std::map<double, uint64_t> sorted(bin.map.begin(), bin.map.end());
         double sum = 0;
         // find the points pi, pnext which satisfy pi <= b < pnext
-        Map.Entry<Double, Long> pnext = bin.higherEntry(b);
-        if (pnext == null)
-        {
+        auto pnext = sorted.upper_bound(b);
+        if (pnext == sorted.end()) {
             // if b is greater than any key in this histogram,
             // just count all appearance and return
-            for (Long value : bin.values())
-                sum += value;
-        }
-        else
-        {
-            Map.Entry<Double, Long> pi = bin.floorEntry(b);
-            if (pi == null)
+            for (auto& e : sorted) {
+                sum += e.second;
+            }
+        } else {
+            if (pnext == sorted.begin()) {
                 return 0;
+            }
+            auto pi = std::prev(pnext);
             // calculate estimated count mb for point b
-            double weight = (b - pi.getKey()) / (pnext.getKey() - pi.getKey());
-            double mb = pi.getValue() + (pnext.getValue() - pi.getValue()) * weight;
-            sum += (pi.getValue() + mb) * weight / 2;
+            double weight = (b - pi->first) / (pnext->first - pi->first);
+            double mb = pi->second + (double(pnext->second) - pi->second) * weight;
+            sum += (pi->second + mb) * weight / 2;
 
-            sum += pi.getValue() / 2.0;
-            for (Long value : bin.headMap(pi.getKey(), false).values())
-                sum += value;
+            sum += pi->second / 2.0;
+            for (auto it = sorted.begin(); it != pi; ++it) {
+                sum += it->second;
+            }
         }
         return sum;
     }
 
+    /**
+     * Function used to describe the type.
+     */
+    template <typename Describer>
+    auto describe_type(Describer f) { return f(max_bin_size, bin); }
+
+    // FIXME: convert Java code below.
+#if 0
     public Map<Double, Long> getAsMap()
     {
         return Collections.unmodifiableMap(bin);
@@ -75,6 +75,11 @@ class index_entry {
         return _position;
     }
 
+    // Serialized promoted index of the partition; empty if it has none.
+    bytes_view get_promoted_index_bytes() const {
+        return bytes_view(reinterpret_cast<const bytes::value_type *>(_promoted_index.get()), _promoted_index.size());
+    }
+
     index_entry(temporary_buffer<char>&& key, uint64_t position, temporary_buffer<char>&& promoted_index)
         : _key(std::move(key)), _position(position), _promoted_index(std::move(promoted_index)) {}
 
@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "streamed_mutation.hh"
+#include "utils/allocation_strategy.hh"
+
+std::ostream& operator<<(std::ostream& out, position_in_partition_view pos) {
+    if (pos.is_static_row()) {
+        return out << "{position: static}";
+    }
+    return out << "{position: " << *pos.key() << ", weight=" << pos.bound_weight() << "}";
+}
+
+static size_t row_memory_usage(const row& r) {
+    size_t size = 0;
+    r.for_each_cell([&size] (column_id, const atomic_cell_or_collection& c) {
+        size += sizeof(c) + c.serialize().size();
+    });
+    return size;
+}
+
+size_t static_row::memory_usage() const {
+    return sizeof(static_row) + row_memory_usage(_cells);
+}
+
+size_t clustering_row::memory_usage() const {
+    return sizeof(clustering_row) + _ck.representation().size() + row_memory_usage(_row.cells());
+}
+
+mutation_fragment::mutation_fragment(static_row&& r)
+    : _kind(kind::static_row), _data(std::make_unique<data>())
+{
+    new (&_data->_static_row) static_row(std::move(r));
+}
+
+mutation_fragment::mutation_fragment(clustering_row&& r)
+    : _kind(kind::clustering_row), _data(std::make_unique<data>())
+{
+    new (&_data->_clustering_row) clustering_row(std::move(r));
+}
+
+mutation_fragment::mutation_fragment(range_tombstone&& r)
+    : _kind(kind::range_tombstone), _data(std::make_unique<data>())
+{
+    new (&_data->_range_tombstone) range_tombstone(std::move(r), range_tombstone::without_link());
+}
+
+mutation_fragment::~mutation_fragment() {
+    if (!_data) {
+        return;
+    }
+    switch (_kind) {
+    case kind::static_row:
+        _data->_static_row.~static_row();
+        break;
+    case kind::clustering_row:
+        _data->_clustering_row.~clustering_row();
+        break;
+    case kind::range_tombstone:
+        _data->_range_tombstone.~range_tombstone();
+        break;
+    }
+}
+
+position_in_partition_view mutation_fragment::position() const {
+    switch (_kind) {
+    case kind::static_row:
+        return as_static_row().position();
+    case kind::clustering_row:
+        return as_clustering_row().position();
+    case kind::range_tombstone:
+        return position_in_partition_view(as_range_tombstone().start_bound());
+    }
+    abort();
+}
+
+bool mutation_fragment::mergeable_with(const schema& s, const mutation_fragment& mf) const {
+    if (_kind != mf._kind) {
+        return false;
+    }
+    switch (_kind) {
+    case kind::static_row:
+        return true;
+    case kind::clustering_row:
+        return as_clustering_row().key().equal(s, mf.as_clustering_row().key());
+    case kind::range_tombstone:
+        // Range tombstones may overlap, they are passed on as they are.
+        return false;
+    }
+    abort();
+}
+
+void mutation_fragment::apply(const schema& s, mutation_fragment&& mf) {
+    assert(mergeable_with(s, mf));
+    switch (_kind) {
+    case kind::static_row:
+        as_static_row().apply(s, std::move(mf.as_static_row()));
+        break;
+    case kind::clustering_row:
+        as_clustering_row().apply(s, std::move(mf.as_clustering_row()));
+        break;
+    case kind::range_tombstone:
+        abort();
+    }
+}
+
+size_t mutation_fragment::memory_usage() const {
+    switch (_kind) {
+    case kind::static_row:
+        return as_static_row().memory_usage();
+    case kind::clustering_row:
+        return as_clustering_row().memory_usage();
+    case kind::range_tombstone: {
+        auto& rt = as_range_tombstone();
+        return sizeof(range_tombstone) + rt.start.representation().size() + rt.end.representation().size();
+    }
+    }
+    abort();
+}
+
+std::ostream& operator<<(std::ostream& os, const mutation_fragment& mf) {
+    switch (mf._kind) {
+    case mutation_fragment::kind::static_row:
+        return os << "{static_row: " << mf.as_static_row().cells() << "}";
+    case mutation_fragment::kind::clustering_row:
+        return os << "{clustering_row: " << mf.as_clustering_row().key() << " " << mf.as_clustering_row().as_deletable_row() << "}";
+    case mutation_fragment::kind::range_tombstone:
+        return os << mf.as_range_tombstone();
+    }
+    abort();
+}
+
+// Moves the contents of a mutation out of it, a buffer at a time, so that
+// the memory is released as the fragments are consumed.
+class mutation_streamer final : public streamed_mutation::impl {
+    mutation _mutation;
+    bool _static_row_done = false;
+public:
+    explicit mutation_streamer(mutation m)
+        : streamed_mutation::impl(m.schema(), m.decorated_key(), m.partition().partition_tombstone())
+        , _mutation(std::move(m))
+    { }
+
+    virtual future<> fill_buffer() override {
+        auto& p = _mutation.partition();
+        if (!_static_row_done) {
+            _static_row_done = true;
+            if (!p.static_row().empty()) {
+                push_mutation_fragment(static_row(std::move(p.static_row())));
+            }
+        }
+        auto& rows = p.clustered_rows();
+        auto& rts = p.row_tombstones().tombstones();
+        position_in_partition_view::less_compare less(*_schema);
+        while (!is_buffer_full() && (!rows.empty() || !rts.empty())) {
+            if (!rts.empty() && (rows.empty()
+                    || less(position_in_partition_view(rts.begin()->start_bound()), position_in_partition_view(rows.begin()->key())))) {
+                range_tombstone rt(std::move(*rts.begin()), range_tombstone::without_link());
+                rts.erase_and_dispose(rts.begin(), current_deleter<range_tombstone>());
+                push_mutation_fragment(std::move(rt));
+            } else {
+                auto& e = *rows.begin();
+                clustering_row cr(std::move(e.key()), std::move(e.row()));
+                rows.erase_and_dispose(rows.begin(), current_deleter<rows_entry>());
+                push_mutation_fragment(std::move(cr));
+            }
+        }
+        _end_of_stream = rows.empty() && rts.empty();
+        return make_ready_future<>();
+    }
+};
+
+streamed_mutation streamed_mutation_from_mutation(mutation m) {
+    return make_streamed_mutation<mutation_streamer>(std::move(m));
+}
+
+class mutation_merger final : public streamed_mutation::impl {
+    struct source {
+        streamed_mutation sm;
+        mutation_fragment_opt head;
+        bool finished = false;
+
+        explicit source(streamed_mutation&& sm) : sm(std::move(sm)) { }
+    };
+    std::vector<source> _sources;
+private:
+    static tombstone merged_tombstone(const std::vector<streamed_mutation>& ms) {
+        tombstone t;
+        for (auto&& sm : ms) {
+            t.apply(sm.partition_tombstone());
+        }
+        return t;
+    }
+
+    // Makes sure that each source which is not finished has its next
+    // fragment available.
+    future<> fetch() {
+        return parallel_for_each(_sources, [] (source& s) {
+            if (s.head || s.finished) {
+                return make_ready_future<>();
+            }
+            return s.sm().then([&s] (mutation_fragment_opt mf) {
+                if (mf) {
+                    s.head = std::move(mf);
+                } else {
+                    s.finished = true;
+                }
+            });
+        });
+    }
+public:
+    explicit mutation_merger(std::vector<streamed_mutation> ms)
+        : streamed_mutation::impl(ms.front().schema(), ms.front().decorated_key(), merged_tombstone(ms))
+    {
+        _sources.reserve(ms.size());
+        for (auto&& sm : ms) {
+            _sources.emplace_back(std::move(sm));
+        }
+    }
+
+    virtual future<> fill_buffer() override {
+        return repeat([this] {
+            return fetch().then([this] {
+                position_in_partition_view::less_compare less(*_schema);
+                source* min = nullptr;
+                for (auto&& s : _sources) {
+                    if (s.head && (!min || less(s.head->position(), min->head->position()))) {
+                        min = &s;
+                    }
+                }
+                if (!min) {
+                    _end_of_stream = true;
+                    return stop_iteration::yes;
+                }
+                auto mf = std::move(*min->head);
+                min->head = { };
+                for (auto&& s : _sources) {
+                    if (s.head && mf.mergeable_with(*_schema, *s.head)) {
+                        mf.apply(*_schema, std::move(*s.head));
+                        s.head = { };
+                    }
+                }
+                push_mutation_fragment(std::move(mf));
+                return is_buffer_full() ? stop_iteration::yes : stop_iteration::no;
+            });
+        });
+    }
+};
+
+streamed_mutation merge_mutations(std::vector<streamed_mutation> ms) {
+    assert(!ms.empty());
+    if (ms.size() == 1) {
+        return std::move(ms.front());
+    }
+    return make_streamed_mutation<mutation_merger>(std::move(ms));
+}
+
+class mutation_rebuilder {
+    mutation _m;
+public:
+    mutation_rebuilder(dht::decorated_key dk, tombstone t, schema_ptr s)
+        : _m(std::move(dk), std::move(s))
+    {
+        _m.partition().apply(t);
+    }
+
+    stop_iteration consume(static_row&& sr) {
+        _m.partition().static_row().apply_reversibly(*_m.schema(), column_kind::static_column, sr.cells());
+        return stop_iteration::no;
+    }
+
+    stop_iteration consume(clustering_row&& cr) {
+        auto& dr = _m.partition().clustered_row(std::move(cr.key()));
+        dr.apply_reversibly(*_m.schema(), cr.as_deletable_row());
+        return stop_iteration::no;
+    }
+
+    stop_iteration consume(range_tombstone&& rt) {
+        _m.partition().apply_delete(*_m.schema(), std::move(rt));
+        return stop_iteration::no;
+    }
+
+    mutation_opt consume_end_of_stream() {
+        return mutation_opt(std::move(_m));
+    }
+};
+
+future<mutation_opt> mutation_from_streamed_mutation(streamed_mutation_opt sm) {
+    if (!sm) {
+        return make_ready_future<mutation_opt>();
+    }
+    return do_with(std::move(*sm), [] (streamed_mutation& sm) {
+        return consume(sm, mutation_rebuilder(sm.decorated_key(), sm.partition_tombstone(), sm.schema()));
+    });
+}
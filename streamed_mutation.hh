@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <experimental/optional>
+
+#include "mutation_partition.hh"
+#include "mutation.hh"
+#include "range_tombstone.hh"
+#include "core/future-util.hh"
+#include "core/do_with.hh"
+#include "core/circular_buffer.hh"
+
+// mutation_fragments are the objects that streamed_mutation are going to
+// stream. They can represent:
+//  - a static row
+//  - a clustering row
+//  - a range tombstone
+//
+// There exists an ordering (implemented in position_in_partition class) between
+// mutation_fragment objects. It reflects the order in which content of
+// partition appears in the sstables.
+
+// Position of a mutation_fragment within its partition. The static row comes
+// first. Clustering rows are positioned at their key, and range tombstones at
+// their start bound, which may be just before or just after a clustering
+// prefix (see bound_view).
+//
+// The view does not own the key, so it must not outlive the fragment it was
+// taken from.
+class position_in_partition_view {
+    // nullptr for the static row.
+    const clustering_key_prefix* _ck;
+    int32_t _bound_weight;
+public:
+    struct static_row_tag_t { };
+
+    explicit position_in_partition_view(static_row_tag_t)
+        : _ck(nullptr), _bound_weight(0) { }
+    explicit position_in_partition_view(const clustering_key_prefix& ck, int32_t bound_weight = 0)
+        : _ck(&ck), _bound_weight(bound_weight) { }
+    explicit position_in_partition_view(const bound_view& bv)
+        : _ck(&bv.prefix), _bound_weight(weight(bv.kind)) { }
+
+    bool is_static_row() const { return !_ck; }
+    const clustering_key_prefix* key() const { return _ck; }
+    int32_t bound_weight() const { return _bound_weight; }
+
+    class less_compare {
+        bound_view::compare _cmp;
+    public:
+        explicit less_compare(const schema& s) : _cmp(s) { }
+        bool operator()(position_in_partition_view a, position_in_partition_view b) const {
+            if (a.is_static_row() || b.is_static_row()) {
+                return a.is_static_row() && !b.is_static_row();
+            }
+            return _cmp(*a._ck, a._bound_weight, *b._ck, b._bound_weight);
+        }
+    };
+
+    friend std::ostream& operator<<(std::ostream&, position_in_partition_view);
+};
+
+// Like position_in_partition_view, but owns the key.
+class position_in_partition {
+    std::experimental::optional<clustering_key_prefix> _ck;
+    int32_t _bound_weight = 0;
+public:
+    explicit position_in_partition(position_in_partition_view::static_row_tag_t) { }
+    explicit position_in_partition(position_in_partition_view v)
+        : _bound_weight(v.bound_weight()) {
+        if (v.key()) {
+            _ck = *v.key();
+        }
+    }
+
+    position_in_partition_view view() const {
+        return _ck ? position_in_partition_view(*_ck, _bound_weight)
+                   : position_in_partition_view(position_in_partition_view::static_row_tag_t());
+    }
+    operator position_in_partition_view() const {
+        return view();
+    }
+};
+
+class static_row {
+    row _cells;
+public:
+    static_row() = default;
+    explicit static_row(const row& r) : _cells(r) { }
+    explicit static_row(row&& r) : _cells(std::move(r)) { }
+
+    row& cells() { return _cells; }
+    const row& cells() const { return _cells; }
+
+    bool empty() const {
+        return _cells.empty();
+    }
+
+    void apply(const schema& s, static_row&& sr) {
+        _cells.apply_reversibly(s, column_kind::static_column, sr._cells);
+    }
+
+    position_in_partition_view position() const {
+        return position_in_partition_view(position_in_partition_view::static_row_tag_t());
+    }
+
+    size_t memory_usage() const;
+};
+
+class clustering_row {
+    clustering_key _ck;
+    deletable_row _row;
+public:
+    explicit clustering_row(clustering_key ck) : _ck(std::move(ck)) { }
+    clustering_row(clustering_key ck, deletable_row&& row)
+        : _ck(std::move(ck)), _row(std::move(row)) { }
+    clustering_row(const rows_entry& re)
+        : _ck(re.key()), _row(re.row()) { }
+
+    clustering_key& key() { return _ck; }
+    const clustering_key& key() const { return _ck; }
+
+    tombstone tomb() const { return _row.deleted_at(); }
+    const row_marker& marker() const { return _row.marker(); }
+    row_marker& marker() { return _row.marker(); }
+    const row& cells() const { return _row.cells(); }
+    row& cells() { return _row.cells(); }
+
+    deletable_row& as_deletable_row() { return _row; }
+    const deletable_row& as_deletable_row() const { return _row; }
+
+    bool empty() const {
+        return _row.empty();
+    }
+
+    void apply(tombstone t) {
+        _row.apply(t);
+    }
+    void apply(const row_marker& rm) {
+        _row.apply(rm);
+    }
+    void apply(const schema& s, clustering_row&& cr) {
+        _row.apply_reversibly(s, cr._row);
+    }
+
+    position_in_partition_view position() const {
+        return position_in_partition_view(_ck);
+    }
+
+    size_t memory_usage() const;
+};
+
+class mutation_fragment {
+public:
+    enum class kind {
+        static_row,
+        clustering_row,
+        range_tombstone,
+    };
+private:
+    struct data {
+        data() { }
+        ~data() { }
+
+        union {
+            static_row _static_row;
+            clustering_row _clustering_row;
+            range_tombstone _range_tombstone;
+        };
+    };
+private:
+    kind _kind;
+    std::unique_ptr<data> _data;
+public:
+    mutation_fragment(static_row&& r);
+    mutation_fragment(clustering_row&& r);
+    // The tombstone must not be linked into a range_tombstone_list.
+    mutation_fragment(range_tombstone&& r);
+
+    mutation_fragment(const mutation_fragment&) = delete;
+    mutation_fragment(mutation_fragment&& other) = default;
+    mutation_fragment& operator=(const mutation_fragment&) = delete;
+    mutation_fragment& operator=(mutation_fragment&& other) noexcept {
+        if (this != &other) {
+            this->~mutation_fragment();
+            new (this) mutation_fragment(std::move(other));
+        }
+        return *this;
+    }
+    ~mutation_fragment();
+
+    kind mutation_fragment_kind() const { return _kind; }
+
+    bool is_static_row() const { return _kind == kind::static_row; }
+    bool is_clustering_row() const { return _kind == kind::clustering_row; }
+    bool is_range_tombstone() const { return _kind == kind::range_tombstone; }
+
+    static_row& as_static_row() { return _data->_static_row; }
+    clustering_row& as_clustering_row() { return _data->_clustering_row; }
+    range_tombstone& as_range_tombstone() { return _data->_range_tombstone; }
+
+    const static_row& as_static_row() const { return _data->_static_row; }
+    const clustering_row& as_clustering_row() const { return _data->_clustering_row; }
+    const range_tombstone& as_range_tombstone() const { return _data->_range_tombstone; }
+
+    position_in_partition_view position() const;
+
+    // Fragments of the same kind at the same position (static rows and
+    // clustering rows with equal keys) can be merged into one.
+    bool mergeable_with(const schema& s, const mutation_fragment& mf) const;
+    void apply(const schema& s, mutation_fragment&& mf);
+
+    // Consumer must provide consume(static_row&&), consume(clustering_row&&)
+    // and consume(range_tombstone&&), all returning the same type.
+    template<typename Consumer>
+    decltype(auto) consume(Consumer& consumer) && {
+        switch (_kind) {
+        case kind::static_row:
+            return consumer.consume(std::move(_data->_static_row));
+        case kind::clustering_row:
+            return consumer.consume(std::move(_data->_clustering_row));
+        case kind::range_tombstone:
+            return consumer.consume(std::move(_data->_range_tombstone));
+        }
+        abort();
+    }
+
+    // Approximate amount of memory held by the fragment.
+    size_t memory_usage() const;
+
+    friend std::ostream& operator<<(std::ostream&, const mutation_fragment&);
+};
+
+using mutation_fragment_opt = std::experimental::optional<mutation_fragment>;
+
+// streamed_mutation represents a mutation in a form of a stream of
+// mutation_fragments. streamed_mutation emits mutation fragments in the order
+// they should appear in the sstables, i.e. static row is always the first one,
+// then clustering rows and range tombstones are emitted according to the
+// lexicographical ordering of their clustering keys and bounds of the range
+// tombstones.
+//
+// Unlike a mutation, a streamed_mutation never needs to have the whole
+// partition in memory: fragments are produced as they are consumed, and an
+// implementation only buffers about max_buffer_size_in_bytes of them.
+//
+// The partition key and the partition tombstone are known upfront.
+class streamed_mutation {
+public:
+    static constexpr size_t max_buffer_size_in_bytes = 8 * 1024;
+
+    class impl {
+        circular_buffer<mutation_fragment> _buffer;
+        size_t _buffer_size = 0;
+    protected:
+        bool _end_of_stream = false;
+        schema_ptr _schema;
+        dht::decorated_key _key;
+        tombstone _partition_tombstone;
+    public:
+        impl(schema_ptr s, dht::decorated_key dk, tombstone pt)
+            : _schema(std::move(s)), _key(std::move(dk)), _partition_tombstone(pt) { }
+        virtual ~impl() { }
+
+        // Fills the buffer with more fragments, or sets _end_of_stream.
+        virtual future<> fill_buffer() = 0;
+
+        void push_mutation_fragment(mutation_fragment mf) {
+            _buffer_size += mf.memory_usage();
+            _buffer.emplace_back(std::move(mf));
+        }
+        bool is_end_of_stream() const { return _end_of_stream; }
+        bool is_buffer_empty() const { return _buffer.empty(); }
+        bool is_buffer_full() const { return _buffer_size >= max_buffer_size_in_bytes; }
+
+        mutation_fragment pop_mutation_fragment() {
+            auto mf = std::move(_buffer.front());
+            _buffer.pop_front();
+            _buffer_size -= mf.memory_usage();
+            return mf;
+        }
+
+        future<mutation_fragment_opt> operator()() {
+            if (is_buffer_empty()) {
+                if (is_end_of_stream()) {
+                    return make_ready_future<mutation_fragment_opt>();
+                }
+                return fill_buffer().then([this] { return operator()(); });
+            }
+            return make_ready_future<mutation_fragment_opt>(pop_mutation_fragment());
+        }
+
+        friend class streamed_mutation;
+    };
+private:
+    std::unique_ptr<impl> _impl;
+public:
+    explicit streamed_mutation(std::unique_ptr<impl> i)
+        : _impl(std::move(i)) { }
+    streamed_mutation(streamed_mutation&&) = default;
+    streamed_mutation& operator=(streamed_mutation&&) = default;
+    streamed_mutation(const streamed_mutation&) = delete;
+    streamed_mutation& operator=(const streamed_mutation&) = delete;
+
+    const schema_ptr& schema() const { return _impl->_schema; }
+    const dht::decorated_key& decorated_key() const { return _impl->_key; }
+    const partition_key& key() const { return _impl->_key.key(); }
+    dht::token token() const { return _impl->_key.token(); }
+    tombstone partition_tombstone() const { return _impl->_partition_tombstone; }
+
+    // Returns the next fragment, or a disengaged optional at the end of the
+    // partition.
+    future<mutation_fragment_opt> operator()() {
+        return _impl->operator()();
+    }
+};
+
+using streamed_mutation_opt = std::experimental::optional<streamed_mutation>;
+
+template<typename Impl, typename... Args>
+streamed_mutation make_streamed_mutation(Args&&... args) {
+    return streamed_mutation(std::make_unique<Impl>(std::forward<Args>(args)...));
+}
+
+// Streams the contents of the given mutation.
+streamed_mutation streamed_mutation_from_mutation(mutation m);
+
+// Merges streams of fragments of the same partition into one. All streams
+// must have the same schema.
+streamed_mutation merge_mutations(std::vector<streamed_mutation> ms);
+
+// Consumes the whole stream and builds a mutation out of it.
+future<mutation_opt> mutation_from_streamed_mutation(streamed_mutation_opt sm);
+
+// Consumer concept:
+//
+// class Consumer {
+// public:
+//     stop_iteration consume(static_row&& sr);
+//     stop_iteration consume(clustering_row&& cr);
+//     stop_iteration consume(range_tombstone&& rt);
+//
+//     auto consume_end_of_stream();
+// };
+//
+// Feeds the fragments of the stream to the consumer until it asks to stop or
+// the stream ends. Resolves to the result of consume_end_of_stream().
+template<typename Consumer>
+auto consume(streamed_mutation& m, Consumer consumer) {
+    return do_with(std::move(consumer), [&m] (Consumer& c) {
+        return repeat([&m, &c] {
+            return m().then([&c] (mutation_fragment_opt mfo) {
+                if (!mfo) {
+                    return stop_iteration::yes;
+                }
+                return std::move(*mfo).consume(c);
+            });
+        }).then([&c] {
+            return c.consume_end_of_stream();
+        });
+    });
+}
@@ -145,6 +145,65 @@ void stream_session::init_messaging_service_handler() {
             });
         });
     });
+    ms().register_stream_mutation_batch([] (const rpc::client_info& cinfo, UUID plan_id, std::vector<frozen_mutation> fms, unsigned dst_cpu_id) {
+        auto from = net::messaging_service::get_source(cinfo);
+        return do_with(std::move(fms), [plan_id, from] (const std::vector<frozen_mutation>& fms) {
+            if (fms.empty()) {
+                return make_ready_future<>();
+            }
+            size_t size = 0;
+            // A batch holds mutations of a single table, but possibly of
+            // several schema versions if it was altered meanwhile.
+            std::unordered_map<table_schema_version, std::vector<const frozen_mutation*>> versions;
+            for (auto& fm : fms) {
+                size += fm.representation().size();
+                versions[fm.schema_version()].push_back(&fm);
+            }
+            get_local_stream_manager().update_progress(plan_id, from.addr, progress_info::direction::IN, size);
+            auto cf_id = fms.front().column_family_id();
+            sslog.debug("[Stream #{}] GOT STREAM_MUTATION_BATCH from {}: cf_id={}, mutations={}", plan_id, from.addr, cf_id, fms.size());
+
+            auto& db = service::get_local_storage_proxy().get_db().local();
+            if (!db.column_family_exists(cf_id)) {
+                sslog.warn("[Stream #{}] STREAM_MUTATION_BATCH from {}: cf_id={} is missing, assume the table is dropped",
+                            plan_id, from.addr, cf_id);
+                return make_ready_future<>();
+            }
+            return do_with(std::move(versions), [plan_id, from, cf_id] (auto& versions) {
+                return parallel_for_each(versions, [from] (auto& v) {
+                    return service::get_schema_for_write(v.first, from).then([&ms = v.second] (schema_ptr s) {
+                        return service::get_storage_proxy().local().mutate_streaming_mutations(std::move(s), ms);
+                    });
+                }).then_wrapped([plan_id, cf_id, from] (auto&& f) {
+                    try {
+                        f.get();
+                    } catch (no_such_column_family) {
+                        sslog.warn("[Stream #{}] STREAM_MUTATION_BATCH from {}: cf_id={} is missing, assume the table is dropped",
+                                plan_id, from.addr, cf_id);
+                    }
+                });
+            });
+        });
+    });
+    ms().register_stream_sstable_file_chunk([] (const rpc::client_info& cinfo, UUID plan_id, UUID cf_id,
+            sstring file_name, uint64_t offset, bytes data, bool last, unsigned dst_cpu_id) {
+        const auto& from = cinfo.retrieve_auxiliary<gms::inet_address>("baddr");
+        return smp::submit_to(dst_cpu_id, [plan_id, cf_id, file_name = std::move(file_name), offset, data = std::move(data), last, from] () mutable {
+            sslog.debug("[Stream #{}] GOT STREAM_SSTABLE_FILE_CHUNK from {}: cf_id={}, file={}, offset={}", plan_id, from, cf_id, file_name, offset);
+            get_local_stream_manager().update_progress(plan_id, from, progress_info::direction::IN, data.size());
+            auto session = get_session(plan_id, from, "STREAM_SSTABLE_FILE_CHUNK", cf_id);
+            return futurize_apply([&] {
+                return session->get_sstable_file_receiver().write_chunk(cf_id, std::move(file_name), offset, std::move(data), last);
+            }).then_wrapped([session, plan_id, cf_id, from] (auto&& f) {
+                try {
+                    f.get();
+                } catch (no_such_column_family) {
+                    sslog.warn("[Stream #{}] STREAM_SSTABLE_FILE_CHUNK from {}: cf_id={} is missing, assume the table is dropped",
+                                plan_id, from, cf_id);
+                }
+            });
+        });
+    });
     ms().register_stream_mutation_done([] (const rpc::client_info& cinfo, UUID plan_id, std::vector<range<dht::token>> ranges, UUID cf_id, unsigned dst_cpu_id) {
         const auto& from = cinfo.retrieve_auxiliary<gms::inet_address>("baddr");
         return smp::submit_to(dst_cpu_id, [ranges = std::move(ranges), plan_id, cf_id, from] () mutable {
@@ -441,6 +500,10 @@ void stream_session::close_session(stream_session_state final_state) {
                 sslog.debug("[Stream #{}] close_session session={}, state={}, abort stream_receive_task cf_id={}", plan_id(), this, final_state, task.cf_id);
                 task.abort();
             }
+            auto plan_id = this->plan_id();
+            _sstable_files.abort().handle_exception([plan_id] (auto ep) {
+                sslog.warn("[Stream #{}] Fail to remove partially received sstables: {}", plan_id, ep);
+            }).finally([s = shared_from_this()] {});
         }
 
         // Note that we shouldn't block on this close because this method is called on the handler
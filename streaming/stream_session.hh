@@ -51,6 +51,7 @@
 #include "streaming/stream_detail.hh"
 #include "streaming/stream_manager.hh"
 #include "streaming/session_info.hh"
+#include "streaming/stream_sstable_files.hh"
 #include "sstables/sstables.hh"
 #include "query-request.hh"
 #include "dht/i_partitioner.hh"
@@ -184,6 +185,9 @@ class stream_session : public enable_shared_from_this<stream_session> {
     lowres_clock::time_point _last_stream_progress;
 
     session_info _session_info;
+
+    // Writes the sstables which the peer sends as files
+    sstable_file_receiver _sstable_files{get_db()};
 public:
     void start_keep_alive_timer() {
         _keep_alive.rearm(lowres_clock::now() + _keep_alive_interval);
@@ -329,6 +333,10 @@ class stream_session : public enable_shared_from_this<stream_session> {
         return _session_info;
     }
 
+    sstable_file_receiver& get_sstable_file_receiver() {
+        return _sstable_files;
+    }
+
     future<> update_progress();
 
     void receive_task_completed(UUID cf_id);
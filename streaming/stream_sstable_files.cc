@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "log.hh"
+#include "streaming/stream_sstable_files.hh"
+#include "streaming/stream_session.hh"
+#include "streaming/stream_manager.hh"
+#include "service/priority_manager.hh"
+#include "checked-file-impl.hh"
+#include "disk-error-handler.hh"
+#include "database.hh"
+#include "core/reactor.hh"
+#include <boost/algorithm/string.hpp>
+
+namespace streaming {
+
+extern logging::logger sslog;
+
+static constexpr size_t file_chunk_size = 1024 * 1024;
+
+static sstring basename(const sstring& path) {
+    auto pos = path.find_last_of('/');
+    return pos == sstring::npos ? path : path.substr(pos + 1);
+}
+
+static future<> send_file(net::messaging_service::msg_addr id, utils::UUID plan_id, utils::UUID cf_id,
+        sstring path, unsigned dst_cpu_id) {
+    return open_checked_file_dma(sstable_read_error, path, open_flags::ro).then([id, plan_id, cf_id, path, dst_cpu_id] (file f) {
+        return f.size().then([id, plan_id, cf_id, path, dst_cpu_id, f] (uint64_t size) mutable {
+            file_input_stream_options options;
+            options.buffer_size = file_chunk_size;
+            options.io_priority_class = service::get_local_streaming_read_priority();
+            auto in = make_file_input_stream(f, 0, size, std::move(options));
+            auto file_name = basename(path);
+            return do_with(std::move(in), uint64_t(0), [id, plan_id, cf_id, file_name, size, dst_cpu_id] (input_stream<char>& in, uint64_t& offset) {
+                return repeat([id, plan_id, cf_id, file_name, size, dst_cpu_id, &in, &offset] {
+                    return in.read_exactly(file_chunk_size).then([id, plan_id, cf_id, file_name, size, dst_cpu_id, &offset] (temporary_buffer<char> buf) {
+                        auto len = buf.size();
+                        auto last = offset + len >= size;
+                        auto data = bytes(reinterpret_cast<const bytes::value_type*>(buf.get()), len);
+                        sslog.debug("[Stream #{}] SEND STREAM_SSTABLE_FILE_CHUNK to {}, file={}, offset={}", plan_id, id, file_name, offset);
+                        return net::get_local_messaging_service().send_stream_sstable_file_chunk(id, plan_id, cf_id, file_name, offset,
+                                std::move(data), last, dst_cpu_id).then([id, plan_id, len, last, &offset] {
+                            offset += len;
+                            get_local_stream_manager().update_progress(plan_id, id.addr, progress_info::direction::OUT, len);
+                            return last ? stop_iteration::yes : stop_iteration::no;
+                        });
+                    });
+                }).finally([&in] {
+                    return in.close();
+                });
+            });
+        }).finally([f] () mutable {
+            return f.close();
+        });
+    });
+}
+
+future<> send_sstable_files(net::messaging_service::msg_addr id, utils::UUID plan_id, utils::UUID cf_id,
+        sstables::shared_sstable sst, unsigned dst_cpu_id) {
+    auto toc = sst->toc_filename();
+    auto files = sst->component_filenames();
+    // The TOC goes first: it tells the receiver which components to wait
+    // for, and marks the sstable as partial until they are all there.
+    files.erase(std::remove(files.begin(), files.end(), toc), files.end());
+    files.insert(files.begin(), toc);
+    sslog.debug("[Stream #{}] Sending sstable {} to {} as files", plan_id, sst->get_filename(), id);
+    return do_with(std::move(files), [id, plan_id, cf_id, dst_cpu_id, sst] (std::vector<sstring>& files) {
+        return do_for_each(files, [id, plan_id, cf_id, dst_cpu_id] (const sstring& path) {
+            return send_file(id, plan_id, cf_id, path, dst_cpu_id);
+        });
+    });
+}
+
+future<lw_shared_ptr<sstable_file_receiver::output_file>>
+sstable_file_receiver::get_file(const sstring& name, uint64_t offset) {
+    auto it = _files.find(name);
+    if (it != _files.end()) {
+        return make_ready_future<lw_shared_ptr<output_file>>(it->second);
+    }
+    if (offset != 0) {
+        return make_exception_future<lw_shared_ptr<output_file>>(std::runtime_error(
+                sprint("Received a chunk of %s at offset %d before its beginning", name, offset)));
+    }
+    return open_checked_file_dma(sstable_write_error, name, open_flags::wo | open_flags::create).then([this, name] (file f) {
+        file_output_stream_options options;
+        options.io_priority_class = service::get_local_streaming_write_priority();
+        auto of = make_lw_shared<output_file>(make_file_output_stream(std::move(f), std::move(options)));
+        auto it = _files.emplace(name, of);
+        if (it.second) {
+            return make_ready_future<lw_shared_ptr<output_file>>(of);
+        }
+        // A retried first chunk opened the file meanwhile.
+        return of->out.close().then([existing = it.first->second] {
+            return existing;
+        });
+    });
+}
+
+future<> sstable_file_receiver::write_chunk(utils::UUID cf_id, sstring file_name, uint64_t offset, bytes data, bool last) {
+    if (_aborted) {
+        return make_exception_future<>(std::runtime_error(sprint("Received a chunk of %s after the session failed", file_name)));
+    }
+    auto desc = sstables::entry_descriptor::make_descriptor(file_name);
+    auto is_toc = desc.component == sstables::sstable::component_type::TOC;
+    auto key = std::make_pair(cf_id, desc.generation);
+    auto sst_it = _sstables.find(key);
+    if (sst_it == _sstables.end()) {
+        if (!is_toc) {
+            return make_exception_future<>(std::runtime_error(sprint("Received a chunk of %s before the TOC of its sstable", file_name)));
+        }
+        auto& cf = _db.local().find_column_family(cf_id);
+        auto s = cf.schema();
+        auto local_desc = sstables::entry_descriptor(s->ks_name(), s->cf_name(), desc.version, cf.new_sstable_generation(), desc.format, desc.component);
+        sst_it = _sstables.emplace(key, make_lw_shared<incoming_sstable>(cf_id, cf.datadir(), std::move(local_desc))).first;
+    }
+    auto sst = sst_it->second;
+    if (sst->sealed) {
+        return make_ready_future<>();
+    }
+    // The TOC is written as a temporary one, and renamed once the sstable
+    // is complete.
+    auto component = is_toc ? sstables::sstable::component_type::TemporaryTOC : desc.component;
+    auto name = sstables::sstable::filename(sst->dir, sst->desc.ks, sst->desc.cf, sst->desc.version, sst->desc.generation, sst->desc.format, component);
+    if (_completed.count(name)) {
+        return make_ready_future<>();
+    }
+    return get_file(name, offset).then([this, sst, name, offset, data = std::move(data), last, is_toc, component = desc.component] (auto of) mutable {
+        if (is_toc) {
+            sst->created = true;
+        }
+        return with_semaphore(of->sem, 1, [this, sst, name, offset, data = std::move(data), last, is_toc, component, of] () mutable {
+            if (_completed.count(name) || offset < of->pos) {
+                return make_ready_future<>();
+            }
+            if (offset != of->pos) {
+                throw std::runtime_error(sprint("Received a chunk of %s at offset %d, expected %d", name, offset, of->pos));
+            }
+            of->pos += data.size();
+            if (is_toc) {
+                sst->toc += sstring(reinterpret_cast<const char*>(data.begin()), data.size());
+            }
+            return do_with(std::move(data), [of] (const bytes& data) {
+                return of->out.write(reinterpret_cast<const char*>(data.begin()), data.size());
+            }).then([this, sst, name, last, component, of] {
+                if (!last) {
+                    return make_ready_future<>();
+                }
+                _completed.insert(name);
+                _files.erase(name);
+                return of->out.close().then([this, sst, component] {
+                    return complete_file(sst, component);
+                });
+            });
+        });
+    });
+}
+
+future<> sstable_file_receiver::complete_file(lw_shared_ptr<incoming_sstable> sst, sstables::sstable::component_type component) {
+    if (component == sstables::sstable::component_type::TOC) {
+        std::vector<sstring> lines;
+        boost::split(lines, sst->toc, boost::is_any_of("\n"));
+        sst->listed.emplace();
+        for (auto& line : lines) {
+            if (!line.empty()) {
+                sst->listed->insert(sstables::sstable::component_from_sstring(line));
+            }
+        }
+        sst->listed->erase(sstables::sstable::component_type::TOC);
+        sst->toc = {};
+        // Make the TemporaryTOC durable before the components it covers.
+        return sstable_write_io_check(sync_directory, sst->dir).then([this, sst] {
+            return seal(sst);
+        });
+    }
+    sst->completed.insert(component);
+    return seal(sst);
+}
+
+future<> sstable_file_receiver::seal(lw_shared_ptr<incoming_sstable> sst) {
+    if (!sst->listed || sst->sealed) {
+        return make_ready_future<>();
+    }
+    for (auto c : *sst->listed) {
+        if (!sst->completed.count(c)) {
+            return make_ready_future<>();
+        }
+    }
+    sst->sealed = true;
+    auto& desc = sst->desc;
+    auto tmp_toc = sstables::sstable::filename(sst->dir, desc.ks, desc.cf, desc.version, desc.generation, desc.format,
+            sstables::sstable::component_type::TemporaryTOC);
+    auto toc = sstables::sstable::filename(sst->dir, desc.ks, desc.cf, desc.version, desc.generation, desc.format,
+            sstables::sstable::component_type::TOC);
+    return sstable_write_io_check(sync_directory, sst->dir).then([tmp_toc, toc] {
+        return sstable_write_io_check([&] {
+            return engine().rename_file(tmp_toc, toc);
+        });
+    }).then([sst] {
+        return sstable_write_io_check(sync_directory, sst->dir);
+    }).then([this, sst] {
+        auto desc = sst->desc;
+        sslog.debug("Loading streamed sstable of {}.{}, generation {}", desc.ks, desc.cf, desc.generation);
+        return _db.invoke_on_all([cf_id = sst->cf_id, desc] (database& db) {
+            return db.find_column_family(cf_id).load_new_sstables({desc});
+        });
+    });
+}
+
+future<> sstable_file_receiver::abort() {
+    _aborted = true;
+    auto files = std::exchange(_files, {});
+    return parallel_for_each(files, [] (auto& f) {
+        auto of = f.second;
+        return with_semaphore(of->sem, 1, [of] {
+            return of->out.close();
+        }).handle_exception([name = f.first] (auto ep) {
+            sslog.debug("Failed to close partially received file {}: {}", name, ep);
+        });
+    }).then([this] {
+        return parallel_for_each(_sstables, [] (auto& x) {
+            auto sst = x.second;
+            if (!sst->created || sst->sealed) {
+                return make_ready_future<>();
+            }
+            auto& desc = sst->desc;
+            sslog.info("Removing partially received sstable of {}.{}, generation {}", desc.ks, desc.cf, desc.generation);
+            return sstables::sstable::remove_sstable_with_temp_toc(desc.ks, desc.cf, sst->dir, desc.generation, desc.version, desc.format);
+        });
+    });
+}
+
+}
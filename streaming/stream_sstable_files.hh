@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <experimental/optional>
+#include "core/future.hh"
+#include "core/fstream.hh"
+#include "core/semaphore.hh"
+#include "core/shared_ptr.hh"
+#include "core/distributed.hh"
+#include "message/messaging_service.hh"
+#include "sstables/sstables.hh"
+#include "utils/UUID.hh"
+#include "bytes.hh"
+
+class database;
+
+namespace streaming {
+
+/*
+ * Streaming of whole sstables.
+ *
+ * An sstable which holds data of a single shard and whose partitions all
+ * fall within a range being transferred is sent as its component files,
+ * chunk by chunk, instead of as mutations. The TOC is sent first; the
+ * receiver writes it as a TemporaryTOC under a new generation of its own
+ * table, so that an sstable which is not received in full is removed on
+ * startup, like one whose write was interrupted. Once every component the
+ * TOC lists is complete, the TOC is renamed and the sstable loaded. Neither
+ * side deserializes the data nor rewrites it.
+ */
+
+// Sends the component files of the sstable to the peer of a session.
+future<> send_sstable_files(net::messaging_service::msg_addr id, utils::UUID plan_id, utils::UUID cf_id,
+        sstables::shared_sstable sst, unsigned dst_cpu_id);
+
+// Writes the sstable files received by a session, on the session's shard.
+class sstable_file_receiver {
+    struct output_file {
+        output_stream<char> out;
+        uint64_t pos = 0;
+        // Chunks of a file are written one at a time.
+        semaphore sem{1};
+        explicit output_file(output_stream<char> o) : out(std::move(o)) {}
+    };
+    // An sstable from the first chunk of its TOC until it is loaded.
+    struct incoming_sstable {
+        utils::UUID cf_id;
+        sstring dir;
+        // Local descriptor of the sstable; the component is unused.
+        sstables::entry_descriptor desc;
+        // Set once the TemporaryTOC exists, and thus the sstable has to be
+        // removed should the session fail.
+        bool created = false;
+        bool sealed = false;
+        // Contents of the TOC, while it is received.
+        sstring toc;
+        // Components listed by the TOC, once it is complete.
+        std::experimental::optional<std::unordered_set<sstables::sstable::component_type, enum_hash<sstables::sstable::component_type>>> listed;
+        std::unordered_set<sstables::sstable::component_type, enum_hash<sstables::sstable::component_type>> completed;
+        incoming_sstable(utils::UUID cf_id_, sstring dir_, sstables::entry_descriptor desc_)
+            : cf_id(cf_id_), dir(std::move(dir_)), desc(std::move(desc_)) {}
+    };
+    distributed<database>& _db;
+    // The sstables being received, keyed by the table and the generation
+    // of the sstable on the sender.
+    std::map<std::pair<utils::UUID, int64_t>, lw_shared_ptr<incoming_sstable>> _sstables;
+    std::unordered_map<sstring, lw_shared_ptr<output_file>> _files;
+    std::unordered_set<sstring> _completed;
+    bool _aborted = false;
+private:
+    future<lw_shared_ptr<output_file>> get_file(const sstring& name, uint64_t offset);
+    future<> complete_file(lw_shared_ptr<incoming_sstable> sst, sstables::sstable::component_type component);
+    future<> seal(lw_shared_ptr<incoming_sstable> sst);
+public:
+    explicit sstable_file_receiver(distributed<database>& db) : _db(db) {}
+
+    // Writes a chunk of a component file of an sstable of the given table.
+    // The chunks of a file must arrive in order, and the TOC of an sstable
+    // must be started before its other components. A chunk which was
+    // already written, as happens when a send is retried, is ignored. Once
+    // every component listed by the TOC is complete, the sstable is loaded
+    // on all shards.
+    future<> write_chunk(utils::UUID cf_id, sstring file_name, uint64_t offset, bytes data, bool last);
+
+    // Removes the files of the sstables which were not received in full.
+    // Called when the session fails; later chunks are rejected.
+    future<> abort();
+};
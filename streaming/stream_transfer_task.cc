@@ -41,6 +41,7 @@
 #include "streaming/stream_transfer_task.hh"
 #include "streaming/stream_session.hh"
 #include "streaming/stream_manager.hh"
+#include "streaming/stream_sstable_files.hh"
 #include "mutation_reader.hh"
 #include "frozen_mutation.hh"
 #include "mutation.hh"
@@ -48,6 +49,8 @@
 #include "range.hh"
 #include "dht/i_partitioner.hh"
 #include "service/priority_manager.hh"
+#include "service/storage_service.hh"
+#include "db/config.hh"
 #include <boost/range/irange.hpp>
 
 namespace streaming {
@@ -72,6 +75,14 @@ struct send_info {
     size_t mutations_nr{0};
     semaphore mutations_done{0};
     bool error_logged = false;
+    // Used when sending mutations in batches
+    std::vector<frozen_mutation> batch;
+    size_t batch_size = 0;
+    size_t max_batch_size = 0;
+    size_t max_outstanding_batches = 1;
+    semaphore outstanding_batches{0};
+    // Sstables sent as files, whose data is not sent again as mutations
+    std::vector<sstables::shared_sstable> whole_sstables;
     send_info(database& db_, utils::UUID plan_id_, utils::UUID cf_id_,
               query::partition_range pr_, net::messaging_service::msg_addr id_,
               uint32_t dst_cpu_id_)
@@ -84,6 +95,27 @@ struct send_info {
     }
 };
 
+// Sends the sstables which lie entirely within the range as files, when
+// enabled and supported by the whole cluster.
+future<> send_whole_sstables(auto si, const range<dht::token>& r) {
+    if (!si->db.get_config().stream_whole_sstables() || !service::get_local_storage_service().cluster_supports_stream_sstable_files()) {
+        return make_ready_future<>();
+    }
+    si->whole_sstables = si->db.find_column_family(si->cf_id).select_sstables_contained_in(r);
+    return do_for_each(si->whole_sstables, [si] (sstables::shared_sstable sst) {
+        return send_sstable_files(si->id, si->plan_id, si->cf_id, std::move(sst), si->dst_cpu_id);
+    });
+}
+
+mutation_reader make_send_reader(auto si) {
+    auto& cf = si->db.find_column_family(si->cf_id);
+    auto& priority = service::get_local_streaming_read_priority();
+    if (si->whole_sstables.empty()) {
+        return cf.make_reader(cf.schema(), si->pr, query::no_clustering_key_filtering, priority);
+    }
+    return cf.make_streaming_reader(cf.schema(), si->pr, si->whole_sstables, priority);
+}
+
 future<stop_iteration> do_send_mutations(auto si, auto fm) {
     sslog.debug("[Stream #{}] SEND STREAM_MUTATION to {}, cf_id={}", si->plan_id, si->id, si->cf_id);
     auto fm_size = fm.representation().size();
@@ -103,10 +135,73 @@ future<stop_iteration> do_send_mutations(auto si, auto fm) {
     return make_ready_future<stop_iteration>(stop_iteration::no);
 }
 
+future<> send_mutation_batch(auto si) {
+    if (si->batch.empty()) {
+        return make_ready_future<>();
+    }
+    auto fms = std::exchange(si->batch, {});
+    auto size = std::exchange(si->batch_size, 0);
+    // Each batch in flight also holds a unit of the shard-wide limiter, so
+    // that concurrent transfers stay bounded as on the per-mutation path.
+    return si->outstanding_batches.wait().then([] {
+        return get_local_stream_manager().mutation_send_limiter().wait();
+    }).then([si, fms = std::move(fms), size] () mutable {
+        sslog.debug("[Stream #{}] SEND STREAM_MUTATION_BATCH to {}, cf_id={}, mutations={}", si->plan_id, si->id, si->cf_id, fms.size());
+        net::get_local_messaging_service().send_stream_mutation_batch(si->id, si->plan_id, std::move(fms), si->dst_cpu_id).then([si, size] {
+            sslog.debug("[Stream #{}] GOT STREAM_MUTATION_BATCH Reply from {}", si->plan_id, si->id.addr);
+            get_local_stream_manager().update_progress(si->plan_id, si->id.addr, progress_info::direction::OUT, size);
+            si->outstanding_batches.signal();
+        }).handle_exception([si] (auto ep) {
+            // Log one error per column_family per range
+            if (!si->error_logged) {
+                si->error_logged = true;
+                sslog.error("[Stream #{}] stream_transfer_task: Fail to send STREAM_MUTATION_BATCH to {}: {}", si->plan_id, si->id, ep);
+            }
+            si->outstanding_batches.broken();
+        }).finally([] {
+            get_local_stream_manager().mutation_send_limiter().signal();
+        });
+    });
+}
+
+// Sends the mutations in batches of up to max_batch_size bytes, with up to
+// max_outstanding_batches of them waiting for a reply at a time.
+future<> send_mutations_in_batches(auto si) {
+    si->outstanding_batches.signal(si->max_outstanding_batches);
+    return do_with(make_send_reader(si), [si] (auto& reader) {
+        return repeat([si, &reader] {
+            return reader().then([si] (auto mopt) {
+                if (mopt && si->db.column_family_exists(si->cf_id)) {
+                    si->mutations_nr++;
+                    auto fm = frozen_mutation(*mopt);
+                    si->batch_size += fm.representation().size();
+                    si->batch.push_back(std::move(fm));
+                    if (si->batch_size < si->max_batch_size) {
+                        return make_ready_future<stop_iteration>(stop_iteration::no);
+                    }
+                    return send_mutation_batch(si).then([] {
+                        return stop_iteration::no;
+                    });
+                } else {
+                    return send_mutation_batch(si).then([] {
+                        return stop_iteration::yes;
+                    });
+                }
+            });
+        });
+    }).then([si] {
+        return si->outstanding_batches.wait(si->max_outstanding_batches);
+    });
+}
+
 future<> send_mutations(auto si) {
-    auto& cf = si->db.find_column_family(si->cf_id);
-    auto& priority = service::get_local_streaming_read_priority();
-    return do_with(cf.make_reader(cf.schema(), si->pr, query::no_clustering_key_filtering, priority), [si] (auto& reader) {
+    auto& cfg = si->db.get_config();
+    if (cfg.stream_mutation_batch_size_in_kb() && service::get_local_storage_service().cluster_supports_stream_mutation_batch()) {
+        si->max_batch_size = size_t(cfg.stream_mutation_batch_size_in_kb()) * 1024;
+        si->max_outstanding_batches = std::max(cfg.stream_max_outstanding_batches(), 1u);
+        return send_mutations_in_batches(si);
+    }
+    return do_with(make_send_reader(si), [si] (auto& reader) {
         return repeat([si, &reader] {
             return get_local_stream_manager().mutation_send_limiter().wait().then([si, &reader] {
                 return reader().then([si] (auto mopt) {
@@ -141,12 +236,14 @@ void stream_transfer_task::start() {
         auto shard_range = boost::irange<unsigned>(shard_begin, shard_end);
         sslog.debug("[Stream #{}] stream_transfer_task: cf_id={}, shard_begin={} shard_end={}", plan_id, cf_id, shard_begin, shard_end);
         return parallel_for_each(shard_range.begin(), shard_range.end(),
-                [this, plan_id, cf_id, id, dst_cpu_id, pr] (unsigned shard) {
+                [this, plan_id, cf_id, id, dst_cpu_id, pr, range] (unsigned shard) {
             sslog.debug("[Stream #{}] stream_transfer_task: cf_id={}, invoke_on shard={}", plan_id, cf_id, shard);
-            return this->session->get_db().invoke_on(shard, [plan_id, cf_id, id, dst_cpu_id, pr] (database& db) {
+            return this->session->get_db().invoke_on(shard, [plan_id, cf_id, id, dst_cpu_id, pr, range] (database& db) {
                 // Send mutations on related shards, do not capture this
                 auto si = make_lw_shared<send_info>(db, plan_id, cf_id, pr, id, dst_cpu_id);
-                return send_mutations(si);
+                return send_whole_sstables(si, range).then([si] {
+                    return send_mutations(si);
+                });
             });
         });
     }).then([this, plan_id, cf_id, id] {
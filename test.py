@@ -35,17 +35,23 @@ boost_tests = [
     'schema_registry_test',
     'range_test',
     'mutation_reader_test',
+    'streamed_mutation_test',
     'cql_query_test',
+    'cql_compression_test',
+    'admission_controller_test',
     'storage_proxy_test',
+    'sstable_streaming_test',
     'schema_change_test',
     'sstable_mutation_test',
     'commitlog_test',
+    'hints_manager_test',
     'hash_test',
     'test-serialization',
     'cartesian_product_test',
     'allocation_strategy_test',
     'UUID_test',
     'compound_test',
+    'checksum_tree_test',
     'murmur_hash_test',
     'partitioner_test',
     'frozen_mutation_test',
@@ -66,6 +72,7 @@ boost_tests = [
     'map_difference_test',
     'memtable_test',
     'mutation_query_test',
+    'querier_cache_test',
     'snitch_reset_test',
     'auth_test',
     'idl_test',
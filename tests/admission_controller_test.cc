@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+#include "tests/test-utils.hh"
+#include "tests/cql_test_env.hh"
+
+#include "core/sleep.hh"
+#include "core/thread.hh"
+#include "transport/admission_controller.hh"
+#include "transport/server.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+using namespace std::chrono_literals;
+using transport::admission_controller;
+using request_kind = admission_controller::request_kind;
+
+SEASTAR_TEST_CASE(test_in_flight_limits) {
+    admission_controller::config cfg;
+    cfg.max_in_flight_reads = 2;
+    cfg.max_in_flight_writes = 1;
+    admission_controller ac(cfg);
+
+    std::vector<admission_controller::permit> reads;
+    BOOST_REQUIRE(!ac.check(request_kind::read));
+    reads.emplace_back(ac, request_kind::read);
+    BOOST_REQUIRE(!ac.check(request_kind::read));
+    reads.emplace_back(ac, request_kind::read);
+    BOOST_REQUIRE_EQUAL(ac.get_stats().in_flight_reads, 2u);
+    BOOST_REQUIRE(ac.check(request_kind::read));
+    BOOST_REQUIRE_EQUAL(ac.get_stats().rejected_reads, 1u);
+
+    // Limits are per kind.
+    BOOST_REQUIRE(!ac.check(request_kind::write));
+    {
+        admission_controller::permit write(ac, request_kind::write);
+        BOOST_REQUIRE(ac.check(request_kind::write));
+        BOOST_REQUIRE_EQUAL(ac.get_stats().rejected_writes, 1u);
+        BOOST_REQUIRE_EQUAL(ac.get_stats().rejected_reads, 1u);
+    }
+    BOOST_REQUIRE_EQUAL(ac.get_stats().in_flight_writes, 0u);
+    BOOST_REQUIRE(!ac.check(request_kind::write));
+
+    // Other requests are never limited.
+    std::vector<admission_controller::permit> others;
+    for (int i = 0; i < 10; ++i) {
+        BOOST_REQUIRE(!ac.check(request_kind::other));
+        others.emplace_back(ac, request_kind::other);
+    }
+
+    reads.pop_back();
+    BOOST_REQUIRE_EQUAL(ac.get_stats().in_flight_reads, 1u);
+    BOOST_REQUIRE(!ac.check(request_kind::read));
+    BOOST_REQUIRE_EQUAL(ac.get_stats().rejected_for_latency, 0u);
+    return make_ready_future<>();
+}
+
+SEASTAR_TEST_CASE(test_zero_limits_disable_checks) {
+    admission_controller ac(admission_controller::config{});
+    std::vector<admission_controller::permit> permits;
+    for (int i = 0; i < 100; ++i) {
+        BOOST_REQUIRE(!ac.check(request_kind::read));
+        BOOST_REQUIRE(!ac.check(request_kind::write));
+        permits.emplace_back(ac, request_kind::read);
+        permits.emplace_back(ac, request_kind::write);
+    }
+    return make_ready_future<>();
+}
+
+SEASTAR_TEST_CASE(test_latency_trip) {
+    return seastar::async([] {
+        admission_controller::config cfg;
+        cfg.max_latency = 1ms;
+        admission_controller ac(cfg);
+
+        // Enough requests in flight for the latency check to apply.
+        std::vector<admission_controller::permit> permits;
+        for (int i = 0; i < 17; ++i) {
+            permits.emplace_back(ac, i % 2 ? request_kind::read : request_kind::write);
+        }
+        BOOST_REQUIRE(!ac.check(request_kind::read));
+
+        // One slow request pushes the average above the limit.
+        sleep(50ms).get();
+        permits.pop_back();
+        BOOST_REQUIRE(ac.get_stats().latency > cfg.max_latency);
+        BOOST_REQUIRE(ac.check(request_kind::read));
+        BOOST_REQUIRE(ac.check(request_kind::write));
+        BOOST_REQUIRE_EQUAL(ac.get_stats().rejected_for_latency, 2u);
+        BOOST_REQUIRE_EQUAL(ac.get_stats().rejected_reads, 1u);
+        BOOST_REQUIRE_EQUAL(ac.get_stats().rejected_writes, 1u);
+        BOOST_REQUIRE(!ac.check(request_kind::other));
+
+        // With too few requests in flight the average is not trusted.
+        permits.pop_back();
+        BOOST_REQUIRE(!ac.check(request_kind::read));
+        BOOST_REQUIRE_EQUAL(ac.get_stats().rejected_for_latency, 2u);
+    });
+}
+
+SEASTAR_TEST_CASE(test_classify_query) {
+    BOOST_REQUIRE(transport::classify_query("SELECT * FROM ks.t") == request_kind::read);
+    BOOST_REQUIRE(transport::classify_query("  select * from ks.t") == request_kind::read);
+    BOOST_REQUIRE(transport::classify_query("\nInsert into ks.t (p) values (1)") == request_kind::write);
+    BOOST_REQUIRE(transport::classify_query("update ks.t set v = 1 where p = 1") == request_kind::write);
+    BOOST_REQUIRE(transport::classify_query("DELETE FROM ks.t WHERE p = 1") == request_kind::write);
+    BOOST_REQUIRE(transport::classify_query("BEGIN BATCH APPLY BATCH") == request_kind::write);
+    BOOST_REQUIRE(transport::classify_query("CREATE TABLE ks.t (p int PRIMARY KEY)") == request_kind::other);
+    BOOST_REQUIRE(transport::classify_query("selected") == request_kind::other);
+    BOOST_REQUIRE(transport::classify_query("") == request_kind::other);
+    return make_ready_future<>();
+}
+
+SEASTAR_TEST_CASE(test_classify_statement) {
+    return do_with_cql_env([] (cql_test_env& e) {
+        return seastar::async([&e] {
+            e.execute_cql("create table classified (p int, c int, v int, PRIMARY KEY (p, c));").get();
+            auto classify = [&e] (sstring query) {
+                auto prepared = e.local_qp().get_prepared(e.prepare(query).get0());
+                BOOST_REQUIRE(prepared);
+                return transport::classify_statement(*prepared->statement);
+            };
+            BOOST_REQUIRE(classify("select * from classified where p = ?;") == request_kind::read);
+            BOOST_REQUIRE(classify("insert into classified (p, c, v) values (?, ?, ?);") == request_kind::write);
+            BOOST_REQUIRE(classify("update classified set v = ? where p = ? and c = ?;") == request_kind::write);
+            BOOST_REQUIRE(classify("delete from classified where p = ?;") == request_kind::write);
+            BOOST_REQUIRE(classify("begin batch insert into classified (p, c, v) values (?, ?, ?); apply batch;") == request_kind::write);
+        });
+    });
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE core
+
+#include <boost/test/unit_test.hpp>
+
+#include "repair/repair.hh"
+#include "dht/i_partitioner.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+using token_range = ::range<dht::token>;
+
+static token_range make_range(int64_t start, int64_t end) {
+    return token_range::make({dht::token::from_long(start), false}, {dht::token::from_long(end), true});
+}
+
+// Leaves too narrow to hold any token are (t, t] ranges, which range<>
+// would take for wrapping ones.
+static bool leaf_contains(const token_range& leaf, const dht::token& t) {
+    return !leaf.is_wrap_around(dht::token_comparator()) && leaf.contains(t, dht::token_comparator());
+}
+
+static partition_checksum make_checksum(uint8_t v) {
+    std::array<uint8_t, 32> digest{};
+    digest[0] = v;
+    return partition_checksum(digest);
+}
+
+static void check_split_points(const token_range& range, const std::vector<dht::token>& points, unsigned depth) {
+    BOOST_REQUIRE_EQUAL(points.size(), (size_t(1) << depth) - 1);
+    for (size_t i = 1; i < points.size(); ++i) {
+        BOOST_REQUIRE(points[i - 1] <= points[i]);
+    }
+    for (auto& p : points) {
+        BOOST_REQUIRE(!p.is_minimum());
+        BOOST_REQUIRE(!range.start() || range.start()->value() <= p);
+        BOOST_REQUIRE(!range.end() || p <= range.end()->value());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_split_points_halve_the_range) {
+    dht::set_global_partitioner(to_sstring("org.apache.cassandra.dht.Murmur3Partitioner"));
+    auto range = make_range(-(int64_t(1) << 62), int64_t(1) << 62);
+    auto points = checksum_tree::split_points(range, 3);
+    check_split_points(range, points, 3);
+    for (size_t i = 1; i < points.size(); ++i) {
+        BOOST_REQUIRE(points[i - 1] < points[i]);
+    }
+    BOOST_REQUIRE_EQUAL(points[3], dht::token::from_long(0));
+    BOOST_REQUIRE_EQUAL(points[1], dht::token::from_long(-(int64_t(1) << 61)));
+    BOOST_REQUIRE_EQUAL(points[5], dht::token::from_long(int64_t(1) << 61));
+
+    BOOST_REQUIRE(checksum_tree::split_points(range, 0).empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_split_points_of_edge_ranges) {
+    dht::set_global_partitioner(to_sstring("org.apache.cassandra.dht.Murmur3Partitioner"));
+
+    // The whole ring is split at its middle.
+    auto whole_ring = token_range::make_open_ended_both_sides();
+    auto whole_ring_points = checksum_tree::split_points(whole_ring, 1);
+    BOOST_REQUIRE_EQUAL(whole_ring_points.size(), 1);
+    BOOST_REQUIRE_EQUAL(whole_ring_points[0], dht::token::from_long(0));
+
+    // Unbounded on either or both sides.
+    for (auto&& range : { whole_ring,
+                          token_range::make_starting_with({dht::token::from_long(0), false}),
+                          token_range::make_ending_with({dht::token::from_long(0), true}) }) {
+        auto points = checksum_tree::split_points(range, 2);
+        check_split_points(range, points, 2);
+        for (size_t i = 1; i < points.size(); ++i) {
+            BOOST_REQUIRE(points[i - 1] < points[i]);
+        }
+    }
+
+    // Too narrow to be split: some leaves are empty, and each token of the
+    // range is in exactly one of them.
+    auto range = make_range(5, 7);
+    auto points = checksum_tree::split_points(range, 3);
+    check_split_points(range, points, 3);
+    for (auto t : { 6, 7 }) {
+        auto nr_leaves = 0;
+        for (unsigned i = 0; i <= points.size(); ++i) {
+            nr_leaves += leaf_contains(checksum_tree::leaves_range(range, points, i, i), dht::token::from_long(t));
+        }
+        BOOST_REQUIRE_EQUAL(nr_leaves, 1);
+    }
+    for (unsigned i = 0; i <= points.size(); ++i) {
+        BOOST_REQUIRE(!leaf_contains(checksum_tree::leaves_range(range, points, i, i), dht::token::from_long(5)));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_leaves_range) {
+    dht::set_global_partitioner(to_sstring("org.apache.cassandra.dht.Murmur3Partitioner"));
+    auto range = make_range(-1000, 1000);
+    auto points = checksum_tree::split_points(range, 2);
+    BOOST_REQUIRE_EQUAL(points.size(), 3);
+    using bound = token_range::bound;
+
+    auto first = checksum_tree::leaves_range(range, points, 0, 0);
+    BOOST_REQUIRE(*first.start() == *range.start());
+    BOOST_REQUIRE(*first.end() == bound(points[0], true));
+
+    auto middle = checksum_tree::leaves_range(range, points, 1, 2);
+    BOOST_REQUIRE(*middle.start() == bound(points[0], false));
+    BOOST_REQUIRE(*middle.end() == bound(points[2], true));
+
+    auto last = checksum_tree::leaves_range(range, points, 3, 3);
+    BOOST_REQUIRE(*last.start() == bound(points[2], false));
+    BOOST_REQUIRE(*last.end() == *range.end());
+
+    auto all = checksum_tree::leaves_range(range, points, 0, 3);
+    BOOST_REQUIRE(*all.start() == *range.start());
+    BOOST_REQUIRE(*all.end() == *range.end());
+
+    // Open ends are kept.
+    auto unbounded = token_range::make_open_ended_both_sides();
+    auto unbounded_points = checksum_tree::split_points(unbounded, 1);
+    BOOST_REQUIRE(!checksum_tree::leaves_range(unbounded, unbounded_points, 0, 0).start());
+    BOOST_REQUIRE(!checksum_tree::leaves_range(unbounded, unbounded_points, 1, 1).end());
+}
+
+BOOST_AUTO_TEST_CASE(test_differing_leaves) {
+    std::vector<partition_checksum> leaves;
+    for (uint8_t i = 0; i < 8; ++i) {
+        leaves.push_back(make_checksum(i));
+    }
+    checksum_tree a(leaves);
+    BOOST_REQUIRE_EQUAL(a.depth(), 3);
+
+    checksum_tree same(leaves);
+    BOOST_REQUIRE(a.root() == same.root());
+    BOOST_REQUIRE(a.differing_leaves(same).empty());
+
+    auto other_leaves = leaves;
+    other_leaves[2] = make_checksum(100);
+    other_leaves[7] = make_checksum(101);
+    checksum_tree b(other_leaves);
+    BOOST_REQUIRE(a.root() != b.root());
+    BOOST_REQUIRE(a.differing_leaves(b) == std::vector<unsigned>({2, 7}));
+    BOOST_REQUIRE(b.differing_leaves(a) == std::vector<unsigned>({2, 7}));
+
+    std::vector<partition_checksum> all_different;
+    for (uint8_t i = 0; i < 8; ++i) {
+        all_different.push_back(make_checksum(i + 10));
+    }
+    BOOST_REQUIRE(a.differing_leaves(checksum_tree(all_different)) == std::vector<unsigned>({0, 1, 2, 3, 4, 5, 6, 7}));
+
+    // A single leaf is its own root.
+    checksum_tree single({make_checksum(1)});
+    BOOST_REQUIRE_EQUAL(single.depth(), 0);
+    BOOST_REQUIRE(single.differing_leaves(checksum_tree({make_checksum(2)})) == std::vector<unsigned>({0}));
+}
@@ -28,6 +28,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <set>
+#include <boost/range/irange.hpp>
 
 #include "tests/test-utils.hh"
 #include "core/future-util.hh"
@@ -35,6 +36,7 @@
 #include "core/scollectd_api.hh"
 #include "core/file.hh"
 #include "core/reactor.hh"
+#include "core/thread.hh"
 #include "utils/UUID_gen.hh"
 #include "tmpdir.hh"
 #include "db/commitlog/commitlog.hh"
@@ -325,6 +327,110 @@ SEASTAR_TEST_CASE(test_commitlog_reader){
         });
 }
 
+SEASTAR_TEST_CASE(test_commitlog_compressed_reader){
+    commitlog::config cfg;
+    cfg.compress = true;
+    cfg.commitlog_segment_size_in_mb = 1;
+    return cl_test(cfg, [](commitlog& log) {
+            auto written = make_lw_shared<std::vector<std::pair<replay_position, sstring>>>();
+            auto uuid = utils::UUID_gen::get_time_UUID();
+            return do_for_each(boost::irange(0, 10000), [&log, uuid, written](int i) {
+                        auto tmp = sprint("hej bubba cow %d", i);
+                        return log.add_mutation(uuid, tmp.size(), [tmp](db::commitlog::output& dst) {
+                                    dst.write(tmp.begin(), tmp.end());
+                                }).then([written, tmp](replay_position rp) {
+                                    written->emplace_back(rp, tmp);
+                                });
+                    }).then([&log] {
+                        return log.sync_all_segments();
+                    }).then([&log, written] {
+                        auto segments = log.get_active_segment_names();
+                        BOOST_REQUIRE(segments.size() > 0);
+                        auto read = make_lw_shared<std::vector<std::pair<replay_position, sstring>>>();
+                        return do_for_each(segments, [read](sstring seg) {
+                            return db::commitlog::read_log_file(seg, [read](temporary_buffer<char> buf, db::replay_position rp) {
+                                        read->emplace_back(rp, sstring(buf.get(), buf.size()));
+                                        return make_ready_future<>();
+                                    }).then([](auto s) {
+                                        return do_with(std::move(s), [](auto& s) {
+                                            return s->done();
+                                        });
+                                    });
+                        }).then([written, read] {
+                            std::sort(written->begin(), written->end());
+                            std::sort(read->begin(), read->end());
+                            BOOST_REQUIRE(*written == *read);
+                        });
+                    });
+        });
+}
+
+SEASTAR_TEST_CASE(test_commitlog_group_commit){
+    commitlog::config cfg;
+    cfg.mode = commitlog::sync_mode::GROUP;
+    cfg.commitlog_sync_group_window_in_ms = 10;
+    return cl_test(cfg, [](commitlog& log) {
+            auto uuid = utils::UUID_gen::get_time_UUID();
+            return parallel_for_each(boost::irange(0, 100), [&log, uuid](int) {
+                        sstring tmp = "hej bubba cow";
+                        return log.add_mutation(uuid, tmp.size(), [tmp](db::commitlog::output& dst) {
+                                    dst.write(tmp.begin(), tmp.end());
+                                }).then([](replay_position rp) {
+                                    BOOST_CHECK_NE(rp, db::replay_position());
+                                });
+                    }).then([&log] {
+                        // All writes were acknowledged after a flush, but not each with its own.
+                        auto n = log.get_flush_count();
+                        BOOST_REQUIRE(n > 0);
+                        BOOST_REQUIRE(n < 100);
+                    });
+        });
+}
+
+SEASTAR_TEST_CASE(test_commitlog_compressed_segment_size){
+    commitlog::config cfg;
+    cfg.compress = true;
+    cfg.mode = commitlog::sync_mode::BATCH;
+    cfg.commitlog_segment_size_in_mb = 1;
+    return cl_test(cfg, [](commitlog& log) {
+        return seastar::async([&log] {
+            auto uuid = utils::UUID_gen::get_time_UUID();
+            // Each write is synced on its own, in a chunk padded to the
+            // alignment, so the segment fills up long before the entries'
+            // positions reach its size.
+            std::vector<replay_position> written;
+            for (int i = 0; i < 600; ++i) {
+                auto tmp = sprint("hej bubba cow %d", i);
+                written.push_back(log.add_mutation(uuid, tmp.size(), [tmp](db::commitlog::output& dst) {
+                    dst.write(tmp.begin(), tmp.end());
+                }).get0());
+            }
+            auto segments = log.get_active_segment_names();
+            BOOST_REQUIRE(segments.size() > 1);
+            size_t read = 0;
+            for (auto&& seg : segments) {
+                BOOST_REQUIRE_LE(engine().file_size(seg).get0(), uint64_t(1024 * 1024));
+                auto s = db::commitlog::read_log_file(seg, [&read](temporary_buffer<char>, db::replay_position) {
+                    ++read;
+                    return make_ready_future<>();
+                }).get0();
+                s->done().get();
+            }
+            BOOST_REQUIRE_EQUAL(read, written.size());
+
+            // Writes synced concurrently share chunks.
+            auto flushes = log.get_flush_count();
+            parallel_for_each(boost::irange(0, 100), [&log, uuid](int) {
+                sstring tmp = "hej bubba cow";
+                return log.add_mutation(uuid, tmp.size(), [tmp](db::commitlog::output& dst) {
+                    dst.write(tmp.begin(), tmp.end());
+                }).discard_result();
+            }).get();
+            BOOST_REQUIRE(log.get_flush_count() - flushes < 10);
+        });
+    });
+}
+
 static future<> corrupt_segment(sstring seg, uint64_t off, uint32_t value) {
     return open_file_dma(seg, open_flags::rw).then([off, value](file f) {
         size_t size = align_up<size_t>(off, 4096);
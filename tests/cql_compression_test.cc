@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <lz4.h>
+#include <snappy-c.h>
+
+#include "tests/test-utils.hh"
+#include "tests/cql_test_env.hh"
+
+#include "core/thread.hh"
+#include "service/storage_proxy.hh"
+#include "transport/server.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+using transport::cql_compression;
+
+static constexpr uint16_t test_port = 19042;
+// Matches native_transport_compression_threshold's default.
+static constexpr size_t test_threshold = 512;
+
+static constexpr uint8_t request_version = 3;
+static constexpr uint8_t startup_opcode = 0x01;
+static constexpr uint8_t ready_opcode = 0x02;
+static constexpr uint8_t query_opcode = 0x07;
+static constexpr uint8_t result_opcode = 0x08;
+
+static void append_short(sstring& out, uint16_t v) {
+    out += char(v >> 8);
+    out += char(v);
+}
+
+static void append_int(sstring& out, uint32_t v) {
+    append_short(out, v >> 16);
+    append_short(out, v);
+}
+
+static void append_string(sstring& out, const sstring& s) {
+    append_short(out, s.size());
+    out += s;
+}
+
+static uint32_t read_int(const char* p) {
+    auto b = reinterpret_cast<const uint8_t*>(p);
+    return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | b[3];
+}
+
+static sstring compress(cql_compression c, const sstring& body) {
+    if (c == cql_compression::lz4) {
+        sstring out;
+        append_int(out, body.size());
+        sstring comp(sstring::initialized_later(), LZ4_compressBound(body.size()));
+        auto len = LZ4_compress(body.begin(), comp.begin(), body.size());
+        BOOST_REQUIRE(len > 0);
+        return out + sstring(comp.begin(), len);
+    }
+    size_t len = snappy_max_compressed_length(body.size());
+    sstring comp(sstring::initialized_later(), len);
+    BOOST_REQUIRE(snappy_compress(body.begin(), body.size(), comp.begin(), &len) == SNAPPY_OK);
+    return sstring(comp.begin(), len);
+}
+
+static sstring decompress(cql_compression c, const sstring& body) {
+    if (c == cql_compression::lz4) {
+        BOOST_REQUIRE(body.size() >= 4);
+        auto len = read_int(body.begin());
+        sstring out(sstring::initialized_later(), len);
+        BOOST_REQUIRE_EQUAL(LZ4_decompress_safe(body.begin() + 4, out.begin(), body.size() - 4, len), int(len));
+        return out;
+    }
+    size_t len;
+    BOOST_REQUIRE(snappy_uncompressed_length(body.begin(), body.size(), &len) == SNAPPY_OK);
+    sstring out(sstring::initialized_later(), len);
+    BOOST_REQUIRE(snappy_uncompress(body.begin(), body.size(), out.begin(), &len) == SNAPPY_OK);
+    return out;
+}
+
+// A minimal native protocol client, good enough to look at the compression
+// flag of the frames the server sends. Must be used in a seastar thread.
+class test_client {
+    connected_socket _socket;
+    input_stream<char> _in;
+    output_stream<char> _out;
+    uint16_t _stream = 0;
+public:
+    struct frame {
+        bool compressed;
+        uint8_t opcode;
+        sstring body;
+    };
+
+    test_client()
+        : _socket(engine().net().connect(make_ipv4_address(ipv4_addr("127.0.0.1", test_port))).get0())
+        , _in(_socket.input())
+        , _out(_socket.output())
+    { }
+
+    void send(uint8_t opcode, const sstring& body, bool compressed = false) {
+        sstring frame;
+        frame += char(request_version);
+        frame += char(compressed ? transport::cql_frame_flags::compression : 0);
+        append_short(frame, _stream++);
+        frame += char(opcode);
+        append_int(frame, body.size());
+        _out.write(frame + body).get();
+        _out.flush().get();
+    }
+
+    frame receive() {
+        auto header = _in.read_exactly(9).get0();
+        BOOST_REQUIRE_EQUAL(header.size(), 9u);
+        BOOST_REQUIRE_EQUAL(uint8_t(header[0]), 0x80 | request_version);
+        auto body = _in.read_exactly(read_int(header.get() + 5)).get0();
+        return frame{bool(header[1] & transport::cql_frame_flags::compression), uint8_t(header[4]), sstring(body.get(), body.size())};
+    }
+
+    void startup(cql_compression c) {
+        sstring body;
+        append_short(body, 2);
+        append_string(body, "CQL_VERSION");
+        append_string(body, "3.0.0");
+        append_string(body, "COMPRESSION");
+        append_string(body, c == cql_compression::lz4 ? "lz4" : "snappy");
+        send(startup_opcode, body);
+        auto f = receive();
+        BOOST_REQUIRE_EQUAL(f.opcode, ready_opcode);
+        // READY is sent before compression is in use.
+        BOOST_REQUIRE(!f.compressed);
+    }
+
+    static sstring query_body(const sstring& query) {
+        sstring body;
+        append_int(body, query.size());
+        body += query;
+        append_short(body, 0x0001); // ONE
+        body += char(0);
+        return body;
+    }
+
+    void close() {
+        _out.close().get();
+        _in.close().get();
+    }
+};
+
+SEASTAR_TEST_CASE(test_compression_negotiation) {
+    return do_with_cql_env([] (cql_test_env& e) {
+        return seastar::async([&e] {
+            sstring big(4096, 'x');
+            e.execute_cql("create table ks.compressed (p int primary key, v text);").get();
+            e.execute_cql(sprint("insert into ks.compressed (p, v) values (0, '%s');", big)).get();
+
+            distributed<transport::cql_server> server;
+            server.start(std::ref(server), std::ref(service::get_storage_proxy()), std::ref(e.qp()), transport::cql_load_balance::none,
+                    test_threshold, transport::admission_controller::config()).get();
+            server.invoke_on_all(&transport::cql_server::listen, ipv4_addr("127.0.0.1", test_port),
+                    std::shared_ptr<seastar::tls::credentials_builder>(), false).get();
+
+            for (auto c : {cql_compression::lz4, cql_compression::snappy}) {
+                BOOST_TEST_MESSAGE(sprint("Testing %s", c == cql_compression::lz4 ? "lz4" : "snappy"));
+                test_client client;
+                client.startup(c);
+
+                // A response below the threshold goes out uncompressed.
+                client.send(query_opcode, test_client::query_body("insert into ks.compressed (p, v) values (1, 'y');"));
+                auto small = client.receive();
+                BOOST_REQUIRE_EQUAL(small.opcode, result_opcode);
+                BOOST_REQUIRE(small.body.size() < test_threshold);
+                BOOST_REQUIRE(!small.compressed);
+
+                // A larger one is compressed with the negotiated algorithm,
+                // and compressed requests are understood.
+                auto query = test_client::query_body("select v from ks.compressed where p = 0;");
+                client.send(query_opcode, compress(c, query), true);
+                auto large = client.receive();
+                BOOST_REQUIRE_EQUAL(large.opcode, result_opcode);
+                BOOST_REQUIRE(large.compressed);
+                auto body = decompress(c, large.body);
+                BOOST_REQUIRE(body.size() >= test_threshold);
+                BOOST_REQUIRE(large.body.size() < body.size());
+                BOOST_REQUIRE(std::search(body.begin(), body.end(), big.begin(), big.end()) != body.end());
+
+                client.close();
+            }
+
+            server.stop().get();
+        });
+    });
+}
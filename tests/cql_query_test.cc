@@ -34,6 +34,8 @@
 #include "core/future-util.hh"
 #include "core/sleep.hh"
 #include "transport/messages/result_message.hh"
+#include "transport/server.hh"
+#include "dht/i_partitioner.hh"
 #include "utils/big_decimal.hh"
 
 #include "disk-error-handler.hh"
@@ -2224,3 +2226,46 @@ SEASTAR_TEST_CASE(test_pg_style_string_literal) {
         });
     });
 }
+
+SEASTAR_TEST_CASE(test_routing_of_prepared_statements) {
+    return do_with_cql_env([] (auto& e) {
+        return seastar::async([&e] {
+            e.execute_cql("create table routing (p int, c int, v int, PRIMARY KEY (p, c));").get();
+            auto s = e.local_db().find_schema("ks", "routing");
+            auto key = partition_key::from_singular(*s, 42);
+            auto token = dht::global_partitioner().get_token(*s, key);
+
+            auto route = [&e] (sstring query, std::vector<bytes_opt> values) {
+                auto prepared = e.local_qp().get_prepared(e.prepare(query).get0());
+                BOOST_REQUIRE(prepared);
+                cql3::query_options options(std::move(values));
+                options.prepare(prepared->bound_names);
+                return std::make_pair(prepared->statement->routing_token(options), transport::routing_shard(*prepared, options));
+            };
+            auto check_routed = [&] (sstring query, std::vector<bytes_opt> values) {
+                auto r = route(query, std::move(values));
+                BOOST_REQUIRE(r.first);
+                BOOST_REQUIRE(*r.first == token);
+                BOOST_REQUIRE(r.second);
+                BOOST_REQUIRE_EQUAL(*r.second, dht::shard_of(token));
+            };
+            auto check_not_routed = [&] (sstring query, std::vector<bytes_opt> values) {
+                auto r = route(query, std::move(values));
+                BOOST_REQUIRE(!r.first);
+                BOOST_REQUIRE(!r.second);
+            };
+
+            auto v = [] (int32_t x) -> bytes_opt { return int32_type->decompose(x); };
+            check_routed("select * from routing where p = ?;", {v(42)});
+            check_routed("select * from routing where p = ? and c = ?;", {v(42), v(1)});
+            check_routed("select * from routing where p = 42 and c = ?;", {v(1)});
+            check_routed("insert into routing (p, c, v) values (?, ?, ?);", {v(42), v(1), v(2)});
+            check_routed("update routing set v = ? where p = ? and c = ?;", {v(2), v(42), v(1)});
+            check_routed("delete from routing where p = ?;", {v(42)});
+
+            check_not_routed("select * from routing;", {});
+            check_not_routed("select * from routing where p in (?, ?);", {v(42), v(43)});
+            check_not_routed("select * from routing where token(p) > ?;", {long_type->decompose(int64_t(0))});
+        });
+    });
+}
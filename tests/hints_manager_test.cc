@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+#include "tests/test-utils.hh"
+#include "tmpdir.hh"
+
+#include "db/hints/manager.hh"
+#include "db/config.hh"
+#include "database.hh"
+#include "schema_builder.hh"
+#include "core/thread.hh"
+#include "core/reactor.hh"
+#include <seastar/util/defer.hh>
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+class test_sender : public db::hints::manager::sender {
+public:
+    std::unordered_map<utils::UUID, schema_ptr> schemas;
+    std::vector<mutation> sent;
+    bool fail = false;
+
+    virtual schema_ptr find_schema(const utils::UUID& cf_id) override {
+        auto i = schemas.find(cf_id);
+        if (i == schemas.end()) {
+            throw no_such_column_family(cf_id);
+        }
+        return i->second;
+    }
+    virtual future<> send(mutation m, gms::inet_address) override {
+        if (fail) {
+            return make_exception_future<>(std::runtime_error("send failed"));
+        }
+        sent.push_back(std::move(m));
+        return make_ready_future<>();
+    }
+};
+
+static schema_ptr make_schema(sstring cf_name) {
+    return schema_builder("ks", cf_name)
+        .with_column("pk", bytes_type, column_kind::partition_key)
+        .with_column("v", bytes_type, column_kind::regular_column)
+        .build();
+}
+
+static mutation make_mutation(schema_ptr s, int i) {
+    mutation m(partition_key::from_single_value(*s, to_bytes(sprint("key%d", i))), s);
+    m.set_clustered_cell(clustering_key::make_empty(), "v", data_value(bytes("v")), 1);
+    return m;
+}
+
+// Runs func with a started manager storing its hints in a temporary
+// directory and delivering them through a test_sender.
+static future<> with_manager(std::function<void (db::hints::manager&, test_sender&, sstring)> func) {
+    return seastar::async([func = std::move(func)] {
+        tmpdir tmp;
+        db::config cfg;
+        cfg.hints_directory() = tmp.path;
+        cfg.hinted_handoff_throttle_in_kb() = 0;
+        auto sender = std::make_unique<test_sender>();
+        auto& s = *sender;
+        db::hints::manager m(cfg, std::move(sender));
+        m.start().get();
+        auto stop = defer([&m] { m.stop().get(); });
+        func(m, s, tmp.path + "/" + to_sstring(engine().cpu_id()));
+    });
+}
+
+static std::vector<sstring> segments_of(const sstring& hints_dir, gms::inet_address ep) {
+    return db::commitlog::list_existing_segments(hints_dir + "/" + ep.to_sstring()).get0();
+}
+
+SEASTAR_TEST_CASE(test_hints_are_replayed_and_kept_on_failure) {
+    return with_manager([] (db::hints::manager& m, test_sender& sender, sstring hints_dir) {
+        auto s = make_schema("cf");
+        sender.schemas.emplace(s->id(), s);
+        gms::inet_address ep("127.0.0.2");
+
+        std::vector<mutation> mutations;
+        for (auto i = 0; i < 3; ++i) {
+            mutations.push_back(make_mutation(s, i));
+            m.store_hint(ep, s, make_lw_shared<const frozen_mutation>(freeze(mutations.back()))).get();
+        }
+        BOOST_REQUIRE_EQUAL(m.get_create_hint_count(ep), 3);
+        BOOST_REQUIRE(m.endpoints_pending_hints() == std::vector<gms::inet_address>({ep}));
+
+        // A failed send leaves the segment for the next attempt.
+        sender.fail = true;
+        m.schedule_delivery(ep).get();
+        BOOST_REQUIRE_EQUAL(m.get_stats().send_errors, 3);
+        BOOST_REQUIRE(sender.sent.empty());
+        BOOST_REQUIRE_EQUAL(segments_of(hints_dir, ep).size(), 1);
+        BOOST_REQUIRE(m.endpoints_pending_hints() == std::vector<gms::inet_address>({ep}));
+
+        sender.fail = false;
+        m.schedule_delivery(ep).get();
+        BOOST_REQUIRE_EQUAL(m.get_stats().sent, 3);
+        BOOST_REQUIRE(sender.sent == mutations);
+        BOOST_REQUIRE(segments_of(hints_dir, ep).empty());
+        BOOST_REQUIRE(m.endpoints_pending_hints().empty());
+    });
+}
+
+SEASTAR_TEST_CASE(test_hints_of_dropped_tables_are_discarded) {
+    return with_manager([] (db::hints::manager& m, test_sender& sender, sstring hints_dir) {
+        auto s = make_schema("cf");
+        auto dropped = make_schema("dropped");
+        sender.schemas.emplace(s->id(), s);
+        gms::inet_address ep("127.0.0.2");
+
+        auto kept = make_mutation(s, 0);
+        m.store_hint(ep, s, make_lw_shared<const frozen_mutation>(freeze(kept))).get();
+        m.store_hint(ep, dropped, make_lw_shared<const frozen_mutation>(freeze(make_mutation(dropped, 1)))).get();
+
+        m.schedule_delivery(ep).get();
+        BOOST_REQUIRE_EQUAL(m.get_stats().discarded, 1);
+        BOOST_REQUIRE_EQUAL(m.get_stats().send_errors, 0);
+        BOOST_REQUIRE(sender.sent == std::vector<mutation>({kept}));
+        BOOST_REQUIRE(segments_of(hints_dir, ep).empty());
+        BOOST_REQUIRE(m.endpoints_pending_hints().empty());
+    });
+}
+
+SEASTAR_TEST_CASE(test_hints_older_than_gc_grace_are_discarded) {
+    return with_manager([] (db::hints::manager& m, test_sender& sender, sstring hints_dir) {
+        auto s = make_schema("cf");
+        auto expiring = schema_builder(make_schema("expiring")).set_gc_grace_seconds(0).build();
+        sender.schemas.emplace(s->id(), s);
+        sender.schemas.emplace(expiring->id(), expiring);
+        gms::inet_address ep("127.0.0.2");
+
+        auto kept = make_mutation(s, 0);
+        m.store_hint(ep, s, make_lw_shared<const frozen_mutation>(freeze(kept))).get();
+        m.store_hint(ep, expiring, make_lw_shared<const frozen_mutation>(freeze(make_mutation(expiring, 1)))).get();
+
+        m.schedule_delivery(ep).get();
+        BOOST_REQUIRE_EQUAL(m.get_stats().discarded, 1);
+        BOOST_REQUIRE_EQUAL(m.get_stats().sent, 1);
+        BOOST_REQUIRE(sender.sent == std::vector<mutation>({kept}));
+        BOOST_REQUIRE(segments_of(hints_dir, ep).empty());
+        BOOST_REQUIRE(m.endpoints_pending_hints().empty());
+    });
+}
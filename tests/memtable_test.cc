@@ -28,6 +28,7 @@
 
 #include "core/thread.hh"
 #include "memtable.hh"
+#include "frozen_mutation.hh"
 #include "mutation_source_test.hh"
 #include "mutation_reader_assertions.hh"
 
@@ -130,3 +131,101 @@ SEASTAR_TEST_CASE(test_adding_a_column_during_reading_doesnt_affect_read_result)
             .produces_end_of_stream();
     });
 }
+
+SEASTAR_TEST_CASE(test_flush_reader_produces_memtable_contents) {
+    return seastar::async([] {
+        for_each_mutation([] (const mutation& m) {
+            auto mt = make_lw_shared<memtable>(m.schema());
+            mt->apply(m);
+            assert_that(mutation_reader_from_streamed_reader(mt->make_flush_reader(m.schema())))
+                .produces(m)
+                .produces_end_of_stream();
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_flush_reader_resumes_after_compaction_and_schema_change) {
+    return seastar::async([] {
+        auto common_builder = schema_builder("ks", "cf")
+                .with_column("pk", bytes_type, column_kind::partition_key)
+                .with_column("ck", int32_type, column_kind::clustering_key);
+
+        auto s1 = common_builder
+                .with_column("v2", bytes_type, column_kind::regular_column)
+                .build();
+
+        auto s2 = common_builder
+                .with_column("v1", bytes_type, column_kind::regular_column) // new column
+                .with_column("v2", bytes_type, column_kind::regular_column)
+                .build();
+
+        auto nr_rows = 1000;
+        auto make_ckey = [&] (int32_t v) {
+            return clustering_key::from_single_value(*s1, int32_type->decompose(v));
+        };
+        auto deletion_time = gc_clock::now();
+        // Fills the mutation with the rows from first on, and a range
+        // tombstone in the middle of them.
+        auto fill = [&] (mutation& m, int first) {
+            for (auto i = first; i < nr_rows; ++i) {
+                m.set_clustered_cell(make_ckey(i), "v2", data_value(to_bytes(sstring(100, 'x'))), 1);
+            }
+            m.partition().apply_delete(*s1, range_tombstone(make_ckey(500), make_ckey(510), tombstone(2, deletion_time)));
+        };
+
+        auto m = make_unique_mutation(s1);
+        fill(m, 0);
+        auto mt = make_lw_shared<memtable>(s1);
+        mt->apply(m);
+
+        auto rd = mt->make_flush_reader(s1);
+        auto sm = rd().get0();
+        BOOST_REQUIRE(bool(sm));
+        auto first = (*sm)().get0();
+        BOOST_REQUIRE(first && first->is_clustering_row());
+        BOOST_REQUIRE(first->as_clustering_row().key().equal(*s1, make_ckey(0)));
+
+        // Move the partition around, and upgrade it to the new schema.
+        logalloc::shard_tracker().full_compaction();
+        mt->set_schema(s2);
+        auto range = query::partition_range::make_singular(m.decorated_key());
+        assert_that(mt->make_reader(s2, range)).next_mutation().has_schema(s2);
+
+        auto rest = mutation_from_streamed_mutation(std::move(sm)).get0();
+        BOOST_REQUIRE(bool(rest));
+        auto expected = mutation(m.decorated_key(), s1);
+        fill(expected, 1);
+        assert_that(*rest).has_schema(s1).is_equal_to(expected);
+        BOOST_REQUIRE(!rd().get0());
+    });
+}
+
+SEASTAR_TEST_CASE(test_memtable_tracks_min_timestamp) {
+    return seastar::async([] {
+        auto s = schema_builder("ks", "cf")
+                .with_column("pk", bytes_type, column_kind::partition_key)
+                .with_column("ck", int32_type, column_kind::clustering_key)
+                .with_column("v", bytes_type, column_kind::regular_column)
+                .build();
+        auto ckey = clustering_key::from_single_value(*s, int32_type->decompose(int32_t(1)));
+
+        auto mt = make_lw_shared<memtable>(s);
+        BOOST_REQUIRE_EQUAL(mt->min_timestamp(), api::max_timestamp);
+
+        auto m1 = make_unique_mutation(s);
+        m1.set_clustered_cell(ckey, "v", data_value(to_bytes(sstring("v"))), 10);
+        mt->apply(m1);
+        BOOST_REQUIRE_EQUAL(mt->min_timestamp(), 10);
+
+        // Tombstones count too, and so do frozen mutations.
+        auto m2 = make_unique_mutation(s);
+        m2.partition().apply(tombstone(5, gc_clock::now()));
+        mt->apply(freeze(m2), s);
+        BOOST_REQUIRE_EQUAL(mt->min_timestamp(), 5);
+
+        auto m3 = make_unique_mutation(s);
+        m3.set_clustered_cell(ckey, "v", data_value(to_bytes(sstring("v"))), 20);
+        mt->apply(m3);
+        BOOST_REQUIRE_EQUAL(mt->min_timestamp(), 5);
+    });
+}
@@ -25,6 +25,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include "utils/murmur_hash.hh"
+#include "murmur3_hasher.hh"
 #include "bytes.hh"
 #include "core/print.hh"
 
@@ -121,5 +122,17 @@ BOOST_AUTO_TEST_CASE(test_hash_output) {
             utils::murmur_hash::hash3_x64_128(prefix.begin(), prefix.size(), seed, dst);
             assert_hashes_equal(prefix, dst, expected);
         }
+
+        // Test the incremental version, fed in pieces of various sizes
+        for (size_t piece = 1; piece <= 17; ++piece) {
+            murmur3_hasher h(seed);
+            for (size_t pos = 0; pos < prefix.size(); pos += piece) {
+                auto n = std::min(piece, prefix.size() - pos);
+                h.update(reinterpret_cast<const char*>(prefix.begin() + pos), n);
+            }
+            std::array<uint64_t,2> dst;
+            h.finalize(dst);
+            assert_hashes_equal(prefix, dst, expected);
+        }
     }
 }
@@ -81,6 +81,14 @@ BOOST_AUTO_TEST_CASE(test_token_wraparound_2) {
     BOOST_REQUIRE_EQUAL(midpoint, token_from_long(0x7800'0000'0000'0000));
 }
 
+BOOST_AUTO_TEST_CASE(test_midpoint_of_equal_tokens_wraps) {
+    dht::murmur3_partitioner partitioner;
+    auto t = token_from_long(0x1000'0000'0000'0000);
+    BOOST_REQUIRE_EQUAL(partitioner.midpoint(t, t), token_from_long(0x9000'0000'0000'0000));
+    auto min = dht::minimum_token();
+    BOOST_REQUIRE_EQUAL(partitioner.midpoint(min, min), token_from_long(0));
+}
+
 BOOST_AUTO_TEST_CASE(test_ring_position_is_comparable_with_decorated_key) {
     auto s = schema_builder("ks", "cf")
         .with_column("pk", bytes_type, column_kind::partition_key)
@@ -113,3 +121,31 @@ BOOST_AUTO_TEST_CASE(test_ring_position_is_comparable_with_decorated_key) {
     BOOST_REQUIRE(k2.tri_compare(*s, dht::ring_position::ending_at(k1._token)) > 0);
     BOOST_REQUIRE(k2.tri_compare(*s, dht::ring_position(k1)) > 0);
 }
+
+BOOST_AUTO_TEST_CASE(test_long_tokens_are_compatible_with_byte_tokens) {
+    dht::murmur3_partitioner partitioner;
+    std::vector<int64_t> values = { std::numeric_limits<int64_t>::min() + 1, -1, 0, 1, std::numeric_limits<int64_t>::max() };
+
+    for (auto v : values) {
+        auto t = dht::token::from_long(v);
+        auto b = token_from_long(v);
+        BOOST_REQUIRE(t.has_long_value());
+        BOOST_REQUIRE(!b.has_long_value());
+        BOOST_REQUIRE_EQUAL(t, b);
+        BOOST_REQUIRE(dht::tri_compare(t, b) == 0);
+        BOOST_REQUIRE(std::hash<dht::token>()(t) == std::hash<dht::token>()(b));
+        BOOST_REQUIRE(t.data() == b.data());
+        BOOST_REQUIRE_EQUAL(partitioner.to_sstring(t), partitioner.to_sstring(b));
+    }
+
+    for (size_t i = 1; i < values.size(); ++i) {
+        auto prev = dht::token::from_long(values[i - 1]);
+        auto next = dht::token::from_long(values[i]);
+        BOOST_REQUIRE(prev < next);
+        BOOST_REQUIRE(prev < token_from_long(values[i]));
+        BOOST_REQUIRE(token_from_long(values[i - 1]) < next);
+        BOOST_REQUIRE(dht::tri_compare(next, prev) > 0);
+        BOOST_REQUIRE(dht::minimum_token() < prev);
+        BOOST_REQUIRE(next < dht::maximum_token());
+    }
+}
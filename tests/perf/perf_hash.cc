@@ -20,8 +20,12 @@
  */
 
 #include "utils/murmur_hash.hh"
+#include "md5_hasher.hh"
+#include "murmur3_hasher.hh"
 #include "tests/perf/perf.hh"
 
+#include <cryptopp/sha.h>
+
 #include "disk-error-handler.hh"
 
 thread_local disk_error_signal_type commit_error;
@@ -53,5 +57,43 @@ int main(int argc, char* argv[]) {
         sink += dst[1];
     });
 
+    // Digests and repair checksums are computed by feeding many small
+    // fields into an incremental hasher, so compare the hashers that way.
+    auto fields = std::vector<bytes>{bytes("key"), bytes("01234567"),
+            bytes("some column value"), bytes("0123"), src};
+    auto feed = [&fields] (auto& h) {
+        for (auto&& f : fields) {
+            h.update(reinterpret_cast<const char*>(f.begin()), f.size());
+        }
+    };
+
+    std::cout << "Timing md5_hasher...\n";
+
+    time_it([&] {
+        md5_hasher h;
+        feed(h);
+        sink += h.finalize_array()[0];
+    });
+
+    std::cout << "Timing SHA-256...\n";
+
+    time_it([&] {
+        CryptoPP::SHA256 h;
+        for (auto&& f : fields) {
+            h.Update(reinterpret_cast<const byte*>(f.begin()), f.size());
+        }
+        std::array<uint8_t, CryptoPP::SHA256::DIGESTSIZE> digest;
+        h.Final(digest.data());
+        sink += digest[0];
+    });
+
+    std::cout << "Timing murmur3_hasher...\n";
+
+    time_it([&] {
+        murmur3_hasher h;
+        feed(h);
+        sink += h.finalize_array()[0];
+    });
+
     black_hole = sink;
 }
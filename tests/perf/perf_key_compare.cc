@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "database.hh"
+#include "schema_builder.hh"
+#include "utils/UUID_gen.hh"
+#include "perf.hh"
+#include <seastar/core/app-template.hh>
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+// Measures clustering key comparisons for common key shapes, comparing
+// through the component types, as done before key types had comparators,
+// and with the comparators of the schema, and then the throughput of the
+// operations which depend on them: memtable inserts and partition merges.
+
+static constexpr int nr_keys = 10000;
+
+struct key_shape {
+    sstring name;
+    std::vector<data_type> types;
+    // Makes the value of the given component of the i-th key
+    std::function<data_value (size_t, int)> make_component;
+};
+
+static schema_ptr make_schema(const key_shape& shape) {
+    schema_builder builder("ks", "cf");
+    builder.with_column("pk", utf8_type, column_kind::partition_key);
+    int i = 0;
+    for (auto&& t : shape.types) {
+        builder.with_column(to_bytes(sprint("ck%d", i++)), t, column_kind::clustering_key);
+    }
+    builder.with_column("v", int32_type);
+    return builder.build();
+}
+
+static std::vector<clustering_key> make_keys(const schema& s, const key_shape& shape) {
+    std::vector<clustering_key> keys;
+    for (int i = 0; i < nr_keys; ++i) {
+        std::vector<bytes> components;
+        for (size_t c = 0; c < shape.types.size(); ++c) {
+            components.push_back(shape.types[c]->decompose(shape.make_component(c, i)));
+        }
+        keys.push_back(clustering_key::from_exploded(s, components));
+    }
+    std::random_shuffle(keys.begin(), keys.end());
+    return keys;
+}
+
+static mutation make_mutation(schema_ptr s, const partition_key& pk, const std::vector<clustering_key>& keys, int first, int n) {
+    mutation m(pk, s);
+    auto& col = *s->get_column_definition("v");
+    for (int i = first; i < first + n; ++i) {
+        m.set_clustered_cell(keys[i % keys.size()], col, atomic_cell::make_live(0, int32_type->decompose(i)));
+    }
+    return m;
+}
+
+static void run(const key_shape& shape) {
+    auto s = make_schema(shape);
+    auto keys = make_keys(*s, shape);
+    auto& type = s->clustering_key_type();
+    auto pk = partition_key::from_exploded(*s, {to_bytes("key1")});
+
+    std::cout << "\n" << shape.name << ":\n";
+
+    std::cout << "Comparing keys through the types...\n";
+    int i = 0;
+    volatile int sink = 0;
+    time_it([&] {
+        auto& k1 = keys[i++ % nr_keys];
+        auto& k2 = keys[i % nr_keys];
+        sink += lexicographical_tri_compare(type->types().begin(), type->types().end(),
+            type->begin(k1), type->end(k1), type->begin(k2), type->end(k2), tri_compare);
+    });
+
+    std::cout << "Comparing keys with the comparators of the schema...\n";
+    time_it([&] {
+        auto& k1 = keys[i++ % nr_keys];
+        auto& k2 = keys[i % nr_keys];
+        sink += type->compare(k1.representation(), k2.representation());
+    });
+
+    std::cout << "Inserting rows into a memtable...\n";
+    memtable mt(s);
+    time_it([&] {
+        mt.apply(make_mutation(s, pk, keys, i++, 1));
+    });
+
+    std::cout << "Merging partitions of 1000 rows...\n";
+    auto m1 = make_mutation(s, pk, keys, 0, 1000);
+    auto m2 = make_mutation(s, pk, keys, 500, 1000);
+    time_it([&] {
+        mutation m = m1;
+        m.partition().apply(*s, m2.partition(), *s);
+    }, 5, 1);
+}
+
+int main(int argc, char* argv[]) {
+    return app_template().run_deprecated(argc, argv, [] {
+        std::vector<utils::UUID> uuids;
+        for (int i = 0; i < nr_keys; ++i) {
+            uuids.push_back(utils::UUID_gen::get_time_UUID());
+        }
+        std::vector<key_shape> shapes = {
+            { "int", { int32_type }, [] (size_t, int i) { return data_value(int32_t(i)); } },
+            { "bigint", { long_type }, [] (size_t, int i) { return data_value(int64_t(i) << 32); } },
+            { "timeuuid", { timeuuid_type }, [&uuids] (size_t, int i) { return data_value(uuids[i]); } },
+            { "timeuuid DESC", { reversed_type_impl::get_instance(timeuuid_type) }, [&uuids] (size_t, int i) { return data_value(uuids[i]); } },
+            { "text", { utf8_type }, [] (size_t, int i) { return data_value(sprint("clustering-key-%08d", i)); } },
+            { "(int, bigint)", { int32_type, long_type }, [] (size_t c, int i) { return c == 0 ? data_value(int32_t(i / 10)) : data_value(int64_t(i)); } },
+        };
+        for (auto&& shape : shapes) {
+            run(shape);
+        }
+        engine().exit(0);
+    });
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <limits>
+
+#include "tests/test_services.hh"
+#include "tests/test-utils.hh"
+#include "tests/cql_test_env.hh"
+
+#include "querier.hh"
+#include "mutation_query.hh"
+#include "schema_builder.hh"
+#include "partition_slice_builder.hh"
+#include "query-result-set.hh"
+#include "database.hh"
+#include "core/sleep.hh"
+#include "core/thread.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+using namespace std::literals::chrono_literals;
+
+static schema_ptr make_schema() {
+    return schema_builder("ks", "cf")
+        .with_column("pk", bytes_type, column_kind::partition_key)
+        .with_column("ck", bytes_type, column_kind::clustering_key)
+        .with_column("v", bytes_type, column_kind::regular_column)
+        .build();
+}
+
+static std::vector<mutation> make_ring(schema_ptr s, int n) {
+    std::vector<mutation> ring;
+    for (int i = 0; i < n; ++i) {
+        mutation m(partition_key::from_single_value(*s, to_bytes(sprint("key%d", i))), s);
+        m.set_clustered_cell(clustering_key::from_single_value(*s, bytes("ck")), "v", data_value(bytes("v")), 1);
+        ring.push_back(std::move(m));
+    }
+    std::sort(ring.begin(), ring.end(), [s] (const mutation& m1, const mutation& m2) {
+        return m1.decorated_key().less_compare(*s, m2.decorated_key());
+    });
+    return ring;
+}
+
+static querier make_querier(schema_ptr s, const query::partition_range& range, dht::decorated_key last_key) {
+    return querier{s, std::make_unique<query::partition_range>(range),
+        std::make_unique<query::partition_slice>(partition_slice_builder(*s).build()), make_empty_reader(), std::move(last_key)};
+}
+
+static querier make_partition_querier(schema_ptr s, const mutation& m) {
+    return querier{s, std::make_unique<query::partition_range>(query::partition_range::make_singular(m.decorated_key())),
+        std::make_unique<query::partition_slice>(partition_slice_builder(*s).build()), make_empty_reader(), m.decorated_key(), m};
+}
+
+static query::partition_range range_after(const dht::decorated_key& dk) {
+    return query::partition_range::make_starting_with({dht::ring_position(dk), false});
+}
+
+SEASTAR_TEST_CASE(test_lookup_matches_position_and_range) {
+    return seastar::async([] {
+        storage_service_for_tests ssft;
+        auto s = make_schema();
+        auto ring = make_ring(s, 3);
+        auto id = utils::make_random_uuid();
+        querier_cache cache;
+
+        cache.insert(id, make_querier(s, query::full_partition_range, ring[0].decorated_key()));
+        BOOST_REQUIRE_EQUAL(cache.get_stats().population, 1);
+
+        // Not where the reader stopped
+        BOOST_REQUIRE(!cache.lookup(id, *s, range_after(ring[1].decorated_key())));
+        // Different range end
+        BOOST_REQUIRE(!cache.lookup(id, *s, query::partition_range::make({dht::ring_position(ring[0].decorated_key()), false},
+                {dht::ring_position(ring[2].decorated_key()), true})));
+        // Different query
+        BOOST_REQUIRE(!cache.lookup(utils::make_random_uuid(), *s, range_after(ring[0].decorated_key())));
+        BOOST_REQUIRE_EQUAL(cache.get_stats().misses, 3);
+
+        auto q = cache.lookup(id, *s, range_after(ring[0].decorated_key()));
+        BOOST_REQUIRE(q);
+        BOOST_REQUIRE(q->last_key.equal(*s, ring[0].decorated_key()));
+        BOOST_REQUIRE_EQUAL(cache.get_stats().hits, 1);
+        BOOST_REQUIRE_EQUAL(cache.get_stats().population, 0);
+
+        // Taken out
+        BOOST_REQUIRE(!cache.lookup(id, *s, range_after(ring[0].decorated_key())));
+    });
+}
+
+SEASTAR_TEST_CASE(test_entries_are_evicted) {
+    return seastar::async([] {
+        storage_service_for_tests ssft;
+        auto s = make_schema();
+        auto ring = make_ring(s, 1);
+        auto& dk = ring[0].decorated_key();
+
+        {
+            querier_cache cache(50ms);
+            cache.insert(utils::make_random_uuid(), make_querier(s, query::full_partition_range, dk));
+            sleep(200ms).get();
+            BOOST_REQUIRE_EQUAL(cache.get_stats().population, 0);
+            BOOST_REQUIRE_EQUAL(cache.get_stats().evictions, 1);
+        }
+
+        {
+            querier_cache cache(querier_cache::default_entry_ttl, std::numeric_limits<size_t>::max());
+            for (size_t i = 0; i < querier_cache::max_entries + 1; ++i) {
+                cache.insert(utils::make_random_uuid(), make_querier(s, query::full_partition_range, dk));
+            }
+            BOOST_REQUIRE_EQUAL(cache.get_stats().population, querier_cache::max_entries);
+            BOOST_REQUIRE_EQUAL(cache.get_stats().evictions, 1);
+
+            cache.evict_all_for_table(s->id());
+            BOOST_REQUIRE_EQUAL(cache.get_stats().population, 0);
+        }
+    });
+}
+
+SEASTAR_TEST_CASE(test_querying_reader_resumes_after_last_partition) {
+    return seastar::async([] {
+        storage_service_for_tests ssft;
+        auto s = make_schema();
+        auto ring = make_ring(s, 4);
+        auto src = mutation_source([&ring] (schema_ptr, const query::partition_range&) {
+            return make_reader_returning_many(ring);
+        });
+        auto slice = partition_slice_builder(*s).build();
+        auto now = gc_clock::now();
+
+        std::vector<dht::decorated_key> keys;
+        auto consumer = [&keys] (uint32_t, mutation&& m) {
+            keys.push_back(m.decorated_key());
+        };
+
+        querying_reader first(s, src, query::full_partition_range, slice, 2, now, consumer);
+        first.read().get();
+        BOOST_REQUIRE_EQUAL(keys.size(), 2);
+
+        querying_reader second(s, src, query::full_partition_range, slice, 2, now, consumer);
+        second.resume(first.release_reader());
+        second.read().get();
+        BOOST_REQUIRE_EQUAL(keys.size(), 4);
+        for (unsigned i = 0; i < ring.size(); ++i) {
+            BOOST_REQUIRE(keys[i].equal(*s, ring[i].decorated_key()));
+        }
+    });
+}
+
+SEASTAR_TEST_CASE(test_parked_partitions_match_singular_ranges_only) {
+    return seastar::async([] {
+        storage_service_for_tests ssft;
+        auto s = make_schema();
+        auto ring = make_ring(s, 2);
+        auto id = utils::make_random_uuid();
+        querier_cache cache;
+
+        cache.insert(id, make_partition_querier(s, ring[0]));
+        BOOST_REQUIRE(!cache.lookup(id, *s, query::partition_range::make_starting_with({dht::ring_position(ring[0].decorated_key()), true})));
+        BOOST_REQUIRE(!cache.lookup(id, *s, query::partition_range::make_singular(ring[1].decorated_key())));
+        auto q = cache.lookup(id, *s, query::partition_range::make_singular(ring[0].decorated_key()));
+        BOOST_REQUIRE(q);
+        BOOST_REQUIRE(q->partition);
+        BOOST_REQUIRE(*q->partition == ring[0]);
+
+        // A parked reader doesn't continue a singular range.
+        cache.insert(id, make_querier(s, query::full_partition_range, ring[0].decorated_key()));
+        BOOST_REQUIRE(!cache.lookup(id, *s, query::partition_range::make_singular(ring[0].decorated_key())));
+    });
+}
+
+SEASTAR_TEST_CASE(test_memory_usage_is_bounded) {
+    return seastar::async([] {
+        storage_service_for_tests ssft;
+        auto s = make_schema();
+        auto ring = make_ring(s, 1);
+        auto& dk = ring[0].decorated_key();
+
+        // Room for two parked readers, and some.
+        querier_cache cache(querier_cache::default_entry_ttl, 2 * querier_cache::reader_memory_estimate + 4096);
+        for (int i = 0; i < 5; ++i) {
+            cache.insert(utils::make_random_uuid(), make_querier(s, query::full_partition_range, dk));
+        }
+        BOOST_REQUIRE_EQUAL(cache.get_stats().population, 2);
+        BOOST_REQUIRE_EQUAL(cache.get_stats().evictions, 3);
+        BOOST_REQUIRE(cache.get_stats().memory_usage > 2 * querier_cache::reader_memory_estimate);
+        BOOST_REQUIRE(cache.get_stats().memory_usage <= 2 * querier_cache::reader_memory_estimate + 4096);
+
+        // A small parked partition still fits next to them.
+        cache.insert(utils::make_random_uuid(), make_partition_querier(s, ring[0]));
+        BOOST_REQUIRE_EQUAL(cache.get_stats().population, 3);
+
+        // An entry larger than the whole budget isn't kept, nor does it
+        // evict anything.
+        mutation big(ring[0].key(), s);
+        for (int i = 0; i < 100; ++i) {
+            big.set_clustered_cell(clustering_key::from_single_value(*s, to_bytes(sprint("ck%d", i))), "v", data_value(bytes(8192, 'v')), 1);
+        }
+        cache.insert(utils::make_random_uuid(), make_partition_querier(s, big));
+        BOOST_REQUIRE_EQUAL(cache.get_stats().population, 3);
+        BOOST_REQUIRE_EQUAL(cache.get_stats().evictions, 4);
+
+        cache.clear();
+        BOOST_REQUIRE_EQUAL(cache.get_stats().memory_usage, 0);
+    });
+}
+
+SEASTAR_TEST_CASE(test_paged_query_resumes_inside_partition) {
+    return do_with_cql_env([] (cql_test_env& e) {
+        return seastar::async([&e] {
+            e.execute_cql("create table paged (p int, c int, v int, PRIMARY KEY (p, c));").get();
+            auto& db = e.local_db();
+            auto s = db.find_schema("ks", "paged");
+
+            // A partition owned by this shard, so that db.query() finds it.
+            int32_t p = 0;
+            while (dht::shard_of(dht::global_partitioner().decorate_key(*s, partition_key::from_singular(*s, p)).token()) != engine().cpu_id()) {
+                ++p;
+            }
+            auto pk = partition_key::from_singular(*s, p);
+            auto dk = dht::global_partitioner().decorate_key(*s, pk);
+            for (int32_t c = 0; c < 10; ++c) {
+                e.execute_cql(sprint("insert into paged (p, c, v) values (%d, %d, %d);", p, c, c)).get();
+            }
+
+            auto ranges = std::vector<query::partition_range>{query::partition_range::make_singular(dk)};
+            auto id = utils::make_random_uuid();
+            auto slice = partition_slice_builder(*s).build();
+            auto hits = db.get_querier_cache_stats().hits;
+            std::vector<int32_t> seen;
+            for (int page = 0; page < 4; ++page) {
+                query::read_command cmd(s->id(), s->version(), slice, 3, gc_clock::now(), std::experimental::nullopt, id);
+                auto result = db.query(s, cmd, query::result_request::only_result, ranges).get0();
+                auto rs = query::result_set::from_raw_result(s, slice, *result);
+                for (auto&& row : rs.rows()) {
+                    seen.push_back(row.get_nonnull<int32_t>("c"));
+                }
+                if (page == 0) {
+                    // Later pages are served from the partition parked by
+                    // the first one.
+                    e.execute_cql(sprint("insert into paged (p, c, v) values (%d, 100, 100);", p)).get();
+                }
+                // Continue after the last row, like the pager does.
+                auto last = clustering_key_prefix::from_single_value(*s, int32_type->decompose(seen.back()));
+                slice.set_range(*s, pk, {query::clustering_range::make_starting_with({last, false})});
+            }
+
+            BOOST_REQUIRE_EQUAL(seen.size(), 10u);
+            for (int32_t c = 0; c < 10; ++c) {
+                BOOST_REQUIRE_EQUAL(seen[c], c);
+            }
+            BOOST_REQUIRE_EQUAL(db.get_querier_cache_stats().hits - hits, 3u);
+            // The last page ended with the partition, nothing is left parked.
+            BOOST_REQUIRE(!db.get_querier_cache_stats().population);
+        });
+    });
+}
@@ -30,6 +30,7 @@
 #include "tests/mutation_source_test.hh"
 
 #include "schema_builder.hh"
+#include "partition_slice_builder.hh"
 #include "row_cache.hh"
 #include "core/thread.hh"
 #include "memtable.hh"
@@ -731,3 +732,76 @@ SEASTAR_TEST_CASE(test_invalidate_works_with_wrap_arounds) {
         verify_does_not_have(cache, ring[7].decorated_key());
     });
 }
+
+SEASTAR_TEST_CASE(test_partial_partition_population) {
+    return seastar::async([] {
+        auto s = schema_builder("ks", "cf")
+            .with_column("pk", bytes_type, column_kind::partition_key)
+            .with_column("ck", int32_type, column_kind::clustering_key)
+            .with_column("v", int32_type)
+            .build();
+
+        auto ck = [&] (int i) {
+            return clustering_key::from_exploded(*s, {int32_type->decompose(i)});
+        };
+
+        mutation m(partition_key::from_single_value(*s, to_bytes("key1")), s);
+        for (int i = 0; i < 10; ++i) {
+            m.set_clustered_cell(ck(i), "v", data_value(i), next_timestamp++);
+        }
+
+        auto mt = make_lw_shared<memtable>(s);
+        mt->apply(m);
+
+        unsigned reads = 0;
+        cache_tracker tracker;
+        row_cache cache(s, mutation_source([mt, &reads] (schema_ptr s, const query::partition_range& range,
+                query::clustering_key_filtering_context ck_filtering) {
+            ++reads;
+            return mt->make_reader(s, range, ck_filtering);
+        }), mt->as_key_source(), tracker);
+
+        auto pr = query::partition_range::make_singular(query::ring_position(m.decorated_key()));
+
+        auto make_range = [&] (int start, int end) {
+            return query::clustering_range::make({ck(start), true}, {ck(end), true});
+        };
+
+        auto check_read = [&] (query::clustering_row_ranges ranges, unsigned expected_reads) {
+            auto builder = partition_slice_builder(*s);
+            for (auto&& r : ranges) {
+                builder.with_range(r);
+            }
+            auto slice = builder.build();
+            auto expected = mutation(s, m.decorated_key(), mutation_partition(m.partition(), *s, ranges));
+            assert_that(cache.make_reader(s, pr, query::clustering_key_filtering_context::create(s, slice)))
+                .produces(expected)
+                .produces_end_of_stream();
+            BOOST_REQUIRE_EQUAL(reads, expected_reads);
+        };
+
+        // Only the requested rows are read and cached
+        check_read({make_range(2, 4)}, 1);
+        check_read({make_range(3, 4)}, 1);
+        check_read({make_range(2, 2), make_range(4, 4)}, 1);
+
+        // Rows which are not cached are read from the underlying source
+        check_read({make_range(3, 6)}, 2);
+        check_read({make_range(2, 6)}, 2);
+        check_read({make_range(1, 7)}, 3);
+
+        // A full read completes the partition
+        check_read({query::clustering_range::make_open_ended_both_sides()}, 4);
+        check_read({query::clustering_range::make_open_ended_both_sides()}, 4);
+        check_read({make_range(8, 9)}, 4);
+
+        // Range scans don't use incomplete partitions
+        cache.invalidate(m.decorated_key());
+        check_read({make_range(2, 4)}, 5);
+        assert_that(cache.make_reader(s, query::full_partition_range))
+            .produces(m)
+            .produces_end_of_stream();
+        BOOST_REQUIRE_EQUAL(reads, 6);
+        check_read({query::clustering_range::make_open_ended_both_sides()}, 6);
+    });
+}
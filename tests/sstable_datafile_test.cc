@@ -31,6 +31,7 @@
 #include "schema_builder.hh"
 #include "database.hh"
 #include "sstables/leveled_manifest.hh"
+#include "sstables/sstable_set.hh"
 #include <memory>
 #include "sstable_test.hh"
 #include "core/seastar.hh"
@@ -1667,6 +1668,78 @@ static bool sstable_overlaps(const lw_shared_ptr<column_family>& cf, int64_t gen
     return range1.overlaps(range2, dht::token_comparator());
 }
 
+static void add_sstable_for_time_window_test(lw_shared_ptr<column_family>& cf, int64_t gen, int64_t min_timestamp,
+        int64_t max_timestamp, uint32_t max_local_deletion_time, sstring first_key, sstring last_key) {
+    auto sst = make_lw_shared<sstable>("ks", "cf", "", gen, la, big);
+    sstables::test(sst).set_values_for_time_window_strategy(1024, min_timestamp, max_timestamp, max_local_deletion_time,
+        std::move(first_key), std::move(last_key));
+    column_family_test(cf).add_sstable(std::move(*sst));
+}
+
+static std::set<int64_t> generations_of(const std::vector<shared_sstable>& sstables) {
+    std::set<int64_t> generations;
+    for (auto&& sst : sstables) {
+        generations.insert(sst->generation());
+    }
+    return generations;
+}
+
+SEASTAR_TEST_CASE(time_window_strategy_test) {
+    auto s = make_lw_shared(schema({}, some_keyspace, some_column_family,
+        {{"p1", utf8_type}}, {}, {}, {}, utf8_type));
+
+    column_family::config cfg;
+    compaction_manager cm;
+    cfg.enable_disk_writes = false;
+    cfg.enable_commitlog = false;
+    auto cf = make_lw_shared<column_family>(s, cfg, column_family::no_commitlog(), cm);
+    cf->mark_ready_for_writes();
+
+    auto key_and_token_pair = token_generation_for_current_shard(2);
+    auto min_key = key_and_token_pair[0].first;
+    auto max_key = key_and_token_pair[1].first;
+    auto live = std::numeric_limits<int32_t>::max();
+
+    std::map<sstring, sstring> options = {
+        { "compaction_window_unit", "HOURS" },
+        { "compaction_window_size", "1" },
+        { "timestamp_resolution", "SECONDS" },
+    };
+    auto get_candidates = [&] {
+        std::vector<shared_sstable> candidates;
+        for (auto&& entry : *cf->get_sstables()) {
+            candidates.push_back(entry.second);
+        }
+        return candidates;
+    };
+
+    // Two sstables in the window of the first hour, one in the third.
+    add_sstable_for_time_window_test(cf, 1, 100, 100, live, min_key, max_key);
+    add_sstable_for_time_window_test(cf, 2, 200, 200, live, min_key, max_key);
+    add_sstable_for_time_window_test(cf, 3, 7300, 7300, live, min_key, max_key);
+
+    auto cs = make_compaction_strategy(compaction_strategy_type::time_window, options);
+    auto descriptor = cs.get_sstables_for_compaction(*cf, get_candidates());
+    BOOST_REQUIRE(!descriptor.drop_expired);
+    BOOST_REQUIRE(generations_of(descriptor.sstables) == std::set<int64_t>({1, 2}));
+
+    // Both expired, but only the first one has no data older than what
+    // is in the other sstables.
+    add_sstable_for_time_window_test(cf, 4, 10000, 10000, 1, min_key, max_key);
+    add_sstable_for_time_window_test(cf, 5, 150, 150, 1, min_key, max_key);
+
+    cs = make_compaction_strategy(compaction_strategy_type::time_window, options);
+    descriptor = cs.get_sstables_for_compaction(*cf, get_candidates());
+    BOOST_REQUIRE(descriptor.drop_expired);
+    BOOST_REQUIRE(generations_of(descriptor.sstables) == std::set<int64_t>({4}));
+
+    // Expired sstables are only looked for once in a while.
+    descriptor = cs.get_sstables_for_compaction(*cf, get_candidates());
+    BOOST_REQUIRE(!descriptor.drop_expired);
+
+    return make_ready_future<>();
+}
+
 SEASTAR_TEST_CASE(leveled_01) {
     auto s = make_lw_shared(schema({}, some_keyspace, some_column_family,
         {{"p1", utf8_type}}, {}, {}, {}, utf8_type));
@@ -1990,6 +2063,52 @@ SEASTAR_TEST_CASE(leveled_07) {
     return make_ready_future<>();
 }
 
+SEASTAR_TEST_CASE(sstable_set_select) {
+    auto s = make_lw_shared(schema({}, some_keyspace, some_column_family,
+        {{"p1", utf8_type}}, {}, {}, {}, utf8_type));
+
+    auto key_and_token_pair = token_generation_for_current_shard(30);
+    auto key = [&] (unsigned i) {
+        return key_and_token_pair[i].first;
+    };
+    auto make_sst = [&] (int64_t gen, uint32_t level, unsigned first, unsigned last) {
+        auto sst = make_lw_shared<sstable>("ks", "cf", "", gen, la, big);
+        sstables::test(sst).set_values_for_leveled_strategy(0, level, 0, key(first), key(last));
+        return sst;
+    };
+    auto decorated = [&] (unsigned i) {
+        return dht::global_partitioner().decorate_key(*s, partition_key::from_exploded(*s, {to_bytes(key(i))}));
+    };
+    auto generations = [] (std::vector<shared_sstable> ssts) {
+        std::set<int64_t> ret;
+        for (auto&& sst : ssts) {
+            ret.insert(sst->generation());
+        }
+        return ret;
+    };
+
+    sstables::sstable_set set(s);
+    set.insert(make_sst(1, 1, 0, 9));
+    set.insert(make_sst(2, 1, 10, 19));
+    set.insert(make_sst(3, 1, 20, 29));
+    set.insert(make_sst(4, 0, 5, 25));
+    set.insert(make_sst(5, 0, 26, 29));
+    BOOST_REQUIRE(set.size() == 5);
+
+    auto singular = query::partition_range::make_singular(decorated(12));
+    BOOST_REQUIRE(generations(set.select(singular)) == std::set<int64_t>({2, 4}));
+
+    auto head = query::partition_range::make({dht::ring_position(decorated(0))}, {dht::ring_position(decorated(3))});
+    BOOST_REQUIRE(generations(set.select(head)) == std::set<int64_t>({1}));
+
+    auto tail = query::partition_range::make_starting_with({dht::ring_position(decorated(19)), false});
+    BOOST_REQUIRE(generations(set.select(tail)) == std::set<int64_t>({3, 4, 5}));
+
+    BOOST_REQUIRE(generations(set.select(query::full_partition_range)) == std::set<int64_t>({1, 2, 3, 4, 5}));
+
+    return make_ready_future<>();
+}
+
 static lw_shared_ptr<key_reader> prepare_key_reader(schema_ptr s,
     const std::vector<shared_sstable>& ssts, const query::partition_range& range)
 {
@@ -2161,6 +2280,56 @@ SEASTAR_TEST_CASE(check_read_indexes) {
     });
 }
 
+SEASTAR_TEST_CASE(index_cache_test) {
+    return seastar::async([] {
+        auto& cache = sstables::global_index_cache();
+        auto sst = make_lw_shared<sstable>("test", "summary_test", "tests/sstables/summary_test", 1,
+            sstables::sstable::version_types::ka, big);
+        sst->load().get();
+
+        auto stats = cache.get_stats();
+        auto pages = cache.pages();
+
+        auto list = sstables::test(sst).read_indexes(0).get0();
+        BOOST_REQUIRE(list.size() == 130);
+        BOOST_REQUIRE(cache.get_stats().misses == stats.misses + 1);
+        BOOST_REQUIRE(cache.get_stats().insertions == stats.insertions + 1);
+        BOOST_REQUIRE(cache.pages() == pages + 1);
+
+        auto cached = sstables::test(sst).read_indexes(0).get0();
+        BOOST_REQUIRE(cache.get_stats().hits == stats.hits + 1);
+        BOOST_REQUIRE(cached.size() == list.size());
+        for (unsigned i = 0; i < list.size(); ++i) {
+            BOOST_REQUIRE(cached[i].get_key_bytes() == list[i].get_key_bytes());
+            BOOST_REQUIRE(cached[i].position() == list[i].position());
+            BOOST_REQUIRE(cached[i].get_promoted_index_bytes() == list[i].get_promoted_index_bytes());
+        }
+
+        // Scans neither use nor populate the cache.
+        stats = cache.get_stats();
+        auto scanned = sstables::test(sst).read_indexes(1, sstable::index_cache_policy::bypass).get0();
+        BOOST_REQUIRE(!scanned.empty());
+        BOOST_REQUIRE(cache.get_stats().hits == stats.hits);
+        BOOST_REQUIRE(cache.get_stats().misses == stats.misses);
+        BOOST_REQUIRE(cache.pages() == pages + 1);
+
+        // Pages are evicted to stay below the limit.
+        auto max_size = cache.max_size();
+        BOOST_REQUIRE(cache.size() > 0);
+        sstables::test(sst).read_indexes(1).get();
+        BOOST_REQUIRE(cache.pages() == pages + 2);
+        cache.set_max_size(cache.size() - 1);
+        BOOST_REQUIRE(cache.pages() < pages + 2);
+        cache.set_max_size(0);
+        BOOST_REQUIRE(cache.pages() == 0);
+        sstables::test(sst).read_indexes(0).get();
+        BOOST_REQUIRE(cache.pages() == 0);
+        cache.set_max_size(max_size);
+
+        sst = {};
+    });
+}
+
 SEASTAR_TEST_CASE(tombstone_purge_test) {
     BOOST_REQUIRE(smp::count == 1);
     // In a column family with gc_grace_seconds set to 0, check that a tombstone
@@ -2368,3 +2537,412 @@ SEASTAR_TEST_CASE(sstable_rewrite) {
         }).then([sst, mt, s] {});
     });
 }
+
+SEASTAR_TEST_CASE(parallel_compaction_test) {
+    BOOST_REQUIRE(smp::count == 1);
+    // Check that a compaction split into sub-ranges writes all partitions
+    // into sstables which don't overlap.
+    return seastar::async([] {
+        auto s = schema_builder("tests", "parallel_compaction")
+            .with_column("id", utf8_type, column_kind::partition_key)
+            .with_column("value", int32_type).build();
+        const column_definition& col = *s->get_column_definition("value");
+        auto tmp = make_lw_shared<tmpdir>();
+        unsigned gen = 1;
+
+        // Two sstables of 1000 partitions, half of them in both.
+        std::vector<shared_sstable> sstables;
+        for (auto first : { 0, 500 }) {
+            auto mt = make_lw_shared<memtable>(s);
+            for (auto i = first; i < first + 1000; ++i) {
+                mutation m(partition_key::from_exploded(*s, {to_bytes(sprint("key%d", i))}), s);
+                m.set_clustered_cell(clustering_key::make_empty(), col, make_atomic_cell(int32_type->decompose(i)));
+                mt->apply(std::move(m));
+            }
+            auto sst = make_lw_shared<sstable>("ks", "cf", tmp->path, gen++, la, big);
+            sst->write_components(*mt).get();
+            sst->load().get();
+            sstables.push_back(sst);
+        }
+
+        auto cm = make_lw_shared<compaction_manager>();
+        auto cf = make_lw_shared<column_family>(s, column_family::config(), column_family::no_commitlog(), *cm);
+        cf->mark_ready_for_writes();
+        auto create = [tmp, &gen] {
+            auto sst = make_lw_shared<sstable>("ks", "cf", tmp->path, gen++, la, big);
+            sst->set_unshared();
+            return sst;
+        };
+        auto new_sstables = sstables::compact_sstables(sstables, *cf, create, std::numeric_limits<uint64_t>::max(), 0, false, 4).get0();
+        BOOST_REQUIRE(new_sstables.size() > 1);
+
+        auto first_token = [s] (const shared_sstable& sst) {
+            return dht::global_partitioner().get_token(*s, sst->get_first_partition_key(*s));
+        };
+        auto last_token = [s] (const shared_sstable& sst) {
+            return dht::global_partitioner().get_token(*s, sst->get_last_partition_key(*s));
+        };
+        std::sort(new_sstables.begin(), new_sstables.end(), [&] (const shared_sstable& x, const shared_sstable& y) {
+            return first_token(x) < first_token(y);
+        });
+        unsigned partitions = 0;
+        for (size_t i = 0; i < new_sstables.size(); ++i) {
+            if (i > 0) {
+                BOOST_REQUIRE(last_token(new_sstables[i - 1]) < first_token(new_sstables[i]));
+            }
+            auto reader = sstable_reader(new_sstables[i], s);
+            while (reader().get0()) {
+                ++partitions;
+            }
+        }
+        BOOST_REQUIRE_EQUAL(partitions, 1500);
+    });
+}
+
+SEASTAR_TEST_CASE(incremental_compaction_test) {
+    BOOST_REQUIRE(smp::count == 1);
+    // Check that an incremental compaction releases the inputs whose data
+    // is all written, together with the outputs holding it, and only those.
+    return seastar::async([] {
+        auto s = schema_builder("tests", "incremental_compaction")
+            .with_column("id", utf8_type, column_kind::partition_key)
+            .with_column("value", int32_type).build();
+        const column_definition& col = *s->get_column_definition("value");
+        auto tmp = make_lw_shared<tmpdir>();
+        unsigned gen = 1;
+        auto keys = token_generation_for_current_shard(30);
+
+        // Three sstables holding consecutive thirds of the keys.
+        std::vector<shared_sstable> sstables;
+        for (auto first : { 0, 10, 20 }) {
+            auto mt = make_lw_shared<memtable>(s);
+            for (auto i = first; i < first + 10; ++i) {
+                mutation m(partition_key::from_exploded(*s, {to_bytes(keys[i].first)}), s);
+                m.set_clustered_cell(clustering_key::make_empty(), col, make_atomic_cell(int32_type->decompose(i)));
+                mt->apply(std::move(m));
+            }
+            auto sst = make_lw_shared<sstable>("ks", "cf", tmp->path, gen++, la, big);
+            sst->write_components(*mt).get();
+            sst->load().get();
+            // Shared sstables are only released at the end.
+            sst->set_unshared();
+            sstables.push_back(sst);
+        }
+
+        auto cm = make_lw_shared<compaction_manager>();
+        auto cf = make_lw_shared<column_family>(s, column_family::config(), column_family::no_commitlog(), *cm);
+        cf->mark_ready_for_writes();
+        auto create = [tmp, &gen] {
+            auto sst = make_lw_shared<sstable>("ks", "cf", tmp->path, gen++, la, big);
+            sst->set_unshared();
+            return sst;
+        };
+        std::vector<shared_sstable> released_outputs;
+        std::vector<shared_sstable> released_inputs;
+        auto release = [&] (std::vector<shared_sstable> sealed, std::vector<shared_sstable> exhausted) {
+            BOOST_REQUIRE(!sealed.empty() && !exhausted.empty());
+            released_outputs.insert(released_outputs.end(), sealed.begin(), sealed.end());
+            released_inputs.insert(released_inputs.end(), exhausted.begin(), exhausted.end());
+        };
+        // Each output holds a single partition.
+        auto new_sstables = sstables::compact_sstables(sstables, *cf, create, 1, 0, false, 1, release).get0();
+
+        // The last input is only done with at the end of the compaction.
+        BOOST_REQUIRE_EQUAL(released_inputs.size(), 2);
+        BOOST_REQUIRE(released_inputs[0] == sstables[0]);
+        BOOST_REQUIRE(released_inputs[1] == sstables[1]);
+        BOOST_REQUIRE_EQUAL(released_outputs.size(), 20);
+        BOOST_REQUIRE_EQUAL(new_sstables.size(), 10);
+        for (auto& sst : released_outputs) {
+            auto token = dht::global_partitioner().get_token(*s, sst->get_last_partition_key(*s));
+            BOOST_REQUIRE(token < keys[20].second);
+        }
+    });
+}
+
+SEASTAR_TEST_CASE(tombstone_compaction_test) {
+    BOOST_REQUIRE(smp::count == 1);
+    // Check that an sstable mostly made of droppable tombstones is compacted
+    // on its own, unless an sstable holding older data overlaps with it.
+    return seastar::async([] {
+        auto builder = schema_builder("tests", "tombstone_compaction")
+            .with_column("id", utf8_type, column_kind::partition_key)
+            .with_column("value", int32_type);
+        builder.set_gc_grace_seconds(0);
+        auto s = builder.build();
+        const column_definition& col = *s->get_column_definition("value");
+        auto tmp = make_lw_shared<tmpdir>();
+        auto keys = token_generation_for_current_shard(20);
+
+        auto cm = make_lw_shared<compaction_manager>();
+        auto cf = make_lw_shared<column_family>(s, column_family::config(), column_family::no_commitlog(), *cm);
+        cf->mark_ready_for_writes();
+
+        auto make_sstable = [&] (int64_t gen, int first, int last, api::timestamp_type ts, bool deleted) {
+            auto mt = make_lw_shared<memtable>(s);
+            for (auto i = first; i <= last; ++i) {
+                mutation m(partition_key::from_exploded(*s, {to_bytes(keys[i].first)}), s);
+                auto cell = deleted ? atomic_cell::make_dead(ts, gc_clock::now() - std::chrono::seconds(10))
+                                    : atomic_cell::make_live(ts, int32_type->decompose(i));
+                m.set_clustered_cell(clustering_key::make_empty(), col, std::move(cell));
+                mt->apply(std::move(m));
+            }
+            auto sst = make_lw_shared<sstable>("ks", "cf", tmp->path, gen, la, big);
+            sst->write_components(*mt).get();
+            sst->load().get();
+            column_family_test(cf).add_sstable(sst);
+            return sst;
+        };
+        auto get_candidates = [&] {
+            std::vector<shared_sstable> candidates;
+            for (auto&& entry : *cf->get_sstables()) {
+                candidates.push_back(entry.second);
+            }
+            return candidates;
+        };
+
+        auto tombstones = make_sstable(1, 0, 9, 10, true);
+        make_sstable(2, 10, 19, 1, false);
+        auto gc_before = gc_clock::now() - s->gc_grace_seconds();
+        BOOST_REQUIRE(tombstones->estimate_droppable_tombstone_ratio(gc_before) > 0.9);
+
+        // Not compacted before tombstone_compaction_interval has elapsed.
+        auto cs = make_compaction_strategy(compaction_strategy_type::size_tiered, {});
+        BOOST_REQUIRE(cs.get_sstables_for_compaction(*cf, get_candidates()).sstables.empty());
+
+        cs = make_compaction_strategy(compaction_strategy_type::size_tiered, {{ "tombstone_compaction_interval", "0" }});
+        auto descriptor = cs.get_sstables_for_compaction(*cf, get_candidates());
+        BOOST_REQUIRE(generations_of(descriptor.sstables) == std::set<int64_t>({1}));
+
+        cs = make_compaction_strategy(compaction_strategy_type::size_tiered, {
+            { "tombstone_compaction_interval", "0" },
+            { "tombstone_threshold", "1" },
+        });
+        BOOST_REQUIRE(cs.get_sstables_for_compaction(*cf, get_candidates()).sstables.empty());
+
+        // Older data which the tombstones may shadow.
+        make_sstable(3, 5, 14, 1, false);
+        cs = make_compaction_strategy(compaction_strategy_type::size_tiered, {{ "tombstone_compaction_interval", "0" }});
+        BOOST_REQUIRE(cs.get_sstables_for_compaction(*cf, get_candidates()).sstables.empty());
+    });
+}
+
+SEASTAR_TEST_CASE(compaction_cardinality_test) {
+    BOOST_REQUIRE(smp::count == 1);
+    // Check that the partitions of sstables holding the same keys are only
+    // counted once when sizing the bloom filter of their compaction's output.
+    return seastar::async([] {
+        auto s = schema_builder("tests", "compaction_cardinality")
+            .with_column("id", utf8_type, column_kind::partition_key)
+            .with_column("value", int32_type).build();
+        const column_definition& col = *s->get_column_definition("value");
+        auto tmp = make_lw_shared<tmpdir>();
+        auto keys = token_generation_for_current_shard(1000);
+
+        std::vector<shared_sstable> sstables;
+        for (auto gen : { 1, 2, 3, 4 }) {
+            auto mt = make_lw_shared<memtable>(s);
+            for (auto& key : keys) {
+                mutation m(partition_key::from_exploded(*s, {to_bytes(key.first)}), s);
+                m.set_clustered_cell(clustering_key::make_empty(), col, make_atomic_cell(int32_type->decompose(gen)));
+                mt->apply(std::move(m));
+            }
+            auto sst = make_lw_shared<sstable>("ks", "cf", tmp->path, gen, la, big);
+            sst->write_components(*mt).get();
+            sst->load().get();
+            sstables.push_back(sst);
+        }
+
+        // The estimator survives its trip through the statistics.
+        auto& cardinality = sstables[0]->get_compaction_metadata().cardinality.elements;
+        temporary_buffer<uint8_t> bytes(cardinality.size());
+        std::copy(cardinality.begin(), cardinality.end(), bytes.get_write());
+        auto estimate = hll::HyperLogLog::from_bytes(std::move(bytes)).estimate();
+        BOOST_REQUIRE(estimate > 950 && estimate < 1050);
+
+        auto cm = make_lw_shared<compaction_manager>();
+        auto cf = make_lw_shared<column_family>(s, column_family::config(), column_family::no_commitlog(), *cm);
+        cf->mark_ready_for_writes();
+        auto create = [tmp] {
+            return make_lw_shared<sstable>("ks", "cf", tmp->path, 5, la, big);
+        };
+        auto new_sstables = sstables::compact_sstables(sstables, *cf, create, std::numeric_limits<uint64_t>::max(), 0).get0();
+        BOOST_REQUIRE_EQUAL(new_sstables.size(), 1);
+        // Sized for about 1000 partitions rather than 4000.
+        BOOST_REQUIRE(new_sstables[0]->filter_memory_size() < 2 * sstables[0]->filter_memory_size());
+    });
+}
+
+SEASTAR_TEST_CASE(incremental_compaction_overlapping_test) {
+    BOOST_REQUIRE(smp::count == 1);
+    // Check that inputs which overlap one another are only released at the
+    // end of an incremental compaction, unlike those which overlap no other.
+    return seastar::async([] {
+        auto s = schema_builder("tests", "incremental_compaction")
+            .with_column("id", utf8_type, column_kind::partition_key)
+            .with_column("value", int32_type).build();
+        const column_definition& col = *s->get_column_definition("value");
+        auto tmp = make_lw_shared<tmpdir>();
+        unsigned gen = 1;
+        auto keys = token_generation_for_current_shard(30);
+
+        auto make_sstable = [&] (std::vector<int> indexes) {
+            auto mt = make_lw_shared<memtable>(s);
+            for (auto i : indexes) {
+                mutation m(partition_key::from_exploded(*s, {to_bytes(keys[i].first)}), s);
+                m.set_clustered_cell(clustering_key::make_empty(), col, make_atomic_cell(int32_type->decompose(i)));
+                mt->apply(std::move(m));
+            }
+            auto sst = make_lw_shared<sstable>("ks", "cf", tmp->path, gen++, la, big);
+            sst->write_components(*mt).get();
+            sst->load().get();
+            sst->set_unshared();
+            return sst;
+        };
+
+        auto cm = make_lw_shared<compaction_manager>();
+        auto cf = make_lw_shared<column_family>(s, column_family::config(), column_family::no_commitlog(), *cm);
+        cf->mark_ready_for_writes();
+        auto create = [tmp, &gen] {
+            auto sst = make_lw_shared<sstable>("ks", "cf", tmp->path, gen++, la, big);
+            sst->set_unshared();
+            return sst;
+        };
+        std::vector<shared_sstable> released_outputs;
+        std::vector<shared_sstable> released_inputs;
+        auto release = [&] (std::vector<shared_sstable> sealed, std::vector<shared_sstable> exhausted) {
+            released_outputs.insert(released_outputs.end(), sealed.begin(), sealed.end());
+            released_inputs.insert(released_inputs.end(), exhausted.begin(), exhausted.end());
+        };
+
+        // Three sstables holding interleaved keys, each spanning the others,
+        // as size-tiered inputs of a random partitioner do.
+        std::vector<shared_sstable> overlapping;
+        for (auto j : { 0, 1, 2 }) {
+            std::vector<int> indexes;
+            for (auto i = j; i < 30; i += 3) {
+                indexes.push_back(i);
+            }
+            overlapping.push_back(make_sstable(std::move(indexes)));
+        }
+        BOOST_REQUIRE(!sstables::can_release_incrementally(*s, overlapping));
+        // Each output holds a single partition, yet none can be released
+        // early: any of them overlaps an input which is kept.
+        auto new_sstables = sstables::compact_sstables(overlapping, *cf, create, 1, 0, false, 1, release).get0();
+        BOOST_REQUIRE(released_inputs.empty());
+        BOOST_REQUIRE(released_outputs.empty());
+        BOOST_REQUIRE_EQUAL(new_sstables.size(), 30);
+
+        // An sstable which overlaps no other is released, together with the
+        // outputs holding its data, while the overlapping ones are kept.
+        std::vector<shared_sstable> mixed;
+        mixed.push_back(make_sstable({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }));
+        for (auto j : { 0, 1 }) {
+            std::vector<int> indexes;
+            for (auto i = 10 + j; i < 30; i += 2) {
+                indexes.push_back(i);
+            }
+            mixed.push_back(make_sstable(std::move(indexes)));
+        }
+        BOOST_REQUIRE(sstables::can_release_incrementally(*s, mixed));
+        new_sstables = sstables::compact_sstables(mixed, *cf, create, 1, 0, false, 1, release).get0();
+        BOOST_REQUIRE_EQUAL(released_inputs.size(), 1);
+        BOOST_REQUIRE(released_inputs[0] == mixed[0]);
+        BOOST_REQUIRE_EQUAL(released_outputs.size(), 10);
+        for (auto& sst : released_outputs) {
+            auto token = dht::global_partitioner().get_token(*s, sst->get_last_partition_key(*s));
+            BOOST_REQUIRE(token < keys[10].second);
+        }
+        BOOST_REQUIRE_EQUAL(new_sstables.size(), 20);
+    });
+}
+
+// Writes an sstable holding the given keys, in cells of the given timestamp.
+static shared_sstable make_sstable_for_time_window(schema_ptr s, sstring dir, int64_t gen, std::vector<sstring> keys,
+        api::timestamp_type timestamp) {
+    const column_definition& col = *s->get_column_definition("value");
+    auto mt = make_lw_shared<memtable>(s);
+    for (auto&& k : keys) {
+        mutation m(partition_key::from_exploded(*s, {to_bytes(k)}), s);
+        m.set_clustered_cell(clustering_key::make_empty(), col, atomic_cell::make_live(timestamp, int32_type->decompose(1)));
+        mt->apply(std::move(m));
+    }
+    auto sst = make_lw_shared<sstable>("tests", "time_window", dir, gen, la, big);
+    sst->write_components(*mt).get();
+    sst->load().get();
+    sst->set_unshared();
+    return sst;
+}
+
+// Compacts the window which is over with the given settings, and checks
+// that the run of sstables it is compacted into isn't compacted again.
+static void check_closed_window_compacted_once(uint64_t incremental_compaction_sstable_size, unsigned parallelism,
+        size_t expected_outputs) {
+    auto s = schema_builder("tests", "time_window")
+        .with_column("id", utf8_type, column_kind::partition_key)
+        .with_column("value", int32_type).build();
+    auto tmp = make_lw_shared<tmpdir>();
+    auto keys = token_generation_for_current_shard(10);
+    auto keys_of = [&keys] (size_t first, size_t last) {
+        std::vector<sstring> ret;
+        for (auto i = first; i < last; ++i) {
+            ret.push_back(keys[i].first);
+        }
+        return ret;
+    };
+
+    auto cm = make_lw_shared<compaction_manager>();
+    column_family::config cfg;
+    cfg.datadir = tmp->path;
+    cfg.enable_commitlog = false;
+    cfg.enable_incremental_backups = false;
+    cfg.incremental_compaction_sstable_size = incremental_compaction_sstable_size;
+    auto cf = make_lw_shared<column_family>(s, cfg, column_family::no_commitlog(), *cm);
+    cf->mark_ready_for_writes();
+
+    // Two key-disjoint sstables in the first hour, one in the third.
+    auto hour = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::hours(1)).count();
+    column_family_test(cf).add_sstable(make_sstable_for_time_window(s, tmp->path, 1, keys_of(0, 5), 100));
+    column_family_test(cf).add_sstable(make_sstable_for_time_window(s, tmp->path, 2, keys_of(5, 10), 200));
+    column_family_test(cf).add_sstable(make_sstable_for_time_window(s, tmp->path, 3, keys_of(0, 10), 2 * hour + 100));
+
+    std::map<sstring, sstring> options = {
+        { "compaction_window_unit", "HOURS" },
+        { "compaction_window_size", "1" },
+    };
+    auto cs = make_compaction_strategy(compaction_strategy_type::time_window, options);
+    auto get_candidates = [&] {
+        std::vector<shared_sstable> candidates;
+        for (auto&& entry : *cf->get_sstables()) {
+            candidates.push_back(entry.second);
+        }
+        return candidates;
+    };
+
+    auto descriptor = cs.get_sstables_for_compaction(*cf, get_candidates());
+    BOOST_REQUIRE(generations_of(descriptor.sstables) == std::set<int64_t>({1, 2}));
+    descriptor.parallelism = parallelism;
+    cf->compact_sstables(std::move(descriptor)).get();
+    BOOST_REQUIRE_EQUAL(cf->sstables_count(), expected_outputs + 1);
+
+    // The window's outputs share their ancestors, and form a single run.
+    descriptor = cs.get_sstables_for_compaction(*cf, get_candidates());
+    BOOST_REQUIRE(descriptor.sstables.empty());
+}
+
+SEASTAR_TEST_CASE(time_window_incremental_compaction_test) {
+    BOOST_REQUIRE(smp::count == 1);
+    return seastar::async([] {
+        // Each output holds a single partition.
+        check_closed_window_compacted_once(1, 1, 10);
+    });
+}
+
+SEASTAR_TEST_CASE(time_window_parallel_compaction_test) {
+    BOOST_REQUIRE(smp::count == 1);
+    return seastar::async([] {
+        // The window is split into two sub-ranges, each written as one
+        // sstable.
+        check_closed_window_compacted_once(0, 2, 2);
+    });
+}
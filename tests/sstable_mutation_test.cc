@@ -34,6 +34,7 @@
 #include "mutation_reader_assertions.hh"
 #include "mutation_source_test.hh"
 #include "tmpdir.hh"
+#include "partition_slice_builder.hh"
 
 #include "disk-error-handler.hh"
 
@@ -421,6 +422,282 @@ SEASTAR_TEST_CASE(test_sstable_can_write_and_read_range_tombstone) {
     });
 }
 
+SEASTAR_TEST_CASE(test_promoted_index_read) {
+    return seastar::async([] {
+        auto dir = make_lw_shared<tmpdir>();
+        auto s = make_lw_shared(schema({}, "ks", "cf",
+            {{"p1", utf8_type}}, {{"c1", int32_type}}, {{"r1", utf8_type}}, {}, utf8_type));
+
+        auto key = partition_key::from_exploded(*s, {to_bytes("key1")});
+        auto make_ckey = [&] (int32_t v) {
+            return clustering_key::from_exploded(*s, {int32_type->decompose(v)});
+        };
+        auto value = sstring(100, 'x');
+        auto nr_rows = 4000;
+
+        mutation m(key, s);
+        for (auto i = 0; i < nr_rows; ++i) {
+            m.set_clustered_cell(make_ckey(i), "r1", data_value(value), 1);
+        }
+        auto ttl = gc_clock::now() + std::chrono::seconds(1);
+        auto rt = range_tombstone(make_ckey(10), bound_kind::incl_start, make_ckey(20), bound_kind::incl_end, tombstone(9, ttl));
+        m.partition().apply_delete(*s, rt);
+
+        auto mt = make_lw_shared<memtable>(s);
+        mt->apply(m);
+
+        auto sst = make_lw_shared<sstables::sstable>("ks", "cf",
+                dir->path,
+                1 /* generation */,
+                sstables::sstable::version_types::la,
+                sstables::sstable::format_types::big);
+        sst->write_components(*mt).get();
+        sst->load().get();
+
+        auto index = sstables::test(sst).read_indexes(0).get0();
+        BOOST_REQUIRE(index.size() == 1);
+        BOOST_REQUIRE(!index[0].get_promoted_index_bytes().empty());
+
+        auto read_slice = [&] (query::clustering_range range) {
+            auto slice = partition_slice_builder(*s).with_range(std::move(range)).build();
+            auto ck_filtering = query::clustering_key_filtering_context::create(s, slice);
+            auto mut = sst->read_row(s, sstables::key::from_partition_key(*s, key), ck_filtering).get0();
+            BOOST_REQUIRE(bool(mut));
+            return std::move(*mut);
+        };
+
+        for (auto i : { 0, 1500, nr_rows - 1 }) {
+            auto mut = read_slice(query::clustering_range::make_singular(make_ckey(i)));
+            auto& rows = mut.partition().clustered_rows();
+            BOOST_REQUIRE(rows.size() == 1);
+            BOOST_REQUIRE(rows.begin()->key().equal(*s, make_ckey(i)));
+            // The range tombstone is in the first block, which is always read.
+            BOOST_REQUIRE(mut.partition().row_tombstones().size() == 1);
+        }
+
+        auto mut = read_slice(query::clustering_range(
+            query::clustering_range::bound(make_ckey(1000)), query::clustering_range::bound(make_ckey(2999))));
+        BOOST_REQUIRE(mut.partition().clustered_rows().size() == 2000u);
+
+        mut = read_slice(query::clustering_range::make_open_ended_both_sides());
+        BOOST_REQUIRE(mut.partition().clustered_rows().size() == size_t(nr_rows));
+    });
+}
+
+// Reads disjoint clustering ranges of a non-compound table, each of them
+// matching its own run of promoted index blocks.
+SEASTAR_TEST_CASE(test_promoted_index_read_disjoint_ranges_non_compound) {
+    return seastar::async([] {
+        auto dir = make_lw_shared<tmpdir>();
+        auto s = schema_builder("ks", "cf")
+            .with_column("p1", utf8_type, column_kind::partition_key)
+            .with_column("c1", int32_type, column_kind::clustering_key)
+            .with_column("r1", utf8_type)
+            .build(schema_builder::compact_storage::yes);
+        BOOST_REQUIRE(!s->is_compound());
+
+        auto key = partition_key::from_exploded(*s, {to_bytes("key1")});
+        auto make_ckey = [&] (int32_t v) {
+            return clustering_key::from_exploded(*s, {int32_type->decompose(v)});
+        };
+        auto value = sstring(100, 'x');
+        auto nr_rows = 4000;
+
+        mutation m(key, s);
+        for (auto i = 0; i < nr_rows; ++i) {
+            m.set_clustered_cell(make_ckey(i), "r1", data_value(value), 1);
+        }
+        auto mt = make_lw_shared<memtable>(s);
+        mt->apply(m);
+
+        auto sst = make_lw_shared<sstables::sstable>("ks", "cf",
+                dir->path,
+                1 /* generation */,
+                sstables::sstable::version_types::la,
+                sstables::sstable::format_types::big);
+        sst->write_components(*mt).get();
+        sst->load().get();
+
+        auto index = sstables::test(sst).read_indexes(0).get0();
+        BOOST_REQUIRE(index.size() == 1);
+        BOOST_REQUIRE(!index[0].get_promoted_index_bytes().empty());
+
+        auto range = [&] (int32_t first, int32_t last) {
+            return query::clustering_range(query::clustering_range::bound(make_ckey(first)),
+                    query::clustering_range::bound(make_ckey(last)));
+        };
+        // Out of order, and with two of them in the same block.
+        auto slice = partition_slice_builder(*s)
+            .with_range(range(3500, 3509))
+            .with_range(range(100, 109))
+            .with_range(range(2000, 2009))
+            .with_range(range(110, 119))
+            .build();
+        auto ck_filtering = query::clustering_key_filtering_context::create(s, slice);
+        auto mut = sst->read_row(s, sstables::key::from_partition_key(*s, key), ck_filtering).get0();
+        BOOST_REQUIRE(bool(mut));
+
+        std::vector<int32_t> expected;
+        for (auto first : { 100, 110, 2000, 3500 }) {
+            for (auto i = first; i < first + 10; ++i) {
+                expected.push_back(i);
+            }
+        }
+        auto& rows = mut->partition().clustered_rows();
+        BOOST_REQUIRE_EQUAL(rows.size(), expected.size());
+        auto it = rows.begin();
+        for (auto i : expected) {
+            BOOST_REQUIRE(it->key().equal(*s, make_ckey(i)));
+            ++it;
+        }
+    });
+}
+
+SEASTAR_TEST_CASE(test_range_tombstones_are_repeated_in_promoted_index_blocks) {
+    return seastar::async([] {
+        auto dir = make_lw_shared<tmpdir>();
+        auto s = make_lw_shared(schema({}, "ks", "cf",
+            {{"p1", utf8_type}}, {{"c1", int32_type}}, {{"r1", utf8_type}}, {}, utf8_type));
+
+        auto key = partition_key::from_exploded(*s, {to_bytes("key1")});
+        auto make_ckey = [&] (int32_t v) {
+            return clustering_key::from_exploded(*s, {int32_type->decompose(v)});
+        };
+        auto value = sstring(100, 'x');
+        auto nr_rows = 4000;
+
+        mutation m(key, s);
+        for (auto i = 0; i < nr_rows; ++i) {
+            m.set_clustered_cell(make_ckey(i), "r1", data_value(value), 10);
+        }
+        auto ttl = gc_clock::now() + std::chrono::seconds(1);
+        // Starts after the first block and spans several others.
+        auto rt = range_tombstone(make_ckey(1000), bound_kind::incl_start, make_ckey(3000), bound_kind::excl_end, tombstone(9, ttl));
+        m.partition().apply_delete(*s, rt);
+
+        auto mt = make_lw_shared<memtable>(s);
+        mt->apply(m);
+
+        auto sst = make_lw_shared<sstables::sstable>("ks", "cf",
+                dir->path,
+                1 /* generation */,
+                sstables::sstable::version_types::la,
+                sstables::sstable::format_types::big);
+        sst->write_components(*mt).get();
+        sst->load().get();
+
+        auto slice = partition_slice_builder(*s).with_range(query::clustering_range::make_singular(make_ckey(2500))).build();
+        auto ck_filtering = query::clustering_key_filtering_context::create(s, slice);
+        auto mut = sst->read_row(s, sstables::key::from_partition_key(*s, key), ck_filtering).get0();
+        BOOST_REQUIRE(bool(mut));
+        BOOST_REQUIRE(mut->partition().clustered_rows().size() == 1);
+        BOOST_REQUIRE(mut->partition().range_tombstone_for_row(*s, make_ckey(2500)) == rt.tomb);
+
+        // Sequential reads see each tombstone once.
+        auto reader = sst->read_rows_streamed(s);
+        auto sm = reader().get0();
+        BOOST_REQUIRE(bool(sm));
+        auto nr_tombstones = 0;
+        while (auto mf = (*sm)().get0()) {
+            if (mf->is_range_tombstone()) {
+                ++nr_tombstones;
+                BOOST_REQUIRE(mf->as_range_tombstone().equal(*s, rt));
+            }
+        }
+        BOOST_REQUIRE(nr_tombstones == 1);
+        BOOST_REQUIRE(!reader().get0());
+    });
+}
+
+SEASTAR_TEST_CASE(test_promoted_index_blocks_extend_to_range_tombstone_end) {
+    return seastar::async([] {
+        auto dir = make_lw_shared<tmpdir>();
+        auto s = make_lw_shared(schema({}, "ks", "cf",
+            {{"p1", utf8_type}}, {{"c1", int32_type}}, {{"r1", utf8_type}}, {}, utf8_type));
+
+        auto key = partition_key::from_exploded(*s, {to_bytes("key1")});
+        auto make_ckey = [&] (int32_t v) {
+            return clustering_key::from_exploded(*s, {int32_type->decompose(v)});
+        };
+        auto value = sstring(100, 'x');
+        auto nr_rows = 2000;
+
+        mutation m(key, s);
+        for (auto i = 0; i < nr_rows; ++i) {
+            m.set_clustered_cell(make_ckey(i), "r1", data_value(value), 10);
+        }
+        auto ttl = gc_clock::now() + std::chrono::seconds(1);
+        // Covers the last rows and extends past them, so that the last
+        // block ends inside of it. The rows it deletes past the last row
+        // of this sstable may be in other sstables.
+        auto rt = range_tombstone(make_ckey(nr_rows - 10), bound_kind::incl_start, make_ckey(nr_rows + 1000), bound_kind::incl_end, tombstone(20, ttl));
+        m.partition().apply_delete(*s, rt);
+
+        auto mt = make_lw_shared<memtable>(s);
+        mt->apply(m);
+
+        auto sst = make_lw_shared<sstables::sstable>("ks", "cf",
+                dir->path,
+                1 /* generation */,
+                sstables::sstable::version_types::la,
+                sstables::sstable::format_types::big);
+        sst->write_components(*mt).get();
+        sst->load().get();
+
+        auto index = sstables::test(sst).read_indexes(0).get0();
+        BOOST_REQUIRE(index.size() == 1);
+        BOOST_REQUIRE(!index[0].get_promoted_index_bytes().empty());
+
+        for (auto start : { nr_rows - 5, nr_rows, nr_rows + 500, nr_rows + 1000 }) {
+            auto slice = partition_slice_builder(*s).with_range(query::clustering_range(
+                query::clustering_range::bound(make_ckey(start)), query::clustering_range::bound(make_ckey(nr_rows + 2000)))).build();
+            auto ck_filtering = query::clustering_key_filtering_context::create(s, slice);
+            auto mut = sst->read_row(s, sstables::key::from_partition_key(*s, key), ck_filtering).get0();
+            BOOST_REQUIRE(bool(mut));
+            BOOST_REQUIRE(mut->partition().range_tombstone_for_row(*s, make_ckey(start)) == rt.tomb);
+        }
+    });
+}
+
+SEASTAR_TEST_CASE(test_streamed_read_matches_mutation_read) {
+    return seastar::async([] {
+        random_mutation_generator gen;
+        auto s = gen.schema();
+        auto mt = make_lw_shared<memtable>(s);
+        for (auto i = 0; i < 10; ++i) {
+            mt->apply(gen(true));
+        }
+
+        auto dir = make_lw_shared<tmpdir>();
+        auto sst = make_lw_shared<sstables::sstable>("ks", "cf",
+                dir->path,
+                1 /* generation */,
+                sstables::sstable::version_types::la,
+                sstables::sstable::format_types::big);
+        sst->write_components(*mt).get();
+        sst->load().get();
+
+        auto expected = sst->read_rows(s);
+        auto reader = sst->read_rows_streamed(s);
+        auto nr_expected = 0;
+        while (auto m = expected.read().get0()) {
+            ++nr_expected;
+            auto actual = mutation_from_streamed_mutation(reader().get0()).get0();
+            BOOST_REQUIRE(bool(actual));
+            assert_that(*actual).is_equal_to(*m);
+        }
+        BOOST_REQUIRE(!reader().get0());
+
+        // Partitions which aren't consumed are skipped.
+        auto skipping = sst->read_rows_streamed(s);
+        auto nr_partitions = 0;
+        while (skipping().get0()) {
+            ++nr_partitions;
+        }
+        BOOST_REQUIRE(nr_partitions == nr_expected);
+    });
+}
+
 SEASTAR_TEST_CASE(compact_storage_sparse_read) {
     return reusable_sst("tests/sstables/compact_sparse", 1).then([] (auto sstp) {
         return do_with(sstables::key("first_row"), [sstp] (auto& key) {
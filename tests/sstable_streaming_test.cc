@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <set>
+
+#include "tests/test-utils.hh"
+#include "tests/cql_test_env.hh"
+#include "tests/cql_assertions.hh"
+
+#include "core/thread.hh"
+#include "core/reactor.hh"
+#include "database.hh"
+#include "dht/i_partitioner.hh"
+#include "streaming/stream_sstable_files.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+// Creates the table and writes an sstable of the current shard, holding
+// the given number of partitions. Must be used in a seastar thread.
+static sstables::shared_sstable make_local_sstable(cql_test_env& e, sstring table, int partitions) {
+    e.execute_cql(sprint("create table ks.%s (p int primary key, v int);", table)).get();
+    auto& cf = e.local_db().find_column_family("ks", table);
+    auto s = cf.schema();
+    int written = 0;
+    for (int k = 0; written < partitions; ++k) {
+        auto dk = dht::global_partitioner().decorate_key(*s, partition_key::from_singular(*s, int32_t(k)));
+        if (dht::shard_of(dk.token()) != engine().cpu_id()) {
+            continue;
+        }
+        e.execute_cql(sprint("insert into ks.%s (p, v) values (%d, %d);", table, k, k)).get();
+        ++written;
+    }
+    cf.flush().get();
+    auto sstables = cf.get_sstables();
+    BOOST_REQUIRE_EQUAL(sstables->size(), 1u);
+    return sstables->begin()->second;
+}
+
+static bytes read_file(sstring path) {
+    auto f = open_file_dma(path, open_flags::ro).get0();
+    auto size = f.size().get0();
+    auto in = make_file_input_stream(f);
+    auto buf = in.read_exactly(size).get0();
+    in.close().get();
+    return bytes(reinterpret_cast<const bytes::value_type*>(buf.get()), buf.size());
+}
+
+// Lists the regular files of the directory, leaving out e.g. upload/.
+static std::set<sstring> list_files(sstring dir) {
+    std::set<sstring> names;
+    auto d = engine().open_directory(dir).get0();
+    d.list_directory([&names] (directory_entry de) {
+        names.insert(de.name);
+        return make_ready_future<>();
+    }).done().get();
+    d.close().get();
+    for (auto it = names.begin(); it != names.end();) {
+        auto type = engine().file_type(dir + "/" + *it).get0();
+        it = type == directory_entry_type::regular ? std::next(it) : names.erase(it);
+    }
+    return names;
+}
+
+static sstring basename(const sstring& path) {
+    return path.substr(path.find_last_of('/') + 1);
+}
+
+// The component files of the sstable, TOC first, as the sender orders them.
+static std::vector<sstring> component_files(sstables::shared_sstable sst) {
+    auto files = sst->component_filenames();
+    auto toc = sst->toc_filename();
+    files.erase(std::remove(files.begin(), files.end(), toc), files.end());
+    files.insert(files.begin(), toc);
+    return files;
+}
+
+// Sends the file in chunks, each of them twice as when a send is retried.
+static void send_file(streaming::sstable_file_receiver& receiver, utils::UUID cf_id, sstring path, size_t chunk_size) {
+    auto data = read_file(path);
+    for (size_t offset = 0; offset < data.size(); offset += chunk_size) {
+        auto len = std::min(chunk_size, data.size() - offset);
+        auto last = offset + len == data.size();
+        auto chunk = bytes(data.begin() + offset, len);
+        receiver.write_chunk(cf_id, basename(path), offset, chunk, last).get();
+        receiver.write_chunk(cf_id, basename(path), offset, chunk, last).get();
+    }
+}
+
+SEASTAR_TEST_CASE(test_sstable_file_receiver) {
+    return do_with_cql_env([] (cql_test_env& e) {
+        return seastar::async([&e] {
+            auto sst = make_local_sstable(e, "src", 10);
+            e.execute_cql("create table ks.dst (p int primary key, v int);").get();
+            auto& dst = e.local_db().find_column_family("ks", "dst");
+            auto cf_id = dst.schema()->id();
+            auto files = component_files(sst);
+            auto data_file = sst->get_filename();
+
+            streaming::sstable_file_receiver receiver(e.db());
+
+            // The TOC has to come first.
+            BOOST_REQUIRE_THROW(receiver.write_chunk(cf_id, basename(data_file), 0, to_bytes(sstring("x")), false).get(), std::runtime_error);
+            BOOST_REQUIRE(list_files(dst.datadir()).empty());
+
+            send_file(receiver, cf_id, files.front(), 7);
+            auto received = list_files(dst.datadir());
+            BOOST_REQUIRE_EQUAL(received.size(), 1u);
+            BOOST_REQUIRE(boost::algorithm::ends_with(*received.begin(), "TOC.txt.tmp"));
+
+            // Chunks must arrive in order.
+            auto data = read_file(data_file);
+            BOOST_REQUIRE(data.size() > 200);
+            receiver.write_chunk(cf_id, basename(data_file), 0, bytes(data.begin(), 100), false).get();
+            BOOST_REQUIRE_THROW(receiver.write_chunk(cf_id, basename(data_file), 200, bytes(data.begin() + 200, 100), false).get(),
+                    std::runtime_error);
+
+            // Nothing is loaded until every component is complete.
+            for (auto it = files.begin() + 1; it != files.end() - 1; ++it) {
+                send_file(receiver, cf_id, *it, 100);
+            }
+            BOOST_REQUIRE(dst.get_sstables()->empty());
+            assert_that(e.execute_cql("select * from ks.dst;").get0()).is_rows().is_empty();
+
+            send_file(receiver, cf_id, files.back(), 100);
+            auto sstables = dst.get_sstables();
+            BOOST_REQUIRE_EQUAL(sstables->size(), 1u);
+            auto loaded = sstables->begin()->second;
+            BOOST_REQUIRE_EQUAL(loaded->get_estimated_key_count(), sst->get_estimated_key_count());
+            received = list_files(dst.datadir());
+            BOOST_REQUIRE_EQUAL(received.size(), files.size());
+            BOOST_REQUIRE(received.count(basename(loaded->toc_filename())));
+            for (auto& name : received) {
+                BOOST_REQUIRE(!boost::algorithm::ends_with(name, "TOC.txt.tmp"));
+            }
+            auto rows = e.execute_cql("select * from ks.dst;").get0();
+            assert_that(rows).is_rows().with_size(10);
+
+            // Chunks retried after the sstable is loaded are ignored.
+            send_file(receiver, cf_id, files.back(), 100);
+            BOOST_REQUIRE_EQUAL(dst.get_sstables()->size(), 1u);
+            BOOST_REQUIRE_EQUAL(list_files(dst.datadir()).size(), files.size());
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_sstable_file_receiver_abort) {
+    return do_with_cql_env([] (cql_test_env& e) {
+        return seastar::async([&e] {
+            auto sst = make_local_sstable(e, "src", 10);
+            e.execute_cql("create table ks.dst (p int primary key, v int);").get();
+            auto& dst = e.local_db().find_column_family("ks", "dst");
+            auto cf_id = dst.schema()->id();
+            auto files = component_files(sst);
+
+            streaming::sstable_file_receiver receiver(e.db());
+            send_file(receiver, cf_id, files[0], 1024);
+            send_file(receiver, cf_id, files[1], 1024);
+            auto partial = read_file(files[2]);
+            receiver.write_chunk(cf_id, basename(files[2]), 0, bytes(partial.begin(), partial.size() / 2), false).get();
+            BOOST_REQUIRE_EQUAL(list_files(dst.datadir()).size(), 3u);
+
+            receiver.abort().get();
+            BOOST_REQUIRE(list_files(dst.datadir()).empty());
+            BOOST_REQUIRE(dst.get_sstables()->empty());
+            BOOST_REQUIRE_THROW(receiver.write_chunk(cf_id, basename(files[2]), 0, partial, true).get(), std::runtime_error);
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_select_sstables_contained_in) {
+    return do_with_cql_env([] (cql_test_env& e) {
+        return seastar::async([&e] {
+            auto sst = make_local_sstable(e, "cf", 10);
+            auto& cf = e.local_db().find_column_family("ks", "cf");
+            auto s = cf.schema();
+            auto first = dht::global_partitioner().get_token(*s, sst->get_first_partition_key(*s));
+            auto last = dht::global_partitioner().get_token(*s, sst->get_last_partition_key(*s));
+            BOOST_REQUIRE(first != last);
+
+            auto selects = [&] (range<dht::token> r) {
+                auto selected = cf.select_sstables_contained_in(r);
+                BOOST_REQUIRE(selected.size() <= 1);
+                return selected.size() == 1 && selected.front() == sst;
+            };
+            BOOST_REQUIRE(selects(range<dht::token>::make_open_ended_both_sides()));
+            BOOST_REQUIRE(selects(range<dht::token>::make(first, last)));
+            BOOST_REQUIRE(selects(range<dht::token>::make_starting_with(first)));
+            BOOST_REQUIRE(selects(range<dht::token>::make_ending_with(last)));
+            BOOST_REQUIRE(!selects(range<dht::token>({{first, false}}, {last})));
+            BOOST_REQUIRE(!selects(range<dht::token>({first}, {{last, false}})));
+            BOOST_REQUIRE(!selects(range<dht::token>::make_singular(first)));
+            BOOST_REQUIRE(!selects(range<dht::token>::make_ending_with({first, false})));
+        });
+    });
+}
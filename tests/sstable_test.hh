@@ -38,7 +38,15 @@ class column_family_test {
 
     void add_sstable(sstables::sstable&& sstable) {
         auto generation = sstable.generation();
-        _cf->_sstables->emplace(generation, make_lw_shared(std::move(sstable)));
+        auto sst = make_lw_shared(std::move(sstable));
+        _cf->_sstable_set->insert(sst);
+        _cf->_sstables->emplace(generation, std::move(sst));
+    }
+
+    void add_sstable(sstables::shared_sstable sst) {
+        auto generation = sst->generation();
+        _cf->_sstable_set->insert(sst);
+        _cf->_sstables->emplace(generation, std::move(sst));
     }
 };
 
@@ -59,8 +67,9 @@ class test {
     future<temporary_buffer<char>> data_read(uint64_t pos, size_t len) {
         return _sst->data_read(pos, len, default_priority_class());
     }
-    future<index_list> read_indexes(uint64_t summary_idx) {
-        return _sst->read_indexes(summary_idx, default_priority_class());
+    future<index_list> read_indexes(uint64_t summary_idx,
+            sstable::index_cache_policy policy = sstable::index_cache_policy::populate) {
+        return _sst->read_indexes(summary_idx, default_priority_class(), policy);
     }
 
     future<> read_statistics() {
@@ -134,6 +143,14 @@ class test {
         _sst->_summary.first_key.value = bytes(reinterpret_cast<const signed char*>(first_key.c_str()), first_key.size());
         _sst->_summary.last_key.value = bytes(reinterpret_cast<const signed char*>(last_key.c_str()), last_key.size());
     }
+
+    void set_values_for_time_window_strategy(uint64_t fake_data_size, int64_t min_timestamp, int64_t max_timestamp,
+            uint32_t max_local_deletion_time, sstring first_key, sstring last_key) {
+        set_values_for_leveled_strategy(fake_data_size, 0, max_timestamp, std::move(first_key), std::move(last_key));
+        auto& stats = *static_cast<stats_metadata*>(_sst->_statistics.contents[metadata_type::Stats].get());
+        stats.min_timestamp = min_timestamp;
+        stats.max_local_deletion_time = max_local_deletion_time;
+    }
 };
 
 inline future<sstable_ptr> reusable_sst(sstring dir, unsigned long generation) {
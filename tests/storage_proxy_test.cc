@@ -31,6 +31,7 @@
 #include "service/storage_proxy.hh"
 #include "partition_slice_builder.hh"
 #include "schema_builder.hh"
+#include "frozen_mutation.hh"
 
 #include "disk-error-handler.hh"
 
@@ -208,3 +209,52 @@ SEASTAR_TEST_CASE(test_get_restricted_ranges) {
         });
     });
 }
+
+SEASTAR_TEST_CASE(test_mutate_streaming_mutations) {
+    return do_with_cql_env([](cql_test_env& e) {
+        return seastar::async([&] {
+            e.execute_cql("create table ks.streamed (k blob, v int, primary key (k));").get();
+            auto s = e.local_db().find_schema("ks", "streamed");
+
+            // A received batch spans partitions owned by all shards.
+            auto make_batch = [&s] (int value) {
+                std::vector<frozen_mutation> fms;
+                for (int i = 0; i < 20; ++i) {
+                    mutation m(partition_key::from_single_value(*s, to_bytes(sprint("key%d", i))), s);
+                    m.set_clustered_cell(clustering_key::make_empty(), "v", data_value(int32_t(value)), api::new_timestamp());
+                    fms.emplace_back(freeze(m));
+                }
+                return fms;
+            };
+            auto apply = [&s] (const std::vector<frozen_mutation>& fms) {
+                std::vector<const frozen_mutation*> ptrs;
+                for (auto& fm : fms) {
+                    ptrs.push_back(&fm);
+                }
+                service::get_local_storage_proxy().mutate_streaming_mutations(s, ptrs).get();
+            };
+            auto check = [&s] (int value) {
+                auto reader = service::get_storage_proxy().local().make_local_reader(s->id(), query::full_partition_range);
+                auto rs = to_result_set(s, reader);
+                assert_that(rs).has_size(20);
+                for (int i = 0; i < 20; ++i) {
+                    assert_that(rs).has(a_row()
+                        .with_column(bytes("k"), data_value(to_bytes(sprint("key%d", i))))
+                        .with_column(bytes("v"), data_value(int32_t(value))));
+                }
+            };
+
+            auto batch = make_batch(1);
+            apply(batch);
+            check(1);
+
+            // Later batches are merged with what was streamed before.
+            apply(make_batch(2));
+            check(2);
+
+            // Empty batches are harmless.
+            apply({});
+            check(2);
+        });
+    });
+}
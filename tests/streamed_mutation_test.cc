@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+#include "tests/test-utils.hh"
+#include "tests/mutation_assertions.hh"
+#include "tests/mutation_reader_assertions.hh"
+#include "tests/mutation_source_test.hh"
+
+#include "streamed_mutation.hh"
+#include "mutation_reader.hh"
+#include "core/thread.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+// Returns a mutation with the key of m and the contents of other.
+static mutation with_key_of(const mutation& m, const mutation& other) {
+    mutation ret(m.decorated_key(), m.schema());
+    ret.partition().apply(*m.schema(), other.partition(), *other.schema());
+    return ret;
+}
+
+SEASTAR_TEST_CASE(test_mutation_from_streamed_mutation_from_mutation) {
+    return seastar::async([] {
+        for_each_mutation([] (const mutation& m) {
+            auto actual = mutation_from_streamed_mutation(streamed_mutation_from_mutation(m)).get0();
+            BOOST_REQUIRE(bool(actual));
+            assert_that(*actual).is_equal_to(m);
+        });
+
+        random_mutation_generator gen;
+        for (auto i = 0; i < 100; ++i) {
+            auto m = gen(true);
+            auto actual = mutation_from_streamed_mutation(streamed_mutation_from_mutation(m)).get0();
+            BOOST_REQUIRE(bool(actual));
+            assert_that(*actual).is_equal_to(m);
+        }
+    });
+}
+
+SEASTAR_TEST_CASE(test_fragments_are_in_clustering_order) {
+    return seastar::async([] {
+        random_mutation_generator gen;
+        for (auto i = 0; i < 100; ++i) {
+            auto sm = streamed_mutation_from_mutation(gen(true));
+            position_in_partition_view::less_compare less(*sm.schema());
+            std::experimental::optional<mutation_fragment> prev;
+            while (auto mf = sm().get0()) {
+                if (prev) {
+                    BOOST_REQUIRE(!less(mf->position(), prev->position()));
+                }
+                prev = std::move(*mf);
+            }
+        }
+    });
+}
+
+SEASTAR_TEST_CASE(test_merging_streamed_mutations) {
+    return seastar::async([] {
+        random_mutation_generator gen;
+        for (auto i = 0; i < 100; ++i) {
+            auto m1 = gen(true);
+            auto m2 = with_key_of(m1, gen(true));
+            auto m3 = with_key_of(m1, gen(true));
+
+            auto expected = m1;
+            expected.apply(m2);
+            expected.apply(m3);
+
+            std::vector<streamed_mutation> sms;
+            sms.emplace_back(streamed_mutation_from_mutation(m1));
+            sms.emplace_back(streamed_mutation_from_mutation(m2));
+            sms.emplace_back(streamed_mutation_from_mutation(m3));
+            auto actual = mutation_from_streamed_mutation(merge_mutations(std::move(sms))).get0();
+            BOOST_REQUIRE(bool(actual));
+            assert_that(*actual).is_equal_to(expected);
+        }
+    });
+}
+
+SEASTAR_TEST_CASE(test_combined_streamed_reader) {
+    return seastar::async([] {
+        random_mutation_generator gen;
+        std::vector<mutation> ms;
+        for (auto i = 0; i < 4; ++i) {
+            ms.emplace_back(gen(true));
+        }
+        auto s = gen.schema();
+        std::sort(ms.begin(), ms.end(), [&s] (const mutation& a, const mutation& b) {
+            return a.decorated_key().less_compare(*s, b.decorated_key());
+        });
+
+        // The first reader has partitions 0 and 2, the second 1 and 2.
+        auto m2 = with_key_of(ms[2], ms[3]);
+        auto expected = ms[2];
+        expected.apply(m2);
+
+        std::vector<streamed_mutation_reader> readers;
+        readers.emplace_back(streamed_reader_from_mutation_reader(make_reader_returning_many({ms[0], ms[2]})));
+        readers.emplace_back(streamed_reader_from_mutation_reader(make_reader_returning_many({ms[1], m2})));
+
+        assert_that(mutation_reader_from_streamed_reader(make_combined_streamed_reader(std::move(readers))))
+            .produces(ms[0])
+            .produces(ms[1])
+            .produces(expected)
+            .produces_end_of_stream();
+    });
+}
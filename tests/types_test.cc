@@ -686,3 +686,54 @@ SEASTAR_TEST_CASE(test_simple_type_compatibility) {
     }
     return make_ready_future<>();
 }
+
+BOOST_AUTO_TEST_CASE(test_native_comparators_agree_with_types) {
+    auto check = [] (data_type t, std::vector<data_value> values) {
+        std::vector<bytes> serialized;
+        for (auto&& v : values) {
+            serialized.push_back(t->decompose(v));
+        }
+        serialized.push_back(bytes()); // empty value
+        for (auto type : { t, data_type(reversed_type_impl::get_instance(t)) }) {
+            value_comparator cmp(type);
+            for (auto&& v1 : serialized) {
+                for (auto&& v2 : serialized) {
+                    auto c = cmp(v1, v2);
+                    BOOST_REQUIRE_EQUAL(c < 0, type->less(v1, v2));
+                    BOOST_REQUIRE_EQUAL(c > 0, type->less(v2, v1));
+                }
+            }
+        }
+    };
+    BOOST_REQUIRE(int32_type->get_native_tri_comparator());
+    check(int32_type, { int32_t(-1), int32_t(0), int32_t(1), std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max() });
+    check(long_type, { int64_t(-1), int64_t(0), int64_t(1), std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max() });
+    check(utf8_type, { sstring(""), sstring("a"), sstring("ab"), sstring("b"), sstring("\xc4\x85") });
+    check(bytes_type, { bytes(), to_bytes("\x01"), to_bytes("\x80"), to_bytes("\x01\x02") });
+    std::vector<data_value> uuids;
+    for (int i = 0; i < 10; ++i) {
+        uuids.push_back(utils::UUID_gen::get_time_UUID());
+    }
+    check(timeuuid_type, uuids);
+    BOOST_REQUIRE(!varint_type->get_native_tri_comparator());
+    check(varint_type, { boost::multiprecision::cpp_int(-1), boost::multiprecision::cpp_int(1) });
+}
+
+BOOST_AUTO_TEST_CASE(test_compound_comparator_matches_component_types) {
+    compound_type<allow_prefixes::yes> type({int32_type, reversed_type_impl::get_instance(utf8_type)});
+    std::vector<bytes> keys;
+    for (auto i : { -1, 1 }) {
+        for (auto s : { "a", "b" }) {
+            keys.push_back(type.serialize_value(std::vector<bytes>{int32_type->decompose(i), utf8_type->decompose(sstring(s))}));
+        }
+        keys.push_back(type.serialize_value(std::vector<bytes>{int32_type->decompose(i)}));
+    }
+    for (auto&& k1 : keys) {
+        for (auto&& k2 : keys) {
+            auto expected = lexicographical_tri_compare(type.types().begin(), type.types().end(),
+                type.begin(k1), type.end(k1), type.begin(k2), type.end(k2), tri_compare);
+            BOOST_REQUIRE_EQUAL(type.compare(k1, k2) < 0, expected < 0);
+            BOOST_REQUIRE_EQUAL(type.compare(k1, k2) > 0, expected > 0);
+        }
+    }
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2016 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <utility>
+#include <experimental/optional>
+#include "core/sstring.hh"
+#include "core/print.hh"
+
+namespace transport {
+
+/*
+ * Per-shard admission control for CQL requests.
+ *
+ * Tracks the reads and writes in flight and a moving average of the time
+ * they take to complete, which includes the time spent queued in
+ * storage_proxy and on replicas. A request is rejected up front, so that
+ * the client gets an OverloadedException instead of a timeout, when the
+ * number of requests of its kind in flight reached the configured limit,
+ * or when the average latency exceeds the configured one while enough
+ * requests are in flight for the average to be meaningful. A limit of
+ * zero disables the corresponding check.
+ */
+class admission_controller {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    enum class request_kind {
+        read,
+        write,
+        other,
+    };
+
+    struct config {
+        uint64_t max_in_flight_reads = 0;
+        uint64_t max_in_flight_writes = 0;
+        std::chrono::microseconds max_latency{0};
+    };
+
+    struct stats {
+        uint64_t in_flight_reads = 0;
+        uint64_t in_flight_writes = 0;
+        uint64_t rejected_reads = 0;
+        uint64_t rejected_writes = 0;
+        uint64_t rejected_for_latency = 0;
+        // Exponentially weighted moving average of request latency.
+        std::chrono::microseconds latency{0};
+    };
+
+    // Accounts for an admitted request until destroyed.
+    class permit {
+        admission_controller* _ac = nullptr;
+        request_kind _kind = request_kind::other;
+        clock_type::time_point _start;
+    public:
+        permit() = default;
+        permit(admission_controller& ac, request_kind kind)
+            : _ac(&ac), _kind(kind), _start(clock_type::now()) {
+            ++_ac->in_flight(_kind);
+        }
+        permit(permit&& o) noexcept
+            : _ac(std::exchange(o._ac, nullptr)), _kind(o._kind), _start(o._start) {}
+        permit& operator=(permit&&) = delete;
+        ~permit() {
+            if (_ac) {
+                --_ac->in_flight(_kind);
+                _ac->record_latency(clock_type::now() - _start);
+            }
+        }
+    };
+private:
+    // Below this many requests in flight the latency check is not applied:
+    // too few samples, and nothing would refresh the average once every
+    // request is rejected.
+    static constexpr uint64_t min_in_flight_for_latency = 16;
+
+    config _cfg;
+    stats _stats;
+    uint64_t _in_flight_other = 0;
+private:
+    uint64_t& in_flight(request_kind kind) {
+        switch (kind) {
+        case request_kind::read: return _stats.in_flight_reads;
+        case request_kind::write: return _stats.in_flight_writes;
+        case request_kind::other: return _in_flight_other;
+        }
+        abort();
+    }
+    void record_latency(clock_type::duration d) {
+        auto sample = std::chrono::duration_cast<std::chrono::microseconds>(d);
+        _stats.latency = (_stats.latency * 7 + sample) / 8;
+    }
+public:
+    explicit admission_controller(config cfg) : _cfg(cfg) {}
+
+    // Returns the reason for rejecting a request of the given kind, or
+    // nothing if it may proceed.
+    std::experimental::optional<sstring> check(request_kind kind) {
+        if (kind == request_kind::other) {
+            return {};
+        }
+        auto max = kind == request_kind::read ? _cfg.max_in_flight_reads : _cfg.max_in_flight_writes;
+        auto current = in_flight(kind);
+        auto& rejected = kind == request_kind::read ? _stats.rejected_reads : _stats.rejected_writes;
+        auto what = kind == request_kind::read ? "reads" : "writes";
+        if (max && current >= max) {
+            ++rejected;
+            return sprint("Too many %s in flight: %d", what, current);
+        }
+        auto all = _stats.in_flight_reads + _stats.in_flight_writes;
+        if (_cfg.max_latency.count() && all >= min_in_flight_for_latency && _stats.latency > _cfg.max_latency) {
+            ++rejected;
+            ++_stats.rejected_for_latency;
+            return sprint("Request latency too high: %d us", _stats.latency.count());
+        }
+        return {};
+    }
+
+    const stats& get_stats() const {
+        return _stats;
+    }
+};
+
+}
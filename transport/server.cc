@@ -27,8 +27,10 @@
 #include <boost/assign.hpp>
 #include <boost/locale/encoding_utf.hpp>
 #include <boost/range/adaptor/sliced.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 
 #include "cql3/statements/batch_statement.hh"
+#include "cql3/statements/select_statement.hh"
 #include "service/migration_manager.hh"
 #include "service/storage_service.hh"
 #include "db/consistency_level.hh"
@@ -37,6 +39,7 @@
 #include "core/reactor.hh"
 #include "utils/UUID.hh"
 #include "database.hh"
+#include "dht/i_partitioner.hh"
 #include "net/byteorder.hh"
 #include <seastar/core/scollectd.hh>
 #include <seastar/net/byteorder.hh>
@@ -49,9 +52,13 @@
 #include "auth/authenticator.hh"
 
 #include <cassert>
+#include <cctype>
+#include <algorithm>
 #include <string>
+#include <utility>
 
 #include <lz4.h>
+#include <snappy-c.h>
 
 namespace transport {
 
@@ -216,13 +223,14 @@ class cql_server::response {
     void write_value(bytes_opt value);
     void write(const cql3::metadata& m);
     void write(const cql3::prepared_metadata& m, uint8_t version);
-    future<> output(output_stream<char>& out, uint8_t version, bool compression);
+    void append_to(scattered_message<char>& msg, uint8_t version, cql_compression compression, size_t threshold, cql_compression_stats& stats);
 
     cql_binary_opcode opcode() const {
         return _opcode;
     }
 private:
-    std::vector<char> compress(const std::vector<char>& body);
+    std::vector<char> compress_lz4(const std::vector<char>& body);
+    std::vector<char> compress_snappy(const std::vector<char>& body);
 
     template <typename CqlFrameHeaderType>
     sstring make_frame_one(uint8_t version, uint8_t flags, size_t length) {
@@ -264,11 +272,15 @@ class cql_server::response {
     }
 };
 
-cql_server::cql_server(distributed<service::storage_proxy>& proxy, distributed<cql3::query_processor>& qp, cql_load_balance lb)
-    : _proxy(proxy)
+cql_server::cql_server(distributed<cql_server>& container, distributed<service::storage_proxy>& proxy, distributed<cql3::query_processor>& qp, cql_load_balance lb, size_t compression_threshold,
+        admission_controller::config admission_cfg)
+    : _container(container)
+    , _proxy(proxy)
     , _query_processor(qp)
     , _max_request_size(memory::stats().total_memory() / 10)
+    , _compression_threshold(compression_threshold)
     , _memory_available(_max_request_size)
+    , _admission(admission_cfg)
     , _collectd_registrations(std::make_unique<scollectd::registrations>(setup_collectd()))
     , _lb(lb)
 {
@@ -297,9 +309,94 @@ cql_server::setup_collectd() {
             scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
                     "queue_length", "requests_blocked_memory"),
             scollectd::make_typed(scollectd::data_type::GAUGE, [this] { return _memory_available.waiters(); })),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "queue_length", "reads_in_flight"),
+            scollectd::make_typed(scollectd::data_type::GAUGE, [this] { return _admission.get_stats().in_flight_reads; })),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "queue_length", "writes_in_flight"),
+            scollectd::make_typed(scollectd::data_type::GAUGE, [this] { return _admission.get_stats().in_flight_writes; })),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "total_operations", "rejected_reads"),
+            scollectd::make_typed(scollectd::data_type::DERIVE, [this] { return _admission.get_stats().rejected_reads; })),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "total_operations", "rejected_writes"),
+            scollectd::make_typed(scollectd::data_type::DERIVE, [this] { return _admission.get_stats().rejected_writes; })),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "total_operations", "rejected_for_latency"),
+            scollectd::make_typed(scollectd::data_type::DERIVE, [this] { return _admission.get_stats().rejected_for_latency; })),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "latency", "request_latency_us"),
+            scollectd::make_typed(scollectd::data_type::GAUGE, [this] { return uint64_t(_admission.get_stats().latency.count()); })),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "total_operations", "response_flushes"),
+            scollectd::make_typed(scollectd::data_type::DERIVE, _response_flushes)),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "total_operations", "responses_flushed"),
+            scollectd::make_typed(scollectd::data_type::DERIVE, _responses_flushed)),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "gauge", "responses_per_flush"),
+            scollectd::make_typed(scollectd::data_type::GAUGE, [this] {
+                return _response_flushes ? double(_responses_flushed) / _response_flushes : 0.0;
+            })),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "total_operations", "frames_compressed"),
+            scollectd::make_typed(scollectd::data_type::DERIVE, [this] { return compression_stats().frames_compressed; })),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "total_operations", "frames_below_compression_threshold"),
+            scollectd::make_typed(scollectd::data_type::DERIVE, [this] { return compression_stats().frames_below_threshold; })),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "total_operations", "frames_decompressed"),
+            scollectd::make_typed(scollectd::data_type::DERIVE, [this] { return compression_stats().frames_decompressed; })),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "gauge", "compression_ratio"),
+            scollectd::make_typed(scollectd::data_type::GAUGE, [this] { return compression_stats().ratio(); })),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "total_operations", "compression_time_us"),
+            scollectd::make_typed(scollectd::data_type::DERIVE, [this] {
+                return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(compression_stats().compression_time).count());
+            })),
+        scollectd::add_polled_metric(
+            scollectd::type_instance_id("transport", scollectd::per_cpu_plugin_instance,
+                    "total_operations", "decompression_time_us"),
+            scollectd::make_typed(scollectd::data_type::DERIVE, [this] {
+                return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(compression_stats().decompression_time).count());
+            })),
     };
 }
 
+cql_compression_stats& cql_compression_stats::operator+=(const cql_compression_stats& o) {
+    frames_compressed += o.frames_compressed;
+    frames_below_threshold += o.frames_below_threshold;
+    bytes_before_compression += o.bytes_before_compression;
+    bytes_after_compression += o.bytes_after_compression;
+    frames_decompressed += o.frames_decompressed;
+    compression_time += o.compression_time;
+    decompression_time += o.decompression_time;
+    return *this;
+}
+
+cql_compression_stats cql_server::compression_stats() const {
+    auto stats = _compression_stats;
+    for (auto&& c : _connections_list) {
+        stats += c.compression_stats();
+    }
+    return stats;
+}
+
 future<> cql_server::stop() {
     _stopping = true;
     size_t nr = 0;
@@ -459,7 +556,7 @@ cql_server::connection::read_frame() {
 }
 
 future<response_type>
-    cql_server::connection::process_request_one(bytes_view buf, uint8_t op, uint16_t stream, service::client_state client_state, tracing_request_type tracing_request) {
+    cql_server::connection::process_request_one(bytes_view buf, uint8_t op, uint16_t stream, service::client_state client_state, tracing_request_type tracing_request, std::unique_ptr<cql3::query_options> options) {
     auto cqlop = static_cast<cql_binary_opcode>(op);
 
     if (tracing_request != tracing_request_type::not_requested) {
@@ -468,7 +565,7 @@ future<response_type>
         }
     }
 
-    return make_ready_future<>().then([this, cqlop, stream, buf = std::move(buf), client_state] () mutable {
+    return make_ready_future<>().then([this, cqlop, stream, buf = std::move(buf), client_state, options = std::move(options)] () mutable {
         // When using authentication, we need to ensure we are doing proper state transitions,
         // i.e. we cannot simply accept any query/exec ops unless auth is complete
         switch (_state) {
@@ -495,7 +592,7 @@ future<response_type>
         case cql_binary_opcode::OPTIONS:       return process_options(stream, std::move(buf), std::move(client_state));
         case cql_binary_opcode::QUERY:         return process_query(stream, std::move(buf), std::move(client_state));
         case cql_binary_opcode::PREPARE:       return process_prepare(stream, std::move(buf), std::move(client_state));
-        case cql_binary_opcode::EXECUTE:       return process_execute(stream, std::move(buf), std::move(client_state));
+        case cql_binary_opcode::EXECUTE:       return process_execute(stream, std::move(buf), std::move(client_state), std::move(options));
         case cql_binary_opcode::BATCH:         return process_batch(stream, std::move(buf), std::move(client_state));
         case cql_binary_opcode::REGISTER:      return process_register(stream, std::move(buf), std::move(client_state));
         default:                               throw exceptions::protocol_exception(sprint("Unknown opcode %d", int(cqlop)));
@@ -562,6 +659,13 @@ cql_server::connection::connection(cql_server& server, connected_socket&& fd, so
 }
 
 cql_server::connection::~connection() {
+    if (_compression != cql_compression::none) {
+        logger.debug("connection closed: {} frames compressed with ratio {}, {} below threshold, compression {} us, decompression {} us",
+                _compression_stats.frames_compressed, _compression_stats.ratio(), _compression_stats.frames_below_threshold,
+                std::chrono::duration_cast<std::chrono::microseconds>(_compression_stats.compression_time).count(),
+                std::chrono::duration_cast<std::chrono::microseconds>(_compression_stats.decompression_time).count());
+    }
+    _server._compression_stats += _compression_stats;
     --_server._current_connections;
     _server._connections_list.erase(_server._connections_list.iterator_to(*this));
     _server.maybe_idle();
@@ -640,18 +744,33 @@ future<> cql_server::connection::process_request() {
 
             with_gate(_pending_requests_gate, [this, flags, op, stream, buf = std::move(buf), tracing_requested] () mutable {
                 auto bv = bytes_view{reinterpret_cast<const int8_t*>(buf.begin()), buf.size()};
-                auto cpu = pick_request_cpu();
-                return smp::submit_to(cpu, [this, bv = std::move(bv), op, stream, client_state = _client_state, tracing_requested] () mutable {
-                    return this->process_request_one(bv, op, stream, std::move(client_state), tracing_requested).then([](auto&& response) {
+                auto kind = classify_request(static_cast<cql_binary_opcode>(op), bv);
+                auto route = route_request(static_cast<cql_binary_opcode>(op), bv);
+                auto cpu = route.shard ? *route.shard : pick_request_cpu();
+                return smp::submit_to(cpu, [this, bv = std::move(bv), op, stream, client_state = _client_state, tracing_requested, kind, options = std::move(route.options)] () mutable {
+                    using foreign_response_type = std::pair<foreign_ptr<shared_ptr<cql_server::response>>, service::client_state>;
+                    // Admission is decided by the shard which executes the
+                    // request, as that is where it queues and takes memory.
+                    auto& admission = _server._container.local()._admission;
+                    if (auto reason = admission.check(kind)) {
+                        --_server._requests_serving;
+                        auto error = make_error(stream, exceptions::exception_code::OVERLOADED, *reason);
+                        return make_ready_future<foreign_response_type>(std::make_pair(make_foreign(std::move(error)), std::move(client_state)));
+                    }
+                    auto permit = kind != admission_controller::request_kind::other
+                            ? admission_controller::permit(admission, kind)
+                            : admission_controller::permit();
+                    return this->process_request_one(bv, op, stream, std::move(client_state), tracing_requested, std::move(options)).then([permit = std::move(permit)] (auto&& response) {
                         auto& tracing_session_id_ptr = response.second.tracing_session_id_ptr();
                         if (tracing_session_id_ptr) {
                             response.first->set_tracing_id(*tracing_session_id_ptr);
                         }
-                        return std::make_pair(make_foreign(response.first), response.second);
+                        return foreign_response_type(make_foreign(response.first), response.second);
                     });
-                }).then([this, flags] (auto&& response) {
+                }).then([this, op] (auto&& response) {
                     _client_state.merge(response.second);
-                    bool compression = flags & cql_frame_flags::compression;
+                    // The response to STARTUP is sent before compression is in use.
+                    bool compression = static_cast<cql_binary_opcode>(op) != cql_binary_opcode::STARTUP;
                     return this->write_response(std::move(response.first), compression);
                 }).then([buf = std::move(buf)] {
                     // Keep buf alive.
@@ -675,31 +794,53 @@ static inline bytes_view to_bytes_view(temporary_buffer<char>& b)
 future<temporary_buffer<char>> cql_server::connection::read_and_decompress_frame(size_t length, uint8_t flags)
 {
     if (flags & cql_frame_flags::compression) {
-        if (length < 4) {
-            throw std::runtime_error("Truncated frame");
-        }
         return _read_buf.read_exactly(length).then([this] (temporary_buffer<char> buf) {
-            auto view = to_bytes_view(buf);
-            int32_t uncomp_len = read_int(view);
-            if (uncomp_len < 0) {
-                throw std::runtime_error("CQL frame uncompressed length is negative: " + std::to_string(uncomp_len));
-            }
-            buf.trim_front(4);
-            temporary_buffer<char> uncomp{size_t(uncomp_len)};
-            const char* input = buf.get();
-            size_t input_len = buf.size();
-            char *output = uncomp.get_write();
-            size_t output_len = uncomp_len;
-            auto ret = LZ4_decompress_safe(input, output, input_len, output_len);
-            if (ret < 0) {
-                throw std::runtime_error("CQL frame LZ4 uncompression failure");
-            }
-            return make_ready_future<temporary_buffer<char>>(std::move(uncomp));
+            return decompress(std::move(buf));
         });
     }
     return _read_buf.read_exactly(length);
 }
 
+temporary_buffer<char> cql_server::connection::decompress(temporary_buffer<char> buf)
+{
+    auto start = std::chrono::steady_clock::now();
+    temporary_buffer<char> uncomp;
+    if (_compression == cql_compression::snappy) {
+        size_t uncomp_len;
+        if (snappy_uncompressed_length(buf.get(), buf.size(), &uncomp_len) != SNAPPY_OK) {
+            throw std::runtime_error("CQL frame Snappy uncompression failure");
+        }
+        uncomp = temporary_buffer<char>(uncomp_len);
+        if (snappy_uncompress(buf.get(), buf.size(), uncomp.get_write(), &uncomp_len) != SNAPPY_OK) {
+            throw std::runtime_error("CQL frame Snappy uncompression failure");
+        }
+    } else {
+        // Clients which did not negotiate a compression algorithm in
+        // STARTUP were always assumed to use LZ4.
+        if (buf.size() < 4) {
+            throw std::runtime_error("Truncated frame");
+        }
+        auto view = to_bytes_view(buf);
+        int32_t uncomp_len = read_int(view);
+        if (uncomp_len < 0) {
+            throw std::runtime_error("CQL frame uncompressed length is negative: " + std::to_string(uncomp_len));
+        }
+        buf.trim_front(4);
+        uncomp = temporary_buffer<char>(size_t(uncomp_len));
+        const char* input = buf.get();
+        size_t input_len = buf.size();
+        char *output = uncomp.get_write();
+        size_t output_len = uncomp_len;
+        auto ret = LZ4_decompress_safe(input, output, input_len, output_len);
+        if (ret < 0) {
+            throw std::runtime_error("CQL frame LZ4 uncompression failure");
+        }
+    }
+    ++_compression_stats.frames_decompressed;
+    _compression_stats.decompression_time += std::chrono::steady_clock::now() - start;
+    return uncomp;
+}
+
 unsigned cql_server::connection::pick_request_cpu()
 {
     if (_server._lb == cql_load_balance::round_robin) {
@@ -708,9 +849,119 @@ unsigned cql_server::connection::pick_request_cpu()
     return engine().cpu_id();
 }
 
+std::experimental::optional<unsigned> routing_shard(const cql3::statements::prepared_statement& prepared, const cql3::query_options& options)
+{
+    auto token = prepared.statement->routing_token(options);
+    if (!token) {
+        return {};
+    }
+    return dht::shard_of(*token);
+}
+
+// Finds the shard owning the partition an EXECUTE request is restricted to,
+// so that it runs there instead of hopping shards in storage_proxy. Any
+// problem with the frame is left to the shard which executes the request.
+cql_server::connection::request_route cql_server::connection::route_request(cql_binary_opcode op, bytes_view buf)
+{
+    request_route route;
+    if (op == cql_binary_opcode::OPTIONS || op == cql_binary_opcode::STARTUP) {
+        // SUPPORTED advertises the shard owning the connection, and STARTUP
+        // sets up the connection's compression.
+        route.shard = engine().cpu_id();
+        return route;
+    }
+    if (op != cql_binary_opcode::EXECUTE) {
+        return route;
+    }
+    try {
+        auto id = read_short_bytes(buf);
+        auto prepared = _server._query_processor.local().get_prepared(id);
+        if (!prepared) {
+            return route;
+        }
+        auto options = read_options(buf);
+        options->prepare(prepared->bound_names);
+        if (prepared->statement->get_bound_terms() != options->get_values_count()) {
+            return route;
+        }
+        route.shard = routing_shard(*prepared, *options);
+        route.options = std::move(options);
+    } catch (...) {
+        route = request_route();
+    }
+    return route;
+}
+
+static bool starts_with_keyword(sstring_view query, sstring_view keyword) {
+    return query.size() >= keyword.size() && boost::iequals(query.substr(0, keyword.size()), keyword);
+}
+
+admission_controller::request_kind classify_statement(const cql3::cql_statement& stmt)
+{
+    if (dynamic_cast<const cql3::statements::select_statement*>(&stmt)) {
+        return admission_controller::request_kind::read;
+    }
+    if (dynamic_cast<const cql3::statements::modification_statement*>(&stmt) || dynamic_cast<const cql3::statements::batch_statement*>(&stmt)) {
+        return admission_controller::request_kind::write;
+    }
+    return admission_controller::request_kind::other;
+}
+
+admission_controller::request_kind classify_query(sstring_view query)
+{
+    auto start = std::find_if_not(query.begin(), query.end(), [] (char c) { return std::isspace(c); });
+    query.remove_prefix(start - query.begin());
+    if (starts_with_keyword(query, "SELECT")) {
+        return admission_controller::request_kind::read;
+    }
+    for (auto keyword : {"INSERT", "UPDATE", "DELETE", "BEGIN"}) {
+        if (starts_with_keyword(query, keyword)) {
+            return admission_controller::request_kind::write;
+        }
+    }
+    return admission_controller::request_kind::other;
+}
+
+// Tells reads from writes for admission control, looking only at the
+// prepared statement or at the first keyword of a query.
+admission_controller::request_kind cql_server::connection::classify_request(cql_binary_opcode op, bytes_view buf)
+{
+    using request_kind = admission_controller::request_kind;
+    try {
+        switch (op) {
+        case cql_binary_opcode::BATCH:
+            return request_kind::write;
+        case cql_binary_opcode::EXECUTE: {
+            auto id = read_short_bytes(buf);
+            auto prepared = _server._query_processor.local().get_prepared(id);
+            if (!prepared) {
+                return request_kind::other;
+            }
+            return classify_statement(*prepared->statement);
+        }
+        case cql_binary_opcode::QUERY:
+            return classify_query(read_long_string_view(buf));
+        default:
+            return request_kind::other;
+        }
+    } catch (...) {
+        return request_kind::other;
+    }
+}
+
 future<response_type> cql_server::connection::process_startup(uint16_t stream, bytes_view buf, service::client_state client_state)
 {
-    /*auto string_map =*/ read_string_map(buf);
+    auto options = read_string_map(buf);
+    auto compression = options.find("COMPRESSION");
+    if (compression != options.end()) {
+        if (compression->second == "lz4") {
+            _compression = cql_compression::lz4;
+        } else if (compression->second == "snappy") {
+            _compression = cql_compression::snappy;
+        } else {
+            throw exceptions::protocol_exception(sprint("Unknown compression algorithm: %s", compression->second));
+        }
+    }
     auto& a = auth::authenticator::get();
     if (a.require_authentication()) {
         return make_ready_future<response_type>(std::make_pair(make_autheticate(stream, a.class_name()), client_state));
@@ -791,7 +1042,7 @@ future<response_type> cql_server::connection::process_prepare(uint16_t stream, b
     });
 }
 
-future<response_type> cql_server::connection::process_execute(uint16_t stream, bytes_view buf, service::client_state client_state)
+future<response_type> cql_server::connection::process_execute(uint16_t stream, bytes_view buf, service::client_state client_state, std::unique_ptr<cql3::query_options> routed_options)
 {
     auto id = read_short_bytes(buf);
     auto prepared = _server._query_processor.local().get_prepared(id);
@@ -800,13 +1051,18 @@ future<response_type> cql_server::connection::process_execute(uint16_t stream, b
     }
     auto q_state = std::make_unique<cql_query_state>(client_state);
     auto& query_state = q_state->query_state;
-    q_state->options = read_options(buf);
-    auto& options = *q_state->options;
-    options.prepare(prepared->bound_names);
     auto stmt = prepared->statement;
-    if (stmt->get_bound_terms() != options.get_values_count()) {
-        throw exceptions::invalid_request_exception("Invalid amount of bind variables");
+    if (routed_options) {
+        // Already parsed, prepared and checked by route_request().
+        q_state->options = std::move(routed_options);
+    } else {
+        q_state->options = read_options(buf);
+        q_state->options->prepare(prepared->bound_names);
+        if (stmt->get_bound_terms() != q_state->options->get_values_count()) {
+            throw exceptions::invalid_request_exception("Invalid amount of bind variables");
+        }
     }
+    auto& options = *q_state->options;
     return _server._query_processor.local().process_statement(stmt, query_state, options).then([this, stream, buf = std::move(buf)] (auto msg) {
         return this->make_result(stream, msg);
     }).then([&query_state, q_state = std::move(q_state), this] (auto&& response) {
@@ -991,6 +1247,11 @@ shared_ptr<cql_server::response> cql_server::connection::make_supported(int16_t
     std::multimap<sstring, sstring> opts;
     opts.insert({"CQL_VERSION", cql3::query_processor::CQL_VERSION});
     opts.insert({"COMPRESSION", "lz4"});
+    opts.insert({"COMPRESSION", "snappy"});
+    opts.insert({"SCYLLA_SHARD", sprint("%d", engine().cpu_id())});
+    opts.insert({"SCYLLA_NR_SHARDS", sprint("%d", smp::count)});
+    opts.insert({"SCYLLA_PARTITIONER", dht::global_partitioner().name()});
+    opts.insert({"SCYLLA_SHARDING_ALGORITHM", "even-token-range"});
     auto response = make_shared<cql_server::response>(stream, cql_binary_opcode::SUPPORTED);
     response->write_string_multimap(opts);
     return response;
@@ -1092,16 +1353,38 @@ cql_server::connection::make_schema_change_event(const event::schema_change& eve
 
 future<> cql_server::connection::write_response(foreign_ptr<shared_ptr<cql_server::response>>&& response, bool compression)
 {
-    _ready_to_respond = _ready_to_respond.then([this, compression, response = std::move(response)] () mutable {
-        return do_with(std::move(response), [this, compression] (auto& response) {
-            return response->output(_write_buf, _version, compression).then([this] {
-                return _write_buf.flush();
+    _pending_responses.push_back(pending_response{std::move(response), compression});
+    if (_pending_responses.size() == 1) {
+        // Yield before flushing, so that responses completing in the same
+        // poll, or while the previous batch is written, are sent together.
+        _ready_to_respond = _ready_to_respond.then([this] {
+            return later().then([this] {
+                return flush_responses();
             });
         });
-    });
+    }
     return make_ready_future<>();
 }
 
+// Writes all pending responses with a single scatter-gather write and flush.
+// Each frame is still compressed on its own, since the protocol requires
+// every frame body to be decompressible independently.
+future<> cql_server::connection::flush_responses()
+{
+    auto responses = std::exchange(_pending_responses, {});
+    ++_server._response_flushes;
+    _server._responses_flushed += responses.size();
+    scattered_message<char> msg;
+    for (auto&& r : responses) {
+        auto compression = r.compression ? _compression : cql_compression::none;
+        r.response->append_to(msg, _version, compression, _server._compression_threshold, _compression_stats);
+    }
+    msg.on_delete([responses = std::move(responses)] {});
+    return _write_buf.write(std::move(msg)).then([this] {
+        return _write_buf.flush();
+    });
+}
+
 void cql_server::connection::check_room(bytes_view& buf, size_t n)
 {
     if (buf.size() < n) {
@@ -1370,23 +1653,30 @@ scattered_message<char> cql_server::response::make_message(uint8_t version) {
     return msg;
 }
 
-future<>
-cql_server::response::output(output_stream<char>& out, uint8_t version, bool compression) {
+// Appends the frame to msg without copying the body, so the response
+// must be kept alive until msg is released. Bodies smaller than threshold
+// are sent uncompressed, as compression would rarely make them smaller.
+void
+cql_server::response::append_to(scattered_message<char>& msg, uint8_t version, cql_compression compression, size_t threshold, cql_compression_stats& stats) {
     uint8_t flags = 0;
-    if (compression) {
-        flags |= cql_frame_flags::compression;
-        _body = compress(_body);
-    }
-    auto frame = make_frame(version, flags, _body.size());
-    auto tmp = temporary_buffer<char>(frame.size());
-    std::copy_n(frame.begin(), frame.size(), tmp.get_write());
-    auto f = out.write(tmp.get(), tmp.size());
-    return f.then([this, &out, tmp = std::move(tmp)] {
-        return out.write(_body.data(), _body.size());
-    });
+    if (compression != cql_compression::none) {
+        if (_body.size() < threshold) {
+            ++stats.frames_below_threshold;
+        } else {
+            auto start = std::chrono::steady_clock::now();
+            stats.bytes_before_compression += _body.size();
+            _body = compression == cql_compression::lz4 ? compress_lz4(_body) : compress_snappy(_body);
+            stats.bytes_after_compression += _body.size();
+            ++stats.frames_compressed;
+            stats.compression_time += std::chrono::steady_clock::now() - start;
+            flags |= cql_frame_flags::compression;
+        }
+    }
+    msg.append(make_frame(version, flags, _body.size()));
+    msg.append_static(_body.data(), _body.size());
 }
 
-std::vector<char> cql_server::response::compress(const std::vector<char>& body)
+std::vector<char> cql_server::response::compress_lz4(const std::vector<char>& body)
 {
     const char* input = body.data();
     size_t input_len = body.size();
@@ -1406,6 +1696,20 @@ std::vector<char> cql_server::response::compress(const std::vector<char>& body)
     return comp;
 }
 
+std::vector<char> cql_server::response::compress_snappy(const std::vector<char>& body)
+{
+    const char* input = body.data();
+    size_t input_len = body.size();
+    std::vector<char> comp;
+    size_t output_len = snappy_max_compressed_length(input_len);
+    comp.resize(output_len);
+    if (snappy_compress(input, input_len, comp.data(), &output_len) != SNAPPY_OK) {
+        throw std::runtime_error("CQL frame Snappy compression failure");
+    }
+    comp.resize(output_len);
+    return comp;
+}
+
 void cql_server::response::serialize(const event::schema_change& event, uint8_t version)
 {
     if (version >= 3) {
@@ -28,8 +28,10 @@
 #include "cql3/query_processor.hh"
 #include "auth/authenticator.hh"
 #include "core/distributed.hh"
+#include "transport/admission_controller.hh"
 #include <seastar/core/semaphore.hh>
 #include <memory>
+#include <chrono>
 #include <boost/intrusive/list.hpp>
 #include <seastar/net/tls.hh>
 
@@ -81,6 +83,37 @@ enum class cql_load_balance {
 
 cql_load_balance parse_load_balance(sstring value);
 
+// The shard owning the single partition a prepared statement is restricted
+// to by the given, already prepared, options; nothing if there is no such
+// partition.
+std::experimental::optional<unsigned> routing_shard(const cql3::statements::prepared_statement& prepared, const cql3::query_options& options);
+
+// Whether a statement, or the text of a query, reads or writes, for
+// admission control.
+admission_controller::request_kind classify_statement(const cql3::cql_statement& stmt);
+admission_controller::request_kind classify_query(sstring_view query);
+
+enum class cql_compression {
+    none,
+    lz4,
+    snappy,
+};
+
+struct cql_compression_stats {
+    uint64_t frames_compressed = 0;
+    uint64_t frames_below_threshold = 0;
+    uint64_t bytes_before_compression = 0;
+    uint64_t bytes_after_compression = 0;
+    uint64_t frames_decompressed = 0;
+    std::chrono::nanoseconds compression_time{0};
+    std::chrono::nanoseconds decompression_time{0};
+
+    cql_compression_stats& operator+=(const cql_compression_stats& o);
+    double ratio() const {
+        return bytes_before_compression ? double(bytes_after_compression) / bytes_before_compression : 1.0;
+    }
+};
+
 struct cql_query_state {
     service::query_state query_state;
     std::unique_ptr<cql3::query_options> options;
@@ -97,10 +130,13 @@ class cql_server {
     static constexpr cql_protocol_version_type current_version = cql_serialization_format::latest_version;
 
     std::vector<server_socket> _listeners;
+    distributed<cql_server>& _container;
     distributed<service::storage_proxy>& _proxy;
     distributed<cql3::query_processor>& _query_processor;
     size_t _max_request_size;
+    size_t _compression_threshold;
     semaphore _memory_available;
+    admission_controller _admission;
     std::unique_ptr<scollectd::registrations> _collectd_registrations;
     std::unique_ptr<event_notifier> _notifier;
 private:
@@ -109,9 +145,14 @@ class cql_server {
     uint64_t _connections = 0;
     uint64_t _requests_served = 0;
     uint64_t _requests_serving = 0;
+    uint64_t _response_flushes = 0;
+    uint64_t _responses_flushed = 0;
+    // Accumulated from connections as they close.
+    cql_compression_stats _compression_stats;
     cql_load_balance _lb;
 public:
-    cql_server(distributed<service::storage_proxy>& proxy, distributed<cql3::query_processor>& qp, cql_load_balance lb);
+    cql_server(distributed<cql_server>& container, distributed<service::storage_proxy>& proxy, distributed<cql3::query_processor>& qp, cql_load_balance lb, size_t compression_threshold,
+            admission_controller::config admission_cfg);
     future<> listen(ipv4_addr addr, std::shared_ptr<seastar::tls::credentials_builder> = {}, bool keepalive = false);
     future<> do_accepts(int which, bool keepalive);
     future<> stop();
@@ -127,11 +168,19 @@ class cql_server {
         output_stream<char> _write_buf;
         seastar::gate _pending_requests_gate;
         future<> _ready_to_respond = make_ready_future<>();
+        struct pending_response {
+            foreign_ptr<shared_ptr<cql_server::response>> response;
+            bool compression;
+        };
+        // Responses waiting for the next flush of _write_buf.
+        std::vector<pending_response> _pending_responses;
         cql_protocol_version_type _version = 0;
         cql_serialization_format _cql_serialization_format = cql_serialization_format::latest();
         service::client_state _client_state;
         std::unordered_map<uint16_t, cql_query_state> _query_states;
         unsigned _request_cpu = 0;
+        cql_compression _compression = cql_compression::none;
+        cql_compression_stats _compression_stats;
 
         enum class state : uint8_t {
             UNINITIALIZED, AUTHENTICATION, READY
@@ -151,10 +200,22 @@ class cql_server {
         future<> process();
         future<> process_request();
         future<> shutdown();
+        const cql_compression_stats& compression_stats() const {
+            return _compression_stats;
+        }
     private:
-        future<response_type> process_request_one(bytes_view buf, uint8_t op, uint16_t stream, service::client_state client_state, tracing_request_type tracing_request);
+        // Where a request is to be executed. The options of a routed EXECUTE
+        // are parsed while routing it, and handed over to the shard which
+        // executes it.
+        struct request_route {
+            std::experimental::optional<unsigned> shard;
+            std::unique_ptr<cql3::query_options> options;
+        };
+        future<response_type> process_request_one(bytes_view buf, uint8_t op, uint16_t stream, service::client_state client_state, tracing_request_type tracing_request, std::unique_ptr<cql3::query_options> options);
         unsigned frame_size() const;
         unsigned pick_request_cpu();
+        request_route route_request(cql_binary_opcode op, bytes_view buf);
+        admission_controller::request_kind classify_request(cql_binary_opcode op, bytes_view buf);
         cql_binary_frame_v3 parse_frame(temporary_buffer<char> buf);
         future<temporary_buffer<char>> read_and_decompress_frame(size_t length, uint8_t flags);
         future<std::experimental::optional<cql_binary_frame_v3>> read_frame();
@@ -163,7 +224,7 @@ class cql_server {
         future<response_type> process_options(uint16_t stream, bytes_view buf, service::client_state client_state);
         future<response_type> process_query(uint16_t stream, bytes_view buf, service::client_state client_state);
         future<response_type> process_prepare(uint16_t stream, bytes_view buf, service::client_state client_state);
-        future<response_type> process_execute(uint16_t stream, bytes_view buf, service::client_state client_state);
+        future<response_type> process_execute(uint16_t stream, bytes_view buf, service::client_state client_state, std::unique_ptr<cql3::query_options> options);
         future<response_type> process_batch(uint16_t stream, bytes_view buf, service::client_state client_state);
         future<response_type> process_register(uint16_t stream, bytes_view buf, service::client_state client_state);
 
@@ -184,6 +245,8 @@ class cql_server {
         shared_ptr<cql_server::response> make_auth_challenge(int16_t, bytes);
 
         future<> write_response(foreign_ptr<shared_ptr<cql_server::response>>&& response, bool compression = false);
+        future<> flush_responses();
+        temporary_buffer<char> decompress(temporary_buffer<char> buf);
 
         void check_room(bytes_view& buf, size_t n);
         void validate_utf8(sstring_view s);
@@ -220,6 +283,7 @@ class cql_server {
     uint64_t _current_connections = 0;
     uint64_t _connections_being_accepted = 0;
 private:
+    cql_compression_stats compression_stats() const;
     void maybe_idle() {
         if (_stopping && !_connections_being_accepted && !_current_connections) {
             _all_connections_stopped.set_value();
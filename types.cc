@@ -93,7 +93,7 @@ struct simple_type_traits<db_clock::time_point> {
 template <typename T>
 struct simple_type_impl : concrete_type<T> {
     simple_type_impl(sstring name) : concrete_type<T>(std::move(name)) {}
-    virtual int32_t compare(bytes_view v1, bytes_view v2) const override {
+    static int32_t compare_values(bytes_view v1, bytes_view v2) {
         if (v1.empty()) {
             return v2.empty() ? 0 : -1;
         }
@@ -104,6 +104,9 @@ struct simple_type_impl : concrete_type<T> {
         T b = simple_type_traits<T>::read_nonempty(v2);
         return a == b ? 0 : a < b ? -1 : 1;
     }
+    virtual int32_t compare(bytes_view v1, bytes_view v2) const override {
+        return compare_values(v1, v2);
+    }
     virtual bool less(bytes_view v1, bytes_view v2) const override {
         return compare(v1, v2) < 0;
     }
@@ -124,6 +127,9 @@ struct simple_type_impl : concrete_type<T> {
 template<typename T>
 struct integer_type_impl : simple_type_impl<T> {
     integer_type_impl(sstring name) : simple_type_impl<T>(name) {}
+    virtual native_tri_comparator get_native_tri_comparator() const override {
+        return &simple_type_impl<T>::compare_values;
+    }
     virtual void serialize(const void* value, bytes::iterator& out) const override {
         if (!value) {
             return;
@@ -233,6 +239,12 @@ struct string_type_impl : public concrete_type<sstring> {
     virtual bool less(bytes_view v1, bytes_view v2) const override {
         return less_unsigned(v1, v2);
     }
+    virtual int32_t compare(bytes_view v1, bytes_view v2) const override {
+        return compare_unsigned(v1, v2);
+    }
+    virtual native_tri_comparator get_native_tri_comparator() const override {
+        return &compare_unsigned;
+    }
     virtual bool is_byte_order_equal() const override {
         return true;
     }
@@ -306,6 +318,12 @@ struct bytes_type_impl final : public concrete_type<bytes> {
     virtual bool less(bytes_view v1, bytes_view v2) const override {
         return less_unsigned(v1, v2);
     }
+    virtual int32_t compare(bytes_view v1, bytes_view v2) const override {
+        return compare_unsigned(v1, v2);
+    }
+    virtual native_tri_comparator get_native_tri_comparator() const override {
+        return &compare_unsigned;
+    }
     virtual bool is_byte_order_equal() const override {
         return true;
     }
@@ -336,6 +354,9 @@ struct bytes_type_impl final : public concrete_type<bytes> {
 
 struct boolean_type_impl : public simple_type_impl<bool> {
     boolean_type_impl() : simple_type_impl<bool>(boolean_type_name) {}
+    virtual native_tri_comparator get_native_tri_comparator() const override {
+        return &compare_values;
+    }
     void serialize_value(maybe_empty<bool> value, bytes::iterator& out) const {
         if (!value.empty()) {
             *out++ = char(value);
@@ -497,19 +518,32 @@ struct timeuuid_type_impl : public concrete_type<utils::UUID> {
         }
         return make_value(utils::UUID(msb, lsb));
     }
-    virtual bool less(bytes_view b1, bytes_view b2) const override {
+    static int32_t compare_values(bytes_view b1, bytes_view b2) {
         if (b1.empty()) {
-            return b2.empty() ? false : true;
+            return b2.empty() ? 0 : -1;
         }
         if (b2.empty()) {
-            return false;
+            return 1;
         }
         auto r = compare_bytes(b1, b2);
         if (r != 0) {
-            return r < 0;
-        } else {
-            return std::lexicographical_compare(b1.begin(), b1.end(), b2.begin(), b2.end());
+            return r;
+        }
+        // Bytes compare as signed here, like in std::lexicographical_compare()
+        auto i = std::mismatch(b1.begin(), b1.end(), b2.begin(), b2.end());
+        if (i.first == b1.end() || i.second == b2.end()) {
+            return int32_t(i.second == b2.end()) - int32_t(i.first == b1.end());
         }
+        return *i.first < *i.second ? -1 : 1;
+    }
+    virtual bool less(bytes_view b1, bytes_view b2) const override {
+        return compare_values(b1, b2) < 0;
+    }
+    virtual int32_t compare(bytes_view b1, bytes_view b2) const override {
+        return compare_values(b1, b2);
+    }
+    virtual native_tri_comparator get_native_tri_comparator() const override {
+        return &compare_values;
     }
     virtual bool is_byte_order_equal() const override {
         return true;
@@ -574,6 +608,9 @@ class timestamp_type_impl : public simple_type_impl<db_clock::time_point> {
     static logging::logger _logger;
 public:
     timestamp_type_impl() : simple_type_impl(timestamp_type_name) {}
+    virtual native_tri_comparator get_native_tri_comparator() const override {
+        return &compare_values;
+    }
     virtual void serialize(const void* value, bytes::iterator& out) const override {
         if (!value) {
             return;
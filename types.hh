@@ -359,6 +359,10 @@ class data_value {
 class serialized_compare;
 class user_type_impl;
 
+// A trichotomic comparator of serialized values of a particular type, which
+// is called directly rather than through the type.
+using native_tri_comparator = int32_t (*)(bytes_view, bytes_view);
+
 class abstract_type : public enable_shared_from_this<abstract_type> {
     sstring _name;
 public:
@@ -455,6 +459,12 @@ class abstract_type : public enable_shared_from_this<abstract_type> {
     virtual bool is_byte_order_comparable() const {
         return false;
     }
+    // Returns a function comparing values of this type the same way as
+    // compare(), or nullptr if the type has none. Implemented by the types
+    // common in keys.
+    virtual native_tri_comparator get_native_tri_comparator() const {
+        return nullptr;
+    }
 
     /**
      * When returns true then equal values have the same byte representation and if byte
@@ -686,6 +696,43 @@ bool equal(data_type t, bytes_view e1, bytes_view e2) {
     return t->equal(e1, e2);
 }
 
+// Compares values of a type, through the type's native comparator when it
+// has one. Key types build these once per schema, so that comparing keys of
+// the common shapes costs neither a virtual call per component nor a copy
+// of the type pointer.
+class value_comparator {
+    native_tri_comparator _native = nullptr;
+    bool _reversed = false;
+    data_type _type;
+public:
+    explicit value_comparator(data_type type)
+        : _type(std::move(type)) {
+        auto t = _type;
+        if (t->is_reversed()) {
+            _reversed = true;
+            t = t->underlying_type();
+        }
+        _native = t->get_native_tri_comparator();
+    }
+    const data_type& type() const {
+        return _type;
+    }
+    int32_t operator()(bytes_view v1, bytes_view v2) const {
+        if (_native) {
+            return _reversed ? _native(v2, v1) : _native(v1, v2);
+        }
+        return _type->compare(v1, v2);
+    }
+};
+
+// Adapts a sequence of value_comparators to lexicographical_tri_compare()
+// and prefix_equality_tri_compare(), in place of a sequence of types.
+struct value_comparator_tri_compare {
+    int32_t operator()(const value_comparator& c, bytes_view v1, bytes_view v2) const {
+        return c(v1, v2);
+    }
+};
+
 class collection_type_impl : public abstract_type {
     static logging::logger _logger;
     static thread_local std::unordered_map<data_type, shared_ptr<cql3::cql3_type>> _cql3_type_cache;  // initialized on demand